@@ -240,11 +240,14 @@ gboolean                                                                \
 G_PASTE (prefix, _create) (type *,                                      \
     const GstVaapiCodecObjectConstructorArgs * args);                   \
                                                                         \
+static GstVaapiMiniObjectCache G_PASTE (type, Cache);                   \
+                                                                        \
 static const GstVaapiCodecObjectClass G_PASTE (type, Class) = {         \
   .parent_class = {                                                     \
     .size = sizeof (type),                                              \
     .finalize = (GstVaapiCodecObjectDestroyFunc)                        \
-        G_PASTE (prefix, _destroy)                                      \
+        G_PASTE (prefix, _destroy),                                     \
+    .cache = &G_PASTE (type, Cache),                                    \
   },                                                                    \
   .create = (GstVaapiCodecObjectCreateFunc)                             \
       G_PASTE (prefix, _create),                                        \
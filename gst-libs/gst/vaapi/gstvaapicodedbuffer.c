@@ -46,8 +46,10 @@ coded_buffer_create (GstVaapiCodedBuffer * buf, guint buf_size,
   if (!success)
     return FALSE;
 
-  GST_DEBUG ("coded buffer %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (buf_id));
+  GST_DEBUG ("coded buffer %" GST_VAAPI_ID_FORMAT ", %u bytes",
+      GST_VAAPI_ID_ARGS (buf_id), buf_size);
   GST_VAAPI_OBJECT_ID (buf) = buf_id;
+  buf->buf_size = buf_size;
   return TRUE;
 }
 
@@ -68,28 +70,32 @@ coded_buffer_destroy (GstVaapiCodedBuffer * buf)
   }
 }
 
+/* Mappings nest, so that the segments can be wrapped into memory
+   objects released from other threads, independently of the copies */
 static gboolean
 coded_buffer_map (GstVaapiCodedBuffer * buf)
 {
-  if (buf->segment_list)
-    return TRUE;
+  gboolean success = TRUE;
 
   GST_VAAPI_OBJECT_LOCK_DISPLAY (buf);
-  buf->segment_list = vaapi_map_buffer (GST_VAAPI_OBJECT_VADISPLAY (buf),
-      GST_VAAPI_OBJECT_ID (buf));
+  if (buf->map_count == 0) {
+    buf->segment_list = vaapi_map_buffer (GST_VAAPI_OBJECT_VADISPLAY (buf),
+        GST_VAAPI_OBJECT_ID (buf));
+    success = buf->segment_list != NULL;
+  }
+  if (success)
+    buf->map_count++;
   GST_VAAPI_OBJECT_UNLOCK_DISPLAY (buf);
-  return buf->segment_list != NULL;
+  return success;
 }
 
 static void
 coded_buffer_unmap (GstVaapiCodedBuffer * buf)
 {
-  if (!buf->segment_list)
-    return;
-
   GST_VAAPI_OBJECT_LOCK_DISPLAY (buf);
-  vaapi_unmap_buffer (GST_VAAPI_OBJECT_VADISPLAY (buf),
-      GST_VAAPI_OBJECT_ID (buf), (void **) &buf->segment_list);
+  if (buf->map_count > 0 && --buf->map_count == 0)
+    vaapi_unmap_buffer (GST_VAAPI_OBJECT_VADISPLAY (buf),
+        GST_VAAPI_OBJECT_ID (buf), (void **) &buf->segment_list);
   GST_VAAPI_OBJECT_UNLOCK_DISPLAY (buf);
 }
 
@@ -133,12 +139,17 @@ error:
   return NULL;
 }
 
-/*
+/**
  * gst_vaapi_coded_buffer_map:
  * @buf: a #GstVaapiCodedBuffer
- * @data: pointer to the mapped buffer data (VACodedBufferSegment)
+ * @out_segment_list_ptr: return location for the mapped buffer data
+ *   (VACodedBufferSegment)
  *
- * Maps the VA coded buffer and returns the data pointer into @data.
+ * Maps the VA coded buffer and returns the list of coded segments
+ * into @out_segment_list_ptr. The segments remain valid until the
+ * matching call to gst_vaapi_coded_buffer_unmap(). Mappings nest, and
+ * the VA buffer is actually unmapped with the last call to
+ * gst_vaapi_coded_buffer_unmap().
  *
  * Return value: %TRUE if successful, %FALSE otherwise
  */
@@ -156,11 +167,12 @@ gst_vaapi_coded_buffer_map (GstVaapiCodedBuffer * buf,
   return TRUE;
 }
 
-/*
+/**
  * gst_vaapi_coded_buffer_unmap:
  * @buf: a #GstVaapiCodedBuffer
  *
- * Unamps the VA coded buffer.
+ * Unmaps the VA coded buffer, as previously mapped with
+ * gst_vaapi_coded_buffer_map().
  */
 void
 gst_vaapi_coded_buffer_unmap (GstVaapiCodedBuffer * buf)
@@ -199,6 +211,39 @@ gst_vaapi_coded_buffer_get_size (GstVaapiCodedBuffer * buf)
   return size;
 }
 
+/**
+ * gst_vaapi_coded_buffer_is_truncated:
+ * @buf: a #GstVaapiCodedBuffer
+ *
+ * Checks whether the driver reported that the coded data did not fit
+ * into the VA coded buffer, through the
+ * %VA_CODED_BUF_STATUS_SLICE_OVERFLOW_MASK status bits of any of its
+ * segments.
+ *
+ * Return value: %TRUE if the coded data is truncated
+ */
+gboolean
+gst_vaapi_coded_buffer_is_truncated (GstVaapiCodedBuffer * buf)
+{
+  VACodedBufferSegment *segment;
+  gboolean truncated = FALSE;
+
+  g_return_val_if_fail (buf != NULL, FALSE);
+
+  if (!coded_buffer_map (buf))
+    return FALSE;
+
+  for (segment = buf->segment_list; segment != NULL; segment = segment->next) {
+    if (segment->status & VA_CODED_BUF_STATUS_SLICE_OVERFLOW_MASK) {
+      truncated = TRUE;
+      break;
+    }
+  }
+
+  coded_buffer_unmap (buf);
+  return truncated;
+}
+
 /**
  * gst_vaapi_coded_buffer_copy_into:
  * @dest: the destination #GstBuffer
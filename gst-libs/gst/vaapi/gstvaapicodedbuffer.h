@@ -24,6 +24,8 @@
 #ifndef GST_VAAPI_CODED_BUFFER_H
 #define GST_VAAPI_CODED_BUFFER_H
 
+#include <va/va.h>
+
 G_BEGIN_DECLS
 
 #define GST_VAAPI_CODED_BUFFER(obj) \
@@ -45,9 +47,19 @@ typedef struct _GstVaapiCodedBufferPool         GstVaapiCodedBufferPool;
 gssize
 gst_vaapi_coded_buffer_get_size (GstVaapiCodedBuffer * buf);
 
+gboolean
+gst_vaapi_coded_buffer_is_truncated (GstVaapiCodedBuffer * buf);
+
 gboolean
 gst_vaapi_coded_buffer_copy_into (GstBuffer * dest, GstVaapiCodedBuffer * src);
 
+gboolean
+gst_vaapi_coded_buffer_map (GstVaapiCodedBuffer * buf,
+    VACodedBufferSegment ** out_segment_list_ptr);
+
+void
+gst_vaapi_coded_buffer_unmap (GstVaapiCodedBuffer * buf);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CODED_BUFFER_H */
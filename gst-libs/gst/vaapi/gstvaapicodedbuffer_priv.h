@@ -47,6 +47,8 @@ struct _GstVaapiCodedBuffer
 
   GstVaapiContext      *context;
   VACodedBufferSegment *segment_list;
+  guint                 map_count;
+  guint                 buf_size;
 };
 
 /**
@@ -64,15 +66,6 @@ G_GNUC_INTERNAL
 GstVaapiCodedBuffer *
 gst_vaapi_coded_buffer_new (GstVaapiContext * context, guint buf_size);
 
-G_GNUC_INTERNAL
-gboolean
-gst_vaapi_coded_buffer_map (GstVaapiCodedBuffer * buf,
-    VACodedBufferSegment ** out_segment_list_ptr);
-
-G_GNUC_INTERNAL
-void
-gst_vaapi_coded_buffer_unmap (GstVaapiCodedBuffer * buf);
-
 G_END_DECLS
 
 #endif /* GST_VAAPI_CODED_BUFFER_PRIV_H */
@@ -26,9 +26,38 @@
 #include "gstvaapivideopool_priv.h"
 #include "gstvaapiencoder_priv.h"
 
+#include <stdlib.h>
+
 #define DEBUG 1
 #include "gstvaapidebug.h"
 
+/* Number of coded sizes tracked for intra and inter pictures */
+#define INTRA_WINDOW_SIZE       8
+#define INTER_WINDOW_SIZE       128
+
+/* Minimum number of coded sizes before buffers get resized */
+#define MIN_SAMPLES             16
+
+/* Percentile of the inter picture sizes to account for. Intra
+   pictures are rare, so their largest size is always accounted for */
+#define INTER_PERCENTILE        95
+
+/* Space reserved by drivers for the coded segment headers */
+#define SEGMENT_HEADER_SIZE     4096
+
+/* Headroom on top of twice the largest sizes, as a fraction of the
+   latter and in bytes, for bitrate peaks the windows did not catch */
+#define SAFETY_MARGIN_RATIO     4
+#define SAFETY_MARGIN_SIZE      (64 * 1024)
+
+typedef struct
+{
+  guint sizes[INTER_WINDOW_SIZE];
+  guint max_len;
+  guint len;
+  guint pos;
+} SizeWindow;
+
 /**
  * GstVaapiCodedBufferPool:
  *
@@ -41,14 +70,90 @@ struct _GstVaapiCodedBufferPool
 
   GstVaapiContext *context;
   gsize buf_size;
+  gsize max_buf_size;
+
+  /* coded size statistics, protected by the base pool lock */
+  SizeWindow intra_sizes;
+  SizeWindow inter_sizes;
+  gsize optimal_buf_size;
+  gboolean overflowed;
 };
 
+static void
+size_window_init (SizeWindow * window, guint max_len)
+{
+  window->max_len = max_len;
+  window->len = 0;
+  window->pos = 0;
+}
+
+static void
+size_window_add (SizeWindow * window, guint size)
+{
+  window->sizes[window->pos] = size;
+  window->pos = (window->pos + 1) % window->max_len;
+  if (window->len < window->max_len)
+    window->len++;
+}
+
+static gint
+compare_sizes (gconstpointer a, gconstpointer b)
+{
+  const guint size_a = *(const guint *) a;
+  const guint size_b = *(const guint *) b;
+
+  return size_a < size_b ? -1 : size_a > size_b;
+}
+
+static guint
+size_window_get_percentile (SizeWindow * window, guint percentile)
+{
+  guint sizes[INTER_WINDOW_SIZE];
+  guint index;
+
+  if (window->len == 0)
+    return 0;
+
+  memcpy (sizes, window->sizes, window->len * sizeof (sizes[0]));
+  qsort (sizes, window->len, sizeof (sizes[0]), compare_sizes);
+
+  index = (window->len * percentile + 99) / 100;
+  return sizes[MAX (index, 1) - 1];
+}
+
 static void
 coded_buffer_pool_init (GstVaapiCodedBufferPool * pool,
     GstVaapiContext * context, gsize buf_size)
 {
   pool->context = gst_vaapi_object_ref (context);
   pool->buf_size = buf_size;
+  pool->max_buf_size = buf_size;
+
+  size_window_init (&pool->intra_sizes, INTRA_WINDOW_SIZE);
+  size_window_init (&pool->inter_sizes, INTER_WINDOW_SIZE);
+  pool->optimal_buf_size = buf_size;
+  pool->overflowed = FALSE;
+}
+
+/* Sizes buffers twice as large as the largest pictures seen lately,
+   plus a safety margin */
+static void
+coded_buffer_pool_update_optimal_size (GstVaapiCodedBufferPool * pool)
+{
+  gsize size, margin;
+
+  if (pool->overflowed ||
+      pool->intra_sizes.len + pool->inter_sizes.len < MIN_SAMPLES) {
+    pool->optimal_buf_size = pool->max_buf_size;
+    return;
+  }
+
+  size = MAX (size_window_get_percentile (&pool->intra_sizes, 100),
+      size_window_get_percentile (&pool->inter_sizes, INTER_PERCENTILE));
+  size *= 2;
+  margin = MAX (size / SAFETY_MARGIN_RATIO, SAFETY_MARGIN_SIZE);
+  size = GST_ROUND_UP_N (size + margin + SEGMENT_HEADER_SIZE, 4096);
+  pool->optimal_buf_size = MIN (size, pool->max_buf_size);
 }
 
 static void
@@ -116,8 +221,10 @@ gst_vaapi_coded_buffer_pool_new (GstVaapiEncoder * encoder, gsize buf_size)
  * gst_vaapi_coded_buffer_pool_get_buffer_size:
  * @pool: a #GstVaapiCodedBufferPool
  *
- * Determines the maximum size of each #GstVaapiCodedBuffer held in
- * the @pool.
+ * Determines the size of each #GstVaapiCodedBuffer allocated by the
+ * @pool. This may be less than the maximum size supplied to
+ * gst_vaapi_coded_buffer_pool_new(), if the pool was created by
+ * gst_vaapi_coded_buffer_pool_new_resized().
  *
  * Return value: size of a #GstVaapiCodedBuffer in @pool
  */
@@ -128,3 +235,103 @@ gst_vaapi_coded_buffer_pool_get_buffer_size (GstVaapiCodedBufferPool * pool)
 
   return pool->buf_size;
 }
+
+/* Determines the maximum size of coded buffers, as supplied to
+   gst_vaapi_coded_buffer_pool_new() */
+gsize
+gst_vaapi_coded_buffer_pool_get_max_buffer_size (GstVaapiCodedBufferPool *
+    pool)
+{
+  g_return_val_if_fail (pool != NULL, 0);
+
+  return pool->max_buf_size;
+}
+
+/* Creates a new pool of buffers of @buf_size bytes, inheriting the
+   statistics, capacity and maximum buffer size of @pool. Buffers in
+   use are returned to @pool, which lives until they are released */
+GstVaapiVideoPool *
+gst_vaapi_coded_buffer_pool_new_resized (GstVaapiCodedBufferPool * pool,
+    gsize buf_size)
+{
+  GstVaapiVideoPool *const base_pool = GST_VAAPI_VIDEO_POOL (pool);
+  GstVaapiCodedBufferPool *new_pool;
+
+  g_return_val_if_fail (pool != NULL, NULL);
+  g_return_val_if_fail (buf_size > 0, NULL);
+
+  new_pool = (GstVaapiCodedBufferPool *)
+      gst_vaapi_mini_object_new (gst_vaapi_coded_buffer_pool_class ());
+  if (!new_pool)
+    return NULL;
+
+  gst_vaapi_video_pool_init (GST_VAAPI_VIDEO_POOL (new_pool),
+      GST_VAAPI_OBJECT_DISPLAY (pool->context),
+      GST_VAAPI_VIDEO_POOL_OBJECT_TYPE_CODED_BUFFER);
+  coded_buffer_pool_init (new_pool, pool->context,
+      MIN (buf_size, pool->max_buf_size));
+  new_pool->max_buf_size = pool->max_buf_size;
+  gst_vaapi_video_pool_set_capacity (GST_VAAPI_VIDEO_POOL (new_pool),
+      gst_vaapi_video_pool_get_capacity (base_pool));
+
+  g_mutex_lock (&base_pool->mutex);
+  new_pool->intra_sizes = pool->intra_sizes;
+  new_pool->inter_sizes = pool->inter_sizes;
+  new_pool->optimal_buf_size = pool->optimal_buf_size;
+  new_pool->overflowed = pool->overflowed;
+  g_mutex_unlock (&base_pool->mutex);
+
+  GST_DEBUG ("resize coded buffers from %" G_GSIZE_FORMAT " to %"
+      G_GSIZE_FORMAT " bytes", pool->buf_size, new_pool->buf_size);
+  return GST_VAAPI_VIDEO_POOL (new_pool);
+}
+
+/* Accounts for the size of the coded data in @buf, once encoding
+   completed. Returns FALSE if the driver reported that the data was
+   truncated. Adaptive sizing is then disabled for good if @buf was
+   smaller than the maximum size */
+gboolean
+gst_vaapi_coded_buffer_pool_update_stats (GstVaapiCodedBufferPool * pool,
+    GstVaapiCodedBuffer * buf, gboolean is_intra)
+{
+  GstVaapiVideoPool *const base_pool = GST_VAAPI_VIDEO_POOL (pool);
+  gssize size;
+  gboolean truncated;
+
+  g_return_val_if_fail (pool != NULL, FALSE);
+  g_return_val_if_fail (buf != NULL, FALSE);
+
+  size = gst_vaapi_coded_buffer_get_size (buf);
+  if (size < 0)
+    return TRUE;
+  truncated = gst_vaapi_coded_buffer_is_truncated (buf);
+
+  g_mutex_lock (&base_pool->mutex);
+  if (truncated && buf->buf_size < pool->max_buf_size && !pool->overflowed) {
+    GST_WARNING ("coded data overflowed the %u bytes buffer, use %"
+        G_GSIZE_FORMAT " bytes buffers from now on", buf->buf_size,
+        pool->max_buf_size);
+    pool->overflowed = TRUE;
+  }
+  size_window_add (is_intra ? &pool->intra_sizes : &pool->inter_sizes, size);
+  coded_buffer_pool_update_optimal_size (pool);
+  g_mutex_unlock (&base_pool->mutex);
+  return !truncated;
+}
+
+/* Determines the size that buffers should have, based on the coded
+   sizes seen so far */
+gsize
+gst_vaapi_coded_buffer_pool_get_optimal_buffer_size (GstVaapiCodedBufferPool *
+    pool)
+{
+  GstVaapiVideoPool *const base_pool = GST_VAAPI_VIDEO_POOL (pool);
+  gsize size;
+
+  g_return_val_if_fail (pool != NULL, 0);
+
+  g_mutex_lock (&base_pool->mutex);
+  size = pool->optimal_buf_size;
+  g_mutex_unlock (&base_pool->mutex);
+  return size;
+}
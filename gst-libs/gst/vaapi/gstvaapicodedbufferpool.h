@@ -40,6 +40,26 @@ gst_vaapi_coded_buffer_pool_new (struct _GstVaapiEncoder * encoder,
 gsize
 gst_vaapi_coded_buffer_pool_get_buffer_size (GstVaapiCodedBufferPool * pool);
 
+G_GNUC_INTERNAL
+gsize
+gst_vaapi_coded_buffer_pool_get_max_buffer_size (GstVaapiCodedBufferPool *
+    pool);
+
+G_GNUC_INTERNAL
+GstVaapiVideoPool *
+gst_vaapi_coded_buffer_pool_new_resized (GstVaapiCodedBufferPool * pool,
+    gsize buf_size);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_coded_buffer_pool_update_stats (GstVaapiCodedBufferPool * pool,
+    GstVaapiCodedBuffer * buf, gboolean is_intra);
+
+G_GNUC_INTERNAL
+gsize
+gst_vaapi_coded_buffer_pool_get_optimal_buffer_size (GstVaapiCodedBufferPool *
+    pool);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CODED_BUFFER_POOL_H */
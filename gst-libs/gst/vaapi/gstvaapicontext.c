@@ -31,6 +31,7 @@
 #include "gstvaapicompat.h"
 #include "gstvaapicontext.h"
 #include "gstvaapicontext_overlay.h"
+#include "gstvaapicontext_buffers.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
 #include "gstvaapisurface.h"
@@ -87,6 +88,8 @@ context_destroy (GstVaapiContext * context)
   context_id = GST_VAAPI_OBJECT_ID (context);
   GST_DEBUG ("context 0x%08x", context_id);
 
+  gst_vaapi_context_buffers_reset (context);
+
   if (context_id != VA_INVALID_ID) {
     GST_VAAPI_DISPLAY_LOCK (display);
     status = vaDestroyContext (GST_VAAPI_DISPLAY_VADISPLAY (display),
@@ -108,11 +111,33 @@ context_destroy (GstVaapiContext * context)
   }
 }
 
+static inline guint
+context_get_num_surfaces (const GstVaapiContextInfo * cip)
+{
+  return cip->ref_frames + SCRATCH_SURFACES_COUNT + cip->surface_headroom;
+}
+
+/* Forces the driver to commit the surface backing store now, rather
+   than on the first decode operation. Failure is not fatal as some
+   drivers cannot derive images from all surface formats */
+static void
+context_prewarm_surface (GstVaapiSurface * surface)
+{
+  GstVaapiImage *image;
+
+  image = gst_vaapi_surface_derive_image (surface);
+  if (image)
+    gst_vaapi_object_unref (image);
+  else
+    GST_DEBUG ("could not pre-warm surface %" GST_VAAPI_ID_FORMAT,
+        GST_VAAPI_ID_ARGS (GST_VAAPI_OBJECT_ID (surface)));
+}
+
 static gboolean
 context_ensure_surfaces (GstVaapiContext * context)
 {
   const GstVaapiContextInfo *const cip = &context->info;
-  const guint num_surfaces = cip->ref_frames + SCRATCH_SURFACES_COUNT;
+  const guint num_surfaces = context_get_num_surfaces (cip);
   GstVaapiSurface *surface;
   guint i;
 
@@ -121,6 +146,8 @@ context_ensure_surfaces (GstVaapiContext * context)
         cip->chroma_type, cip->width, cip->height);
     if (!surface)
       return FALSE;
+    if (cip->prewarm_surfaces)
+      context_prewarm_surface (surface);
     gst_vaapi_surface_set_parent_context (surface, context);
     g_ptr_array_add (context->surfaces, surface);
     if (!gst_vaapi_video_pool_add_object (context->surfaces_pool, surface))
@@ -140,7 +167,7 @@ context_create_surfaces (GstVaapiContext * context)
   if (!gst_vaapi_context_overlay_reset (context))
     return FALSE;
 
-  num_surfaces = cip->ref_frames + SCRATCH_SURFACES_COUNT;
+  num_surfaces = context_get_num_surfaces (cip);
   if (!context->surfaces) {
     context->surfaces = g_ptr_array_new_full (num_surfaces,
         (GDestroyNotify) unref_surface_cb);
@@ -324,6 +351,7 @@ gst_vaapi_context_init (GstVaapiContext * context,
 
   context->va_config = VA_INVALID_ID;
   gst_vaapi_context_overlay_init (context);
+  gst_vaapi_context_buffers_init (context);
 }
 
 static void
@@ -332,6 +360,7 @@ gst_vaapi_context_finalize (GstVaapiContext * context)
   context_destroy (context);
   context_destroy_surfaces (context);
   gst_vaapi_context_overlay_finalize (context);
+  gst_vaapi_context_buffers_finalize (context);
 }
 
 GST_VAAPI_OBJECT_DEFINE_CLASS (GstVaapiContext, gst_vaapi_context);
@@ -417,6 +446,12 @@ gst_vaapi_context_reset (GstVaapiContext * context,
     grow_surfaces = TRUE;
   }
 
+  if (cip->surface_headroom < new_cip->surface_headroom) {
+    cip->surface_headroom = new_cip->surface_headroom;
+    grow_surfaces = TRUE;
+  }
+  cip->prewarm_surfaces = new_cip->prewarm_surfaces;
+
   if (cip->usage != new_cip->usage) {
     cip->usage = new_cip->usage;
     reset_config = TRUE;
@@ -499,3 +534,28 @@ gst_vaapi_context_get_surface_count (GstVaapiContext * context)
 
   return gst_vaapi_video_pool_get_size (context->surfaces_pool);
 }
+
+/**
+ * gst_vaapi_context_get_surface_pool_stats:
+ * @context: a #GstVaapiContext
+ * @stats: return location for the #GstVaapiVideoPoolStats
+ *
+ * Retrieves the usage statistics of the surface pool, i.e. how many
+ * surfaces were allocated and how often the pool ran out of free
+ * surfaces.
+ *
+ * Return value: %TRUE if @context has a surface pool
+ */
+gboolean
+gst_vaapi_context_get_surface_pool_stats (GstVaapiContext * context,
+    GstVaapiVideoPoolStats * stats)
+{
+  g_return_val_if_fail (context != NULL, FALSE);
+  g_return_val_if_fail (stats != NULL, FALSE);
+
+  if (!context->surfaces_pool)
+    return FALSE;
+
+  gst_vaapi_video_pool_get_stats (context->surfaces_pool, stats);
+  return TRUE;
+}
@@ -31,6 +31,7 @@
 #include "gstvaapidisplay.h"
 #include "gstvaapisurface.h"
 #include "gstvaapivideopool.h"
+#include "gstvaapivideopool_priv.h"
 
 G_BEGIN_DECLS
 
@@ -75,6 +76,12 @@ struct _GstVaapiConfigInfoEncoder
  * Structure holding VA context info like encoded size, decoder
  * profile and entry-point to use, and maximum number of reference
  * frames reported by the bitstream.
+ *
+ * @surface_headroom extra surfaces are allocated on top of those
+ * needed for decoding, so that downstream elements can hold frames
+ * without starving the decoder. If @prewarm_surfaces is set, the
+ * backing store of all surfaces is committed at creation time rather
+ * than on first use.
  */
 struct _GstVaapiContextInfo
 {
@@ -85,6 +92,8 @@ struct _GstVaapiContextInfo
   guint width;
   guint height;
   guint ref_frames;
+  guint surface_headroom;
+  gboolean prewarm_surfaces;
   union _GstVaapiConfigInfo {
     GstVaapiConfigInfoEncoder encoder;
   } config;
@@ -108,6 +117,7 @@ struct _GstVaapiContext
   GstVaapiVideoPool *surfaces_pool;
   GPtrArray *overlays[2];
   guint overlay_id;
+  gpointer buffer_pool;
 };
 
 /**
@@ -143,6 +153,11 @@ G_GNUC_INTERNAL
 guint
 gst_vaapi_context_get_surface_count (GstVaapiContext * context);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_context_get_surface_pool_stats (GstVaapiContext * context,
+    GstVaapiVideoPoolStats * stats);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CONTEXT_H */
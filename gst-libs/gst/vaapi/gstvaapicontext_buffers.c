@@ -0,0 +1,445 @@
+/*
+ *  gstvaapicontext_buffers.c - VA context abstraction (VA buffers pool)
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include "gstvaapicompat.h"
+#include "gstvaapicontext_buffers.h"
+#include "gstvaapiobject_priv.h"
+#include "gstvaapiutils.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Smallest allocation for slice data buffers. Larger ones are rounded
+   up to one of 4 size classes per power of two, i.e. by at most 25%, so
+   that they could be shared across slices of various sizes */
+#define MIN_DATA_BUFFER_SIZE (4096)
+#define DATA_BUFFER_CLASSES_SHIFT (2)
+
+/* Minimum time between two trimming passes, in microseconds */
+#define TRIM_PERIOD (G_USEC_PER_SEC)
+
+/* A released VA buffer that the hardware may still read from, until
+   the surface it was rendered to is complete */
+typedef struct
+{
+  VABufferID buf_id;
+  VASurfaceID surface_id;
+} GstVaapiBusyBuffer;
+
+typedef struct _GstVaapiBufferBucket GstVaapiBufferBucket;
+struct _GstVaapiBufferBucket
+{
+  VABufferType type;
+  guint size;
+  GQueue free_buffers;
+  GQueue busy_buffers;
+  guint in_use;
+  guint peak_in_use;
+};
+
+typedef struct _GstVaapiBufferPool GstVaapiBufferPool;
+struct _GstVaapiBufferPool
+{
+  GMutex mutex;
+  GPtrArray *buckets;
+  guint generation;
+  gint64 last_trim_time;
+  guint64 hits;
+  guint64 misses;
+};
+
+#define BUFFER_POOL(context) \
+  ((GstVaapiBufferPool *) (context)->buffer_pool)
+
+static guint
+get_alloc_size (VABufferType type, guint size)
+{
+  /* Parameter buffers are sized after fixed structures, so only slice
+     data buffers are bucketed by size class */
+  guint step;
+
+  if (type != VASliceDataBufferType)
+    return size;
+  if (size <= MIN_DATA_BUFFER_SIZE)
+    return MIN_DATA_BUFFER_SIZE;
+
+  step = 1U << (g_bit_storage (size - 1) - 1 - DATA_BUFFER_CLASSES_SHIFT);
+  return (size + step - 1) & ~(step - 1);
+}
+
+static void
+bucket_destroy_busy_buffers (GstVaapiBufferBucket * bucket, VADisplay dpy)
+{
+  GstVaapiBusyBuffer *busy;
+
+  while ((busy = g_queue_pop_head (&bucket->busy_buffers))) {
+    vaapi_destroy_buffer (dpy, &busy->buf_id);
+    g_slice_free (GstVaapiBusyBuffer, busy);
+  }
+}
+
+/* Makes the buffers whose surface was completely decoded available
+   again. Buffers are released in decoding order, so this stops at the
+   first surface that is still being rendered */
+static void
+bucket_collect_busy_buffers (GstVaapiBufferBucket * bucket, VADisplay dpy)
+{
+  GstVaapiBusyBuffer *busy;
+  VASurfaceID ready_surface = VA_INVALID_SURFACE;
+  VASurfaceStatus surface_status;
+  VAStatus status;
+
+  while ((busy = g_queue_peek_head (&bucket->busy_buffers))) {
+    if (busy->surface_id != ready_surface) {
+      status = vaQuerySurfaceStatus (dpy, busy->surface_id, &surface_status);
+      if (status == VA_STATUS_SUCCESS &&
+          (surface_status & VASurfaceRendering))
+        break;
+      ready_surface = busy->surface_id;
+    }
+    g_queue_pop_head (&bucket->busy_buffers);
+    g_queue_push_tail (&bucket->free_buffers,
+        GUINT_TO_POINTER (busy->buf_id));
+    g_slice_free (GstVaapiBusyBuffer, busy);
+  }
+}
+
+static void
+bucket_destroy_buffers (GstVaapiBufferBucket * bucket, VADisplay dpy,
+    guint max_free_buffers)
+{
+  VABufferID buf_id;
+
+  while (g_queue_get_length (&bucket->free_buffers) > max_free_buffers) {
+    buf_id = GPOINTER_TO_UINT (g_queue_pop_tail (&bucket->free_buffers));
+    vaapi_destroy_buffer (dpy, &buf_id);
+  }
+}
+
+static void
+bucket_free (GstVaapiBufferBucket * bucket)
+{
+  g_assert (g_queue_is_empty (&bucket->free_buffers));
+  g_assert (g_queue_is_empty (&bucket->busy_buffers));
+  g_slice_free (GstVaapiBufferBucket, bucket);
+}
+
+static GstVaapiBufferBucket *
+pool_lookup_bucket (GstVaapiBufferPool * pool, VABufferType type, guint size)
+{
+  GstVaapiBufferBucket *bucket;
+  guint i;
+
+  for (i = 0; i < pool->buckets->len; i++) {
+    bucket = g_ptr_array_index (pool->buckets, i);
+    if (bucket->type == type && bucket->size == size)
+      return bucket;
+  }
+  return NULL;
+}
+
+/* Releases free buffers that were not needed to satisfy the peak usage
+   observed since the last trimming pass */
+static void
+pool_trim (GstVaapiBufferPool * pool, VADisplay dpy, gint64 now)
+{
+  guint i;
+
+  for (i = 0; i < pool->buckets->len; i++) {
+    GstVaapiBufferBucket *const bucket = g_ptr_array_index (pool->buckets, i);
+
+    bucket_destroy_buffers (bucket, dpy, bucket->peak_in_use - bucket->in_use);
+    bucket->peak_in_use = bucket->in_use;
+  }
+  pool->last_trim_time = now;
+}
+
+/* Trims the pool if the last pass is older than TRIM_PERIOD */
+static void
+pool_maybe_trim (GstVaapiBufferPool * pool, VADisplay dpy)
+{
+  const gint64 now = g_get_monotonic_time ();
+
+  if (now - pool->last_trim_time >= TRIM_PERIOD)
+    pool_trim (pool, dpy, now);
+}
+
+gboolean
+gst_vaapi_context_buffers_init (GstVaapiContext * context)
+{
+  GstVaapiBufferPool *pool;
+
+  pool = g_slice_new0 (GstVaapiBufferPool);
+  if (!pool)
+    return FALSE;
+
+  g_mutex_init (&pool->mutex);
+  pool->buckets = g_ptr_array_new_with_free_func ((GDestroyNotify) bucket_free);
+  pool->last_trim_time = g_get_monotonic_time ();
+  context->buffer_pool = pool;
+  return TRUE;
+}
+
+void
+gst_vaapi_context_buffers_finalize (GstVaapiContext * context)
+{
+  GstVaapiBufferPool *const pool = BUFFER_POOL (context);
+
+  if (!pool)
+    return;
+
+  gst_vaapi_context_buffers_reset (context);
+  g_ptr_array_unref (pool->buckets);
+  g_mutex_clear (&pool->mutex);
+  g_slice_free (GstVaapiBufferPool, pool);
+  context->buffer_pool = NULL;
+}
+
+/**
+ * gst_vaapi_context_buffers_reset:
+ * @context: a #GstVaapiContext
+ *
+ * Destroys all free VA buffers held by the @context pool. This must be
+ * called whenever the underlying VA context is destroyed. Buffers that
+ * are still in use will be destroyed when released.
+ */
+void
+gst_vaapi_context_buffers_reset (GstVaapiContext * context)
+{
+  GstVaapiBufferPool *const pool = BUFFER_POOL (context);
+  VADisplay const dpy = GST_VAAPI_OBJECT_VADISPLAY (context);
+  guint i;
+
+  if (!pool)
+    return;
+
+  g_mutex_lock (&pool->mutex);
+  for (i = 0; i < pool->buckets->len; i++) {
+    GstVaapiBufferBucket *const bucket = g_ptr_array_index (pool->buckets, i);
+
+    bucket_destroy_buffers (bucket, dpy, 0);
+    bucket_destroy_busy_buffers (bucket, dpy);
+  }
+  g_ptr_array_set_size (pool->buckets, 0);
+  pool->generation++;
+  pool->last_trim_time = g_get_monotonic_time ();
+  g_mutex_unlock (&pool->mutex);
+}
+
+/**
+ * gst_vaapi_context_buffers_trim:
+ * @context: a #GstVaapiContext
+ *
+ * Destroys all free VA buffers held by the @context pool, including
+ * the released ones whose surface was decoded since, while keeping
+ * buffers that are still in use. This is meant to be called
+ * when the decoder goes idle, e.g. on flush, since the periodic
+ * trimming only happens while buffers are allocated.
+ */
+void
+gst_vaapi_context_buffers_trim (GstVaapiContext * context)
+{
+  GstVaapiBufferPool *const pool = BUFFER_POOL (context);
+  VADisplay const dpy = GST_VAAPI_OBJECT_VADISPLAY (context);
+  guint i;
+
+  if (!pool)
+    return;
+
+  g_mutex_lock (&pool->mutex);
+  for (i = 0; i < pool->buckets->len; i++) {
+    GstVaapiBufferBucket *const bucket = g_ptr_array_index (pool->buckets, i);
+
+    bucket_collect_busy_buffers (bucket, dpy);
+    bucket_destroy_buffers (bucket, dpy, 0);
+    bucket->peak_in_use = bucket->in_use;
+  }
+  pool->last_trim_time = g_get_monotonic_time ();
+  g_mutex_unlock (&pool->mutex);
+}
+
+/**
+ * gst_vaapi_context_create_buffer:
+ * @context: a #GstVaapiContext
+ * @type: the #VABufferType
+ * @size: the requested buffer size, in bytes
+ * @data: optional data to fill the buffer with, or %NULL
+ * @buf_id_ptr: return location for the VA buffer id
+ * @mapped_data: optional return location for the mapped buffer data
+ * @generation_ptr: return location for the pool generation, to pass
+ *   back to gst_vaapi_context_destroy_buffer()
+ *
+ * Acquires a VA buffer of at least @size bytes, recycling one that was
+ * previously released to the @context pool if possible. Slice data
+ * buffers could be larger than @size. Recycled buffers are cleared
+ * when no @data is supplied, as freshly created ones would be.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_context_create_buffer (GstVaapiContext * context,
+    VABufferType type, guint size, gconstpointer data,
+    VABufferID * buf_id_ptr, gpointer * mapped_data, guint * generation_ptr)
+{
+  GstVaapiBufferPool *const pool = BUFFER_POOL (context);
+  VADisplay const dpy = GST_VAAPI_OBJECT_VADISPLAY (context);
+  GstVaapiBufferBucket *bucket;
+  const guint alloc_size = get_alloc_size (type, size);
+  VABufferID buf_id = VA_INVALID_ID;
+  VAStatus status;
+  gboolean recycled = FALSE;
+  gpointer buf;
+
+  g_mutex_lock (&pool->mutex);
+  bucket = pool_lookup_bucket (pool, type, alloc_size);
+  if (!bucket) {
+    bucket = g_slice_new0 (GstVaapiBufferBucket);
+    bucket->type = type;
+    bucket->size = alloc_size;
+    g_ptr_array_add (pool->buckets, bucket);
+  }
+
+  if (g_queue_is_empty (&bucket->free_buffers))
+    bucket_collect_busy_buffers (bucket, dpy);
+  if (!g_queue_is_empty (&bucket->free_buffers)) {
+    buf_id = GPOINTER_TO_UINT (g_queue_pop_head (&bucket->free_buffers));
+    recycled = TRUE;
+    pool->hits++;
+  } else
+    pool->misses++;
+
+  bucket->in_use++;
+  if (bucket->peak_in_use < bucket->in_use)
+    bucket->peak_in_use = bucket->in_use;
+
+  pool_maybe_trim (pool, dpy);
+
+  *generation_ptr = pool->generation;
+  g_mutex_unlock (&pool->mutex);
+
+  if (buf_id == VA_INVALID_ID) {
+    status = vaCreateBuffer (dpy, GST_VAAPI_OBJECT_ID (context), type,
+        alloc_size, 1, NULL, &buf_id);
+    if (!vaapi_check_status (status, "vaCreateBuffer()"))
+      goto error;
+  }
+
+  buf = vaapi_map_buffer (dpy, buf_id);
+  if (!buf)
+    goto error;
+  if (data)
+    memcpy (buf, data, size);
+  else if (recycled)
+    memset (buf, 0, size);
+
+  if (mapped_data)
+    *mapped_data = buf;
+  else
+    vaapi_unmap_buffer (dpy, buf_id, NULL);
+
+  *buf_id_ptr = buf_id;
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    vaapi_destroy_buffer (dpy, &buf_id);
+    gst_vaapi_context_destroy_buffer (context, type, size, &buf_id,
+        VA_INVALID_SURFACE, *generation_ptr);
+    return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_context_destroy_buffer:
+ * @context: a #GstVaapiContext
+ * @type: the #VABufferType
+ * @size: the size that was requested at creation time
+ * @buf_id_ptr: pointer to the VA buffer id to release
+ * @surface_id: the VA surface the buffer was rendered to, or
+ *   %VA_INVALID_SURFACE if it was not submitted
+ * @generation: the pool generation returned at creation time
+ *
+ * Releases the VA buffer back to the @context pool, or destroys it if
+ * the pool was reset in the meantime. A buffer that was submitted is
+ * only reused once @surface_id is no longer being rendered, since the
+ * hardware may read it until then. The VA buffer id is reset to
+ * %VA_INVALID_ID. The buffer must not be mapped anymore.
+ */
+void
+gst_vaapi_context_destroy_buffer (GstVaapiContext * context,
+    VABufferType type, guint size, VABufferID * buf_id_ptr,
+    VASurfaceID surface_id, guint generation)
+{
+  GstVaapiBufferPool *const pool = BUFFER_POOL (context);
+  VADisplay const dpy = GST_VAAPI_OBJECT_VADISPLAY (context);
+  GstVaapiBufferBucket *bucket;
+  GstVaapiBusyBuffer *busy;
+
+  g_mutex_lock (&pool->mutex);
+  if (generation != pool->generation)
+    goto destroy;
+
+  bucket = pool_lookup_bucket (pool, type, get_alloc_size (type, size));
+  if (!bucket)
+    goto destroy;
+
+  bucket->in_use--;
+  if (*buf_id_ptr != VA_INVALID_ID && surface_id != VA_INVALID_SURFACE) {
+    busy = g_slice_new (GstVaapiBusyBuffer);
+    busy->buf_id = *buf_id_ptr;
+    busy->surface_id = surface_id;
+    g_queue_push_tail (&bucket->busy_buffers, busy);
+  } else if (*buf_id_ptr != VA_INVALID_ID)
+    g_queue_push_tail (&bucket->free_buffers, GUINT_TO_POINTER (*buf_id_ptr));
+  g_mutex_unlock (&pool->mutex);
+  *buf_id_ptr = VA_INVALID_ID;
+  return;
+
+destroy:
+  g_mutex_unlock (&pool->mutex);
+  vaapi_destroy_buffer (dpy, buf_id_ptr);
+}
+
+/**
+ * gst_vaapi_context_get_buffer_stats:
+ * @context: a #GstVaapiContext
+ * @hits_ptr: return location for the number of recycled VA buffers
+ * @misses_ptr: return location for the number of newly created VA
+ *   buffers
+ *
+ * Retrieves the VA buffers pool counters of @context.
+ */
+void
+gst_vaapi_context_get_buffer_stats (GstVaapiContext * context,
+    guint64 * hits_ptr, guint64 * misses_ptr)
+{
+  GstVaapiBufferPool *const pool = BUFFER_POOL (context);
+
+  g_return_if_fail (context != NULL);
+
+  g_mutex_lock (&pool->mutex);
+  if (hits_ptr)
+    *hits_ptr = pool->hits;
+  if (misses_ptr)
+    *misses_ptr = pool->misses;
+  g_mutex_unlock (&pool->mutex);
+}
@@ -0,0 +1,62 @@
+/*
+ *  gstvaapicontext_buffers.h - VA context abstraction (VA buffers pool)
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_CONTEXT_BUFFERS_H
+#define GST_VAAPI_CONTEXT_BUFFERS_H
+
+#include "gstvaapicontext.h"
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_context_buffers_init (GstVaapiContext * context);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_buffers_finalize (GstVaapiContext * context);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_buffers_reset (GstVaapiContext * context);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_buffers_trim (GstVaapiContext * context);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_context_create_buffer (GstVaapiContext * context,
+    VABufferType type, guint size, gconstpointer data,
+    VABufferID * buf_id_ptr, gpointer * mapped_data, guint * generation_ptr);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_destroy_buffer (GstVaapiContext * context,
+    VABufferType type, guint size, VABufferID * buf_id_ptr,
+    VASurfaceID surface_id, guint generation);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_get_buffer_stats (GstVaapiContext * context,
+    guint64 * hits_ptr, guint64 * misses_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_CONTEXT_BUFFERS_H */
@@ -31,6 +31,7 @@
 #include "gstvaapicompat.h"
 #include "gstvaapidecoder.h"
 #include "gstvaapidecoder_priv.h"
+#include "gstvaapicontext_buffers.h"
 #include "gstvaapiparser_frame.h"
 #include "gstvaapisurfaceproxy_priv.h"
 #include "gstvaapiutils.h"
@@ -55,6 +56,9 @@ parser_state_finalize (GstVaapiParserState * ps)
     ps->output_adapter = NULL;
   }
 
+  g_queue_foreach (&ps->input_regions, (GFunc) gst_buffer_unref, NULL);
+  g_queue_clear (&ps->input_regions);
+
   if (ps->next_unit_pending) {
     gst_vaapi_decoder_unit_clear (&ps->next_unit);
     ps->next_unit_pending = FALSE;
@@ -90,6 +94,122 @@ reset:
   ps->input_offset2 = -1;
 }
 
+/* Discards all input that was not parsed into a complete frame yet,
+   along with the byte range recorded for the current frame */
+static void
+parser_state_reset (GstVaapiParserState * ps)
+{
+  /* The current frame is only ours on the gst_vaapi_decoder_put_buffer()
+     path. Otherwise, it belongs to the gst_vaapi_decoder_parse() caller */
+  if (ps->current_frame && ps->current_adapter == ps->input_adapter)
+    gst_video_codec_frame_unref (ps->current_frame);
+  ps->current_frame = NULL;
+  ps->current_adapter = NULL;
+
+  gst_adapter_clear (ps->input_adapter);
+  gst_adapter_clear (ps->output_adapter);
+
+  g_queue_foreach (&ps->input_regions, (GFunc) gst_buffer_unref, NULL);
+  g_queue_clear (&ps->input_regions);
+  ps->input_region_offset = ps->input_total_size;
+  ps->output_slice_start = ps->input_total_size;
+  ps->output_slice_end = ps->input_total_size;
+
+  if (ps->next_unit_pending) {
+    gst_vaapi_decoder_unit_clear (&ps->next_unit);
+    ps->next_unit_pending = FALSE;
+  }
+  ps->at_eos = FALSE;
+}
+
+/* Appends @buffer to the input adapter, and keeps a reference to it so
+   that decode units lying within that buffer could be recorded as byte
+   ranges instead of being split into intermediate buffers */
+static void
+input_region_push (GstVaapiParserState * ps, GstBuffer * buffer)
+{
+  g_queue_push_tail (&ps->input_regions, gst_buffer_ref (buffer));
+  ps->input_total_size += gst_buffer_get_size (buffer);
+  gst_adapter_push (ps->input_adapter, buffer);
+}
+
+/* Returns the stream offset of the next byte to parse */
+static inline guint64
+input_region_get_position (GstVaapiParserState * ps)
+{
+  return ps->input_total_size - gst_adapter_available (ps->input_adapter);
+}
+
+/* Pushes the recorded byte range of the current frame to the output
+   adapter, as a single sub-buffer of the head input region */
+static void
+output_slice_flush (GstVaapiParserState * ps)
+{
+  GstBuffer *const region = g_queue_peek_head (&ps->input_regions);
+  GstBuffer *buffer;
+  gsize offset, size;
+
+  size = ps->output_slice_end - ps->output_slice_start;
+  if (size == 0)
+    return;
+
+  offset = ps->output_slice_start - ps->input_region_offset;
+  if (offset == 0 && size == gst_buffer_get_size (region))
+    buffer = gst_buffer_ref (region);
+  else
+    buffer = gst_buffer_copy_region (region, GST_BUFFER_COPY_ALL, offset,
+        size);
+  gst_adapter_push (ps->output_adapter, buffer);
+  ps->output_slice_start = ps->output_slice_end;
+}
+
+/* Releases the input regions that were fully consumed */
+static void
+input_region_advance (GstVaapiParserState * ps)
+{
+  const guint64 position = input_region_get_position (ps);
+  GstBuffer *region;
+  gsize size;
+
+  while ((region = g_queue_peek_head (&ps->input_regions)) != NULL) {
+    size = gst_buffer_get_size (region);
+    if (ps->input_region_offset + size > position)
+      break;
+    output_slice_flush (ps);
+    gst_buffer_unref (g_queue_pop_head (&ps->input_regions));
+    ps->input_region_offset += size;
+  }
+}
+
+/* Moves the next @unit_size bytes of input to the current frame. Units
+   within the head input region only extend the recorded byte range;
+   units crossing region boundaries fall back to an intermediate buffer */
+static void
+input_region_consume (GstVaapiParserState * ps, guint unit_size)
+{
+  GstBuffer *region;
+  guint64 position;
+
+  input_region_advance (ps);
+
+  region = g_queue_peek_head (&ps->input_regions);
+  position = input_region_get_position (ps);
+  if (region && position + unit_size <=
+      ps->input_region_offset + gst_buffer_get_size (region)) {
+    if (position != ps->output_slice_end) {
+      output_slice_flush (ps);
+      ps->output_slice_start = position;
+    }
+    ps->output_slice_end = position + unit_size;
+    gst_adapter_flush (ps->input_adapter, unit_size);
+  } else {
+    output_slice_flush (ps);
+    gst_adapter_push (ps->output_adapter,
+        gst_adapter_take_buffer (ps->input_adapter, unit_size));
+  }
+  input_region_advance (ps);
+}
+
 static gboolean
 push_buffer (GstVaapiDecoder * decoder, GstBuffer * buffer)
 {
@@ -103,6 +223,11 @@ push_buffer (GstVaapiDecoder * decoder, GstBuffer * buffer)
   GST_DEBUG ("queue encoded data buffer %p (%zu bytes)",
       buffer, gst_buffer_get_size (buffer));
 
+  if (decoder->parse_ahead.thread) {
+    g_mutex_lock (&decoder->parse_ahead.mutex);
+    decoder->parse_ahead.pending_buffers++;
+    g_mutex_unlock (&decoder->parse_ahead.mutex);
+  }
   g_async_queue_push (decoder->buffers, buffer);
   return TRUE;
 }
@@ -131,6 +256,7 @@ do_parse (GstVaapiDecoder * decoder,
   GstVaapiParserFrame *frame;
   GstVaapiDecoderUnit *unit;
   GstVaapiDecoderStatus status;
+  gint64 start_time;
 
   *got_unit_size_ptr = 0;
   *got_frame_ptr = FALSE;
@@ -156,8 +282,12 @@ do_parse (GstVaapiDecoder * decoder,
   gst_vaapi_decoder_unit_init (unit);
 
   ps->current_frame = base_frame;
+  start_time =
+      gst_vaapi_decoder_stats_begin (GST_VAAPI_DECODER_STATS (decoder));
   status = GST_VAAPI_DECODER_GET_CLASS (decoder)->parse (decoder,
       adapter, at_eos, unit);
+  gst_vaapi_decoder_stats_end (GST_VAAPI_DECODER_STATS (decoder),
+      GST_VAAPI_DECODER_STAT_PARSE, start_time);
   if (status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
     if (at_eos && frame->units->len > 0 &&
         status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA) {
@@ -205,6 +335,7 @@ do_decode_1 (GstVaapiDecoder * decoder, GstVaapiParserFrame * frame)
 {
   GstVaapiDecoderClass *const klass = GST_VAAPI_DECODER_GET_CLASS (decoder);
   GstVaapiDecoderStatus status;
+  gboolean skipped = FALSE;
 
   if (frame->pre_units->len > 0) {
     status = do_decode_units (decoder, frame->pre_units);
@@ -217,18 +348,24 @@ do_decode_1 (GstVaapiDecoder * decoder, GstVaapiParserFrame * frame)
       GstVaapiDecoderUnit *const unit =
           &g_array_index (frame->units, GstVaapiDecoderUnit, 0);
       status = klass->start_frame (decoder, unit);
-      if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+      if ((gint) status == GST_VAAPI_DECODER_STATUS_DROP_FRAME)
+        skipped = TRUE;
+      else if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
         return status;
     }
 
-    status = do_decode_units (decoder, frame->units);
-    if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
-      return status;
-
-    if (klass->end_frame) {
-      status = klass->end_frame (decoder);
+    /* The picture was skipped: don't submit any slice, but still
+       process the units that follow it */
+    if (!skipped) {
+      status = do_decode_units (decoder, frame->units);
       if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
         return status;
+
+      if (klass->end_frame) {
+        status = klass->end_frame (decoder);
+        if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+          return status;
+      }
     }
   }
 
@@ -239,7 +376,7 @@ do_decode_1 (GstVaapiDecoder * decoder, GstVaapiParserFrame * frame)
   }
 
   /* Drop frame if there is no slice data unit in there */
-  if (G_UNLIKELY (frame->units->len == 0))
+  if (G_UNLIKELY (frame->units->len == 0 || skipped))
     return (GstVaapiDecoderStatus) GST_VAAPI_DECODER_STATUS_DROP_FRAME;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -247,16 +384,22 @@ do_decode_1 (GstVaapiDecoder * decoder, GstVaapiParserFrame * frame)
 static inline GstVaapiDecoderStatus
 do_decode (GstVaapiDecoder * decoder, GstVideoCodecFrame * base_frame)
 {
-  GstVaapiParserState *const ps = &decoder->parser_state;
   GstVaapiParserFrame *const frame = base_frame->user_data;
   GstVaapiDecoderStatus status;
 
-  ps->current_frame = base_frame;
+  decoder->decode_frame = base_frame;
+
+  /* Unit offsets are relative to the bytes that were actually parsed */
+  if (frame->input_buffer)
+    gst_buffer_replace (&base_frame->input_buffer, frame->input_buffer);
 
   gst_vaapi_parser_frame_ref (frame);
   status = do_decode_1 (decoder, frame);
   gst_vaapi_parser_frame_unref (frame);
 
+  /* The caller may release the frame as soon as we return */
+  decoder->decode_frame = NULL;
+
   switch ((guint) status) {
     case GST_VAAPI_DECODER_STATUS_DROP_FRAME:
       drop_frame (decoder, base_frame);
@@ -276,31 +419,18 @@ do_flush (GstVaapiDecoder * decoder)
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
+/* Parses decode units from the input adapter until a complete frame is
+   available in *out_frame_ptr, or more data is needed */
 static GstVaapiDecoderStatus
-decode_step (GstVaapiDecoder * decoder)
+parse_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame ** out_frame_ptr)
 {
   GstVaapiParserState *const ps = &decoder->parser_state;
   GstVaapiDecoderStatus status;
-  GstBuffer *buffer;
   gboolean got_frame;
   guint got_unit_size, input_size;
 
-  status = gst_vaapi_decoder_check_status (decoder);
-  if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
-    return status;
-
-  /* Fill adapter with all buffers we have in the queue */
-  for (;;) {
-    buffer = pop_buffer (decoder);
-    if (!buffer)
-      break;
-
-    ps->at_eos = GST_BUFFER_IS_EOS (buffer);
-    if (!ps->at_eos)
-      gst_adapter_push (ps->input_adapter, buffer);
-  }
+  *out_frame_ptr = NULL;
 
-  /* Parse and decode all decode units */
   input_size = gst_adapter_available (ps->input_adapter);
   if (input_size == 0) {
     if (ps->at_eos)
@@ -327,24 +457,25 @@ decode_step (GstVaapiDecoder * decoder)
     }
 
     if (got_unit_size > 0) {
-      buffer = gst_adapter_take_buffer (ps->input_adapter, got_unit_size);
+      const gboolean is_first_unit =
+          gst_adapter_available (ps->output_adapter) == 0 &&
+          ps->output_slice_start == ps->output_slice_end;
+
+      input_region_consume (ps, got_unit_size);
       input_size -= got_unit_size;
 
-      if (gst_adapter_available (ps->output_adapter) == 0) {
+      if (is_first_unit) {
         ps->current_frame->pts = gst_adapter_prev_pts (ps->input_adapter, NULL);
       }
-      gst_adapter_push (ps->output_adapter, buffer);
     }
 
     if (got_frame) {
+      output_slice_flush (ps);
       ps->current_frame->input_buffer =
           gst_adapter_take_buffer (ps->output_adapter,
           gst_adapter_available (ps->output_adapter));
 
-      status = do_decode (decoder, ps->current_frame);
-      GST_DEBUG ("decode frame (status = %d)", status);
-
-      gst_video_codec_frame_unref (ps->current_frame);
+      *out_frame_ptr = ps->current_frame;
       ps->current_frame = NULL;
       break;
     }
@@ -352,6 +483,391 @@ decode_step (GstVaapiDecoder * decoder)
   return status;
 }
 
+/* Fills the input adapter with all buffers we have in the queue */
+static void
+fill_input (GstVaapiDecoder * decoder)
+{
+  GstVaapiParserState *const ps = &decoder->parser_state;
+  GstBuffer *buffer;
+
+  for (;;) {
+    buffer = pop_buffer (decoder);
+    if (!buffer)
+      break;
+
+    ps->at_eos = GST_BUFFER_IS_EOS (buffer);
+    if (!ps->at_eos)
+      input_region_push (ps, buffer);
+    else
+      gst_buffer_unref (buffer);
+  }
+}
+
+/* Pushes a parsed frame to the decode thread, waiting for a free slot
+   if max_parsed_frames are already queued. The parser is not busy while
+   waiting, so that the decode thread could flush the codec state. The
+   frame is dropped if the decoder was flushed since @generation */
+static gboolean
+parse_ahead_push_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame,
+    guint generation)
+{
+  GstVaapiParseAhead *const pa = &decoder->parse_ahead;
+  const guint64 frame_end = input_region_get_position (&decoder->parser_state);
+
+  g_mutex_lock (&pa->mutex);
+  pa->busy = FALSE;
+  g_cond_broadcast (&pa->cond);
+  while ((g_queue_get_length (&pa->frames) >= pa->max_frames || pa->paused)
+      && !pa->stop)
+    g_cond_wait (&pa->cond, &pa->mutex);
+  if (pa->stop) {
+    g_mutex_unlock (&pa->mutex);
+    return FALSE;
+  }
+  if (pa->generation != generation)
+    gst_video_codec_frame_unref (frame);
+  else {
+    /* The frame covers all the input consumed since the previous frame,
+       including the bytes the parser skipped */
+    g_queue_push_tail (&pa->frames, frame);
+    g_queue_push_tail (&pa->frame_sizes,
+        GSIZE_TO_POINTER (frame_end - pa->frame_end));
+    pa->frame_end = frame_end;
+  }
+  pa->busy = TRUE;
+  g_cond_broadcast (&pa->cond);
+  g_mutex_unlock (&pa->mutex);
+  return TRUE;
+}
+
+static gpointer
+parse_ahead_thread (gpointer data)
+{
+  GstVaapiDecoder *const decoder = data;
+  GstVaapiParseAhead *const pa = &decoder->parse_ahead;
+  GstVaapiParserState *const ps = &decoder->parser_state;
+  GstVaapiDecoderStatus status;
+  GstVideoCodecFrame *frame;
+  GstBuffer *buffer;
+  guint generation;
+
+  for (;;) {
+    /* The generation tells whether the buffer was submitted before or
+       after the last flush, see parse_ahead_reset() */
+    g_async_queue_lock (decoder->buffers);
+    buffer = g_async_queue_pop_unlocked (decoder->buffers);
+    generation = pa->generation;
+    g_async_queue_unlock (decoder->buffers);
+
+    g_mutex_lock (&pa->mutex);
+    while (pa->paused && !pa->stop)
+      g_cond_wait (&pa->cond, &pa->mutex);
+    if (pa->generation != generation) {
+      g_mutex_unlock (&pa->mutex);
+      gst_buffer_unref (buffer);
+      continue;
+    }
+    pa->busy = !pa->stop;
+    g_mutex_unlock (&pa->mutex);
+    if (g_atomic_int_get (&pa->stop)) {
+      gst_buffer_unref (buffer);
+      break;
+    }
+
+    ps->at_eos = GST_BUFFER_IS_EOS (buffer);
+    if (!ps->at_eos)
+      input_region_push (ps, buffer);
+    else
+      gst_buffer_unref (buffer);
+
+    do {
+      status = parse_frame (decoder, &frame);
+      if (frame && !parse_ahead_push_frame (decoder, frame, generation)) {
+        gst_video_codec_frame_unref (frame);
+        return NULL;
+      }
+    } while (frame);
+
+    g_mutex_lock (&pa->mutex);
+    if (pa->generation == generation) {
+      if (status != GST_VAAPI_DECODER_STATUS_SUCCESS &&
+          status != GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA)
+        pa->status = status;
+      pa->pending_buffers--;
+    }
+    pa->busy = FALSE;
+    g_cond_broadcast (&pa->cond);
+    g_mutex_unlock (&pa->mutex);
+  }
+  return NULL;
+}
+
+/* Suspends the parser thread once it no longer runs the parse() vfunc,
+   or resumes it. The codec state shall only be flushed while paused */
+static void
+parse_ahead_set_paused (GstVaapiDecoder * decoder, gboolean paused)
+{
+  GstVaapiParseAhead *const pa = &decoder->parse_ahead;
+
+  if (!pa->thread)
+    return;
+
+  g_mutex_lock (&pa->mutex);
+  pa->paused = paused;
+  if (paused) {
+    while (pa->busy && !pa->stop)
+      g_cond_wait (&pa->cond, &pa->mutex);
+  } else
+    g_cond_broadcast (&pa->cond);
+  g_mutex_unlock (&pa->mutex);
+}
+
+/* Discards the buffers and frames that the parser thread did not hand
+   over yet. The parser thread shall be paused. A buffer it already
+   popped from the queue is dropped once it resumes, since its
+   generation no longer matches */
+static void
+parse_ahead_reset (GstVaapiDecoder * decoder)
+{
+  GstVaapiParseAhead *const pa = &decoder->parse_ahead;
+  GstBuffer *buffer;
+
+  g_mutex_lock (&pa->mutex);
+  g_async_queue_lock (decoder->buffers);
+  while ((buffer = g_async_queue_try_pop_unlocked (decoder->buffers)))
+    gst_buffer_unref (buffer);
+  pa->generation++;
+  g_async_queue_unlock (decoder->buffers);
+
+  g_queue_foreach (&pa->frames, (GFunc) gst_video_codec_frame_unref, NULL);
+  g_queue_clear (&pa->frames);
+  g_queue_clear (&pa->frame_sizes);
+  pa->frame_end = decoder->parser_state.input_total_size;
+  pa->pending_buffers = 0;
+  pa->queued_bytes = 0;
+  pa->eos_queued = FALSE;
+  pa->status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+  g_cond_broadcast (&pa->cond);
+  g_mutex_unlock (&pa->mutex);
+}
+
+/* Waits for the next frame parsed ahead, or for the parser thread to
+   consume all pending input. Returns NULL and the status to report in
+   the latter case. Otherwise, *@size_ptr is the number of input bytes
+   the frame was parsed from */
+static GstVideoCodecFrame *
+parse_ahead_pop_frame (GstVaapiDecoder * decoder,
+    GstVaapiDecoderStatus * status_ptr, gsize * size_ptr)
+{
+  GstVaapiParseAhead *const pa = &decoder->parse_ahead;
+  GstVaapiDecoderStatus status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+  GstVideoCodecFrame *frame;
+  gsize size;
+
+  g_mutex_lock (&pa->mutex);
+  while (g_queue_is_empty (&pa->frames) && pa->pending_buffers > 0)
+    g_cond_wait (&pa->cond, &pa->mutex);
+
+  frame = g_queue_pop_head (&pa->frames);
+  size = GPOINTER_TO_SIZE (g_queue_pop_head (&pa->frame_sizes));
+  if (!frame) {
+    status = pa->status;
+    if (status == GST_VAAPI_DECODER_STATUS_SUCCESS)
+      status = GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+    else if (status != GST_VAAPI_DECODER_STATUS_END_OF_STREAM)
+      pa->status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+  }
+  g_cond_broadcast (&pa->cond);
+  g_mutex_unlock (&pa->mutex);
+
+  *status_ptr = status;
+  if (size_ptr)
+    *size_ptr = size;
+  return frame;
+}
+
+/* Submits the bytes of @adapter that the parser thread has not seen
+   yet, as sub-buffers of the adapter contents */
+static gboolean
+parse_ahead_queue_adapter (GstVaapiDecoder * decoder, GstAdapter * adapter)
+{
+  GstVaapiParseAhead *const pa = &decoder->parse_ahead;
+  const gsize avail = gst_adapter_available (adapter);
+  GstBufferList *list;
+  GstBuffer *buffer;
+  gsize offset, size, skip;
+  guint i;
+
+  if (avail <= pa->queued_bytes)
+    return TRUE;
+
+  list = gst_adapter_get_buffer_list (adapter, avail);
+  if (!list)
+    return FALSE;
+
+  skip = pa->queued_bytes;
+  for (i = 0; i < gst_buffer_list_length (list); i++) {
+    buffer = gst_buffer_list_get (list, i);
+    size = gst_buffer_get_size (buffer);
+    if (skip >= size) {
+      skip -= size;
+      continue;
+    }
+    offset = skip;
+    skip = 0;
+    if (offset == 0)
+      buffer = gst_buffer_ref (buffer);
+    else
+      buffer = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL, offset,
+          size - offset);
+    push_buffer (decoder, buffer);
+  }
+  gst_buffer_list_unref (list);
+
+  pa->queued_bytes = avail;
+  pa->eos_queued = FALSE;
+  return TRUE;
+}
+
+/* Implements gst_vaapi_decoder_parse() on top of the parser thread. The
+   frame parsed ahead is returned in a single step: its parser frame is
+   moved to @base_frame, and the unit size covers all the input bytes it
+   was parsed from, including the bytes the parser skipped. The parsed
+   bytes are handed over along with the parser frame, so that the unit
+   offsets remain valid whatever the caller gathers into its frame */
+static GstVaapiDecoderStatus
+parse_ahead_parse (GstVaapiDecoder * decoder,
+    GstVideoCodecFrame * base_frame, GstAdapter * adapter, gboolean at_eos,
+    guint * got_unit_size_ptr, gboolean * got_frame_ptr)
+{
+  GstVaapiParseAhead *const pa = &decoder->parse_ahead;
+  GstVaapiDecoderStatus status;
+  GstVaapiParserFrame *parser_frame;
+  GstVideoCodecFrame *frame;
+  gsize frame_size;
+
+  *got_unit_size_ptr = 0;
+  *got_frame_ptr = FALSE;
+
+  if (!parse_ahead_queue_adapter (decoder, adapter))
+    return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
+  if (at_eos && !pa->eos_queued) {
+    push_buffer (decoder, NULL);
+    pa->eos_queued = TRUE;
+  }
+
+  frame = parse_ahead_pop_frame (decoder, &status, &frame_size);
+  if (!frame) {
+    if (status != GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA &&
+        status != GST_VAAPI_DECODER_STATUS_END_OF_STREAM)
+      return status;
+
+    /* Data left over at <EOS> was dropped by the parser thread */
+    if (at_eos) {
+      g_mutex_lock (&pa->mutex);
+      pa->status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+      g_mutex_unlock (&pa->mutex);
+      pa->queued_bytes = 0;
+    }
+    return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+  }
+
+  g_assert (frame_size <= pa->queued_bytes);
+  pa->queued_bytes -= frame_size;
+
+  parser_frame = frame->user_data;
+  parser_frame->input_buffer = frame->input_buffer;
+  frame->input_buffer = NULL;
+
+  gst_video_codec_frame_set_user_data (base_frame,
+      gst_vaapi_mini_object_ref (parser_frame),
+      (GDestroyNotify) gst_vaapi_mini_object_unref);
+  gst_video_codec_frame_unref (frame);
+
+  *got_unit_size_ptr = frame_size;
+  *got_frame_ptr = TRUE;
+  return GST_VAAPI_DECODER_STATUS_SUCCESS;
+}
+
+/* Decodes the next frame that was parsed ahead by the parser thread */
+static GstVaapiDecoderStatus
+parse_ahead_decode_step (GstVaapiDecoder * decoder)
+{
+  GstVaapiDecoderStatus status;
+  GstVideoCodecFrame *frame;
+
+  frame = parse_ahead_pop_frame (decoder, &status, NULL);
+  if (!frame)
+    return status;
+
+  status = do_decode (decoder, frame);
+  GST_DEBUG ("decode frame (status = %d)", status);
+
+  gst_video_codec_frame_unref (frame);
+  return status;
+}
+
+static void
+parse_ahead_init (GstVaapiParseAhead * pa)
+{
+  g_mutex_init (&pa->mutex);
+  g_cond_init (&pa->cond);
+  g_queue_init (&pa->frames);
+  g_queue_init (&pa->frame_sizes);
+  pa->status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+}
+
+static void
+parse_ahead_finalize (GstVaapiDecoder * decoder)
+{
+  GstVaapiParseAhead *const pa = &decoder->parse_ahead;
+
+  if (pa->thread) {
+    g_mutex_lock (&pa->mutex);
+    g_atomic_int_set (&pa->stop, TRUE);
+    g_cond_broadcast (&pa->cond);
+    g_mutex_unlock (&pa->mutex);
+
+    /* Wake up the parser thread if it is waiting for input */
+    g_async_queue_push (decoder->buffers, gst_buffer_new ());
+    g_thread_join (pa->thread);
+    pa->thread = NULL;
+  }
+
+  g_queue_foreach (&pa->frames, (GFunc) gst_video_codec_frame_unref, NULL);
+  g_queue_clear (&pa->frames);
+  g_queue_clear (&pa->frame_sizes);
+  g_cond_clear (&pa->cond);
+  g_mutex_clear (&pa->mutex);
+}
+
+static GstVaapiDecoderStatus
+decode_step (GstVaapiDecoder * decoder)
+{
+  GstVaapiParserState *const ps = &decoder->parser_state;
+  GstVaapiDecoderStatus status;
+  GstVideoCodecFrame *frame;
+
+  status = gst_vaapi_decoder_check_status (decoder);
+  if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+    return status;
+
+  if (decoder->parse_ahead.thread)
+    return parse_ahead_decode_step (decoder);
+
+  fill_input (decoder);
+
+  /* Parse and decode all decode units */
+  status = parse_frame (decoder, &frame);
+  if (frame) {
+    status = do_decode (decoder, frame);
+    GST_DEBUG ("decode frame (status = %d)", status);
+
+    gst_video_codec_frame_unref (frame);
+  }
+  return status;
+}
+
 static void
 drop_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
 {
@@ -364,6 +880,8 @@ drop_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
   GST_VIDEO_CODEC_FRAME_FLAG_SET (frame,
       GST_VIDEO_CODEC_FRAME_FLAG_DECODE_ONLY);
 
+  gst_vaapi_decoder_stats_push_frame (GST_VAAPI_DECODER_STATS (decoder),
+      frame, TRUE);
   g_async_queue_push (decoder->frames, gst_video_codec_frame_ref (frame));
 }
 
@@ -375,6 +893,8 @@ push_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
   GST_DEBUG ("push frame %d (surface 0x%08x)", frame->system_frame_number,
       (guint32) GST_VAAPI_SURFACE_PROXY_SURFACE_ID (proxy));
 
+  gst_vaapi_decoder_stats_push_frame (GST_VAAPI_DECODER_STATS (decoder),
+      frame, FALSE);
   g_async_queue_push (decoder->frames, gst_video_codec_frame_ref (frame));
 }
 
@@ -391,6 +911,8 @@ pop_frame (GstVaapiDecoder * decoder, guint64 timeout)
   if (!frame)
     return NULL;
 
+  gst_vaapi_decoder_stats_pop_frame (GST_VAAPI_DECODER_STATS (decoder), frame);
+
   proxy = frame->user_data;
   GST_DEBUG ("pop frame %d (surface 0x%08x)", frame->system_frame_number,
       (proxy ? (guint32) GST_VAAPI_SURFACE_PROXY_SURFACE_ID (proxy) :
@@ -447,6 +969,8 @@ gst_vaapi_decoder_finalize (GstVaapiDecoder * decoder)
   const GstVaapiDecoderClass *const klass =
       GST_VAAPI_DECODER_GET_CLASS (decoder);
 
+  parse_ahead_finalize (decoder);
+
   if (klass->destroy)
     klass->destroy (decoder);
 
@@ -470,6 +994,26 @@ gst_vaapi_decoder_finalize (GstVaapiDecoder * decoder)
 
   gst_vaapi_display_replace (&decoder->display, NULL);
   decoder->va_display = NULL;
+
+  gst_vaapi_decoder_stats_finalize (&decoder->stats);
+}
+
+/* Drivers that cannot take all the buffers of a picture in a single
+   vaRenderPicture() call are handled with
+   GST_VAAPI_DECODER_SEQUENTIAL_RENDER=1. There is no fallback after a
+   failed submission: the driver may already have consumed some of the
+   buffers */
+static gboolean
+render_sequential_is_required (void)
+{
+  static gsize g_sequential_state = 0;
+
+  if (g_once_init_enter (&g_sequential_state)) {
+    const gchar *const env = g_getenv ("GST_VAAPI_DECODER_SEQUENTIAL_RENDER");
+    g_once_init_leave (&g_sequential_state,
+        g_strcmp0 (env, "1") == 0 ? 2 : 1);
+  }
+  return g_sequential_state == 2;
 }
 
 static gboolean
@@ -482,6 +1026,8 @@ gst_vaapi_decoder_init (GstVaapiDecoder * decoder, GstVaapiDisplay * display,
   guint sub_size;
 
   parser_state_init (&decoder->parser_state);
+  parse_ahead_init (&decoder->parse_ahead);
+  gst_vaapi_decoder_stats_init (&decoder->stats);
 
   codec_state = g_slice_new0 (GstVideoCodecState);
   codec_state->ref_count = 1;
@@ -496,6 +1042,9 @@ gst_vaapi_decoder_init (GstVaapiDecoder * decoder, GstVaapiDisplay * display,
   decoder->codec_state = codec_state;
   decoder->codec_state_changed_func = NULL;
   decoder->codec_state_changed_data = NULL;
+  decoder->render_sequential = render_sequential_is_required ();
+  decoder->decode_frame = NULL;
+  decoder->skip_policy = GST_VAAPI_DECODER_SKIP_NONE;
 
   decoder->buffers = g_async_queue_new_full ((GDestroyNotify) gst_buffer_unref);
   decoder->frames = g_async_queue_new_full ((GDestroyNotify)
@@ -707,6 +1256,66 @@ gst_vaapi_decoder_put_buffer (GstVaapiDecoder * decoder, GstBuffer * buf)
   return push_buffer (decoder, buf);
 }
 
+/**
+ * gst_vaapi_decoder_set_parse_ahead:
+ * @decoder: a #GstVaapiDecoder
+ * @max_frames: the maximum number of frames to parse ahead, or zero
+ *
+ * Enables pipelined decoding for buffers submitted through
+ * gst_vaapi_decoder_put_buffer(). A dedicated thread then parses the
+ * bitstream, and queues up to @max_frames complete frames that
+ * gst_vaapi_decoder_get_surface() and gst_vaapi_decoder_get_frame()
+ * decode in turn. This overlaps start code scanning and header parsing
+ * with VA submission.
+ *
+ * Likewise, gst_vaapi_decoder_parse() hands the adapter contents over
+ * to the parser thread, and returns whole frames that were parsed
+ * ahead. The caller shall then only flush the reported unit sizes from
+ * the adapter, and pass the frames to gst_vaapi_decoder_decode().
+ *
+ * This needs to be called before the first buffer is submitted, and
+ * the parser thread cannot be stopped afterwards but through decoder
+ * destruction. Codecs whose parser depends on decoding state are not
+ * supported.
+ *
+ * Return value: %TRUE if the parser thread is running, or if
+ *   @max_frames is zero and it was not started yet
+ */
+gboolean
+gst_vaapi_decoder_set_parse_ahead (GstVaapiDecoder * decoder,
+    guint max_frames)
+{
+  GstVaapiParseAhead *const pa = &decoder->parse_ahead;
+  GError *error = NULL;
+
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  if (pa->thread)
+    return max_frames > 0;
+  if (max_frames == 0)
+    return TRUE;
+
+  if (!GST_VAAPI_DECODER_GET_CLASS (decoder)->parse_ahead) {
+    GST_WARNING ("parse-ahead is not supported by this codec");
+    return FALSE;
+  }
+  if (g_async_queue_length (decoder->buffers) > 0 ||
+      decoder->parser_state.input_total_size > 0) {
+    GST_WARNING ("parse-ahead cannot be enabled once decoding started");
+    return FALSE;
+  }
+
+  pa->max_frames = max_frames;
+  pa->thread = g_thread_try_new ("vaapiparser", parse_ahead_thread, decoder,
+      &error);
+  if (!pa->thread) {
+    GST_ERROR ("failed to create parser thread: %s", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
 /**
  * gst_vaapi_decoder_get_surface:
  * @decoder: a #GstVaapiDecoder
@@ -956,7 +1565,22 @@ gst_vaapi_decoder_ensure_context (GstVaapiDecoder * decoder,
 {
   gst_vaapi_decoder_set_picture_size (decoder, cip->width, cip->height);
 
+  /* Allocate surfaces for the maximum resolution and keep them across
+     resolution decreases, pictures are then cropped to the actual size */
+  if (decoder->max_width || decoder->max_height) {
+    cip->width = MAX (cip->width, decoder->max_width);
+    cip->height = MAX (cip->height, decoder->max_height);
+    if (decoder->context && decoder->context->info.chroma_type ==
+        (cip->chroma_type ? cip->chroma_type : GST_VAAPI_CHROMA_TYPE_YUV420)) {
+      cip->width = MAX (cip->width, decoder->context->info.width);
+      cip->height = MAX (cip->height, decoder->context->info.height);
+    }
+    GST_DEBUG ("allocate %ux%u surfaces", cip->width, cip->height);
+  }
+
   cip->usage = GST_VAAPI_CONTEXT_USAGE_DECODE;
+  cip->surface_headroom = decoder->surface_headroom;
+  cip->prewarm_surfaces = decoder->prewarm_surfaces;
   if (decoder->context) {
     if (!gst_vaapi_context_reset (decoder->context, cip))
       return FALSE;
@@ -1001,6 +1625,9 @@ gst_vaapi_decoder_parse (GstVaapiDecoder * decoder,
   g_return_val_if_fail (got_frame_ptr != NULL,
       GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
 
+  if (decoder->parse_ahead.thread)
+    return parse_ahead_parse (decoder, base_frame, adapter, at_eos,
+        got_unit_size_ptr, got_frame_ptr);
   return do_parse (decoder, base_frame, adapter, at_eos,
       got_unit_size_ptr, got_frame_ptr);
 }
@@ -1026,10 +1653,31 @@ gst_vaapi_decoder_decode (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
 GstVaapiDecoderStatus
 gst_vaapi_decoder_flush (GstVaapiDecoder * decoder)
 {
+  GstVaapiDecoderStatus status;
+
   g_return_val_if_fail (decoder != NULL,
       GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
 
-  return do_flush (decoder);
+  /* The parse() vfunc shall not run concurrently with flush() */
+  parse_ahead_set_paused (decoder, TRUE);
+  status = do_flush (decoder);
+
+  /* Input submitted before the flush, e.g. prior to a seek, shall not
+     be prepended to the input that follows */
+  if (decoder->parse_ahead.thread)
+    parse_ahead_reset (decoder);
+  else {
+    GstBuffer *buffer;
+    while ((buffer = pop_buffer (decoder)))
+      gst_buffer_unref (buffer);
+  }
+  parser_state_reset (&decoder->parser_state);
+  parse_ahead_set_paused (decoder, FALSE);
+
+  /* No more slices are expected for a while, release idle VA buffers */
+  if (decoder->context)
+    gst_vaapi_context_buffers_trim (decoder->context);
+  return status;
 }
 
 GstVaapiDecoderStatus
@@ -1063,3 +1711,295 @@ gst_vaapi_decoder_decode_codec_data (GstVaapiDecoder * decoder)
   gst_buffer_unmap (codec_data, &map_info);
   return status;
 }
+
+/**
+ * gst_vaapi_decoder_set_stats_enabled:
+ * @decoder: a #GstVaapiDecoder
+ * @enabled: %TRUE to collect statistics
+ *
+ * Enables or disables the collection of decoding statistics, i.e. the
+ * time spent parsing, waiting for a free surface, submitting pictures
+ * to the hardware, bumping pictures out of the DPB, and the latency of
+ * decoded frames in the output queue. This is disabled by default, and
+ * costs a single atomic read per measurement point in that case.
+ *
+ * Statistics accumulated so far are kept when collection is disabled
+ * or enabled again. Use gst_vaapi_decoder_reset_stats() to clear them.
+ */
+void
+gst_vaapi_decoder_set_stats_enabled (GstVaapiDecoder * decoder,
+    gboolean enabled)
+{
+  g_return_if_fail (decoder != NULL);
+
+  gst_vaapi_decoder_stats_set_enabled (&decoder->stats, enabled);
+}
+
+/**
+ * gst_vaapi_decoder_reset_stats:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Clears all decoding statistics collected so far.
+ */
+void
+gst_vaapi_decoder_reset_stats (GstVaapiDecoder * decoder)
+{
+  g_return_if_fail (decoder != NULL);
+
+  gst_vaapi_decoder_stats_reset (&decoder->stats);
+}
+
+/**
+ * gst_vaapi_decoder_get_stats:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Retrieves a snapshot of the decoding statistics, see
+ * gst_vaapi_decoder_set_stats_enabled(). The returned structure holds
+ * the "frames-output" and "frames-dropped" counters, the surface pool
+ * usage as last seen by the decoder, i.e. "surfaces" (number of
+ * allocated surfaces), "surfaces-peak-used" (highest number of surfaces
+ * in use at once), "surface-pool-grown" (surfaces allocated on demand)
+ * and "surface-pool-exhausted" (requests that found no free surface),
+ * the VA buffers pool counters "va-buffers-recycled" and
+ * "va-buffers-created", and for each of
+ * "parse", "surface-wait", "render", "dpb-bump" and "output-latency",
+ * the following fields:
+ *   - "&lt;name&gt;-count": number of samples (#guint64)
+ *   - "&lt;name&gt;-total-time": cumulated time in nanoseconds (#guint64)
+ *   - "&lt;name&gt;-max-time": longest sample in nanoseconds (#guint64)
+ *   - "&lt;name&gt;-histogram": array of sample counts (#GstValueArray
+ *     of #guint64), where bucket 0 counts samples below 1 us, and
+ *     bucket i those in [2^(i-1), 2^i) us, the last one being open
+ *
+ * Return value: (transfer full): a newly allocated #GstStructure
+ */
+GstStructure *
+gst_vaapi_decoder_get_stats (GstVaapiDecoder * decoder)
+{
+  GstStructure *structure;
+  guint64 hits = 0, misses = 0;
+
+  g_return_val_if_fail (decoder != NULL, NULL);
+
+  structure = gst_structure_new_empty ("GstVaapiDecoderStats");
+  gst_vaapi_decoder_stats_fill (&decoder->stats, structure);
+
+  if (decoder->context)
+    gst_vaapi_context_get_buffer_stats (decoder->context, &hits, &misses);
+  gst_structure_set (structure,
+      "va-buffers-recycled", G_TYPE_UINT64, hits,
+      "va-buffers-created", G_TYPE_UINT64, misses, NULL);
+  return structure;
+}
+
+/**
+ * gst_vaapi_decoder_set_skip_policy:
+ * @decoder: a #GstVaapiDecoder
+ * @policy: the #GstVaapiDecoderSkipPolicy
+ *
+ * Selects the pictures that are skipped, i.e. neither submitted to the
+ * hardware nor stored in the DPB. This is useful for trick modes and
+ * for fast thumbnail extraction. Only the H.264, H.265 and MPEG-2
+ * decoders honour the policy at this time.
+ *
+ * Switching back to a less restrictive policy is best done at a random
+ * access point, e.g. after a flush, since pictures that follow may
+ * reference the skipped ones.
+ */
+void
+gst_vaapi_decoder_set_skip_policy (GstVaapiDecoder * decoder,
+    GstVaapiDecoderSkipPolicy policy)
+{
+  g_return_if_fail (decoder != NULL);
+
+  g_atomic_int_set (&decoder->skip_policy, policy);
+}
+
+/**
+ * gst_vaapi_decoder_get_skip_policy:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Retrieves the current skip policy, see
+ * gst_vaapi_decoder_set_skip_policy().
+ *
+ * Return value: the #GstVaapiDecoderSkipPolicy
+ */
+GstVaapiDecoderSkipPolicy
+gst_vaapi_decoder_get_skip_policy (GstVaapiDecoder * decoder)
+{
+  g_return_val_if_fail (decoder != NULL, GST_VAAPI_DECODER_SKIP_NONE);
+
+  return g_atomic_int_get (&decoder->skip_policy);
+}
+
+/**
+ * gst_vaapi_decoder_set_max_size:
+ * @decoder: a #GstVaapiDecoder
+ * @max_width: the maximum picture width, or zero
+ * @max_height: the maximum picture height, or zero
+ *
+ * Announces the maximum resolution of the stream, e.g. the largest
+ * rendition of an adaptive streaming session. When set, VA surfaces
+ * are allocated for at least that resolution and are kept across
+ * resolution decreases, decoded pictures being cropped to their actual
+ * size. Surfaces are only reallocated when a larger resolution shows
+ * up. Passing zero for both dimensions restores the default behaviour
+ * of allocating surfaces at the exact stream resolution.
+ *
+ * This takes effect on the next sequence change.
+ */
+void
+gst_vaapi_decoder_set_max_size (GstVaapiDecoder * decoder,
+    guint max_width, guint max_height)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->max_width = max_width;
+  decoder->max_height = max_height;
+}
+
+/**
+ * gst_vaapi_decoder_get_max_size:
+ * @decoder: a #GstVaapiDecoder
+ * @max_width_ptr: return location for the maximum width, or %NULL
+ * @max_height_ptr: return location for the maximum height, or %NULL
+ *
+ * Retrieves the maximum resolution set with
+ * gst_vaapi_decoder_set_max_size().
+ */
+void
+gst_vaapi_decoder_get_max_size (GstVaapiDecoder * decoder,
+    guint * max_width_ptr, guint * max_height_ptr)
+{
+  g_return_if_fail (decoder != NULL);
+
+  if (max_width_ptr)
+    *max_width_ptr = decoder->max_width;
+  if (max_height_ptr)
+    *max_height_ptr = decoder->max_height;
+}
+
+/**
+ * gst_vaapi_decoder_set_surface_headroom:
+ * @decoder: a #GstVaapiDecoder
+ * @num_surfaces: the number of extra surfaces
+ *
+ * Reserves @num_surfaces VA surfaces on top of those required by the
+ * codec, so that downstream elements can queue up that many decoded
+ * frames without stalling the decoder. This is useful when frames are
+ * held for a while, e.g. by a compositor or a deep queue.
+ *
+ * This takes effect on the next sequence change. The surface pool is
+ * never shrunk while the decoder is active.
+ */
+void
+gst_vaapi_decoder_set_surface_headroom (GstVaapiDecoder * decoder,
+    guint num_surfaces)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->surface_headroom = num_surfaces;
+}
+
+/**
+ * gst_vaapi_decoder_get_surface_headroom:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Retrieves the number of extra surfaces set with
+ * gst_vaapi_decoder_set_surface_headroom().
+ *
+ * Return value: the number of extra surfaces
+ */
+guint
+gst_vaapi_decoder_get_surface_headroom (GstVaapiDecoder * decoder)
+{
+  g_return_val_if_fail (decoder != NULL, 0);
+
+  return decoder->surface_headroom;
+}
+
+/**
+ * gst_vaapi_decoder_set_prewarm_surfaces:
+ * @decoder: a #GstVaapiDecoder
+ * @prewarm: %TRUE to commit surfaces memory upfront
+ *
+ * When @prewarm is set, the memory backing the VA surfaces is committed
+ * as soon as they are created, instead of on their first use by the
+ * hardware. This trades a longer startup for the absence of allocation
+ * spikes during the first seconds of playback.
+ *
+ * This takes effect on the next sequence change.
+ */
+void
+gst_vaapi_decoder_set_prewarm_surfaces (GstVaapiDecoder * decoder,
+    gboolean prewarm)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->prewarm_surfaces = prewarm != FALSE;
+}
+
+/**
+ * gst_vaapi_decoder_get_prewarm_surfaces:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Retrieves whether surfaces are pre-warmed, as set with
+ * gst_vaapi_decoder_set_prewarm_surfaces().
+ *
+ * Return value: %TRUE if surfaces are pre-warmed
+ */
+gboolean
+gst_vaapi_decoder_get_prewarm_surfaces (GstVaapiDecoder * decoder)
+{
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  return decoder->prewarm_surfaces;
+}
+
+/* Checks whether the picture about to be decoded shall be skipped,
+   according to the skip policy and the decode-only flag of the
+   current frame */
+gboolean
+gst_vaapi_decoder_skip_picture (GstVaapiDecoder * decoder,
+    gboolean is_reference, gboolean is_key)
+{
+  GstVideoCodecFrame *const frame = decoder->decode_frame;
+
+  switch (g_atomic_int_get (&decoder->skip_policy)) {
+    case GST_VAAPI_DECODER_SKIP_NON_KEY:
+      if (!is_key)
+        return TRUE;
+      break;
+    case GST_VAAPI_DECODER_SKIP_NON_REFERENCE:
+      if (!is_reference)
+        return TRUE;
+      break;
+  }
+  return !is_reference && frame && GST_VIDEO_CODEC_FRAME_IS_DECODE_ONLY (frame);
+}
+
+/** Returns a GType for the #GstVaapiDecoderSkipPolicy set */
+GType
+gst_vaapi_decoder_skip_policy_get_type (void)
+{
+  static volatile gsize g_type = 0;
+
+  static const GEnumValue skip_policy_values[] = {
+    /* *INDENT-OFF* */
+    { GST_VAAPI_DECODER_SKIP_NONE,
+      "Decode all pictures", "none" },
+    { GST_VAAPI_DECODER_SKIP_NON_REFERENCE,
+      "Skip non-reference pictures", "non-reference" },
+    { GST_VAAPI_DECODER_SKIP_NON_KEY,
+      "Decode key pictures only", "non-key" },
+    { 0, NULL, NULL },
+    /* *INDENT-ON* */
+  };
+
+  if (g_once_init_enter (&g_type)) {
+    GType type = g_enum_register_static ("GstVaapiDecoderSkipPolicy",
+        skip_policy_values);
+    g_once_init_leave (&g_type, type);
+  }
+  return g_type;
+}
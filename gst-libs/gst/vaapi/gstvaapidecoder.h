@@ -73,6 +73,38 @@ typedef enum {
   GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN = -1
 } GstVaapiDecoderStatus;
 
+/**
+ * GstVaapiDecoderSkipPolicy:
+ * @GST_VAAPI_DECODER_SKIP_NONE: Decode all pictures.
+ * @GST_VAAPI_DECODER_SKIP_NON_REFERENCE: Skip pictures that are not
+ *   used for reference, e.g. B pictures in typical streams.
+ * @GST_VAAPI_DECODER_SKIP_NON_KEY: Decode only key pictures, i.e.
+ *   IDR or intra pictures, and output them as soon as they are decoded.
+ *
+ * The set of pictures that are skipped before they reach the hardware.
+ * Skipped pictures are returned as decode-only frames. Besides, a
+ * non-reference picture is always skipped if its frame is flagged as
+ * decode-only, see GST_VIDEO_CODEC_FRAME_IS_DECODE_ONLY().
+ */
+typedef enum {
+  GST_VAAPI_DECODER_SKIP_NONE = 0,
+  GST_VAAPI_DECODER_SKIP_NON_REFERENCE,
+  GST_VAAPI_DECODER_SKIP_NON_KEY,
+} GstVaapiDecoderSkipPolicy;
+
+/**
+ * GST_VAAPI_TYPE_DECODER_SKIP_POLICY:
+ *
+ * A type that represents the #GstVaapiDecoderSkipPolicy set.
+ *
+ * Return value: the #GType of GstVaapiDecoderSkipPolicy
+ */
+#define GST_VAAPI_TYPE_DECODER_SKIP_POLICY \
+    gst_vaapi_decoder_skip_policy_get_type ()
+
+GType
+gst_vaapi_decoder_skip_policy_get_type (void) G_GNUC_CONST;
+
 GstVaapiDecoder *
 gst_vaapi_decoder_ref (GstVaapiDecoder * decoder);
 
@@ -132,6 +164,49 @@ gst_vaapi_decoder_flush (GstVaapiDecoder * decoder);
 GstVaapiDecoderStatus
 gst_vaapi_decoder_check_status (GstVaapiDecoder * decoder);
 
+gboolean
+gst_vaapi_decoder_set_parse_ahead (GstVaapiDecoder * decoder,
+    guint max_frames);
+
+void
+gst_vaapi_decoder_set_stats_enabled (GstVaapiDecoder * decoder,
+    gboolean enabled);
+
+void
+gst_vaapi_decoder_reset_stats (GstVaapiDecoder * decoder);
+
+GstStructure *
+gst_vaapi_decoder_get_stats (GstVaapiDecoder * decoder);
+
+void
+gst_vaapi_decoder_set_skip_policy (GstVaapiDecoder * decoder,
+    GstVaapiDecoderSkipPolicy policy);
+
+GstVaapiDecoderSkipPolicy
+gst_vaapi_decoder_get_skip_policy (GstVaapiDecoder * decoder);
+
+void
+gst_vaapi_decoder_set_max_size (GstVaapiDecoder * decoder,
+    guint max_width, guint max_height);
+
+void
+gst_vaapi_decoder_get_max_size (GstVaapiDecoder * decoder,
+    guint * max_width_ptr, guint * max_height_ptr);
+
+void
+gst_vaapi_decoder_set_surface_headroom (GstVaapiDecoder * decoder,
+    guint num_surfaces);
+
+guint
+gst_vaapi_decoder_get_surface_headroom (GstVaapiDecoder * decoder);
+
+void
+gst_vaapi_decoder_set_prewarm_surfaces (GstVaapiDecoder * decoder,
+    gboolean prewarm);
+
+gboolean
+gst_vaapi_decoder_get_prewarm_surfaces (GstVaapiDecoder * decoder);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_DECODER_H */
@@ -22,6 +22,7 @@
 
 #include "sysdeps.h"
 #include "gstvaapidecoder_dpb.h"
+#include "gstvaapidecoder_priv.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -142,6 +143,9 @@ dpb_output (GstVaapiDpb * dpb, GstVaapiPicture * picture)
 static gboolean
 dpb_bump (GstVaapiDpb * dpb)
 {
+  GstVaapiCodecObject *codec_object;
+  GstVaapiDecoderStats *stats;
+  gint64 start_time;
   gint index;
   gboolean success;
 
@@ -149,9 +153,16 @@ dpb_bump (GstVaapiDpb * dpb)
   if (index < 0)
     return FALSE;
 
+  codec_object = GST_VAAPI_CODEC_OBJECT (dpb->pictures[index]);
+  stats = GST_VAAPI_DECODER_STATS (codec_object->codec);
+  start_time = gst_vaapi_decoder_stats_begin (stats);
+
   success = dpb_output (dpb, dpb->pictures[index]);
   if (!GST_VAAPI_PICTURE_IS_REFERENCE (dpb->pictures[index]))
     dpb_remove_index (dpb, index);
+
+  gst_vaapi_decoder_stats_end (stats, GST_VAAPI_DECODER_STAT_DPB_BUMP,
+      start_time);
   return success;
 }
 
@@ -35,6 +35,7 @@
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
 #include "gstvaapiutils_h264_priv.h"
+#include "gstvaapiutils_startcode.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -95,11 +96,15 @@ struct _GstVaapiParserInfoH264
   guint flags;                  // Same as decoder unit flags (persistent)
   guint view_id;                // View ID of slice
   guint voc;                    // View order index (VOIdx) of slice
+  GstVaapiParserInfoH264 *param_set;    // SPS of a PPS, or PPS of a slice
 };
 
 static void
 gst_vaapi_parser_info_h264_finalize (GstVaapiParserInfoH264 * pi)
 {
+  gst_vaapi_mini_object_replace ((GstVaapiMiniObject **) & pi->param_set,
+      NULL);
+
   switch (pi->nalu.type) {
     case GST_H264_NAL_SPS:
     case GST_H264_NAL_SUBSET_SPS:
@@ -120,9 +125,11 @@ gst_vaapi_parser_info_h264_finalize (GstVaapiParserInfoH264 * pi)
 static inline const GstVaapiMiniObjectClass *
 gst_vaapi_parser_info_h264_class (void)
 {
+  static GstVaapiMiniObjectCache GstVaapiParserInfoH264Cache;
   static const GstVaapiMiniObjectClass GstVaapiParserInfoH264Class = {
     .size = sizeof (GstVaapiParserInfoH264),
-    .finalize = (GDestroyNotify) gst_vaapi_parser_info_h264_finalize
+    .finalize = (GDestroyNotify) gst_vaapi_parser_info_h264_finalize,
+    .cache = &GstVaapiParserInfoH264Cache
   };
   return &GstVaapiParserInfoH264Class;
 }
@@ -130,8 +137,12 @@ gst_vaapi_parser_info_h264_class (void)
 static inline GstVaapiParserInfoH264 *
 gst_vaapi_parser_info_h264_new (void)
 {
-  return (GstVaapiParserInfoH264 *)
+  GstVaapiParserInfoH264 *const pi = (GstVaapiParserInfoH264 *)
       gst_vaapi_mini_object_new (gst_vaapi_parser_info_h264_class ());
+
+  if (pi)
+    pi->param_set = NULL;
+  return pi;
 }
 
 #define gst_vaapi_parser_info_h264_ref(pi) \
@@ -322,9 +333,11 @@ gst_vaapi_frame_store_new (GstVaapiPictureH264 * picture)
 {
   GstVaapiFrameStore *fs;
 
+  static GstVaapiMiniObjectCache GstVaapiFrameStoreCache;
   static const GstVaapiMiniObjectClass GstVaapiFrameStoreClass = {
     sizeof (GstVaapiFrameStore),
-    gst_vaapi_frame_store_finalize
+    gst_vaapi_frame_store_finalize,
+    &GstVaapiFrameStoreCache
   };
 
   fs = (GstVaapiFrameStore *)
@@ -473,18 +486,36 @@ typedef enum
       GST_H264_VIDEO_STATE_GOT_SLICE)
 } GstH264VideoState;
 
+/* Reference picture state derived once per picture, see init_picture_refs() */
+typedef enum
+{
+  GST_H264_REF_CACHE_LISTS = 1 << 0,    // short_ref[], long_ref[], PicNum
+  GST_H264_REF_CACHE_MAPS = 1 << 1,     // short_ref_map[], long_ref_map[]
+  GST_H264_REF_CACHE_P_SLICE = 1 << 2,  // initial RefPicList0 for P slices
+  GST_H264_REF_CACHE_B_SLICE = 1 << 3,  // initial RefPicList0/1 for B slices
+  GST_H264_REF_CACHE_SLICE_PARAM = 1 << 4,      // slice_param, for last_slice_hdr
+} GstH264RefCache;
+
+/* Number of slots in the PicNum lookup table, a power of two larger
+   than the maximum number of short-term reference fields */
+#define SHORT_REF_MAP_SIZE 64
+
 struct _GstVaapiDecoderH264Private
 {
   GstH264NalParser *parser;
   guint parser_state;
   guint decoder_state;
   GstVaapiStreamAlignH264 stream_alignment;
+  GstVaapiAccessUnitSplitter au_splitter;
   GstVaapiPictureH264 *current_picture;
   GstVaapiPictureH264 *missing_picture;
   GstVaapiParserInfoH264 *sps[GST_H264_MAX_SPS_COUNT];
   GstVaapiParserInfoH264 *active_sps;
   GstVaapiParserInfoH264 *pps[GST_H264_MAX_PPS_COUNT];
   GstVaapiParserInfoH264 *active_pps;
+  /* Parameter sets as seen by the parser, which may run ahead */
+  GstVaapiParserInfoH264 *parser_sps[GST_H264_MAX_SPS_COUNT];
+  GstVaapiParserInfoH264 *parser_pps[GST_H264_MAX_PPS_COUNT];
   GstVaapiParserInfoH264 *prev_pi;
   GstVaapiParserInfoH264 *prev_slice_pi;
   GstVaapiFrameStore **prev_ref_frames;
@@ -495,6 +526,9 @@ struct _GstVaapiDecoderH264Private
   guint dpb_size;
   guint dpb_size_max;
   guint max_views;
+  gint num_reorder_frames;      // from VUI, or -1 if unknown
+  gint32 last_output_poc;       // POC of the last output frame
+  gboolean low_latency;         // set from the application thread
   GstVaapiProfile profile;
   GstVaapiEntrypoint entrypoint;
   GstVaapiChromaType chroma_type;
@@ -503,10 +537,18 @@ struct _GstVaapiDecoderH264Private
   guint short_ref_count;
   GstVaapiPictureH264 *long_ref[32];
   guint long_ref_count;
+  guint8 short_ref_map[SHORT_REF_MAP_SIZE];     // PicNum -> short_ref index + 1
+  guint8 long_ref_map[32];      // LongTermPicNum -> long_ref index + 1
   GstVaapiPictureH264 *RefPicList0[32];
   guint RefPicList0_count;
   GstVaapiPictureH264 *RefPicList1[32];
   guint RefPicList1_count;
+  GstVaapiPictureH264 *RefPicList0_init[32];
+  guint RefPicList0_init_count;
+  GstVaapiPictureH264 *RefPicList1_init[32];
+  guint RefPicList1_init_count;
+  guint ref_cache;              // GstH264RefCache flags
+  VASliceParameterBufferH264 slice_param;       // template for the next slice
   guint nal_length_size;
   guint mb_width;
   guint mb_height;
@@ -528,6 +570,8 @@ struct _GstVaapiDecoderH264Private
   guint has_context:1;
   guint progressive_sequence:1;
   guint top_field_first:1;
+  guint reorder_violation:1;
+  guint key_only:1;
 };
 
 /**
@@ -669,6 +713,21 @@ get_max_dec_frame_buffering (GstH264SPS * sps)
   return MAX (1, max_dec_frame_buffering);
 }
 
+/* Get the maximum number of frames that precede any frame in decoding
+   order and follow it in output order, or -1 if this is not known */
+static gint
+get_num_reorder_frames (GstH264SPS * sps)
+{
+  if (sps->vui_parameters_present_flag &&
+      sps->vui_parameters.bitstream_restriction_flag)
+    return sps->vui_parameters.num_reorder_frames;
+
+  /* 8.2.1.3 - output order is the same as decoding order */
+  if (sps->pic_order_cnt_type == 2)
+    return 0;
+  return -1;
+}
+
 static void
 array_remove_index_fast (void *array, guint * array_length_ptr, guint index)
 {
@@ -747,6 +806,7 @@ dpb_output (GstVaapiDecoderH264 * decoder, GstVaapiFrameStore * fs)
   fs->output_called = 0;
   if (!picture)
     return TRUE;
+  decoder->priv.last_output_poc = fs->buffers[0]->base.poc;
   return gst_vaapi_picture_output (GST_VAAPI_PICTURE_CAST (picture));
 }
 
@@ -882,7 +942,7 @@ dpb_output_other_views (GstVaapiDecoderH264 * decoder,
 }
 
 static gboolean
-dpb_bump (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
+dpb_bump_1 (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
   GstVaapiPictureH264 *found_picture;
@@ -906,6 +966,19 @@ dpb_bump (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
   return success;
 }
 
+static gboolean
+dpb_bump (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
+{
+  GstVaapiDecoderStats *const stats = GST_VAAPI_DECODER_STATS (decoder);
+  const gint64 start_time = gst_vaapi_decoder_stats_begin (stats);
+  gboolean success;
+
+  success = dpb_bump_1 (decoder, picture);
+  gst_vaapi_decoder_stats_end (stats, GST_VAAPI_DECODER_STAT_DPB_BUMP,
+      start_time);
+  return success;
+}
+
 static void
 dpb_clear (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
 {
@@ -968,6 +1041,7 @@ dpb_flush (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
   /* Output any frame remaining in DPB */
   while (dpb_bump (decoder, picture));
   dpb_clear (decoder, picture);
+  priv->last_output_poc = G_MININT32;
 }
 
 static void
@@ -993,7 +1067,7 @@ dpb_prune_mvc (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
 }
 
 static gboolean
-dpb_add (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
+dpb_add_1 (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
   GstVaapiFrameStore *fs;
@@ -1077,6 +1151,83 @@ dpb_add (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
   return TRUE;
 }
 
+/* Returns the number of frames that may be held in the DPB for
+   reordering purposes in low-latency mode, as signalled by the SPS */
+static guint
+get_low_latency_output_delay (GstVaapiDecoderH264 * decoder)
+{
+  GstVaapiDecoderH264Private *const priv = &decoder->priv;
+
+  return MIN ((guint) priv->num_reorder_frames, priv->dpb_size);
+}
+
+/* Checks whether the output order was broken, i.e. @picture comes
+   after a frame with a higher POC was output. In that case, fall back
+   to the regular output delay until the next SPS is activated */
+static void
+check_output_order (GstVaapiDecoderH264 * decoder,
+    GstVaapiPictureH264 * picture)
+{
+  GstVaapiDecoderH264Private *const priv = &decoder->priv;
+
+  if (priv->reorder_violation || !picture->output_flag ||
+      GST_VAAPI_PICTURE_FLAG_IS_SET (picture, GST_VAAPI_PICTURE_FLAG_GHOST))
+    return;
+  if (!GST_VAAPI_PICTURE_IS_FRAME (picture) &&
+      !GST_VAAPI_PICTURE_IS_FIRST_FIELD (picture))
+    return;
+  if (picture->base.poc >= priv->last_output_poc)
+    return;
+
+  GST_WARNING ("picture with POC %d follows output POC %d, disabling "
+      "low-latency output", picture->base.poc, priv->last_output_poc);
+  priv->reorder_violation = TRUE;
+}
+
+static guint
+dpb_get_num_need_output (GstVaapiDecoderH264 * decoder)
+{
+  GstVaapiDecoderH264Private *const priv = &decoder->priv;
+  guint i, n_output_needed = 0;
+
+  for (i = 0; i < priv->dpb_count; i++) {
+    if (priv->dpb[i]->output_needed)
+      n_output_needed++;
+  }
+  return n_output_needed;
+}
+
+/* Stores @picture into the DPB. In low-latency mode, frames are then
+   output as soon as the reordering depth signalled by the SPS is
+   exceeded, rather than when the DPB is full */
+static gboolean
+dpb_add (GstVaapiDecoderH264 * decoder, GstVaapiPictureH264 * picture)
+{
+  GstVaapiDecoderH264Private *const priv = &decoder->priv;
+  GstVaapiPictureH264 *found_picture;
+  gint found_index;
+
+  if (!g_atomic_int_get (&priv->low_latency) || priv->max_views > 1 ||
+      priv->num_reorder_frames < 0 || priv->reorder_violation)
+    return dpb_add_1 (decoder, picture);
+
+  check_output_order (decoder, picture);
+  if (!dpb_add_1 (decoder, picture))
+    return FALSE;
+
+  while (dpb_get_num_need_output (decoder) >
+      get_low_latency_output_delay (decoder)) {
+    /* Incomplete frames are output once the second field is decoded */
+    found_index = dpb_find_lowest_poc (decoder, picture, &found_picture);
+    if (found_index < 0 ||
+        !gst_vaapi_frame_store_is_complete (priv->dpb[found_index]))
+      break;
+    if (!dpb_bump (decoder, picture))
+      return FALSE;
+  }
+  return TRUE;
+}
+
 static gboolean
 dpb_reset (GstVaapiDecoderH264 * decoder, guint dpb_size)
 {
@@ -1219,6 +1370,7 @@ gst_vaapi_decoder_h264_destroy (GstVaapiDecoder * base_decoder)
   guint i;
 
   gst_vaapi_decoder_h264_close (decoder);
+  gst_vaapi_access_unit_splitter_clear (&priv->au_splitter);
 
   g_free (priv->dpb);
   priv->dpb = NULL;
@@ -1237,6 +1389,11 @@ gst_vaapi_decoder_h264_destroy (GstVaapiDecoder * base_decoder)
   for (i = 0; i < G_N_ELEMENTS (priv->sps); i++)
     gst_vaapi_parser_info_h264_replace (&priv->sps[i], NULL);
   gst_vaapi_parser_info_h264_replace (&priv->active_sps, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (priv->parser_pps); i++)
+    gst_vaapi_parser_info_h264_replace (&priv->parser_pps[i], NULL);
+  for (i = 0; i < G_N_ELEMENTS (priv->parser_sps); i++)
+    gst_vaapi_parser_info_h264_replace (&priv->parser_sps[i], NULL);
 }
 
 static gboolean
@@ -1246,12 +1403,15 @@ gst_vaapi_decoder_h264_create (GstVaapiDecoder * base_decoder)
       GST_VAAPI_DECODER_H264_CAST (base_decoder);
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
 
+  gst_vaapi_access_unit_splitter_init (&priv->au_splitter);
   priv->profile = GST_VAAPI_PROFILE_UNKNOWN;
   priv->entrypoint = GST_VAAPI_ENTRYPOINT_VLD;
   priv->chroma_type = GST_VAAPI_CHROMA_TYPE_YUV420;
   priv->prev_pic_structure = GST_VAAPI_PICTURE_STRUCTURE_FRAME;
   priv->progressive_sequence = TRUE;
   priv->top_field_first = FALSE;
+  priv->num_reorder_frames = -1;
+  priv->last_output_poc = G_MININT32;
   return TRUE;
 }
 
@@ -1287,6 +1447,10 @@ ensure_sps (GstVaapiDecoderH264 * decoder, GstH264SPS * sps)
   if (pi && priv->active_sps)
     pi->state |= (priv->active_sps->state & GST_H264_VIDEO_STATE_GOT_I_FRAME);
 
+  /* A new sequence may signal a different reordering depth */
+  if (pi != priv->active_sps)
+    priv->reorder_violation = FALSE;
+
   gst_vaapi_parser_info_h264_replace (&priv->active_sps, pi);
   return pi ? &pi->data.sps : NULL;
 }
@@ -1422,6 +1586,8 @@ ensure_context (GstVaapiDecoderH264 * decoder, GstH264SPS * sps)
     GST_DEBUG ("maximum number of views changed to %u", num_views);
   }
 
+  priv->num_reorder_frames = get_num_reorder_frames (sps);
+
   dpb_size = get_max_dec_frame_buffering (sps);
   if (priv->dpb_size < dpb_size) {
     GST_DEBUG ("DPB size increased");
@@ -1624,6 +1790,13 @@ decode_current_picture (GstVaapiDecoderH264 * decoder)
     goto error;
   if (!dpb_add (decoder, picture))
     goto error;
+
+  /* In key-only mode, output complete frames right away since they
+     will not be referenced by any other decoded picture */
+  if (GST_VAAPI_PICTURE_IS_COMPLETE (picture) && priv->max_views == 1 &&
+      gst_vaapi_decoder_get_skip_policy (GST_VAAPI_DECODER_CAST (decoder)) ==
+      GST_VAAPI_DECODER_SKIP_NON_KEY)
+    dpb_flush (decoder, NULL);
   gst_vaapi_picture_replace (&priv->current_picture, NULL);
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 
@@ -1658,6 +1831,7 @@ parse_sps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H264_PARSER_OK)
     return get_status (result);
 
+  gst_vaapi_parser_info_h264_replace (&priv->parser_sps[sps->id], pi);
   priv->parser_state |= GST_H264_VIDEO_STATE_GOT_SPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1681,6 +1855,7 @@ parse_subset_sps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H264_PARSER_OK)
     return get_status (result);
 
+  gst_vaapi_parser_info_h264_replace (&priv->parser_sps[sps->id], pi);
   priv->parser_state |= GST_H264_VIDEO_STATE_GOT_SPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1691,6 +1866,7 @@ parse_pps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
   GstVaapiParserInfoH264 *const pi = unit->parsed_info;
   GstH264PPS *const pps = &pi->data.pps;
+  GstVaapiParserInfoH264 *sps_pi;
   GstH264ParserResult result;
 
   GST_DEBUG ("parse PPS");
@@ -1707,6 +1883,15 @@ parse_pps (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H264_PARSER_OK)
     return get_status (result);
 
+  /* Refer to our own copy of the SPS, that the parser cannot overwrite
+     while the PPS is still in use by the decoder */
+  sps_pi = priv->parser_sps[pps->sequence->id];
+  if (!sps_pi)
+    return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
+  pps->sequence = &sps_pi->data.sps;
+  gst_vaapi_parser_info_h264_replace (&pi->param_set, sps_pi);
+
+  gst_vaapi_parser_info_h264_replace (&priv->parser_pps[pps->id], pi);
   priv->parser_state |= GST_H264_VIDEO_STATE_GOT_PPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1736,6 +1921,7 @@ parse_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiParserInfoH264 *const pi = unit->parsed_info;
   GstH264SliceHdr *const slice_hdr = &pi->data.slice_hdr;
   GstH264NalUnit *const nalu = &pi->nalu;
+  GstVaapiParserInfoH264 *pps_pi;
   GstH264SPS *sps;
   GstH264ParserResult result;
 
@@ -1781,6 +1967,13 @@ parse_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H264_PARSER_OK)
     return get_status (result);
 
+  /* Likewise, the decoder only reads our own copy of the PPS */
+  pps_pi = priv->parser_pps[slice_hdr->pps->id];
+  if (!pps_pi)
+    return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
+  slice_hdr->pps = &pps_pi->data.pps;
+  gst_vaapi_parser_info_h264_replace (&pi->param_set, pps_pi);
+
   sps = slice_hdr->pps->sequence;
 
   /* Update MVC data */
@@ -2134,6 +2327,37 @@ compare_picture_long_term_frame_idx_inc (const void *a, const void *b)
   return picA->long_term_frame_idx - picB->long_term_frame_idx;
 }
 
+/* Builds the PicNum and LongTermPicNum lookup tables. The first match
+   wins on duplicates, as with a linear scan of the reference lists */
+static void
+init_picture_refs_maps (GstVaapiDecoderH264 * decoder)
+{
+  GstVaapiDecoderH264Private *const priv = &decoder->priv;
+  guint i, h;
+
+  memset (priv->short_ref_map, 0, sizeof (priv->short_ref_map));
+  for (i = 0; i < priv->short_ref_count; i++) {
+    const gint32 pic_num = priv->short_ref[i]->pic_num;
+
+    h = (guint) pic_num & (SHORT_REF_MAP_SIZE - 1);
+    while (priv->short_ref_map[h] &&
+        priv->short_ref[priv->short_ref_map[h] - 1]->pic_num != pic_num)
+      h = (h + 1) & (SHORT_REF_MAP_SIZE - 1);
+    if (!priv->short_ref_map[h])
+      priv->short_ref_map[h] = i + 1;
+  }
+
+  memset (priv->long_ref_map, 0, sizeof (priv->long_ref_map));
+  for (i = 0; i < priv->long_ref_count; i++) {
+    const guint32 long_term_pic_num = priv->long_ref[i]->long_term_pic_num;
+
+    if (long_term_pic_num < G_N_ELEMENTS (priv->long_ref_map) &&
+        !priv->long_ref_map[long_term_pic_num])
+      priv->long_ref_map[long_term_pic_num] = i + 1;
+  }
+  priv->ref_cache |= GST_H264_REF_CACHE_MAPS;
+}
+
 /* 8.2.4.1 - Decoding process for picture numbers */
 static void
 init_picture_refs_pic_num (GstVaapiDecoderH264 * decoder,
@@ -2187,6 +2411,8 @@ init_picture_refs_pic_num (GstVaapiDecoderH264 * decoder,
         pic->long_term_pic_num = 2 * pic->long_term_frame_idx;
     }
   }
+
+  init_picture_refs_maps (decoder);
 }
 
 #define SORT_REF_LIST(list, n, compare_func) \
@@ -2602,11 +2828,20 @@ static gint
 find_short_term_reference (GstVaapiDecoderH264 * decoder, gint32 pic_num)
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
-  guint i;
-
-  for (i = 0; i < priv->short_ref_count; i++) {
-    if (priv->short_ref[i]->pic_num == pic_num)
-      return i;
+  guint i, h;
+
+  if (priv->ref_cache & GST_H264_REF_CACHE_MAPS) {
+    h = (guint) pic_num & (SHORT_REF_MAP_SIZE - 1);
+    while ((i = priv->short_ref_map[h]) != 0) {
+      if (priv->short_ref[i - 1]->pic_num == pic_num)
+        return i - 1;
+      h = (h + 1) & (SHORT_REF_MAP_SIZE - 1);
+    }
+  } else {
+    for (i = 0; i < priv->short_ref_count; i++) {
+      if (priv->short_ref[i]->pic_num == pic_num)
+        return i;
+    }
   }
   GST_ERROR ("found no short-term reference picture with PicNum = %d", pic_num);
   return -1;
@@ -2619,9 +2854,15 @@ find_long_term_reference (GstVaapiDecoderH264 * decoder,
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
   guint i;
 
-  for (i = 0; i < priv->long_ref_count; i++) {
-    if (priv->long_ref[i]->long_term_pic_num == long_term_pic_num)
-      return i;
+  if (priv->ref_cache & GST_H264_REF_CACHE_MAPS) {
+    if ((guint) long_term_pic_num < G_N_ELEMENTS (priv->long_ref_map) &&
+        (i = priv->long_ref_map[long_term_pic_num]) != 0)
+      return i - 1;
+  } else {
+    for (i = 0; i < priv->long_ref_count; i++) {
+      if (priv->long_ref[i]->long_term_pic_num == long_term_pic_num)
+        return i;
+    }
   }
   GST_ERROR ("found no long-term reference picture with LongTermPicNum = %d",
       long_term_pic_num);
@@ -2874,6 +3115,8 @@ init_picture_ref_lists (GstVaapiDecoderH264 * decoder,
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
   guint i, j, short_ref_count, long_ref_count;
 
+  priv->ref_cache = 0;
+
   short_ref_count = 0;
   long_ref_count = 0;
   if (GST_VAAPI_PICTURE_IS_FRAME (picture)) {
@@ -2923,26 +3166,65 @@ init_picture_refs (GstVaapiDecoderH264 * decoder,
     GstVaapiPictureH264 * picture, GstH264SliceHdr * slice_hdr)
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
-  guint i, num_refs;
-
-  init_picture_ref_lists (decoder, picture);
-  init_picture_refs_pic_num (decoder, picture, slice_hdr);
-
-  priv->RefPicList0_count = 0;
-  priv->RefPicList1_count = 0;
+  guint i, num_refs, ref_cache;
+
+  /* The reference picture sets, picture numbers and initial lists only
+     depend on the picture, so they are derived once for all its slices */
+  if (!(priv->ref_cache & GST_H264_REF_CACHE_LISTS)) {
+    init_picture_ref_lists (decoder, picture);
+    init_picture_refs_pic_num (decoder, picture, slice_hdr);
+    priv->ref_cache |= GST_H264_REF_CACHE_LISTS;
+  }
 
   switch (slice_hdr->type % 5) {
     case GST_H264_P_SLICE:
     case GST_H264_SP_SLICE:
-      init_picture_refs_p_slice (decoder, picture, slice_hdr);
+      ref_cache = GST_H264_REF_CACHE_P_SLICE;
       break;
     case GST_H264_B_SLICE:
-      init_picture_refs_b_slice (decoder, picture, slice_hdr);
+      ref_cache = GST_H264_REF_CACHE_B_SLICE;
       break;
     default:
+      ref_cache = 0;
       break;
   }
 
+  if (ref_cache && (priv->ref_cache & ref_cache)) {
+    priv->RefPicList0_count = priv->RefPicList0_init_count;
+    memcpy (priv->RefPicList0, priv->RefPicList0_init,
+        priv->RefPicList0_count * sizeof (priv->RefPicList0[0]));
+    priv->RefPicList1_count = priv->RefPicList1_init_count;
+    memcpy (priv->RefPicList1, priv->RefPicList1_init,
+        priv->RefPicList1_count * sizeof (priv->RefPicList1[0]));
+  } else {
+    priv->RefPicList0_count = 0;
+    priv->RefPicList1_count = 0;
+
+    switch (ref_cache) {
+      case GST_H264_REF_CACHE_P_SLICE:
+        init_picture_refs_p_slice (decoder, picture, slice_hdr);
+        break;
+      case GST_H264_REF_CACHE_B_SLICE:
+        init_picture_refs_b_slice (decoder, picture, slice_hdr);
+        break;
+      default:
+        break;
+    }
+
+    /* MVC inter-view references depend on num_ref_idx_lX_active_minus1 */
+    if (ref_cache && !GST_VAAPI_PICTURE_IS_MVC (picture)) {
+      priv->RefPicList0_init_count = priv->RefPicList0_count;
+      memcpy (priv->RefPicList0_init, priv->RefPicList0,
+          priv->RefPicList0_count * sizeof (priv->RefPicList0[0]));
+      priv->RefPicList1_init_count = priv->RefPicList1_count;
+      memcpy (priv->RefPicList1_init, priv->RefPicList1,
+          priv->RefPicList1_count * sizeof (priv->RefPicList1[0]));
+      priv->ref_cache &= ~(GST_H264_REF_CACHE_P_SLICE |
+          GST_H264_REF_CACHE_B_SLICE);
+      priv->ref_cache |= ref_cache;
+    }
+  }
+
   exec_picture_refs_modification (decoder, picture, slice_hdr);
 
   switch (slice_hdr->type % 5) {
@@ -3573,6 +3855,9 @@ exec_ref_pic_marking (GstVaapiDecoderH264 * decoder,
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
 
+  /* Marking removes entries from short_ref[] and long_ref[] */
+  priv->ref_cache = 0;
+
   priv->prev_pic_reference = GST_VAAPI_PICTURE_IS_REFERENCE (picture);
   priv->prev_pic_has_mmco5 = FALSE;
   priv->prev_pic_structure = picture->structure;
@@ -3911,6 +4196,8 @@ decode_picture (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
     return status;
 
   priv->decoder_state = 0;
+  priv->ref_cache = 0;
+  memset (&priv->slice_param, 0, sizeof (priv->slice_param));
   gst_vaapi_picture_replace (&priv->missing_picture, NULL);
 
   first_field = find_first_field (decoder, pi, TRUE);
@@ -3973,9 +4260,8 @@ get_slice_data_bit_offset (GstH264SliceHdr * slice_hdr, guint nal_header_bytes)
 
 static gboolean
 fill_pred_weight_table (GstVaapiDecoderH264 * decoder,
-    GstVaapiSlice * slice, GstH264SliceHdr * slice_hdr)
+    VASliceParameterBufferH264 * slice_param, GstH264SliceHdr * slice_hdr)
 {
-  VASliceParameterBufferH264 *const slice_param = slice->param;
   GstH264PPS *const pps = get_pps (decoder);
   GstH264SPS *const sps = get_sps (decoder);
   GstH264PredWeightTable *const w = &slice_hdr->pred_weight_table;
@@ -3997,6 +4283,20 @@ fill_pred_weight_table (GstVaapiDecoderH264 * decoder,
   slice_param->luma_weight_l1_flag = 0;
   slice_param->chroma_weight_l1_flag = 0;
 
+  /* The template may hold the weights of a previous slice */
+  memset (slice_param->luma_weight_l0, 0, sizeof (slice_param->luma_weight_l0));
+  memset (slice_param->luma_offset_l0, 0, sizeof (slice_param->luma_offset_l0));
+  memset (slice_param->chroma_weight_l0, 0,
+      sizeof (slice_param->chroma_weight_l0));
+  memset (slice_param->chroma_offset_l0, 0,
+      sizeof (slice_param->chroma_offset_l0));
+  memset (slice_param->luma_weight_l1, 0, sizeof (slice_param->luma_weight_l1));
+  memset (slice_param->luma_offset_l1, 0, sizeof (slice_param->luma_offset_l1));
+  memset (slice_param->chroma_weight_l1, 0,
+      sizeof (slice_param->chroma_weight_l1));
+  memset (slice_param->chroma_offset_l1, 0,
+      sizeof (slice_param->chroma_offset_l1));
+
   if (num_weight_tables < 1)
     return TRUE;
 
@@ -4042,15 +4342,20 @@ fill_pred_weight_table (GstVaapiDecoderH264 * decoder,
 
 static gboolean
 fill_RefPicList (GstVaapiDecoderH264 * decoder,
-    GstVaapiSlice * slice, GstH264SliceHdr * slice_hdr)
+    VASliceParameterBufferH264 * slice_param, GstH264SliceHdr * slice_hdr)
 {
   GstVaapiDecoderH264Private *const priv = &decoder->priv;
-  VASliceParameterBufferH264 *const slice_param = slice->param;
   guint i, num_ref_lists = 0;
 
   slice_param->num_ref_idx_l0_active_minus1 = 0;
   slice_param->num_ref_idx_l1_active_minus1 = 0;
 
+  /* The template may hold the lists of a previous slice */
+  for (i = 0; i < G_N_ELEMENTS (slice_param->RefPicList0); i++)
+    vaapi_init_picture (&slice_param->RefPicList0[i]);
+  for (i = 0; i < G_N_ELEMENTS (slice_param->RefPicList1); i++)
+    vaapi_init_picture (&slice_param->RefPicList1[i]);
+
   if (GST_H264_IS_B_SLICE (slice_hdr))
     num_ref_lists = 2;
   else if (GST_H264_IS_I_SLICE (slice_hdr))
@@ -4067,8 +4372,6 @@ fill_RefPicList (GstVaapiDecoderH264 * decoder,
   for (i = 0; i < priv->RefPicList0_count && priv->RefPicList0[i]; i++)
     vaapi_fill_picture_for_RefPicListX (&slice_param->RefPicList0[i],
         priv->RefPicList0[i]);
-  for (; i <= slice_param->num_ref_idx_l0_active_minus1; i++)
-    vaapi_init_picture (&slice_param->RefPicList0[i]);
 
   if (num_ref_lists < 2)
     return TRUE;
@@ -4079,8 +4382,93 @@ fill_RefPicList (GstVaapiDecoderH264 * decoder,
   for (i = 0; i < priv->RefPicList1_count && priv->RefPicList1[i]; i++)
     vaapi_fill_picture_for_RefPicListX (&slice_param->RefPicList1[i],
         priv->RefPicList1[i]);
-  for (; i <= slice_param->num_ref_idx_l1_active_minus1; i++)
-    vaapi_init_picture (&slice_param->RefPicList1[i]);
+  return TRUE;
+}
+
+static gboolean
+is_same_ref_pic_list_modification (guint8 flag_a, guint8 flag_b,
+    const GstH264RefPicListModification * a,
+    const GstH264RefPicListModification * b, guint num_a, guint num_b)
+{
+  guint i;
+
+  if (flag_a != flag_b)
+    return FALSE;
+  if (!flag_a)
+    return TRUE;
+  if (num_a != num_b)
+    return FALSE;
+
+  for (i = 0; i < num_a; i++) {
+    if (a[i].modification_of_pic_nums_idc != b[i].modification_of_pic_nums_idc
+        || a[i].value.abs_diff_pic_num_minus1 !=
+        b[i].value.abs_diff_pic_num_minus1)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Checks whether the final reference picture lists of two slices of the
+   same picture are identical, i.e. they are derived from the same initial
+   lists with the same modification operations */
+static gboolean
+is_same_ref_pic_lists (GstH264SliceHdr * slice_hdr, GstH264SliceHdr * prev_hdr)
+{
+  if (slice_hdr->type % 5 != prev_hdr->type % 5)
+    return FALSE;
+  if (GST_H264_IS_I_SLICE (slice_hdr) || GST_H264_IS_SI_SLICE (slice_hdr))
+    return TRUE;
+
+  if (slice_hdr->num_ref_idx_l0_active_minus1 !=
+      prev_hdr->num_ref_idx_l0_active_minus1 ||
+      !is_same_ref_pic_list_modification (
+          slice_hdr->ref_pic_list_modification_flag_l0,
+          prev_hdr->ref_pic_list_modification_flag_l0,
+          slice_hdr->ref_pic_list_modification_l0,
+          prev_hdr->ref_pic_list_modification_l0,
+          slice_hdr->n_ref_pic_list_modification_l0,
+          prev_hdr->n_ref_pic_list_modification_l0))
+    return FALSE;
+  if (!GST_H264_IS_B_SLICE (slice_hdr))
+    return TRUE;
+
+  return slice_hdr->num_ref_idx_l1_active_minus1 ==
+      prev_hdr->num_ref_idx_l1_active_minus1 &&
+      is_same_ref_pic_list_modification (
+          slice_hdr->ref_pic_list_modification_flag_l1,
+          prev_hdr->ref_pic_list_modification_flag_l1,
+          slice_hdr->ref_pic_list_modification_l1,
+          prev_hdr->ref_pic_list_modification_l1,
+          slice_hdr->n_ref_pic_list_modification_l1,
+          prev_hdr->n_ref_pic_list_modification_l1);
+}
+
+/* Fills in the reference picture lists and prediction weight tables of
+   the slice parameter template. Those are only rebuilt when they differ
+   from the previous slice of the same picture */
+static gboolean
+fill_slice_template (GstVaapiDecoderH264 * decoder,
+    GstVaapiPictureH264 * picture, GstH264SliceHdr * slice_hdr)
+{
+  GstVaapiDecoderH264Private *const priv = &decoder->priv;
+  VASliceParameterBufferH264 *const slice_param = &priv->slice_param;
+  GstH264SliceHdr *const prev_hdr = picture->last_slice_hdr;
+
+  if ((priv->ref_cache & GST_H264_REF_CACHE_SLICE_PARAM) && prev_hdr &&
+      prev_hdr->pps == slice_hdr->pps &&
+      is_same_ref_pic_lists (slice_hdr, prev_hdr)) {
+    if (!(slice_param->luma_weight_l0_flag || slice_param->luma_weight_l1_flag)
+        || memcmp (&slice_hdr->pred_weight_table, &prev_hdr->pred_weight_table,
+            sizeof (slice_hdr->pred_weight_table)) == 0)
+      return TRUE;
+    return fill_pred_weight_table (decoder, slice_param, slice_hdr);
+  }
+
+  priv->ref_cache &= ~GST_H264_REF_CACHE_SLICE_PARAM;
+  if (!fill_RefPicList (decoder, slice_param, slice_hdr))
+    return FALSE;
+  if (!fill_pred_weight_table (decoder, slice_param, slice_hdr))
+    return FALSE;
   return TRUE;
 }
 
@@ -4091,7 +4479,8 @@ fill_slice (GstVaapiDecoderH264 * decoder,
   VASliceParameterBufferH264 *const slice_param = slice->param;
   GstH264SliceHdr *const slice_hdr = &pi->data.slice_hdr;
 
-  /* Fill in VASliceParameterBufferH264 */
+  /* Fill in VASliceParameterBufferH264. The reference picture lists and
+     prediction weight tables were copied from the template */
   slice_param->slice_data_bit_offset =
       get_slice_data_bit_offset (slice_hdr, pi->nalu.header_bytes);
   slice_param->first_mb_in_slice = slice_hdr->first_mb_in_slice;
@@ -4105,11 +4494,6 @@ fill_slice (GstVaapiDecoderH264 * decoder,
   slice_param->slice_alpha_c0_offset_div2 =
       slice_hdr->slice_alpha_c0_offset_div2;
   slice_param->slice_beta_offset_div2 = slice_hdr->slice_beta_offset_div2;
-
-  if (!fill_RefPicList (decoder, slice, slice_hdr))
-    return FALSE;
-  if (!fill_pred_weight_table (decoder, slice, slice_hdr))
-    return FALSE;
   return TRUE;
 }
 
@@ -4142,18 +4526,23 @@ decode_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
   }
 
-  if (!gst_buffer_map (buffer, &map_info, GST_MAP_READ)) {
-    GST_ERROR ("failed to map buffer");
-    return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
-  }
-
   /* Check wether this is the first/last slice in the current access unit */
   if (pi->flags & GST_VAAPI_DECODER_UNIT_FLAG_AU_START)
     GST_VAAPI_PICTURE_FLAG_SET (picture, GST_VAAPI_PICTURE_FLAG_AU_START);
   if (pi->flags & GST_VAAPI_DECODER_UNIT_FLAG_AU_END)
     GST_VAAPI_PICTURE_FLAG_SET (picture, GST_VAAPI_PICTURE_FLAG_AU_END);
 
-  slice = GST_VAAPI_SLICE_NEW (H264, decoder,
+  init_picture_refs (decoder, picture, slice_hdr);
+  if (!fill_slice_template (decoder, picture, slice_hdr))
+    return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+
+  if (!gst_buffer_map (buffer, &map_info, GST_MAP_READ)) {
+    GST_ERROR ("failed to map buffer");
+    return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+  }
+
+  slice = gst_vaapi_slice_new (GST_VAAPI_DECODER_CAST (decoder),
+      &priv->slice_param, sizeof (priv->slice_param),
       (map_info.data + unit->offset + pi->nalu.offset), pi->nalu.size);
   gst_buffer_unmap (buffer, &map_info);
   if (!slice) {
@@ -4161,7 +4550,6 @@ decode_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
     return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
   }
 
-  init_picture_refs (decoder, picture, slice_hdr);
   if (!fill_slice (decoder, slice, pi)) {
     gst_vaapi_mini_object_unref (GST_VAAPI_MINI_OBJECT (slice));
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
@@ -4169,14 +4557,14 @@ decode_slice (GstVaapiDecoderH264 * decoder, GstVaapiDecoderUnit * unit)
 
   gst_vaapi_picture_add_slice (GST_VAAPI_PICTURE_CAST (picture), slice);
   picture->last_slice_hdr = slice_hdr;
+  priv->ref_cache |= GST_H264_REF_CACHE_SLICE_PARAM;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
 static inline gint
 scan_for_start_code (GstAdapter * adapter, guint ofs, guint size, guint32 * scp)
 {
-  return (gint) gst_adapter_masked_scan_uint32_peek (adapter,
-      0xffffff00, 0x00000100, ofs, size, scp);
+  return gst_vaapi_adapter_scan_for_start_code (adapter, ofs, size, scp);
 }
 
 static GstVaapiDecoderStatus
@@ -4353,7 +4741,6 @@ gst_vaapi_decoder_h264_parse (GstVaapiDecoder * base_decoder,
 
   switch (priv->stream_alignment) {
     case GST_VAAPI_STREAM_ALIGN_H264_NALU:
-    case GST_VAAPI_STREAM_ALIGN_H264_AU:
       size = gst_adapter_available_fast (adapter);
       break;
     default:
@@ -4361,7 +4748,12 @@ gst_vaapi_decoder_h264_parse (GstVaapiDecoder * base_decoder,
       break;
   }
 
-  if (priv->is_avcC) {
+  if (priv->stream_alignment == GST_VAAPI_STREAM_ALIGN_H264_AU) {
+    /* The head buffer holds a complete access unit: split it in one pass */
+    if (!gst_vaapi_access_unit_splitter_next (&priv->au_splitter, adapter,
+            priv->is_avcC ? priv->nal_length_size : 0, &buf_size, &at_au_end))
+      return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+  } else if (priv->is_avcC) {
     if (size < priv->nal_length_size)
       return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
 
@@ -4376,8 +4768,6 @@ gst_vaapi_decoder_h264_parse (GstVaapiDecoder * base_decoder,
     buf_size = priv->nal_length_size + nalu_size;
     if (size < buf_size)
       return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
-    else if (priv->stream_alignment == GST_VAAPI_STREAM_ALIGN_H264_AU)
-      at_au_end = (buf_size == size);
   } else {
     if (size < 4)
       return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
@@ -4402,10 +4792,7 @@ gst_vaapi_decoder_h264_parse (GstVaapiDecoder * base_decoder,
           scan_for_start_code (adapter, ofs2, size - ofs2, NULL);
       if (ofs < 0) {
         // Assume the whole NAL unit is present if end-of-stream
-        // or stream buffers aligned on access unit boundaries
-        if (priv->stream_alignment == GST_VAAPI_STREAM_ALIGN_H264_AU)
-          at_au_end = TRUE;
-        else if (!at_eos) {
+        if (!at_eos) {
           ps->input_offset2 = size;
           return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
         }
@@ -4558,6 +4945,41 @@ gst_vaapi_decoder_h264_decode (GstVaapiDecoder * base_decoder,
   return decode_unit (decoder, unit);
 }
 
+/* Checks whether the picture starting with the slice @pi can be skipped
+   according to the decoder skip policy. The DPB is flushed when entering
+   key-only mode, since pictures are output right away afterwards */
+static gboolean
+skip_picture (GstVaapiDecoderH264 * decoder, GstVaapiParserInfoH264 * pi)
+{
+  GstVaapiDecoderH264Private *const priv = &decoder->priv;
+  GstVaapiDecoder *const base_decoder = GST_VAAPI_DECODER_CAST (decoder);
+  GstH264SliceHdr *const slice_hdr = &pi->data.slice_hdr;
+  gboolean is_key;
+
+  /* Other views may reference any base view picture */
+  if (is_mvc_profile (slice_hdr->pps->sequence->profile_idc))
+    return FALSE;
+
+  /* The second field of a decoded first field is always decoded */
+  if (find_first_field (decoder, pi, FALSE))
+    return FALSE;
+
+  is_key = pi->nalu.idr_pic_flag || GST_H264_IS_I_SLICE (slice_hdr) ||
+      GST_H264_IS_SI_SLICE (slice_hdr);
+  if (gst_vaapi_decoder_skip_picture (base_decoder, pi->nalu.ref_idc != 0,
+          is_key))
+    return TRUE;
+
+  if (gst_vaapi_decoder_get_skip_policy (base_decoder) !=
+      GST_VAAPI_DECODER_SKIP_NON_KEY)
+    priv->key_only = FALSE;
+  else if (!priv->key_only) {
+    dpb_flush (decoder, NULL);
+    priv->key_only = TRUE;
+  }
+  return FALSE;
+}
+
 static GstVaapiDecoderStatus
 gst_vaapi_decoder_h264_start_frame (GstVaapiDecoder * base_decoder,
     GstVaapiDecoderUnit * unit)
@@ -4565,6 +4987,8 @@ gst_vaapi_decoder_h264_start_frame (GstVaapiDecoder * base_decoder,
   GstVaapiDecoderH264 *const decoder =
       GST_VAAPI_DECODER_H264_CAST (base_decoder);
 
+  if (skip_picture (decoder, unit->parsed_info))
+    return (GstVaapiDecoderStatus) GST_VAAPI_DECODER_STATUS_DROP_FRAME;
   return decode_picture (decoder, unit);
 }
 
@@ -4584,6 +5008,10 @@ gst_vaapi_decoder_h264_flush (GstVaapiDecoder * base_decoder)
       GST_VAAPI_DECODER_H264_CAST (base_decoder);
 
   dpb_flush (decoder, NULL);
+  decoder->priv.reorder_violation = FALSE;
+
+  /* The input that was split is discarded along with the flush */
+  gst_vaapi_access_unit_splitter_reset (&decoder->priv.au_splitter);
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
@@ -4597,6 +5025,7 @@ gst_vaapi_decoder_h264_class_init (GstVaapiDecoderH264Class * klass)
   object_class->size = sizeof (GstVaapiDecoderH264);
   object_class->finalize = (GDestroyNotify) gst_vaapi_decoder_finalize;
 
+  decoder_class->parse_ahead = TRUE;
   decoder_class->create = gst_vaapi_decoder_h264_create;
   decoder_class->destroy = gst_vaapi_decoder_h264_destroy;
   decoder_class->parse = gst_vaapi_decoder_h264_parse;
@@ -4637,6 +5066,48 @@ gst_vaapi_decoder_h264_set_alignment (GstVaapiDecoderH264 * decoder,
   g_return_if_fail (decoder != NULL);
 
   decoder->priv.stream_alignment = alignment;
+  gst_vaapi_access_unit_splitter_reset (&decoder->priv.au_splitter);
+}
+
+/**
+ * gst_vaapi_decoder_h264_set_low_latency:
+ * @decoder: a #GstVaapiDecoderH264
+ * @low_latency: %TRUE to output pictures as early as possible
+ *
+ * Specifies whether decoded pictures are output as soon as the output
+ * order allows, rather than when the DPB is full. This only applies to
+ * streams whose SPS signals the reordering depth, i.e. through the VUI
+ * num_reorder_frames value, or with pic_order_cnt_type 2 where no
+ * reordering occurs. Should a picture still come out of order, the
+ * decoder falls back to the regular DPB output delay until the next
+ * SPS is activated or the decoder is flushed.
+ *
+ * This function can be called while decoding.
+ */
+void
+gst_vaapi_decoder_h264_set_low_latency (GstVaapiDecoderH264 * decoder,
+    gboolean low_latency)
+{
+  g_return_if_fail (decoder != NULL);
+
+  g_atomic_int_set (&decoder->priv.low_latency, low_latency != FALSE);
+}
+
+/**
+ * gst_vaapi_decoder_h264_get_low_latency:
+ * @decoder: a #GstVaapiDecoderH264
+ *
+ * Returns whether the low-latency output mode is enabled, see
+ * gst_vaapi_decoder_h264_set_low_latency().
+ *
+ * Return value: %TRUE if low-latency output is enabled
+ */
+gboolean
+gst_vaapi_decoder_h264_get_low_latency (GstVaapiDecoderH264 * decoder)
+{
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  return g_atomic_int_get (&decoder->priv.low_latency);
 }
 
 /**
@@ -37,6 +37,7 @@
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
 #include "gstvaapiutils_h265_priv.h"
+#include "gstvaapiutils_startcode.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -90,11 +91,15 @@ struct _GstVaapiParserInfoH265
   } data;
   guint state;
   guint flags;                  // Same as decoder unit flags (persistent)
+  GstVaapiParserInfoH265 *param_set;    // SPS of a PPS, or PPS of a slice
 };
 
 static void
 gst_vaapi_parser_info_h265_finalize (GstVaapiParserInfoH265 * pi)
 {
+  gst_vaapi_mini_object_replace ((GstVaapiMiniObject **) & pi->param_set,
+      NULL);
+
   if (nal_is_slice (pi->nalu.type))
     gst_h265_slice_hdr_free (&pi->data.slice_hdr);
   else {
@@ -117,9 +122,11 @@ gst_vaapi_parser_info_h265_finalize (GstVaapiParserInfoH265 * pi)
 static inline const GstVaapiMiniObjectClass *
 gst_vaapi_parser_info_h265_class (void)
 {
+  static GstVaapiMiniObjectCache GstVaapiParserInfoH265Cache;
   static const GstVaapiMiniObjectClass GstVaapiParserInfoH265Class = {
     .size = sizeof (GstVaapiParserInfoH265),
-    .finalize = (GDestroyNotify) gst_vaapi_parser_info_h265_finalize
+    .finalize = (GDestroyNotify) gst_vaapi_parser_info_h265_finalize,
+    .cache = &GstVaapiParserInfoH265Cache
   };
   return &GstVaapiParserInfoH265Class;
 }
@@ -127,8 +134,12 @@ gst_vaapi_parser_info_h265_class (void)
 static inline GstVaapiParserInfoH265 *
 gst_vaapi_parser_info_h265_new (void)
 {
-  return (GstVaapiParserInfoH265 *)
+  GstVaapiParserInfoH265 *const pi = (GstVaapiParserInfoH265 *)
       gst_vaapi_mini_object_new (gst_vaapi_parser_info_h265_class ());
+
+  if (pi)
+    pi->param_set = NULL;
+  return pi;
 }
 
 #define gst_vaapi_parser_info_h265_ref(pi) \
@@ -298,9 +309,11 @@ gst_vaapi_frame_store_new (GstVaapiPictureH265 * picture)
 {
   GstVaapiFrameStore *fs;
 
+  static GstVaapiMiniObjectCache GstVaapiFrameStoreCache;
   static const GstVaapiMiniObjectClass GstVaapiFrameStoreClass = {
     sizeof (GstVaapiFrameStore),
-    gst_vaapi_frame_store_finalize
+    gst_vaapi_frame_store_finalize,
+    &GstVaapiFrameStoreCache
   };
 
   fs = (GstVaapiFrameStore *)
@@ -358,6 +371,7 @@ struct _GstVaapiDecoderH265Private
   guint parser_state;
   guint decoder_state;
   GstVaapiStreamAlignH265 stream_alignment;
+  GstVaapiAccessUnitSplitter au_splitter;
   GstVaapiPictureH265 *current_picture;
   GstVaapiParserInfoH265 *vps[GST_H265_MAX_VPS_COUNT];
   GstVaapiParserInfoH265 *active_vps;
@@ -365,6 +379,9 @@ struct _GstVaapiDecoderH265Private
   GstVaapiParserInfoH265 *active_sps;
   GstVaapiParserInfoH265 *pps[GST_H265_MAX_PPS_COUNT];
   GstVaapiParserInfoH265 *active_pps;
+  /* Parameter sets as seen by the parser, which may run ahead */
+  GstVaapiParserInfoH265 *parser_sps[GST_H265_MAX_SPS_COUNT];
+  GstVaapiParserInfoH265 *parser_pps[GST_H265_MAX_PPS_COUNT];
   GstVaapiParserInfoH265 *prev_pi;
   GstVaapiParserInfoH265 *prev_slice_pi;
   GstVaapiParserInfoH265 *prev_independent_slice_pi;
@@ -387,6 +404,9 @@ struct _GstVaapiDecoderH265Private
   GstVaapiPictureH265 *RefPicList1[16];
   guint RefPicList1_count;
 
+  VASliceParameterBufferHEVC slice_param;       // template for the next slice
+  GstH265SliceHdr *slice_param_hdr;     // slice header the template is for
+
   guint32 SpsMaxLatencyPictures;
   gint32 WpOffsetHalfRangeC;
 
@@ -420,6 +440,7 @@ struct _GstVaapiDecoderH265Private
   guint new_bitstream:1;
   guint prev_nal_is_eos:1;      /*previous nal type is EOS */
   guint associated_irap_NoRaslOutputFlag:1;
+  guint key_only:1;
 };
 
 /**
@@ -533,6 +554,13 @@ nal_is_ref (guint8 nal_type)
   return ret;
 }
 
+static inline gboolean
+is_key_only_mode (GstVaapiDecoderH265 * decoder)
+{
+  return gst_vaapi_decoder_get_skip_policy (GST_VAAPI_DECODER_CAST (decoder))
+      == GST_VAAPI_DECODER_SKIP_NON_KEY;
+}
+
 /* Activates the supplied PPS */
 static GstH265PPS *
 ensure_pps (GstVaapiDecoderH265 * decoder, GstH265PPS * pps)
@@ -721,6 +749,8 @@ static gboolean
 dpb_bump (GstVaapiDecoderH265 * decoder, GstVaapiPictureH265 * picture)
 {
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
+  GstVaapiDecoderStats *const stats = GST_VAAPI_DECODER_STATS (decoder);
+  const gint64 start_time = gst_vaapi_decoder_stats_begin (stats);
   GstVaapiPictureH265 *found_picture;
   gint found_index;
   gboolean success;
@@ -734,6 +764,8 @@ dpb_bump (GstVaapiDecoderH265 * decoder, GstVaapiPictureH265 * picture)
   if (!gst_vaapi_frame_store_has_reference (priv->dpb[found_index]))
     dpb_remove_index (decoder, found_index);
 
+  gst_vaapi_decoder_stats_end (stats, GST_VAAPI_DECODER_STAT_DPB_BUMP,
+      start_time);
   return success;
 }
 
@@ -973,6 +1005,7 @@ gst_vaapi_decoder_h265_destroy (GstVaapiDecoder * base_decoder)
   guint i;
 
   gst_vaapi_decoder_h265_close (decoder);
+  gst_vaapi_access_unit_splitter_clear (&priv->au_splitter);
   g_free (priv->dpb);
   priv->dpb = NULL;
   priv->dpb_size = 0;
@@ -985,6 +1018,10 @@ gst_vaapi_decoder_h265_destroy (GstVaapiDecoder * base_decoder)
   for (i = 0; i < G_N_ELEMENTS (priv->vps); i++)
     gst_vaapi_parser_info_h265_replace (&priv->vps[i], NULL);
   gst_vaapi_parser_info_h265_replace (&priv->active_vps, NULL);
+  for (i = 0; i < G_N_ELEMENTS (priv->parser_pps); i++)
+    gst_vaapi_parser_info_h265_replace (&priv->parser_pps[i], NULL);
+  for (i = 0; i < G_N_ELEMENTS (priv->parser_sps); i++)
+    gst_vaapi_parser_info_h265_replace (&priv->parser_sps[i], NULL);
 }
 
 static gboolean
@@ -994,6 +1031,7 @@ gst_vaapi_decoder_h265_create (GstVaapiDecoder * base_decoder)
       GST_VAAPI_DECODER_H265_CAST (base_decoder);
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
 
+  gst_vaapi_access_unit_splitter_init (&priv->au_splitter);
   priv->profile = GST_VAAPI_PROFILE_UNKNOWN;
   priv->entrypoint = GST_VAAPI_ENTRYPOINT_VLD;
   priv->chroma_type = GST_VAAPI_CHROMA_TYPE_YUV420;
@@ -1299,6 +1337,11 @@ decode_current_picture (GstVaapiDecoderH265 * decoder)
   if (!dpb_add (decoder, picture))
     goto error;
 
+  /* In key-only mode, output pictures right away since they will not
+     be referenced by any other decoded picture */
+  if (is_key_only_mode (decoder))
+    dpb_flush (decoder);
+
   gst_vaapi_picture_replace (&priv->current_picture, NULL);
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 
@@ -1349,6 +1392,7 @@ parse_sps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H265_PARSER_OK)
     return get_status (result);
 
+  gst_vaapi_parser_info_h265_replace (&priv->parser_sps[sps->id], pi);
   priv->parser_state |= GST_H265_VIDEO_STATE_GOT_SPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1359,6 +1403,7 @@ parse_pps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
   GstVaapiParserInfoH265 *const pi = unit->parsed_info;
   GstH265PPS *const pps = &pi->data.pps;
+  GstVaapiParserInfoH265 *sps_pi;
   GstH265ParserResult result;
   guint col_width[19], row_height[21];
 
@@ -1374,6 +1419,15 @@ parse_pps (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H265_PARSER_OK)
     return get_status (result);
 
+  /* Refer to our own copy of the SPS, that the parser cannot overwrite
+     while the PPS is still in use by the decoder */
+  sps_pi = priv->parser_sps[pps->sps->id];
+  if (!sps_pi)
+    return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
+  pps->sps = &sps_pi->data.sps;
+  gst_vaapi_parser_info_h265_replace (&pi->param_set, sps_pi);
+
+  gst_vaapi_parser_info_h265_replace (&priv->parser_pps[pps->id], pi);
   priv->parser_state |= GST_H265_VIDEO_STATE_GOT_PPS;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1402,6 +1456,7 @@ parse_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
   GstVaapiParserInfoH265 *const pi = unit->parsed_info;
   GstH265SliceHdr *const slice_hdr = &pi->data.slice_hdr;
+  GstVaapiParserInfoH265 *pps_pi;
   GstH265ParserResult result;
 
   GST_DEBUG ("parse slice");
@@ -1416,6 +1471,13 @@ parse_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   if (result != GST_H265_PARSER_OK)
     return get_status (result);
 
+  /* Likewise, the decoder only reads our own copy of the PPS */
+  pps_pi = priv->parser_pps[slice_hdr->pps->id];
+  if (!pps_pi)
+    return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
+  slice_hdr->pps = &pps_pi->data.pps;
+  gst_vaapi_parser_info_h265_replace (&pi->param_set, pps_pi);
+
   priv->parser_state |= GST_H265_VIDEO_STATE_GOT_SLICE;
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1700,10 +1762,12 @@ init_picture (GstVaapiDecoderH265 * decoder,
      2) a BLA picture
      3) a CRA picture that is the first access unit in the bitstream
      4) first picture that follows an end of sequence NAL unit in decoding order
-     5) has HandleCraAsBlaFlag == 1 (set by external means, so not considering )
+     5) has HandleCraAsBlaFlag == 1, i.e. in key-only mode where the
+        leading pictures are skipped
    */
   if (nal_is_idr (pi->nalu.type) || nal_is_bla (pi->nalu.type) ||
-      (nal_is_cra (pi->nalu.type) && priv->new_bitstream)
+      (nal_is_cra (pi->nalu.type) && (priv->new_bitstream ||
+              is_key_only_mode (decoder)))
       || priv->prev_nal_is_eos) {
     picture->NoRaslOutputFlag = 1;
   }
@@ -2222,6 +2286,8 @@ decode_picture (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
     return status;
 
   priv->decoder_state = 0;
+  priv->slice_param_hdr = NULL;
+  memset (&priv->slice_param, 0, sizeof (priv->slice_param));
 
   /* Create new picture */
   picture = gst_vaapi_picture_h265_new (decoder);
@@ -2283,10 +2349,9 @@ get_slice_data_byte_offset (GstH265SliceHdr * slice_hdr, guint nal_header_bytes)
 
 static gboolean
 fill_pred_weight_table (GstVaapiDecoderH265 * decoder,
-    GstVaapiSlice * slice, GstH265SliceHdr * slice_hdr)
+    VASliceParameterBufferHEVC * slice_param, GstH265SliceHdr * slice_hdr)
 {
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
-  VASliceParameterBufferHEVC *const slice_param = slice->param;
   GstH265PPS *const pps = get_pps (decoder);
   GstH265SPS *const sps = get_sps (decoder);
   GstH265PredWeightTable *const w = &slice_hdr->pred_weight_table;
@@ -2296,27 +2361,24 @@ fill_pred_weight_table (GstVaapiDecoderH265 * decoder,
   slice_param->luma_log2_weight_denom = 0;
   slice_param->delta_chroma_log2_weight_denom = 0;
 
+  /* The template may hold the weights of a previous slice */
+  memset (slice_param->delta_luma_weight_l0, 0,
+      sizeof (slice_param->delta_luma_weight_l0));
+  memset (slice_param->luma_offset_l0, 0, sizeof (slice_param->luma_offset_l0));
+  memset (slice_param->delta_luma_weight_l1, 0,
+      sizeof (slice_param->delta_luma_weight_l1));
+  memset (slice_param->luma_offset_l1, 0, sizeof (slice_param->luma_offset_l1));
+  memset (slice_param->delta_chroma_weight_l0, 0,
+      sizeof (slice_param->delta_chroma_weight_l0));
+  memset (slice_param->ChromaOffsetL0, 0,
+      sizeof (slice_param->ChromaOffsetL0));
+  memset (slice_param->delta_chroma_weight_l1, 0,
+      sizeof (slice_param->delta_chroma_weight_l1));
+  memset (slice_param->ChromaOffsetL1, 0,
+      sizeof (slice_param->ChromaOffsetL1));
+
   if ((pps->weighted_pred_flag && GST_H265_IS_P_SLICE (slice_hdr)) ||
       (pps->weighted_bipred_flag && GST_H265_IS_B_SLICE (slice_hdr))) {
-
-    /* Fixme: This should be done in parser apis */
-    memset (slice_param->delta_luma_weight_l0, 0,
-        sizeof (slice_param->delta_luma_weight_l0));
-    memset (slice_param->luma_offset_l0, 0,
-        sizeof (slice_param->luma_offset_l0));
-    memset (slice_param->delta_luma_weight_l1, 0,
-        sizeof (slice_param->delta_luma_weight_l1));
-    memset (slice_param->luma_offset_l1, 0,
-        sizeof (slice_param->luma_offset_l1));
-    memset (slice_param->delta_chroma_weight_l0, 0,
-        sizeof (slice_param->delta_chroma_weight_l0));
-    memset (slice_param->ChromaOffsetL0, 0,
-        sizeof (slice_param->ChromaOffsetL0));
-    memset (slice_param->delta_chroma_weight_l1, 0,
-        sizeof (slice_param->delta_chroma_weight_l1));
-    memset (slice_param->ChromaOffsetL1, 0,
-        sizeof (slice_param->ChromaOffsetL1));
-
     slice_param->luma_log2_weight_denom = w->luma_log2_weight_denom;
     if (sps->chroma_array_type != 0)
       slice_param->delta_chroma_log2_weight_denom =
@@ -2379,11 +2441,10 @@ fill_pred_weight_table (GstVaapiDecoderH265 * decoder,
 
 static gboolean
 fill_RefPicList (GstVaapiDecoderH265 * decoder,
-    GstVaapiPictureH265 * picture, GstVaapiSlice * slice,
+    GstVaapiPictureH265 * picture, VASliceParameterBufferHEVC * slice_param,
     GstH265SliceHdr * slice_hdr)
 {
   GstVaapiDecoderH265Private *const priv = &decoder->priv;
-  VASliceParameterBufferHEVC *const slice_param = slice->param;
   GstVaapiPicture *const base_picture = &picture->base;
   VAPictureParameterBufferHEVC *const pic_param = base_picture->param;
   guint i, num_ref_lists = 0, j;
@@ -2429,6 +2490,86 @@ fill_RefPicList (GstVaapiDecoderH265 * decoder,
   return TRUE;
 }
 
+static gboolean
+is_same_ref_pic_list_modification (GstH265RefPicListModification * a,
+    GstH265RefPicListModification * b, GstH265SliceHdr * slice_hdr)
+{
+  guint i;
+
+  if (a->ref_pic_list_modification_flag_l0 !=
+      b->ref_pic_list_modification_flag_l0 ||
+      a->ref_pic_list_modification_flag_l1 !=
+      b->ref_pic_list_modification_flag_l1)
+    return FALSE;
+
+  if (a->ref_pic_list_modification_flag_l0) {
+    for (i = 0; i <= slice_hdr->num_ref_idx_l0_active_minus1; i++) {
+      if (a->list_entry_l0[i] != b->list_entry_l0[i])
+        return FALSE;
+    }
+  }
+  if (a->ref_pic_list_modification_flag_l1) {
+    for (i = 0; i <= slice_hdr->num_ref_idx_l1_active_minus1; i++) {
+      if (a->list_entry_l1[i] != b->list_entry_l1[i])
+        return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/* Checks whether two independent slices of the same picture yield the
+   same reference picture lists and prediction weight tables */
+static gboolean
+is_same_slice_refs (GstH265SliceHdr * slice_hdr, GstH265SliceHdr * prev_hdr)
+{
+  if (slice_hdr->pps != prev_hdr->pps || slice_hdr->type != prev_hdr->type)
+    return FALSE;
+  if (GST_H265_IS_I_SLICE (slice_hdr))
+    return TRUE;
+
+  if (slice_hdr->num_ref_idx_l0_active_minus1 !=
+      prev_hdr->num_ref_idx_l0_active_minus1 ||
+      slice_hdr->num_ref_idx_l1_active_minus1 !=
+      prev_hdr->num_ref_idx_l1_active_minus1)
+    return FALSE;
+  if (!is_same_ref_pic_list_modification (&slice_hdr->ref_pic_list_modification,
+          &prev_hdr->ref_pic_list_modification, slice_hdr))
+    return FALSE;
+
+  if ((slice_hdr->pps->weighted_pred_flag && GST_H265_IS_P_SLICE (slice_hdr))
+      || (slice_hdr->pps->weighted_bipred_flag
+          && GST_H265_IS_B_SLICE (slice_hdr)))
+    return memcmp (&slice_hdr->pred_weight_table, &prev_hdr->pred_weight_table,
+        sizeof (slice_hdr->pred_weight_table)) == 0;
+  return TRUE;
+}
+
+/* Fills in the reference picture lists and prediction weight tables of
+   the slice parameter template. Dependent slice segments, and slices
+   with the same reference setup as the previous one, reuse them as is */
+static gboolean
+fill_slice_template (GstVaapiDecoderH265 * decoder,
+    GstVaapiPictureH265 * picture, GstH265SliceHdr * slice_hdr)
+{
+  GstVaapiDecoderH265Private *const priv = &decoder->priv;
+  VASliceParameterBufferHEVC *const slice_param = &priv->slice_param;
+
+  if (slice_hdr->dependent_slice_segment_flag)
+    slice_hdr = &priv->prev_independent_slice_pi->data.slice_hdr;
+
+  if (priv->slice_param_hdr && (priv->slice_param_hdr == slice_hdr ||
+          is_same_slice_refs (slice_hdr, priv->slice_param_hdr)))
+    return TRUE;
+
+  priv->slice_param_hdr = NULL;
+  if (!fill_RefPicList (decoder, picture, slice_param, slice_hdr))
+    return FALSE;
+  if (!fill_pred_weight_table (decoder, slice_param, slice_hdr))
+    return FALSE;
+  priv->slice_param_hdr = slice_hdr;
+  return TRUE;
+}
+
 static gboolean
 fill_slice (GstVaapiDecoderH265 * decoder,
     GstVaapiPictureH265 * picture, GstVaapiSlice * slice,
@@ -2495,12 +2636,8 @@ fill_slice (GstVaapiDecoderH265 * decoder,
   slice_param->five_minus_max_num_merge_cand =
       slice_hdr->five_minus_max_num_merge_cand;
 
-  if (!fill_RefPicList (decoder, picture, slice, slice_hdr))
-    return FALSE;
-
-  if (!fill_pred_weight_table (decoder, slice, slice_hdr))
-    return FALSE;
-
+  /* The reference picture lists and prediction weight tables were
+     copied from the template, see fill_slice_template() */
   return TRUE;
 }
 
@@ -2532,11 +2669,6 @@ decode_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
   }
 
-  if (!gst_buffer_map (buffer, &map_info, GST_MAP_READ)) {
-    GST_ERROR ("failed to map buffer");
-    return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
-  }
-
   /* Check wether this is the first/last slice in the current access unit */
   if (pi->flags & GST_VAAPI_DECODER_UNIT_FLAG_AU_START)
     GST_VAAPI_PICTURE_FLAG_SET (picture, GST_VAAPI_PICTURE_FLAG_AU_START);
@@ -2544,7 +2676,18 @@ decode_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
   if (pi->flags & GST_VAAPI_DECODER_UNIT_FLAG_AU_END)
     GST_VAAPI_PICTURE_FLAG_SET (picture, GST_VAAPI_PICTURE_FLAG_AU_END);
 
-  slice = GST_VAAPI_SLICE_NEW (HEVC, decoder,
+  init_picture_refs (decoder, picture, slice_hdr);
+
+  if (!fill_slice_template (decoder, picture, slice_hdr))
+    return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+
+  if (!gst_buffer_map (buffer, &map_info, GST_MAP_READ)) {
+    GST_ERROR ("failed to map buffer");
+    return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+  }
+
+  slice = gst_vaapi_slice_new (GST_VAAPI_DECODER_CAST (decoder),
+      &priv->slice_param, sizeof (priv->slice_param),
       (map_info.data + unit->offset + pi->nalu.offset), pi->nalu.size);
 
   gst_buffer_unmap (buffer, &map_info);
@@ -2553,8 +2696,6 @@ decode_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
     return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
   }
 
-  init_picture_refs (decoder, picture, slice_hdr);
-
   if (!fill_slice (decoder, picture, slice, pi, unit)) {
     gst_vaapi_mini_object_unref (GST_VAAPI_MINI_OBJECT (slice));
     return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
@@ -2569,8 +2710,7 @@ decode_slice (GstVaapiDecoderH265 * decoder, GstVaapiDecoderUnit * unit)
 static inline gint
 scan_for_start_code (GstAdapter * adapter, guint ofs, guint size, guint32 * scp)
 {
-  return (gint) gst_adapter_masked_scan_uint32_peek (adapter,
-      0xffffff00, 0x00000100, ofs, size, scp);
+  return gst_vaapi_adapter_scan_for_start_code (adapter, ofs, size, scp);
 }
 
 static GstVaapiDecoderStatus
@@ -2754,7 +2894,6 @@ gst_vaapi_decoder_h265_parse (GstVaapiDecoder * base_decoder,
 
   switch (priv->stream_alignment) {
     case GST_VAAPI_STREAM_ALIGN_H265_NALU:
-    case GST_VAAPI_STREAM_ALIGN_H265_AU:
       size = gst_adapter_available_fast (adapter);
       break;
     default:
@@ -2762,7 +2901,12 @@ gst_vaapi_decoder_h265_parse (GstVaapiDecoder * base_decoder,
       break;
   }
 
-  if (priv->is_hvcC) {
+  if (priv->stream_alignment == GST_VAAPI_STREAM_ALIGN_H265_AU) {
+    /* The head buffer holds a complete access unit: split it in one pass */
+    if (!gst_vaapi_access_unit_splitter_next (&priv->au_splitter, adapter,
+            priv->is_hvcC ? priv->nal_length_size : 0, &buf_size, &at_au_end))
+      return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+  } else if (priv->is_hvcC) {
     if (size < priv->nal_length_size)
       return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
     buf = (guchar *) & start_code;
@@ -2774,8 +2918,6 @@ gst_vaapi_decoder_h265_parse (GstVaapiDecoder * base_decoder,
     buf_size = priv->nal_length_size + nalu_size;
     if (size < buf_size)
       return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
-    else if (priv->stream_alignment == GST_VAAPI_STREAM_ALIGN_H265_AU)
-      at_au_end = (buf_size == size);
   } else {
     if (size < 4)
       return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
@@ -2797,10 +2939,7 @@ gst_vaapi_decoder_h265_parse (GstVaapiDecoder * base_decoder,
           scan_for_start_code (adapter, ofs2, size - ofs2, NULL);
       if (ofs < 0) {
         // Assume the whole NAL unit is present if end-of-stream
-        // or stream buffers aligned on access unit boundaries
-        if (priv->stream_alignment == GST_VAAPI_STREAM_ALIGN_H265_AU)
-          at_au_end = TRUE;
-        else if (!at_eos) {
+        if (!at_eos) {
           ps->input_offset2 = size;
           return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
         }
@@ -2954,6 +3093,36 @@ gst_vaapi_decoder_h265_decode (GstVaapiDecoder * base_decoder,
   return decode_unit (decoder, unit);
 }
 
+/* Checks whether the picture starting with the slice @pi can be skipped
+   according to the decoder skip policy. Sub-layer non-reference pictures
+   may still be referenced by higher sub-layers, so only those from the
+   highest sub-layer are considered as non-reference pictures */
+static gboolean
+skip_picture (GstVaapiDecoderH265 * decoder, GstVaapiParserInfoH265 * pi)
+{
+  GstVaapiDecoderH265Private *const priv = &decoder->priv;
+  GstH265SPS *const sps = pi->data.slice_hdr.pps->sps;
+  const guint8 nal_type = pi->nalu.type;
+  const guint8 temporal_id = pi->nalu.temporal_id_plus1 - 1;
+  gboolean is_reference;
+
+  is_reference = nal_is_ref (nal_type) ||
+      temporal_id < sps->max_sub_layers_minus1;
+  if (gst_vaapi_decoder_skip_picture (GST_VAAPI_DECODER_CAST (decoder),
+          is_reference, nal_is_irap (nal_type)))
+    return TRUE;
+
+  /* The DPB is flushed when entering key-only mode, since pictures are
+     output right away afterwards */
+  if (!is_key_only_mode (decoder))
+    priv->key_only = FALSE;
+  else if (!priv->key_only) {
+    dpb_flush (decoder);
+    priv->key_only = TRUE;
+  }
+  return FALSE;
+}
+
 static GstVaapiDecoderStatus
 gst_vaapi_decoder_h265_start_frame (GstVaapiDecoder * base_decoder,
     GstVaapiDecoderUnit * unit)
@@ -2961,6 +3130,8 @@ gst_vaapi_decoder_h265_start_frame (GstVaapiDecoder * base_decoder,
   GstVaapiDecoderH265 *const decoder =
       GST_VAAPI_DECODER_H265_CAST (base_decoder);
 
+  if (skip_picture (decoder, unit->parsed_info))
+    return (GstVaapiDecoderStatus) GST_VAAPI_DECODER_STATUS_DROP_FRAME;
   return decode_picture (decoder, unit);
 }
 
@@ -2980,6 +3151,9 @@ gst_vaapi_decoder_h265_flush (GstVaapiDecoder * base_decoder)
       GST_VAAPI_DECODER_H265_CAST (base_decoder);
 
   dpb_flush (decoder);
+
+  /* The input that was split is discarded along with the flush */
+  gst_vaapi_access_unit_splitter_reset (&decoder->priv.au_splitter);
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
@@ -2992,6 +3166,7 @@ gst_vaapi_decoder_h265_class_init (GstVaapiDecoderH265Class * klass)
 
   object_class->size = sizeof (GstVaapiDecoderH265);
   object_class->finalize = (GDestroyNotify) gst_vaapi_decoder_finalize;
+  decoder_class->parse_ahead = TRUE;
   decoder_class->create = gst_vaapi_decoder_h265_create;
   decoder_class->destroy = gst_vaapi_decoder_h265_destroy;
   decoder_class->parse = gst_vaapi_decoder_h265_parse;
@@ -3030,6 +3205,7 @@ gst_vaapi_decoder_h265_set_alignment (GstVaapiDecoderH265 * decoder,
 {
   g_return_if_fail (decoder != NULL);
   decoder->priv.stream_alignment = alignment;
+  gst_vaapi_access_unit_splitter_reset (&decoder->priv.au_splitter);
 }
 
 /**
@@ -35,6 +35,7 @@
 #include "gstvaapidecoder_priv.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
+#include "gstvaapiutils_startcode.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -179,9 +180,11 @@ struct _GstVaapiParserInfoMpeg2
 static inline const GstVaapiMiniObjectClass *
 gst_vaapi_parser_info_mpeg2_class (void)
 {
+  static GstVaapiMiniObjectCache GstVaapiParserInfoMpeg2Cache;
   static const GstVaapiMiniObjectClass GstVaapiParserInfoMpeg2Class = {
     sizeof (GstVaapiParserInfoMpeg2),
-    NULL
+    NULL,
+    &GstVaapiParserInfoMpeg2Cache
   };
   return &GstVaapiParserInfoMpeg2Class;
 }
@@ -556,6 +559,12 @@ decode_current_picture (GstVaapiDecoderMpeg2 * decoder)
     if (!gst_vaapi_dpb_add (priv->dpb, picture))
       goto error;
     gst_vaapi_picture_replace (&priv->current_picture, NULL);
+
+    /* In key-only mode, output pictures right away since they will
+       not be referenced by any other decoded picture */
+    if (gst_vaapi_decoder_get_skip_policy (GST_VAAPI_DECODER_CAST (decoder))
+        == GST_VAAPI_DECODER_SKIP_NON_KEY)
+      gst_vaapi_dpb_flush (priv->dpb);
   }
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 
@@ -1187,25 +1196,11 @@ static inline gint
 scan_for_start_code (const guchar * buf, guint buf_size,
     GstMpegVideoPacketTypeCode * type_ptr)
 {
-  guint i = 0;
-
-  while (i <= (buf_size - 4)) {
-    if (buf[i + 2] > 1)
-      i += 3;
-    else if (buf[i + 1])
-      i += 2;
-    else if (buf[i] || buf[i + 2] != 1)
-      i++;
-    else
-      break;
-  }
+  const gint ofs = gst_vaapi_find_start_code (buf, buf_size);
 
-  if (i <= (buf_size - 4)) {
-    if (type_ptr)
-      *type_ptr = buf[i + 3];
-    return i;
-  }
-  return -1;
+  if (ofs >= 0 && type_ptr)
+    *type_ptr = buf[ofs + 3];
+  return ofs;
 }
 
 static GstVaapiDecoderStatus
@@ -1461,6 +1456,29 @@ gst_vaapi_decoder_mpeg2_decode (GstVaapiDecoder * base_decoder,
   return decode_unit (decoder, unit, &packet);
 }
 
+/* Checks whether the current picture can be skipped according to the
+   decoder skip policy. B pictures are the only non-reference pictures */
+static gboolean
+skip_picture (GstVaapiDecoderMpeg2 * decoder)
+{
+  GstVaapiDecoderMpeg2Private *const priv = &decoder->priv;
+  GstMpegVideoPictureHdr *const pic_hdr = &priv->pic_hdr->data.pic_hdr;
+
+  /* The second field of a decoded first field is always decoded */
+  if (priv->current_picture)
+    return FALSE;
+
+  if (!gst_vaapi_decoder_skip_picture (GST_VAAPI_DECODER_CAST (decoder),
+          pic_hdr->pic_type != GST_MPEG_VIDEO_PICTURE_TYPE_B,
+          pic_hdr->pic_type == GST_MPEG_VIDEO_PICTURE_TYPE_I))
+    return FALSE;
+
+  /* Keep track of temporal references all the same */
+  pts_eval (&priv->tsg, GST_VAAPI_DECODER_CODEC_FRAME (decoder)->pts,
+      pic_hdr->tsn);
+  return TRUE;
+}
+
 static GstVaapiDecoderStatus
 gst_vaapi_decoder_mpeg2_start_frame (GstVaapiDecoder * base_decoder,
     GstVaapiDecoderUnit * base_unit)
@@ -1476,6 +1494,11 @@ gst_vaapi_decoder_mpeg2_start_frame (GstVaapiDecoder * base_decoder,
 
   if (!is_valid_state (decoder, GST_MPEG_VIDEO_STATE_VALID_PIC_HEADERS))
     return GST_VAAPI_DECODER_STATUS_SUCCESS;
+
+  if (skip_picture (decoder)) {
+    priv->state &= GST_MPEG_VIDEO_STATE_VALID_SEQ_HEADERS;
+    return (GstVaapiDecoderStatus) GST_VAAPI_DECODER_STATUS_DROP_FRAME;
+  }
   priv->state &= ~GST_MPEG_VIDEO_STATE_VALID_PIC_HEADERS;
 
   seq_hdr = &priv->seq_hdr->data.seq_hdr;
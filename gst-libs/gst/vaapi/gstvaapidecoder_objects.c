@@ -25,6 +25,7 @@
 #include "sysdeps.h"
 #include <string.h>
 #include <gst/vaapi/gstvaapicontext.h>
+#include "gstvaapicontext_buffers.h"
 #include "gstvaapidecoder_objects.h"
 #include "gstvaapidecoder_priv.h"
 #include "gstvaapisurfaceproxy_priv.h"
@@ -48,6 +49,29 @@ gst_video_codec_frame_clear (GstVideoCodecFrame ** frame_ptr)
   *frame_ptr = NULL;
 }
 
+/* Releases the slice VA buffers to the context pool, for reuse once
+   @surface_id is decoded, or right away if they were not submitted
+   (@surface_id is %VA_INVALID_SURFACE) */
+static void
+slice_release_buffers (GstVaapiSlice * slice, VASurfaceID surface_id)
+{
+  GstVaapiContext *const context = GET_CONTEXT (slice);
+
+  if (slice->param)
+    vaapi_unmap_buffer (GET_VA_DISPLAY (slice), slice->param_id,
+        &slice->param);
+
+  if (slice->param_id != VA_INVALID_ID)
+    gst_vaapi_context_destroy_buffer (context, VASliceParameterBufferType,
+        slice->param_size, &slice->param_id, surface_id,
+        slice->buffers_generation);
+
+  if (slice->data_id != VA_INVALID_ID)
+    gst_vaapi_context_destroy_buffer (context, VASliceDataBufferType,
+        slice->data_size, &slice->data_id, surface_id,
+        slice->buffers_generation);
+}
+
 /* ------------------------------------------------------------------------- */
 /* --- Pictures                                                          --- */
 /* ------------------------------------------------------------------------- */
@@ -87,6 +111,26 @@ gst_vaapi_picture_destroy (GstVaapiPicture * picture)
   gst_vaapi_picture_replace (&picture->parent_picture, NULL);
 }
 
+/* Surfaces could be larger than the picture when they are allocated
+   for a maximum resolution, see gst_vaapi_decoder_set_max_size() */
+static void
+picture_init_crop_rect (GstVaapiPicture * picture)
+{
+  GstVaapiDecoder *const decoder = GET_DECODER (picture);
+  const GstVaapiContextInfo *const cip = &decoder->context->info;
+  const guint width = GST_VAAPI_DECODER_WIDTH (decoder);
+  const guint height = GST_VAAPI_DECODER_HEIGHT (decoder);
+
+  if (cip->width <= width && cip->height <= height)
+    return;
+
+  picture->crop_rect.x = 0;
+  picture->crop_rect.y = 0;
+  picture->crop_rect.width = MIN (width, cip->width);
+  picture->crop_rect.height = MIN (height, cip->height);
+  picture->has_crop_rect = TRUE;
+}
+
 gboolean
 gst_vaapi_picture_create (GstVaapiPicture * picture,
     const GstVaapiCodecObjectConstructorArgs * args)
@@ -142,14 +186,37 @@ gst_vaapi_picture_create (GstVaapiPicture * picture,
       picture->crop_rect = parent_picture->crop_rect;
     }
   } else {
+    GstVaapiDecoderStats *const stats =
+        GST_VAAPI_DECODER_STATS (GET_DECODER (picture));
+    const gint64 start_time = gst_vaapi_decoder_stats_begin (stats);
+
     picture->type = GST_VAAPI_PICTURE_TYPE_NONE;
     picture->pts = GST_CLOCK_TIME_NONE;
 
     picture->proxy =
         gst_vaapi_context_get_surface_proxy (GET_CONTEXT (picture));
+    if (start_time) {
+      GstVaapiVideoPoolStats pool_stats;
+
+      if (gst_vaapi_context_get_surface_pool_stats (GET_CONTEXT (picture),
+              &pool_stats))
+        gst_vaapi_decoder_stats_set_surface_pool (stats, &pool_stats);
+
+      /* Account for the whole stall if previous attempts ran out of
+         free surfaces, and decoding is retried */
+      if (!stats->surface_wait_start)
+        stats->surface_wait_start = start_time;
+      if (picture->proxy) {
+        gst_vaapi_decoder_stats_record (stats,
+            GST_VAAPI_DECODER_STAT_SURFACE_WAIT, stats->surface_wait_start);
+        stats->surface_wait_start = 0;
+      }
+    }
     if (!picture->proxy)
       return FALSE;
 
+    picture_init_crop_rect (picture);
+
     picture->structure = GST_VAAPI_PICTURE_STRUCTURE_FRAME;
     GST_VAAPI_PICTURE_FLAG_SET (picture, GST_VAAPI_PICTURE_FLAG_FF);
   }
@@ -226,93 +293,196 @@ gst_vaapi_picture_add_slice (GstVaapiPicture * picture, GstVaapiSlice * slice)
   g_ptr_array_add (picture->slices, slice);
 }
 
+/* Number of VA buffers that could be submitted without heap allocations */
+#define MAX_STACK_BUFFERS 64
+
+/* Collection of VA buffers to submit with a single vaRenderPicture() */
+typedef struct
+{
+  VADisplay va_display;
+  guint num_buffers;
+  guint max_buffers;
+  VABufferID *buffers;
+  VABufferID **buffer_ptrs;
+  guint8 *groups;
+  VABufferID stack_buffers[MAX_STACK_BUFFERS];
+  VABufferID *stack_buffer_ptrs[MAX_STACK_BUFFERS];
+  guint8 stack_groups[MAX_STACK_BUFFERS];
+} RenderBatch;
+
+static void
+render_batch_init (RenderBatch * batch, VADisplay dpy, guint max_buffers)
+{
+  batch->va_display = dpy;
+  batch->num_buffers = 0;
+  batch->max_buffers = max_buffers;
+  if (max_buffers <= MAX_STACK_BUFFERS) {
+    batch->buffers = batch->stack_buffers;
+    batch->buffer_ptrs = batch->stack_buffer_ptrs;
+    batch->groups = batch->stack_groups;
+  } else {
+    batch->buffers = g_new (VABufferID, max_buffers);
+    batch->buffer_ptrs = g_new (VABufferID *, max_buffers);
+    batch->groups = g_new (guint8, max_buffers);
+  }
+}
+
+/* Destroys all VA buffers that were submitted for rendering */
+static void
+render_batch_clear (RenderBatch * batch)
+{
+  guint i;
+
+  for (i = 0; i < batch->num_buffers; i++)
+    vaapi_destroy_buffer (batch->va_display, batch->buffer_ptrs[i]);
+  batch->num_buffers = 0;
+
+  if (batch->buffers != batch->stack_buffers) {
+    g_free (batch->buffers);
+    g_free (batch->buffer_ptrs);
+    g_free (batch->groups);
+  }
+}
+
+/* Appends the VA buffer to the batch. @group_size is the number of
+   buffers, starting from this one, that have to be submitted together
+   in sequential mode. Trailing buffers of a group use zero */
+static void
+render_batch_append (RenderBatch * batch, VABufferID * buf_id_ptr,
+    guint group_size)
+{
+  g_assert (batch->num_buffers < batch->max_buffers);
+
+  batch->buffers[batch->num_buffers] = *buf_id_ptr;
+  batch->buffer_ptrs[batch->num_buffers] = buf_id_ptr;
+  batch->groups[batch->num_buffers] = group_size;
+  batch->num_buffers++;
+}
+
+/* Unmaps the VA buffer and appends it to the batch */
+static inline void
+render_batch_add (RenderBatch * batch, VABufferID * buf_id_ptr,
+    void **buf_ptr, guint group_size)
+{
+  vaapi_unmap_buffer (batch->va_display, *buf_id_ptr, buf_ptr);
+  render_batch_append (batch, buf_id_ptr, group_size);
+}
+
 static gboolean
-do_decode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
+render_batch_submit (RenderBatch * batch, VAContextID ctx)
 {
   VAStatus status;
 
-  vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
+  status = vaRenderPicture (batch->va_display, ctx, batch->buffers,
+      batch->num_buffers);
+  return vaapi_check_status (status, "vaRenderPicture()");
+}
 
-  status = vaRenderPicture (dpy, ctx, buf_id, 1);
-  if (!vaapi_check_status (status, "vaRenderPicture()"))
-    return FALSE;
+/* Submits each parameter buffer and each slice param/data pair through
+   a separate vaRenderPicture() call, for drivers that do not handle a
+   whole picture at once. This is decided when the decoder is created,
+   since a failed vaRenderPicture() may have consumed some buffers */
+static gboolean
+render_batch_submit_sequential (RenderBatch * batch, VAContextID ctx)
+{
+  VAStatus status;
+  guint i, n;
 
-  /* XXX: vaRenderPicture() is meant to destroy the VA buffer implicitly */
-  vaapi_destroy_buffer (dpy, buf_id);
+  for (i = 0; i < batch->num_buffers; i += n) {
+    n = batch->groups[i];
+    status = vaRenderPicture (batch->va_display, ctx, &batch->buffers[i], n);
+    if (!vaapi_check_status (status, "vaRenderPicture()"))
+      return FALSE;
+  }
   return TRUE;
 }
 
 gboolean
 gst_vaapi_picture_decode (GstVaapiPicture * picture)
 {
+  GstVaapiDecoder *decoder;
   GstVaapiIqMatrix *iq_matrix;
   GstVaapiBitPlane *bitplane;
   GstVaapiHuffmanTable *huf_table;
   GstVaapiProbabilityTable *prob_table;
+  RenderBatch batch;
   VADisplay va_display;
   VAContextID va_context;
   VAStatus status;
+  gboolean success;
+  gint64 start_time;
   guint i;
 
   g_return_val_if_fail (GST_VAAPI_IS_PICTURE (picture), FALSE);
 
+  decoder = GET_DECODER (picture);
   va_display = GET_VA_DISPLAY (picture);
   va_context = GET_VA_CONTEXT (picture);
 
   GST_DEBUG ("decode picture 0x%08x", picture->surface_id);
 
+  start_time =
+      gst_vaapi_decoder_stats_begin (GST_VAAPI_DECODER_STATS (decoder));
   status = vaBeginPicture (va_display, va_context, picture->surface_id);
   if (!vaapi_check_status (status, "vaBeginPicture()"))
     return FALSE;
 
-  if (!do_decode (va_display, va_context, &picture->param_id, &picture->param))
-    return FALSE;
+  /* picture, iq_matrix, bitplane, huf_table, prob_table + 3 per slice */
+  render_batch_init (&batch, va_display, 5 + 3 * picture->slices->len);
+
+  render_batch_add (&batch, &picture->param_id, &picture->param, 1);
 
   iq_matrix = picture->iq_matrix;
-  if (iq_matrix && !do_decode (va_display, va_context,
-          &iq_matrix->param_id, &iq_matrix->param))
-    return FALSE;
+  if (iq_matrix)
+    render_batch_add (&batch, &iq_matrix->param_id, &iq_matrix->param, 1);
 
   bitplane = picture->bitplane;
-  if (bitplane && !do_decode (va_display, va_context,
-          &bitplane->data_id, (void **) &bitplane->data))
-    return FALSE;
+  if (bitplane)
+    render_batch_add (&batch, &bitplane->data_id, (void **) &bitplane->data,
+        1);
 
   huf_table = picture->huf_table;
-  if (huf_table && !do_decode (va_display, va_context,
-          &huf_table->param_id, (void **) &huf_table->param))
-    return FALSE;
+  if (huf_table)
+    render_batch_add (&batch, &huf_table->param_id,
+        (void **) &huf_table->param, 1);
 
   prob_table = picture->prob_table;
-  if (prob_table && !do_decode (va_display, va_context,
-          &prob_table->param_id, (void **) &prob_table->param))
-    return FALSE;
+  if (prob_table)
+    render_batch_add (&batch, &prob_table->param_id,
+        (void **) &prob_table->param, 1);
 
   for (i = 0; i < picture->slices->len; i++) {
     GstVaapiSlice *const slice = g_ptr_array_index (picture->slices, i);
-    VABufferID va_buffers[2];
 
     huf_table = slice->huf_table;
-    if (huf_table && !do_decode (va_display, va_context,
-            &huf_table->param_id, (void **) &huf_table->param))
-      return FALSE;
+    if (huf_table)
+      render_batch_add (&batch, &huf_table->param_id,
+          (void **) &huf_table->param, 1);
 
-    vaapi_unmap_buffer (va_display, slice->param_id, NULL);
-    va_buffers[0] = slice->param_id;
-    va_buffers[1] = slice->data_id;
+    render_batch_add (&batch, &slice->param_id, &slice->param, 2);
+    render_batch_append (&batch, &slice->data_id, 0);
+  }
 
-    status = vaRenderPicture (va_display, va_context, va_buffers, 2);
-    if (!vaapi_check_status (status, "vaRenderPicture()"))
-      return FALSE;
+  if (decoder->render_sequential)
+    success = render_batch_submit_sequential (&batch, va_context);
+  else
+    success = render_batch_submit (&batch, va_context);
 
-    vaapi_destroy_buffer (va_display, &slice->param_id);
-    vaapi_destroy_buffer (va_display, &slice->data_id);
+  if (success) {
+    status = vaEndPicture (va_display, va_context);
+    success = vaapi_check_status (status, "vaEndPicture()");
   }
+  gst_vaapi_decoder_stats_end (GST_VAAPI_DECODER_STATS (decoder),
+      GST_VAAPI_DECODER_STAT_RENDER, start_time);
 
-  status = vaEndPicture (va_display, va_context);
-  if (!vaapi_check_status (status, "vaEndPicture()"))
-    return FALSE;
-  return TRUE;
+  /* Recycle slice buffers, and destroy the other ones */
+  for (i = 0; i < picture->slices->len; i++)
+    slice_release_buffers (g_ptr_array_index (picture->slices, i),
+        picture->surface_id);
+
+  /* XXX: vaRenderPicture() is meant to destroy the VA buffer implicitly */
+  render_batch_clear (&batch);
+  return success;
 }
 
 /* Mark picture as output for internal purposes only. Don't push frame out */
@@ -428,13 +598,9 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiSlice, gst_vaapi_slice);
 void
 gst_vaapi_slice_destroy (GstVaapiSlice * slice)
 {
-  VADisplay const va_display = GET_VA_DISPLAY (slice);
-
   gst_vaapi_codec_object_replace (&slice->huf_table, NULL);
 
-  vaapi_destroy_buffer (va_display, &slice->data_id);
-  vaapi_destroy_buffer (va_display, &slice->param_id);
-  slice->param = NULL;
+  slice_release_buffers (slice, VA_INVALID_SURFACE);
 }
 
 gboolean
@@ -446,16 +612,18 @@ gst_vaapi_slice_create (GstVaapiSlice * slice,
 
   slice->param_id = VA_INVALID_ID;
   slice->data_id = VA_INVALID_ID;
+  slice->param_size = args->param_size;
+  slice->data_size = args->data_size;
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (slice), GET_VA_CONTEXT (slice),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (slice),
       VASliceDataBufferType, args->data_size, args->data, &slice->data_id,
-      NULL);
+      NULL, &slice->buffers_generation);
   if (!success)
     return FALSE;
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (slice), GET_VA_CONTEXT (slice),
+  success = gst_vaapi_context_create_buffer (GET_CONTEXT (slice),
       VASliceParameterBufferType, args->param_size, args->param,
-      &slice->param_id, &slice->param);
+      &slice->param_id, &slice->param, &slice->buffers_generation);
   if (!success)
     return FALSE;
 
@@ -244,6 +244,11 @@ struct _GstVaapiSlice
 
   /* Per-slice overrides */
   GstVaapiHuffmanTable *huf_table;
+
+  /*< private >*/
+  guint param_size;
+  guint data_size;
+  guint buffers_generation;
 };
 
 G_GNUC_INTERNAL
@@ -30,6 +30,7 @@
 #include <gst/vaapi/gstvaapidecoder_unit.h>
 #include <gst/vaapi/gstvaapicontext.h>
 #include "gstvaapiminiobject.h"
+#include "gstvaapidecoder_stats.h"
 
 G_BEGIN_DECLS
 
@@ -121,12 +122,23 @@ struct _GstVaapiDecoderUnit;
  * @decoder: a #GstVaapiDecoder
  *
  * Macro that evaluates to the #GstVideoCodecFrame holding decoder
- * units for the current frame.
+ * units for the frame being decoded.
  * This is an internal macro that does not do any run-time type check.
  */
 #undef  GST_VAAPI_DECODER_CODEC_FRAME
 #define GST_VAAPI_DECODER_CODEC_FRAME(decoder) \
-    GST_VAAPI_PARSER_STATE(decoder)->current_frame
+    GST_VAAPI_DECODER_CAST(decoder)->decode_frame
+
+/**
+ * GST_VAAPI_DECODER_STATS:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Macro that evaluates to the #GstVaapiDecoderStats of @decoder.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#undef  GST_VAAPI_DECODER_STATS
+#define GST_VAAPI_DECODER_STATS(decoder) \
+    (&GST_VAAPI_DECODER_CAST(decoder)->stats)
 
 /**
  * GST_VAAPI_DECODER_WIDTH:
@@ -175,11 +187,36 @@ struct _GstVaapiParserState
   gint input_offset1;
   gint input_offset2;
   GstAdapter *output_adapter;
+  GQueue input_regions;
+  guint64 input_region_offset;
+  guint64 input_total_size;
+  guint64 output_slice_start;
+  guint64 output_slice_end;
   GstVaapiDecoderUnit next_unit;
   guint next_unit_pending:1;
   guint at_eos:1;
 };
 
+typedef struct _GstVaapiParseAhead GstVaapiParseAhead;
+struct _GstVaapiParseAhead
+{
+  GThread *thread;
+  GMutex mutex;
+  GCond cond;
+  GQueue frames;
+  GQueue frame_sizes;
+  guint64 frame_end;
+  guint max_frames;
+  guint pending_buffers;
+  guint generation;
+  guint64 queued_bytes;
+  GstVaapiDecoderStatus status;
+  volatile gint stop;
+  gboolean paused;
+  gboolean busy;
+  gboolean eos_queued;
+};
+
 /**
  * GstVaapiDecoder:
  *
@@ -200,12 +237,23 @@ struct _GstVaapiDecoder
   GAsyncQueue *buffers;
   GAsyncQueue *frames;
   GstVaapiParserState parser_state;
+  GstVaapiParseAhead parse_ahead;
+  GstVideoCodecFrame *decode_frame;
+  GstVaapiDecoderStats stats;
+  volatile gint skip_policy;
+  guint max_width;
+  guint max_height;
+  guint surface_headroom;
+  gboolean prewarm_surfaces;
   GstVaapiDecoderStateChangedFunc codec_state_changed_func;
   gpointer codec_state_changed_data;
+  gboolean render_sequential;
 };
 
 /**
  * GstVaapiDecoderClass:
+ * @parse_ahead: %TRUE if the parse() vfunc only updates parser state,
+ *   and can thus run in a separate thread, ahead of decode()
  *
  * A VA decoder base class.
  */
@@ -214,6 +262,8 @@ struct _GstVaapiDecoderClass
   /*< private >*/
   GstVaapiMiniObjectClass parent_class;
 
+  gboolean parse_ahead;
+
   gboolean (*create) (GstVaapiDecoder * decoder);
   void (*destroy) (GstVaapiDecoder * decoder);
   GstVaapiDecoderStatus (*parse) (GstVaapiDecoder * decoder,
@@ -282,6 +332,11 @@ G_GNUC_INTERNAL
 GstVaapiDecoderStatus
 gst_vaapi_decoder_decode_codec_data (GstVaapiDecoder * decoder);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_decoder_skip_picture (GstVaapiDecoder * decoder,
+    gboolean is_reference, gboolean is_key);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_DECODER_PRIV_H */
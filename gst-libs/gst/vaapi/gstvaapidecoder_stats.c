@@ -0,0 +1,271 @@
+/*
+ *  gstvaapidecoder_stats.c - Decoder statistics
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include "gstvaapidecoder_stats.h"
+
+/* Field name prefixes, in GstVaapiDecoderStat order */
+static const gchar *const g_stat_names[GST_VAAPI_DECODER_STAT_COUNT] = {
+  "parse",
+  "surface-wait",
+  "render",
+  "dpb-bump",
+  "output-latency",
+};
+
+typedef struct
+{
+  gconstpointer frame;
+  gint64 time;
+} OutputEntry;
+
+static void
+output_entry_free (OutputEntry * entry)
+{
+  g_slice_free (OutputEntry, entry);
+}
+
+static gint
+output_entry_compare (gconstpointer a, gconstpointer b)
+{
+  const OutputEntry *const entry = a;
+
+  return entry->frame != b;
+}
+
+static void
+output_queue_clear (GQueue * queue)
+{
+  g_queue_foreach (queue, (GFunc) output_entry_free, NULL);
+  g_queue_clear (queue);
+}
+
+static void
+stats_clear (GstVaapiDecoderStats * stats)
+{
+  memset (stats->entries, 0, sizeof (stats->entries));
+  stats->frames_output = 0;
+  stats->frames_dropped = 0;
+  stats->surface_wait_start = 0;
+  memset (&stats->surface_pool, 0, sizeof (stats->surface_pool));
+  output_queue_clear (&stats->output_queue);
+}
+
+void
+gst_vaapi_decoder_stats_init (GstVaapiDecoderStats * stats)
+{
+  memset (stats, 0, sizeof (*stats));
+  g_mutex_init (&stats->lock);
+  g_queue_init (&stats->output_queue);
+}
+
+void
+gst_vaapi_decoder_stats_finalize (GstVaapiDecoderStats * stats)
+{
+  stats_clear (stats);
+  g_mutex_clear (&stats->lock);
+}
+
+void
+gst_vaapi_decoder_stats_reset (GstVaapiDecoderStats * stats)
+{
+  g_mutex_lock (&stats->lock);
+  stats_clear (stats);
+  g_mutex_unlock (&stats->lock);
+}
+
+/* Frames that were queued or output while the statistics were disabled
+   have no matching entry, so pending entries are dropped on toggle */
+void
+gst_vaapi_decoder_stats_set_enabled (GstVaapiDecoderStats * stats,
+    gboolean enabled)
+{
+  enabled = enabled != FALSE;
+  if (g_atomic_int_get (&stats->enabled) == enabled)
+    return;
+
+  g_mutex_lock (&stats->lock);
+  output_queue_clear (&stats->output_queue);
+  g_atomic_int_set (&stats->enabled, enabled);
+  g_mutex_unlock (&stats->lock);
+}
+
+static inline guint
+get_histogram_bucket (guint64 duration)
+{
+  guint bucket = 0;
+
+  while (duration > 0 && bucket < GST_VAAPI_DECODER_STATS_HISTOGRAM_SIZE - 1) {
+    duration >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+static void
+stats_add (GstVaapiDecoderStats * stats, GstVaapiDecoderStat stat,
+    gint64 duration)
+{
+  GstVaapiDecoderStatsEntry *const entry = &stats->entries[stat];
+
+  if (duration < 0)
+    duration = 0;
+
+  entry->count++;
+  entry->total_time += duration;
+  if (entry->max_time < duration)
+    entry->max_time = duration;
+  entry->histogram[get_histogram_bucket (duration)]++;
+}
+
+void
+gst_vaapi_decoder_stats_record (GstVaapiDecoderStats * stats,
+    GstVaapiDecoderStat stat, gint64 start_time)
+{
+  const gint64 now = g_get_monotonic_time ();
+
+  g_mutex_lock (&stats->lock);
+  stats_add (stats, stat, now - start_time);
+  g_mutex_unlock (&stats->lock);
+}
+
+/* Records when @frame entered the output queue */
+void
+gst_vaapi_decoder_stats_push_frame (GstVaapiDecoderStats * stats,
+    gconstpointer frame, gboolean dropped)
+{
+  OutputEntry *entry;
+
+  if (!gst_vaapi_decoder_stats_enabled (stats))
+    return;
+
+  entry = g_slice_new (OutputEntry);
+  entry->frame = frame;
+  entry->time = g_get_monotonic_time ();
+
+  g_mutex_lock (&stats->lock);
+  if (dropped)
+    stats->frames_dropped++;
+  else
+    stats->frames_output++;
+  g_queue_push_tail (&stats->output_queue, entry);
+  g_mutex_unlock (&stats->lock);
+}
+
+/* Records the output queue latency of @frame. Entries queued before
+   @frame were left behind by frames that never went through here, e.g.
+   on flush, so they are dropped along the way */
+void
+gst_vaapi_decoder_stats_pop_frame (GstVaapiDecoderStats * stats,
+    gconstpointer frame)
+{
+  OutputEntry *entry;
+  GList *link;
+
+  if (!gst_vaapi_decoder_stats_enabled (stats))
+    return;
+
+  g_mutex_lock (&stats->lock);
+  link = g_queue_find_custom (&stats->output_queue, frame,
+      output_entry_compare);
+  if (link) {
+    while (g_queue_peek_head_link (&stats->output_queue) != link)
+      output_entry_free (g_queue_pop_head (&stats->output_queue));
+    entry = g_queue_pop_head (&stats->output_queue);
+
+    stats_add (stats, GST_VAAPI_DECODER_STAT_OUTPUT_LATENCY,
+        g_get_monotonic_time () - entry->time);
+    output_entry_free (entry);
+  }
+  g_mutex_unlock (&stats->lock);
+}
+
+/* Records the latest snapshot of the decoder surface pool usage */
+void
+gst_vaapi_decoder_stats_set_surface_pool (GstVaapiDecoderStats * stats,
+    const GstVaapiVideoPoolStats * pool_stats)
+{
+  g_mutex_lock (&stats->lock);
+  stats->surface_pool = *pool_stats;
+  g_mutex_unlock (&stats->lock);
+}
+
+static void
+fill_entry (GstStructure * structure, const gchar * name,
+    const GstVaapiDecoderStatsEntry * entry)
+{
+  GValue histogram = G_VALUE_INIT;
+  GValue value = G_VALUE_INIT;
+  gchar field[64];
+  guint i;
+
+  g_snprintf (field, sizeof (field), "%s-count", name);
+  gst_structure_set (structure, field, G_TYPE_UINT64, entry->count, NULL);
+  g_snprintf (field, sizeof (field), "%s-total-time", name);
+  gst_structure_set (structure, field, G_TYPE_UINT64,
+      entry->total_time * GST_USECOND, NULL);
+  g_snprintf (field, sizeof (field), "%s-max-time", name);
+  gst_structure_set (structure, field, G_TYPE_UINT64,
+      entry->max_time * GST_USECOND, NULL);
+
+  g_value_init (&histogram, GST_TYPE_ARRAY);
+  g_value_init (&value, G_TYPE_UINT64);
+  for (i = 0; i < GST_VAAPI_DECODER_STATS_HISTOGRAM_SIZE; i++) {
+    g_value_set_uint64 (&value, entry->histogram[i]);
+    gst_value_array_append_value (&histogram, &value);
+  }
+  g_value_unset (&value);
+
+  g_snprintf (field, sizeof (field), "%s-histogram", name);
+  gst_structure_take_value (structure, field, &histogram);
+}
+
+/* Fills @structure with a snapshot of the statistics. Times are
+   expressed in nanoseconds, histograms hold the number of samples in
+   each power of two microseconds bucket */
+void
+gst_vaapi_decoder_stats_fill (GstVaapiDecoderStats * stats,
+    GstStructure * structure)
+{
+  GstVaapiDecoderStatsEntry entries[GST_VAAPI_DECODER_STAT_COUNT];
+  GstVaapiVideoPoolStats surface_pool;
+  guint64 frames_output, frames_dropped;
+  guint i;
+
+  g_mutex_lock (&stats->lock);
+  memcpy (entries, stats->entries, sizeof (entries));
+  frames_output = stats->frames_output;
+  frames_dropped = stats->frames_dropped;
+  surface_pool = stats->surface_pool;
+  g_mutex_unlock (&stats->lock);
+
+  gst_structure_set (structure,
+      "enabled", G_TYPE_BOOLEAN, gst_vaapi_decoder_stats_enabled (stats),
+      "frames-output", G_TYPE_UINT64, frames_output,
+      "frames-dropped", G_TYPE_UINT64, frames_dropped,
+      "surfaces", G_TYPE_UINT, surface_pool.num_objects,
+      "surfaces-peak-used", G_TYPE_UINT, surface_pool.peak_used,
+      "surface-pool-grown", G_TYPE_UINT64, surface_pool.num_grown,
+      "surface-pool-exhausted", G_TYPE_UINT64, surface_pool.num_exhausted,
+      NULL);
+
+  for (i = 0; i < GST_VAAPI_DECODER_STAT_COUNT; i++)
+    fill_entry (structure, g_stat_names[i], &entries[i]);
+}
@@ -0,0 +1,130 @@
+/*
+ *  gstvaapidecoder_stats.h - Decoder statistics
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DECODER_STATS_H
+#define GST_VAAPI_DECODER_STATS_H
+
+#include <gst/gst.h>
+#include "gstvaapivideopool_priv.h"
+
+G_BEGIN_DECLS
+
+/* Number of histogram buckets. Bucket 0 counts durations below 1 us,
+   bucket i durations in [2^(i-1), 2^i) us, the last one is open ended */
+#define GST_VAAPI_DECODER_STATS_HISTOGRAM_SIZE 20
+
+typedef enum
+{
+  GST_VAAPI_DECODER_STAT_PARSE = 0,
+  GST_VAAPI_DECODER_STAT_SURFACE_WAIT,
+  GST_VAAPI_DECODER_STAT_RENDER,
+  GST_VAAPI_DECODER_STAT_DPB_BUMP,
+  GST_VAAPI_DECODER_STAT_OUTPUT_LATENCY,
+
+  GST_VAAPI_DECODER_STAT_COUNT
+} GstVaapiDecoderStat;
+
+typedef struct _GstVaapiDecoderStatsEntry GstVaapiDecoderStatsEntry;
+struct _GstVaapiDecoderStatsEntry
+{
+  guint64 count;
+  guint64 total_time;
+  guint64 max_time;
+  guint64 histogram[GST_VAAPI_DECODER_STATS_HISTOGRAM_SIZE];
+};
+
+typedef struct _GstVaapiDecoderStats GstVaapiDecoderStats;
+struct _GstVaapiDecoderStats
+{
+  volatile gint enabled;
+  GMutex lock;
+  GstVaapiDecoderStatsEntry entries[GST_VAAPI_DECODER_STAT_COUNT];
+  guint64 frames_output;
+  guint64 frames_dropped;
+  GQueue output_queue;
+  gint64 surface_wait_start;
+  GstVaapiVideoPoolStats surface_pool;
+};
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stats_init (GstVaapiDecoderStats * stats);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stats_finalize (GstVaapiDecoderStats * stats);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stats_reset (GstVaapiDecoderStats * stats);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stats_set_enabled (GstVaapiDecoderStats * stats,
+    gboolean enabled);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stats_record (GstVaapiDecoderStats * stats,
+    GstVaapiDecoderStat stat, gint64 start_time);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stats_push_frame (GstVaapiDecoderStats * stats,
+    gconstpointer frame, gboolean dropped);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stats_pop_frame (GstVaapiDecoderStats * stats,
+    gconstpointer frame);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stats_set_surface_pool (GstVaapiDecoderStats * stats,
+    const GstVaapiVideoPoolStats * pool_stats);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stats_fill (GstVaapiDecoderStats * stats,
+    GstStructure * structure);
+
+static inline gboolean
+gst_vaapi_decoder_stats_enabled (GstVaapiDecoderStats * stats)
+{
+  return G_UNLIKELY (g_atomic_int_get (&stats->enabled));
+}
+
+/* Returns the start time of a measurement, or zero if disabled */
+static inline gint64
+gst_vaapi_decoder_stats_begin (GstVaapiDecoderStats * stats)
+{
+  return gst_vaapi_decoder_stats_enabled (stats) ? g_get_monotonic_time () : 0;
+}
+
+static inline void
+gst_vaapi_decoder_stats_end (GstVaapiDecoderStats * stats,
+    GstVaapiDecoderStat stat, gint64 start_time)
+{
+  if (G_UNLIKELY (start_time != 0))
+    gst_vaapi_decoder_stats_record (stats, stat, start_time);
+}
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DECODER_STATS_H */
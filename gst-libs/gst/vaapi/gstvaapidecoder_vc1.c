@@ -35,6 +35,7 @@
 #include "gstvaapidecoder_priv.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
+#include "gstvaapiutils_startcode.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -1230,8 +1231,7 @@ ensure_decoder (GstVaapiDecoderVC1 * decoder)
 static inline gint
 scan_for_start_code (GstAdapter * adapter, guint ofs, guint size, guint32 * scp)
 {
-  return (gint) gst_adapter_masked_scan_uint32_peek (adapter,
-      0xffffff00, 0x00000100, ofs, size, scp);
+  return gst_vaapi_adapter_scan_for_start_code (adapter, ofs, size, scp);
 }
 
 static GstVaapiDecoderStatus
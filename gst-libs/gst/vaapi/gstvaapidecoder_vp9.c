@@ -568,7 +568,9 @@ parse_frame_header (GstVaapiDecoderVp9 * decoder, const guchar * buf,
    * what actullay configured. There are streams where a bigger
    * resolution set in ivf header or webm header but actual resolution
    * of all frames are less. Also it is possible to have inter-prediction
-   * between these multi resolution frames */
+   * between these multi resolution frames. Surfaces are further kept
+   * at the size announced with gst_vaapi_decoder_set_max_size(), so
+   * that growing up to that size doesn't reset the context either */
   width = GST_VAAPI_DECODER_WIDTH (decoder);
   height = GST_VAAPI_DECODER_HEIGHT (decoder);
   if (priv->width < width || priv->height < height) {
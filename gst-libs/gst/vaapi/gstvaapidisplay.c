@@ -174,6 +174,10 @@ gst_vaapi_display_type_get_type (void)
 #if USE_DRM
     {GST_VAAPI_DISPLAY_TYPE_DRM,
         "VA/DRM display", "drm"},
+#endif
+#if USE_NULL
+    {GST_VAAPI_DISPLAY_TYPE_NULL,
+        "VA/NULL display", "null"},
 #endif
     {0, NULL, NULL},
   };
@@ -933,7 +937,8 @@ gst_vaapi_display_create_unlocked (GstVaapiDisplay * display,
     priv->display_type = cached_info->display_type;
   }
 
-  if (!priv->parent) {
+  /* The in-process VA/NULL driver is ready as soon as it is opened */
+  if (!priv->parent && priv->display_type != GST_VAAPI_DISPLAY_TYPE_NULL) {
     status = vaInitialize (priv->display, &major_version, &minor_version);
     if (!vaapi_check_status (status, "vaInitialize()"))
       return FALSE;
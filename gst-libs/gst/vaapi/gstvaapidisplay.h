@@ -92,6 +92,7 @@ typedef struct _GstVaapiDisplay                 GstVaapiDisplay;
  * @GST_VAAPI_DISPLAY_TYPE_WAYLAND: VA/Wayland display.
  * @GST_VAAPI_DISPLAY_TYPE_DRM: VA/DRM display.
  * @GST_VAAPI_DISPLAY_TYPE_EGL: VA/EGL display.
+ * @GST_VAAPI_DISPLAY_TYPE_NULL: VA/NULL display (in-process software backend).
  */
 typedef enum
 {
@@ -101,6 +102,7 @@ typedef enum
   GST_VAAPI_DISPLAY_TYPE_WAYLAND,
   GST_VAAPI_DISPLAY_TYPE_DRM,
   GST_VAAPI_DISPLAY_TYPE_EGL,
+  GST_VAAPI_DISPLAY_TYPE_NULL,
 } GstVaapiDisplayType;
 
 #define GST_VAAPI_TYPE_DISPLAY_TYPE \
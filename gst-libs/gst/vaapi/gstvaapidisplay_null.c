@@ -0,0 +1,227 @@
+/*
+ *  gstvaapidisplay_null.c - VA/NULL display abstraction
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapidisplay_null
+ * @short_description: VA/NULL display abstraction
+ *
+ * The VA/NULL display is backed by an in-process driver that keeps
+ * surfaces, images and buffers in system memory and records every
+ * buffer submitted for rendering. It needs no GPU and no libva driver
+ * module, so that decoders and encoders can run end-to-end on
+ * headless machines, e.g. for CI or for benchmarking the CPU side of
+ * the decoding pipeline.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapidisplay_priv.h"
+#include "gstvaapidisplay_null.h"
+#include "gstvaapidisplay_null_priv.h"
+#include "gstvaapidriver_null.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+#define DEFAULT_DISPLAY_NAME "null"
+
+static void
+gst_vaapi_display_null_render_cb (VAContextID context_id,
+    VASurfaceID surface_id, VABufferType buffer_type, gconstpointer data,
+    guint size, gpointer user_data)
+{
+  GstVaapiDisplayNull *const display = user_data;
+  GstVaapiDisplayNullPrivate *const priv =
+      GST_VAAPI_DISPLAY_NULL_PRIVATE (display);
+
+  if (priv->render_func)
+    priv->render_func (display, context_id, surface_id, buffer_type, data,
+        size, priv->render_data);
+}
+
+static gboolean
+gst_vaapi_display_null_open_display (GstVaapiDisplay * display,
+    const gchar * name)
+{
+  GstVaapiDisplayNullPrivate *const priv =
+      GST_VAAPI_DISPLAY_NULL_PRIVATE (display);
+
+  g_free (priv->display_name);
+  priv->display_name = g_strdup (name ? name : DEFAULT_DISPLAY_NAME);
+
+  priv->va_display = gst_vaapi_driver_null_open ();
+  return priv->va_display != NULL;
+}
+
+static void
+gst_vaapi_display_null_close_display (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayNullPrivate *const priv =
+      GST_VAAPI_DISPLAY_NULL_PRIVATE (display);
+
+  /* The VA display itself was released through vaTerminate() */
+  priv->va_display = NULL;
+
+  g_free (priv->display_name);
+  priv->display_name = NULL;
+}
+
+static gboolean
+gst_vaapi_display_null_get_display_info (GstVaapiDisplay * display,
+    GstVaapiDisplayInfo * info)
+{
+  GstVaapiDisplayNullPrivate *const priv =
+      GST_VAAPI_DISPLAY_NULL_PRIVATE (display);
+
+  if (!priv->va_display)
+    return FALSE;
+
+  /* The in-process driver is its own native display */
+  info->native_display = priv->va_display;
+  info->display_name = priv->display_name;
+  info->va_display = priv->va_display;
+  info->display_type = GST_VAAPI_DISPLAY_TYPE_NULL;
+  return TRUE;
+}
+
+static void
+gst_vaapi_display_null_class_init (GstVaapiDisplayNullClass * klass)
+{
+  GstVaapiMiniObjectClass *const object_class =
+      GST_VAAPI_MINI_OBJECT_CLASS (klass);
+  GstVaapiDisplayClass *const dpy_class = GST_VAAPI_DISPLAY_CLASS (klass);
+
+  gst_vaapi_display_class_init (&klass->parent_class);
+
+  object_class->size = sizeof (GstVaapiDisplayNull);
+  dpy_class->display_type = GST_VAAPI_DISPLAY_TYPE_NULL;
+  dpy_class->open_display = gst_vaapi_display_null_open_display;
+  dpy_class->close_display = gst_vaapi_display_null_close_display;
+  dpy_class->get_display = gst_vaapi_display_null_get_display_info;
+}
+
+static inline const GstVaapiDisplayClass *
+gst_vaapi_display_null_class (void)
+{
+  static GstVaapiDisplayNullClass g_class;
+  static gsize g_class_init = FALSE;
+
+  if (g_once_init_enter (&g_class_init)) {
+    gst_vaapi_display_null_class_init (&g_class);
+    g_once_init_leave (&g_class_init, TRUE);
+  }
+  return GST_VAAPI_DISPLAY_CLASS (&g_class);
+}
+
+/**
+ * gst_vaapi_display_null_new:
+ * @display_name: the display name, or %NULL
+ *
+ * Creates a new #GstVaapiDisplay backed by the in-process VA/NULL
+ * driver. Each call creates an independent driver instance, with its
+ * own set of VA objects and counters.
+ *
+ * Return value: a newly allocated #GstVaapiDisplay object
+ */
+GstVaapiDisplay *
+gst_vaapi_display_null_new (const gchar * display_name)
+{
+  return gst_vaapi_display_new (gst_vaapi_display_null_class (),
+      GST_VAAPI_DISPLAY_INIT_FROM_DISPLAY_NAME, (gpointer) display_name);
+}
+
+/**
+ * gst_vaapi_display_null_set_render_func:
+ * @display: a #GstVaapiDisplayNull
+ * @func: the function to call for each rendered buffer, or %NULL
+ * @user_data: user data to pass to @func
+ *
+ * Installs @func as the hook that records every buffer submitted to
+ * the driver through vaRenderPicture(). Passing %NULL for @func
+ * removes any previous hook.
+ */
+void
+gst_vaapi_display_null_set_render_func (GstVaapiDisplayNull * display,
+    GstVaapiDisplayNullRenderFunc func, gpointer user_data)
+{
+  GstVaapiDisplayNullPrivate *priv;
+
+  g_return_if_fail (GST_VAAPI_IS_DISPLAY_NULL (display));
+
+  priv = GST_VAAPI_DISPLAY_NULL_PRIVATE (display);
+  GST_VAAPI_DISPLAY_LOCK (display);
+  priv->render_func = func;
+  priv->render_data = user_data;
+  gst_vaapi_driver_null_set_render_func (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      func ? gst_vaapi_display_null_render_cb : NULL, display);
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+}
+
+/**
+ * gst_vaapi_display_null_get_buffer_count:
+ * @display: a #GstVaapiDisplayNull
+ * @buffer_type: a #VABufferType
+ *
+ * Returns the number of buffers of type @buffer_type that were
+ * submitted through vaRenderPicture(), since the creation of @display
+ * or the last call to gst_vaapi_display_null_reset_counters().
+ *
+ * Return value: the number of submitted buffers
+ */
+guint64
+gst_vaapi_display_null_get_buffer_count (GstVaapiDisplayNull * display,
+    guint buffer_type)
+{
+  g_return_val_if_fail (GST_VAAPI_IS_DISPLAY_NULL (display), 0);
+
+  return gst_vaapi_driver_null_get_buffer_count (GST_VAAPI_DISPLAY_VADISPLAY
+      (display), buffer_type);
+}
+
+/**
+ * gst_vaapi_display_null_get_picture_count:
+ * @display: a #GstVaapiDisplayNull
+ *
+ * Returns the number of pictures that were completed through
+ * vaEndPicture(), since the creation of @display or the last call to
+ * gst_vaapi_display_null_reset_counters().
+ *
+ * Return value: the number of submitted pictures
+ */
+guint64
+gst_vaapi_display_null_get_picture_count (GstVaapiDisplayNull * display)
+{
+  g_return_val_if_fail (GST_VAAPI_IS_DISPLAY_NULL (display), 0);
+
+  return gst_vaapi_driver_null_get_picture_count (GST_VAAPI_DISPLAY_VADISPLAY
+      (display));
+}
+
+/**
+ * gst_vaapi_display_null_reset_counters:
+ * @display: a #GstVaapiDisplayNull
+ *
+ * Resets the buffer and picture counters of @display.
+ */
+void
+gst_vaapi_display_null_reset_counters (GstVaapiDisplayNull * display)
+{
+  g_return_if_fail (GST_VAAPI_IS_DISPLAY_NULL (display));
+
+  gst_vaapi_driver_null_reset_counters (GST_VAAPI_DISPLAY_VADISPLAY (display));
+}
@@ -0,0 +1,68 @@
+/*
+ *  gstvaapidisplay_null.h - VA/NULL display abstraction
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DISPLAY_NULL_H
+#define GST_VAAPI_DISPLAY_NULL_H
+
+#include <gst/vaapi/gstvaapidisplay.h>
+
+G_BEGIN_DECLS
+
+#define GST_VAAPI_DISPLAY_NULL(obj) \
+    ((GstVaapiDisplayNull *)(obj))
+
+typedef struct _GstVaapiDisplayNull             GstVaapiDisplayNull;
+
+/**
+ * GstVaapiDisplayNullRenderFunc:
+ * @display: the #GstVaapiDisplayNull
+ * @context_id: the VA context the buffer was submitted to
+ * @surface_id: the VA surface being rendered to
+ * @buffer_type: the #VABufferType of the submitted buffer
+ * @data: the buffer contents
+ * @size: the size of @data, in bytes
+ * @user_data: user data supplied to gst_vaapi_display_null_set_render_func()
+ *
+ * Called for every buffer submitted through vaRenderPicture(). @data
+ * is only valid for the duration of the call.
+ */
+typedef void (*GstVaapiDisplayNullRenderFunc) (GstVaapiDisplayNull * display,
+    GstVaapiID context_id, GstVaapiID surface_id, guint buffer_type,
+    gconstpointer data, guint size, gpointer user_data);
+
+GstVaapiDisplay *
+gst_vaapi_display_null_new (const gchar * display_name);
+
+void
+gst_vaapi_display_null_set_render_func (GstVaapiDisplayNull * display,
+    GstVaapiDisplayNullRenderFunc func, gpointer user_data);
+
+guint64
+gst_vaapi_display_null_get_buffer_count (GstVaapiDisplayNull * display,
+    guint buffer_type);
+
+guint64
+gst_vaapi_display_null_get_picture_count (GstVaapiDisplayNull * display);
+
+void
+gst_vaapi_display_null_reset_counters (GstVaapiDisplayNull * display);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DISPLAY_NULL_H */
@@ -0,0 +1,1606 @@
+/*
+ *  gstvaapidriver_null.c - In-process VA driver for the VA/NULL display
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The VA/NULL driver implements the subset of the VA driver interface
+ * that libgstvaapi relies on, entirely in system memory. There is no
+ * dlopen()'ed driver module: the VADisplayContext and VADriverContext
+ * are populated by hand, so that every vaXXX() entry point dispatches
+ * straight into the functions below. Surfaces hold NV12 pixels,
+ * decode pictures leave them untouched, and encode pictures produce a
+ * coded buffer made of the packed headers that were submitted.
+ */
+
+#include "sysdeps.h"
+#include <va/va_backend.h>
+#include "gstvaapicompat.h"
+#include "gstvaapidriver_null.h"
+
+#if USE_ENCODERS
+# include <va/va_enc_h264.h>
+# include <va/va_enc_mpeg2.h>
+#endif
+#if USE_JPEG_ENCODER
+# include <va/va_enc_jpeg.h>
+#endif
+#if USE_VP8_ENCODER
+# include <va/va_enc_vp8.h>
+#endif
+#if USE_H265_ENCODER
+# include <va/va_enc_hevc.h>
+#endif
+
+#ifndef VA_DISPLAY_MAGIC
+#define VA_DISPLAY_MAGIC 0x56414430     /* VA@0 */
+#endif
+
+#define NULL_VENDOR_STRING      "GStreamer VA-API NULL driver"
+#define NULL_MAX_PROFILES       32
+#define NULL_MAX_ENTRYPOINTS    4
+#define NULL_MAX_ATTRIBUTES     8
+#define NULL_MAX_IMAGE_FORMATS  3
+#define NULL_MAX_BUFFER_TYPES   64
+
+/* Minimal payload written into coded buffers without packed headers */
+#define NULL_CODED_PAYLOAD_SIZE 16
+
+#define NULL_DRIVER_DATA(ctx) \
+  ((NullDriverData *) (ctx)->pDriverData)
+
+typedef enum
+{
+  NULL_OBJECT_CONFIG = 1,
+  NULL_OBJECT_SURFACE,
+  NULL_OBJECT_CONTEXT,
+  NULL_OBJECT_BUFFER,
+  NULL_OBJECT_IMAGE,
+  NULL_OBJECT_SUBPICTURE,
+} NullObjectType;
+
+typedef struct _NullObject NullObject;
+struct _NullObject
+{
+  NullObjectType type;
+  guint ref_count;
+  VAGenericID id;
+};
+
+typedef struct _NullConfig NullConfig;
+struct _NullConfig
+{
+  NullObject base;
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+  VAConfigAttrib attribs[NULL_MAX_ATTRIBUTES];
+  guint num_attribs;
+};
+
+typedef struct _NullSurface NullSurface;
+struct _NullSurface
+{
+  NullObject base;
+  guint width;
+  guint height;
+  guint pitch;
+  guint height2;
+  guint8 *data;
+  gsize data_size;
+  guint frame_count;
+};
+
+typedef struct _NullContext NullContext;
+struct _NullContext
+{
+  NullObject base;
+  VAConfigID config_id;
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+  gint width;
+  gint height;
+  VASurfaceID render_target;
+  VABufferID coded_buf;
+  GByteArray *packed_data;
+  guint packed_bits;
+};
+
+typedef struct _NullBuffer NullBuffer;
+struct _NullBuffer
+{
+  NullObject base;
+  VABufferType type;
+  guint size;
+  guint num_elements;
+  guint8 *data;
+  NullSurface *surface;         /* derived images only */
+};
+
+typedef struct _NullImage NullImage;
+struct _NullImage
+{
+  NullObject base;
+  VAImage image;
+};
+
+typedef struct _NullSubpicture NullSubpicture;
+struct _NullSubpicture
+{
+  NullObject base;
+  VAImageID image_id;
+};
+
+typedef struct _NullDriverData NullDriverData;
+struct _NullDriverData
+{
+  GMutex lock;
+  GHashTable *objects;
+  VAGenericID next_id;
+  guint64 buffer_counts[NULL_MAX_BUFFER_TYPES + 1];
+  guint64 picture_count;
+  GstVaapiDriverNullRenderFunc render_func;
+  gpointer render_data;
+};
+
+typedef struct _NullPlane NullPlane;
+struct _NullPlane
+{
+  guint8 *data;
+  guint pitch;
+  guint pixel_stride;
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- Objects                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+static gpointer
+null_object_new (NullDriverData * drv, NullObjectType type, gsize size)
+{
+  NullObject *const object = g_malloc0 (size);
+
+  object->type = type;
+  object->ref_count = 1;
+
+  if (drv->next_id == 0 || drv->next_id == VA_INVALID_ID)
+    drv->next_id = 1;
+  object->id = drv->next_id++;
+  g_hash_table_insert (drv->objects, GUINT_TO_POINTER (object->id), object);
+  return object;
+}
+
+static gpointer
+null_object_lookup (NullDriverData * drv, VAGenericID id, NullObjectType type)
+{
+  NullObject *const object =
+      g_hash_table_lookup (drv->objects, GUINT_TO_POINTER (id));
+
+  if (!object || object->type != type)
+    return NULL;
+  return object;
+}
+
+static void null_object_unref (NullObject * object);
+
+static void
+null_object_finalize (NullObject * object)
+{
+  switch (object->type) {
+    case NULL_OBJECT_SURFACE:
+      g_free (((NullSurface *) object)->data);
+      break;
+    case NULL_OBJECT_CONTEXT:
+      if (((NullContext *) object)->packed_data)
+        g_byte_array_unref (((NullContext *) object)->packed_data);
+      break;
+    case NULL_OBJECT_BUFFER:{
+      NullBuffer *const buf = (NullBuffer *) object;
+      if (buf->surface)
+        null_object_unref (&buf->surface->base);
+      else
+        g_free (buf->data);
+      break;
+    }
+    default:
+      break;
+  }
+  g_free (object);
+}
+
+static inline NullObject *
+null_object_ref (NullObject * object)
+{
+  object->ref_count++;
+  return object;
+}
+
+static void
+null_object_unref (NullObject * object)
+{
+  if (--object->ref_count == 0)
+    null_object_finalize (object);
+}
+
+static gboolean
+null_object_destroy (NullDriverData * drv, VAGenericID id,
+    NullObjectType type)
+{
+  if (!null_object_lookup (drv, id, type))
+    return FALSE;
+  return g_hash_table_remove (drv->objects, GUINT_TO_POINTER (id));
+}
+
+static NullBuffer *
+null_buffer_new (NullDriverData * drv, VABufferType type, guint size,
+    guint num_elements)
+{
+  NullBuffer *buf;
+  gsize alloc_size = (gsize) size * num_elements;
+
+  buf = null_object_new (drv, NULL_OBJECT_BUFFER, sizeof (*buf));
+  buf->type = type;
+  buf->size = size;
+  buf->num_elements = num_elements;
+
+  if (type == VAEncCodedBufferType) {
+    VACodedBufferSegment *segment;
+
+    buf->data = g_malloc0 (sizeof (*segment) + alloc_size);
+    segment = (VACodedBufferSegment *) buf->data;
+    segment->buf = buf->data + sizeof (*segment);
+  } else
+    buf->data = g_malloc0 (MAX (alloc_size, 1));
+  return buf;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Pixel helpers                                                     --- */
+/* ------------------------------------------------------------------------- */
+
+static inline void
+null_plane_init (NullPlane * plane, guint8 * data, guint pitch,
+    guint pixel_stride)
+{
+  plane->data = data;
+  plane->pitch = pitch;
+  plane->pixel_stride = pixel_stride;
+}
+
+/* Fills in the Y, U and V planes of an NV12 surface */
+static void
+null_surface_get_planes (NullSurface * surface, NullPlane planes[3])
+{
+  guint8 *const uv = surface->data + surface->pitch * surface->height2;
+
+  null_plane_init (&planes[0], surface->data, surface->pitch, 1);
+  null_plane_init (&planes[1], uv, surface->pitch, 2);
+  null_plane_init (&planes[2], uv + 1, surface->pitch, 2);
+}
+
+/* Fills in the Y, U and V planes of an image, mapped at @data */
+static gboolean
+null_image_get_planes (const VAImage * image, guint8 * data,
+    NullPlane planes[3])
+{
+  null_plane_init (&planes[0], data + image->offsets[0], image->pitches[0], 1);
+
+  switch (image->format.fourcc) {
+    case VA_FOURCC ('N', 'V', '1', '2'):
+      null_plane_init (&planes[1], data + image->offsets[1],
+          image->pitches[1], 2);
+      null_plane_init (&planes[2], data + image->offsets[1] + 1,
+          image->pitches[1], 2);
+      break;
+    case VA_FOURCC ('I', '4', '2', '0'):
+      null_plane_init (&planes[1], data + image->offsets[1],
+          image->pitches[1], 1);
+      null_plane_init (&planes[2], data + image->offsets[2],
+          image->pitches[2], 1);
+      break;
+    case VA_FOURCC ('Y', 'V', '1', '2'):
+      null_plane_init (&planes[1], data + image->offsets[2],
+          image->pitches[2], 1);
+      null_plane_init (&planes[2], data + image->offsets[1],
+          image->pitches[1], 1);
+      break;
+    default:
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+null_copy_plane (const NullPlane * dst, guint dst_x, guint dst_y,
+    const NullPlane * src, guint src_x, guint src_y, guint width, guint height)
+{
+  guint x, y;
+
+  for (y = 0; y < height; y++) {
+    guint8 *const d = dst->data + (dst_y + y) * dst->pitch +
+        dst_x * dst->pixel_stride;
+    const guint8 *const s = src->data + (src_y + y) * src->pitch +
+        src_x * src->pixel_stride;
+
+    if (dst->pixel_stride == 1 && src->pixel_stride == 1)
+      memcpy (d, s, width);
+    else {
+      for (x = 0; x < width; x++)
+        d[x * dst->pixel_stride] = s[x * src->pixel_stride];
+    }
+  }
+}
+
+/* Copies a 4:2:0 rectangle, luma coordinates are expected */
+static void
+null_copy_planes (const NullPlane dst[3], guint dst_x, guint dst_y,
+    const NullPlane src[3], guint src_x, guint src_y, guint width, guint height)
+{
+  guint i;
+
+  null_copy_plane (&dst[0], dst_x, dst_y, &src[0], src_x, src_y,
+      width, height);
+  for (i = 1; i < 3; i++)
+    null_copy_plane (&dst[i], dst_x / 2, dst_y / 2, &src[i], src_x / 2,
+        src_y / 2, (width + 1) / 2, (height + 1) / 2);
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Configs                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+} NullProfileMap;
+
+/* *INDENT-OFF* */
+static const NullProfileMap g_null_profiles[] = {
+  { VAProfileMPEG2Simple,             VAEntrypointVLD },
+  { VAProfileMPEG2Main,               VAEntrypointVLD },
+  { VAProfileMPEG4Simple,             VAEntrypointVLD },
+  { VAProfileMPEG4AdvancedSimple,     VAEntrypointVLD },
+  { VAProfileMPEG4Main,               VAEntrypointVLD },
+  { VAProfileH264ConstrainedBaseline, VAEntrypointVLD },
+  { VAProfileH264Main,                VAEntrypointVLD },
+  { VAProfileH264High,                VAEntrypointVLD },
+  { VAProfileVC1Simple,               VAEntrypointVLD },
+  { VAProfileVC1Main,                 VAEntrypointVLD },
+  { VAProfileVC1Advanced,             VAEntrypointVLD },
+#if USE_JPEG_DECODER
+  { VAProfileJPEGBaseline,            VAEntrypointVLD },
+#endif
+#if USE_VP8_DECODER
+  { VAProfileVP8Version0_3,           VAEntrypointVLD },
+#endif
+#if USE_HEVC_DECODER
+  { VAProfileHEVCMain,                VAEntrypointVLD },
+#endif
+#if USE_VP9_DECODER
+  { VAProfileVP9Profile0,             VAEntrypointVLD },
+#endif
+#if USE_ENCODERS
+  { VAProfileMPEG2Simple,             VAEntrypointEncSlice },
+  { VAProfileMPEG2Main,               VAEntrypointEncSlice },
+  { VAProfileH264ConstrainedBaseline, VAEntrypointEncSlice },
+  { VAProfileH264Main,                VAEntrypointEncSlice },
+  { VAProfileH264High,                VAEntrypointEncSlice },
+#endif
+#if USE_JPEG_ENCODER
+  { VAProfileJPEGBaseline,            VAEntrypointEncPicture },
+#endif
+#if USE_VP8_ENCODER
+  { VAProfileVP8Version0_3,           VAEntrypointEncSlice },
+#endif
+#if USE_H265_ENCODER
+  { VAProfileHEVCMain,                VAEntrypointEncSlice },
+#endif
+};
+/* *INDENT-ON* */
+
+static gboolean
+null_has_config (VAProfile profile, VAEntrypoint entrypoint)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (g_null_profiles); i++) {
+    const NullProfileMap *const m = &g_null_profiles[i];
+    if (m->profile == profile && m->entrypoint == entrypoint)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static inline gboolean
+null_is_encode_entrypoint (VAEntrypoint entrypoint)
+{
+  return entrypoint == VAEntrypointEncSlice ||
+      entrypoint == VAEntrypointEncPicture;
+}
+
+static guint
+null_get_config_attrib_value (VAEntrypoint entrypoint, VAConfigAttribType type)
+{
+  const gboolean is_encoder = null_is_encode_entrypoint (entrypoint);
+
+  switch (type) {
+    case VAConfigAttribRTFormat:
+      return VA_RT_FORMAT_YUV420;
+    case VAConfigAttribRateControl:
+      return is_encoder ? (VA_RC_NONE | VA_RC_CBR | VA_RC_VBR | VA_RC_CQP) :
+          VA_ATTRIB_NOT_SUPPORTED;
+    case VAConfigAttribEncPackedHeaders:
+      return is_encoder ? (VA_ENC_PACKED_HEADER_SEQUENCE |
+          VA_ENC_PACKED_HEADER_PICTURE | VA_ENC_PACKED_HEADER_SLICE |
+          VA_ENC_PACKED_HEADER_MISC) : VA_ATTRIB_NOT_SUPPORTED;
+#if VA_CHECK_VERSION(0,37,0)
+    case VAConfigAttribEncJPEG:
+      if (entrypoint == VAEntrypointEncPicture) {
+        VAConfigAttribValEncJPEG jpeg = { 0, };
+
+        /* Baseline sequential DCT, interleaved components */
+        jpeg.bits.max_num_components = 3;
+        jpeg.bits.max_num_scans = 1;
+        jpeg.bits.max_num_huffman_tables = 2;
+        jpeg.bits.max_num_quantization_tables = 2;
+        return jpeg.value;
+      }
+      break;
+#endif
+    default:
+      break;
+  }
+  return VA_ATTRIB_NOT_SUPPORTED;
+}
+
+static VAStatus
+null_QueryConfigProfiles (VADriverContextP ctx, VAProfile * profile_list,
+    int *num_profiles)
+{
+  guint i, j, n = 0;
+
+  for (i = 0; i < G_N_ELEMENTS (g_null_profiles); i++) {
+    const VAProfile profile = g_null_profiles[i].profile;
+    for (j = 0; j < n; j++) {
+      if (profile_list[j] == profile)
+        break;
+    }
+    if (j == n && n < NULL_MAX_PROFILES)
+      profile_list[n++] = profile;
+  }
+  *num_profiles = n;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_QueryConfigEntrypoints (VADriverContextP ctx, VAProfile profile,
+    VAEntrypoint * entrypoint_list, int *num_entrypoints)
+{
+  guint i, n = 0;
+
+  for (i = 0; i < G_N_ELEMENTS (g_null_profiles); i++) {
+    if (g_null_profiles[i].profile == profile && n < NULL_MAX_ENTRYPOINTS)
+      entrypoint_list[n++] = g_null_profiles[i].entrypoint;
+  }
+  *num_entrypoints = n;
+  return n > 0 ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+}
+
+static VAStatus
+null_GetConfigAttributes (VADriverContextP ctx, VAProfile profile,
+    VAEntrypoint entrypoint, VAConfigAttrib * attrib_list, int num_attribs)
+{
+  gint i;
+
+  if (!null_has_config (profile, entrypoint))
+    return VA_STATUS_ERROR_UNSUPPORTED_ENTRYPOINT;
+
+  for (i = 0; i < num_attribs; i++)
+    attrib_list[i].value =
+        null_get_config_attrib_value (entrypoint, attrib_list[i].type);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_CreateConfig (VADriverContextP ctx, VAProfile profile,
+    VAEntrypoint entrypoint, VAConfigAttrib * attrib_list, int num_attribs,
+    VAConfigID * config_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullConfig *config;
+  gint i;
+
+  if (!null_has_config (profile, entrypoint))
+    return VA_STATUS_ERROR_UNSUPPORTED_ENTRYPOINT;
+  if (num_attribs > NULL_MAX_ATTRIBUTES)
+    return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+  for (i = 0; i < num_attribs; i++) {
+    const guint value =
+        null_get_config_attrib_value (entrypoint, attrib_list[i].type);
+    if (value == VA_ATTRIB_NOT_SUPPORTED)
+      continue;
+    if ((attrib_list[i].value & ~value) != 0)
+      return VA_STATUS_ERROR_INVALID_CONFIG;
+  }
+
+  g_mutex_lock (&drv->lock);
+  config = null_object_new (drv, NULL_OBJECT_CONFIG, sizeof (*config));
+  config->profile = profile;
+  config->entrypoint = entrypoint;
+  config->num_attribs = num_attribs;
+  if (num_attribs > 0)
+    memcpy (config->attribs, attrib_list, num_attribs * sizeof (*attrib_list));
+  *config_id = config->base.id;
+  g_mutex_unlock (&drv->lock);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_DestroyConfig (VADriverContextP ctx, VAConfigID config_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  gboolean success;
+
+  g_mutex_lock (&drv->lock);
+  success = null_object_destroy (drv, config_id, NULL_OBJECT_CONFIG);
+  g_mutex_unlock (&drv->lock);
+  return success ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_CONFIG;
+}
+
+static VAStatus
+null_QueryConfigAttributes (VADriverContextP ctx, VAConfigID config_id,
+    VAProfile * profile, VAEntrypoint * entrypoint,
+    VAConfigAttrib * attrib_list, int *num_attribs)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullConfig *config;
+
+  g_mutex_lock (&drv->lock);
+  config = null_object_lookup (drv, config_id, NULL_OBJECT_CONFIG);
+  if (config) {
+    *profile = config->profile;
+    *entrypoint = config->entrypoint;
+    *num_attribs = config->num_attribs;
+    if (config->num_attribs > 0)
+      memcpy (attrib_list, config->attribs,
+          config->num_attribs * sizeof (*attrib_list));
+  }
+  g_mutex_unlock (&drv->lock);
+  return config ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_CONFIG;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Surfaces                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+null_CreateSurfaces2 (VADriverContextP ctx, unsigned int format,
+    unsigned int width, unsigned int height, VASurfaceID * surfaces,
+    unsigned int num_surfaces, VASurfaceAttrib * attrib_list,
+    unsigned int num_attribs)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  guint i;
+
+  if (format != VA_RT_FORMAT_YUV420)
+    return VA_STATUS_ERROR_UNSUPPORTED_RT_FORMAT;
+  if (width == 0 || height == 0)
+    return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+  /* Only plain VA memory surfaces are supported, no buffer import */
+  for (i = 0; i < num_attribs; i++) {
+    const VASurfaceAttrib *const attrib = &attrib_list[i];
+    if (attrib->type == VASurfaceAttribMemoryType &&
+        attrib->value.value.i != VA_SURFACE_ATTRIB_MEM_TYPE_VA)
+      return VA_STATUS_ERROR_UNSUPPORTED_MEMORY_TYPE;
+  }
+
+  g_mutex_lock (&drv->lock);
+  for (i = 0; i < num_surfaces; i++) {
+    NullSurface *const surface =
+        null_object_new (drv, NULL_OBJECT_SURFACE, sizeof (*surface));
+    gsize luma_size;
+
+    surface->width = width;
+    surface->height = height;
+    surface->pitch = GST_ROUND_UP_16 (width);
+    surface->height2 = GST_ROUND_UP_2 (height);
+    luma_size = (gsize) surface->pitch * surface->height2;
+    surface->data_size = luma_size + luma_size / 2;
+    surface->data = g_malloc (surface->data_size);
+    memset (surface->data, 0x10, luma_size);
+    memset (surface->data + luma_size, 0x80, luma_size / 2);
+    surfaces[i] = surface->base.id;
+  }
+  g_mutex_unlock (&drv->lock);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_CreateSurfaces (VADriverContextP ctx, int width, int height, int format,
+    int num_surfaces, VASurfaceID * surfaces)
+{
+  return null_CreateSurfaces2 (ctx, format, width, height, surfaces,
+      num_surfaces, NULL, 0);
+}
+
+static VAStatus
+null_DestroySurfaces (VADriverContextP ctx, VASurfaceID * surface_list,
+    int num_surfaces)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  VAStatus status = VA_STATUS_SUCCESS;
+  gint i;
+
+  g_mutex_lock (&drv->lock);
+  for (i = 0; i < num_surfaces; i++) {
+    if (!null_object_destroy (drv, surface_list[i], NULL_OBJECT_SURFACE))
+      status = VA_STATUS_ERROR_INVALID_SURFACE;
+  }
+  g_mutex_unlock (&drv->lock);
+  return status;
+}
+
+static VAStatus
+null_SyncSurface (VADriverContextP ctx, VASurfaceID render_target)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullSurface *surface;
+
+  g_mutex_lock (&drv->lock);
+  surface = null_object_lookup (drv, render_target, NULL_OBJECT_SURFACE);
+  g_mutex_unlock (&drv->lock);
+  return surface ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_SURFACE;
+}
+
+static VAStatus
+null_QuerySurfaceStatus (VADriverContextP ctx, VASurfaceID render_target,
+    VASurfaceStatus * status)
+{
+  const VAStatus va_status = null_SyncSurface (ctx, render_target);
+
+  if (va_status == VA_STATUS_SUCCESS)
+    *status = VASurfaceReady;
+  return va_status;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Contexts                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+null_CreateContext (VADriverContextP ctx, VAConfigID config_id,
+    int picture_width, int picture_height, int flag,
+    VASurfaceID * render_targets, int num_render_targets,
+    VAContextID * context_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullConfig *config;
+  NullContext *context;
+
+  g_mutex_lock (&drv->lock);
+  config = null_object_lookup (drv, config_id, NULL_OBJECT_CONFIG);
+  if (!config) {
+    g_mutex_unlock (&drv->lock);
+    return VA_STATUS_ERROR_INVALID_CONFIG;
+  }
+
+  context = null_object_new (drv, NULL_OBJECT_CONTEXT, sizeof (*context));
+  context->config_id = config_id;
+  context->profile = config->profile;
+  context->entrypoint = config->entrypoint;
+  context->width = picture_width;
+  context->height = picture_height;
+  context->render_target = VA_INVALID_SURFACE;
+  context->coded_buf = VA_INVALID_ID;
+  if (null_is_encode_entrypoint (config->entrypoint))
+    context->packed_data = g_byte_array_new ();
+  *context_id = context->base.id;
+  g_mutex_unlock (&drv->lock);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_DestroyContext (VADriverContextP ctx, VAContextID context_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  gboolean success;
+
+  g_mutex_lock (&drv->lock);
+  success = null_object_destroy (drv, context_id, NULL_OBJECT_CONTEXT);
+  g_mutex_unlock (&drv->lock);
+  return success ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_CONTEXT;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Buffers                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+null_CreateBuffer (VADriverContextP ctx, VAContextID context,
+    VABufferType type, unsigned int size, unsigned int num_elements,
+    void *data, VABufferID * buf_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullBuffer *buf;
+
+  if (size == 0 || num_elements == 0)
+    return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+  g_mutex_lock (&drv->lock);
+  buf = null_buffer_new (drv, type, size, num_elements);
+  if (data && type != VAEncCodedBufferType)
+    memcpy (buf->data, data, (gsize) size * num_elements);
+  *buf_id = buf->base.id;
+  g_mutex_unlock (&drv->lock);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_BufferSetNumElements (VADriverContextP ctx, VABufferID buf_id,
+    unsigned int num_elements)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullBuffer *buf;
+  VAStatus status = VA_STATUS_SUCCESS;
+
+  g_mutex_lock (&drv->lock);
+  buf = null_object_lookup (drv, buf_id, NULL_OBJECT_BUFFER);
+  if (!buf)
+    status = VA_STATUS_ERROR_INVALID_BUFFER;
+  else if (num_elements > buf->num_elements)
+    status = VA_STATUS_ERROR_INVALID_PARAMETER;
+  else
+    buf->num_elements = num_elements;
+  g_mutex_unlock (&drv->lock);
+  return status;
+}
+
+static VAStatus
+null_MapBuffer (VADriverContextP ctx, VABufferID buf_id, void **pbuf)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullBuffer *buf;
+
+  g_mutex_lock (&drv->lock);
+  buf = null_object_lookup (drv, buf_id, NULL_OBJECT_BUFFER);
+  if (buf)
+    *pbuf = buf->data;
+  g_mutex_unlock (&drv->lock);
+  return buf ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_BUFFER;
+}
+
+static VAStatus
+null_UnmapBuffer (VADriverContextP ctx, VABufferID buf_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullBuffer *buf;
+
+  g_mutex_lock (&drv->lock);
+  buf = null_object_lookup (drv, buf_id, NULL_OBJECT_BUFFER);
+  g_mutex_unlock (&drv->lock);
+  return buf ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_BUFFER;
+}
+
+static VAStatus
+null_DestroyBuffer (VADriverContextP ctx, VABufferID buf_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  gboolean success;
+
+  g_mutex_lock (&drv->lock);
+  success = null_object_destroy (drv, buf_id, NULL_OBJECT_BUFFER);
+  g_mutex_unlock (&drv->lock);
+  return success ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_BUFFER;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Pictures                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+/* Extracts the coded buffer from an encoder picture parameter buffer */
+static VABufferID
+null_get_coded_buf (NullContext * context, NullBuffer * buf)
+{
+  switch (context->profile) {
+#if USE_ENCODERS
+    case VAProfileH264ConstrainedBaseline:
+    case VAProfileH264Main:
+    case VAProfileH264High:
+      if (buf->size >= sizeof (VAEncPictureParameterBufferH264))
+        return ((VAEncPictureParameterBufferH264 *) buf->data)->coded_buf;
+      break;
+    case VAProfileMPEG2Simple:
+    case VAProfileMPEG2Main:
+      if (buf->size >= sizeof (VAEncPictureParameterBufferMPEG2))
+        return ((VAEncPictureParameterBufferMPEG2 *) buf->data)->coded_buf;
+      break;
+#endif
+#if USE_JPEG_ENCODER
+    case VAProfileJPEGBaseline:
+      if (buf->size >= sizeof (VAEncPictureParameterBufferJPEG))
+        return ((VAEncPictureParameterBufferJPEG *) buf->data)->coded_buf;
+      break;
+#endif
+#if USE_VP8_ENCODER
+    case VAProfileVP8Version0_3:
+      if (buf->size >= sizeof (VAEncPictureParameterBufferVP8))
+        return ((VAEncPictureParameterBufferVP8 *) buf->data)->coded_buf;
+      break;
+#endif
+#if USE_H265_ENCODER
+    case VAProfileHEVCMain:
+      if (buf->size >= sizeof (VAEncPictureParameterBufferHEVC))
+        return ((VAEncPictureParameterBufferHEVC *) buf->data)->coded_buf;
+      break;
+#endif
+    default:
+      break;
+  }
+  return VA_INVALID_ID;
+}
+
+static void
+null_render_encode_buffer (NullContext * context, NullBuffer * buf)
+{
+  gsize size;
+
+  switch (buf->type) {
+    case VAEncPictureParameterBufferType:
+      context->coded_buf = null_get_coded_buf (context, buf);
+      break;
+    case VAEncPackedHeaderParameterBufferType:
+      if (buf->size >= sizeof (VAEncPackedHeaderParameterBuffer))
+        context->packed_bits =
+            ((VAEncPackedHeaderParameterBuffer *) buf->data)->bit_length;
+      break;
+    case VAEncPackedHeaderDataBufferType:
+      size = MIN ((context->packed_bits + 7) / 8,
+          (gsize) buf->size * buf->num_elements);
+      g_byte_array_append (context->packed_data, buf->data, size);
+      context->packed_bits = 0;
+      break;
+    default:
+      break;
+  }
+}
+
+/* Fills the coded buffer in with the packed headers of the picture */
+static void
+null_end_encode_picture (NullDriverData * drv, NullContext * context)
+{
+  NullBuffer *const buf =
+      null_object_lookup (drv, context->coded_buf, NULL_OBJECT_BUFFER);
+  VACodedBufferSegment *segment;
+  gsize size, max_size;
+
+  if (!buf || buf->type != VAEncCodedBufferType)
+    return;
+
+  segment = (VACodedBufferSegment *) buf->data;
+  max_size = (gsize) buf->size * buf->num_elements;
+  size = context->packed_data->len;
+  if (size > 0)
+    memcpy (segment->buf, context->packed_data->data, MIN (size, max_size));
+  else {
+    size = MIN (NULL_CODED_PAYLOAD_SIZE, max_size);
+    memset (segment->buf, 0, size);
+  }
+  segment->size = MIN (size, max_size);
+  segment->bit_offset = 0;
+  segment->status = size > max_size ? VA_CODED_BUF_STATUS_SLICE_OVERFLOW_MASK :
+      0;
+  segment->next = NULL;
+}
+
+static VAStatus
+null_BeginPicture (VADriverContextP ctx, VAContextID context_id,
+    VASurfaceID render_target)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullContext *context;
+  VAStatus status = VA_STATUS_SUCCESS;
+
+  g_mutex_lock (&drv->lock);
+  context = null_object_lookup (drv, context_id, NULL_OBJECT_CONTEXT);
+  if (!context)
+    status = VA_STATUS_ERROR_INVALID_CONTEXT;
+  else if (!null_object_lookup (drv, render_target, NULL_OBJECT_SURFACE))
+    status = VA_STATUS_ERROR_INVALID_SURFACE;
+  else {
+    context->render_target = render_target;
+    context->coded_buf = VA_INVALID_ID;
+    context->packed_bits = 0;
+    if (context->packed_data)
+      g_byte_array_set_size (context->packed_data, 0);
+  }
+  g_mutex_unlock (&drv->lock);
+  return status;
+}
+
+static VAStatus
+null_RenderPicture (VADriverContextP ctx, VAContextID context_id,
+    VABufferID * buffers, int num_buffers)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullContext *context;
+  VAStatus status = VA_STATUS_SUCCESS;
+  gint i;
+
+  g_mutex_lock (&drv->lock);
+  context = null_object_lookup (drv, context_id, NULL_OBJECT_CONTEXT);
+  if (!context || context->render_target == VA_INVALID_SURFACE) {
+    g_mutex_unlock (&drv->lock);
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+  }
+
+  for (i = 0; i < num_buffers; i++) {
+    NullBuffer *const buf =
+        null_object_lookup (drv, buffers[i], NULL_OBJECT_BUFFER);
+
+    if (!buf) {
+      status = VA_STATUS_ERROR_INVALID_BUFFER;
+      break;
+    }
+
+    drv->buffer_counts[MIN (buf->type, NULL_MAX_BUFFER_TYPES)]++;
+    if (context->packed_data)
+      null_render_encode_buffer (context, buf);
+    if (drv->render_func)
+      drv->render_func (context_id, context->render_target, buf->type,
+          buf->data, buf->size * buf->num_elements, drv->render_data);
+  }
+  g_mutex_unlock (&drv->lock);
+  return status;
+}
+
+static VAStatus
+null_EndPicture (VADriverContextP ctx, VAContextID context_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullContext *context;
+  NullSurface *surface;
+
+  g_mutex_lock (&drv->lock);
+  context = null_object_lookup (drv, context_id, NULL_OBJECT_CONTEXT);
+  if (!context || context->render_target == VA_INVALID_SURFACE) {
+    g_mutex_unlock (&drv->lock);
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+  }
+
+  surface = null_object_lookup (drv, context->render_target,
+      NULL_OBJECT_SURFACE);
+  if (surface)
+    surface->frame_count++;
+  if (context->packed_data)
+    null_end_encode_picture (drv, context);
+  context->render_target = VA_INVALID_SURFACE;
+  drv->picture_count++;
+  g_mutex_unlock (&drv->lock);
+  return VA_STATUS_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Images                                                            --- */
+/* ------------------------------------------------------------------------- */
+
+/* *INDENT-OFF* */
+static const VAImageFormat g_null_image_formats[NULL_MAX_IMAGE_FORMATS] = {
+  { VA_FOURCC ('N', 'V', '1', '2'), VA_LSB_FIRST, 12, },
+  { VA_FOURCC ('I', '4', '2', '0'), VA_LSB_FIRST, 12, },
+  { VA_FOURCC ('Y', 'V', '1', '2'), VA_LSB_FIRST, 12, },
+};
+/* *INDENT-ON* */
+
+static VAStatus
+null_QueryImageFormats (VADriverContextP ctx, VAImageFormat * format_list,
+    int *num_formats)
+{
+  memcpy (format_list, g_null_image_formats, sizeof (g_null_image_formats));
+  *num_formats = G_N_ELEMENTS (g_null_image_formats);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_CreateImage (VADriverContextP ctx, VAImageFormat * format, int width,
+    int height, VAImage * out_image)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullImage *image;
+  NullBuffer *buf;
+  VAImage *va_image;
+  guint pitch, height2, luma_size;
+
+  if (width <= 0 || height <= 0)
+    return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+  pitch = GST_ROUND_UP_16 (width);
+  height2 = GST_ROUND_UP_2 (height);
+  luma_size = pitch * height2;
+
+  g_mutex_lock (&drv->lock);
+  image = null_object_new (drv, NULL_OBJECT_IMAGE, sizeof (*image));
+  va_image = &image->image;
+  va_image->image_id = image->base.id;
+  va_image->format = *format;
+  va_image->width = width;
+  va_image->height = height;
+  va_image->pitches[0] = pitch;
+  va_image->offsets[0] = 0;
+
+  switch (format->fourcc) {
+    case VA_FOURCC ('N', 'V', '1', '2'):
+      va_image->num_planes = 2;
+      va_image->pitches[1] = pitch;
+      va_image->offsets[1] = luma_size;
+      break;
+    case VA_FOURCC ('I', '4', '2', '0'):
+    case VA_FOURCC ('Y', 'V', '1', '2'):
+      va_image->num_planes = 3;
+      va_image->pitches[1] = pitch / 2;
+      va_image->pitches[2] = pitch / 2;
+      va_image->offsets[1] = luma_size;
+      va_image->offsets[2] = luma_size + luma_size / 4;
+      break;
+    default:
+      null_object_destroy (drv, image->base.id, NULL_OBJECT_IMAGE);
+      g_mutex_unlock (&drv->lock);
+      return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+  }
+  va_image->data_size = luma_size + luma_size / 2;
+
+  buf = null_buffer_new (drv, VAImageBufferType, va_image->data_size, 1);
+  va_image->buf = buf->base.id;
+  *out_image = *va_image;
+  g_mutex_unlock (&drv->lock);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_DeriveImage (VADriverContextP ctx, VASurfaceID surface_id,
+    VAImage * out_image)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullSurface *surface;
+  NullImage *image;
+  NullBuffer *buf;
+  VAImage *va_image;
+
+  g_mutex_lock (&drv->lock);
+  surface = null_object_lookup (drv, surface_id, NULL_OBJECT_SURFACE);
+  if (!surface) {
+    g_mutex_unlock (&drv->lock);
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  }
+
+  /* The image buffer aliases the surface pixels */
+  buf = null_object_new (drv, NULL_OBJECT_BUFFER, sizeof (*buf));
+  buf->type = VAImageBufferType;
+  buf->size = surface->data_size;
+  buf->num_elements = 1;
+  buf->data = surface->data;
+  buf->surface = (NullSurface *) null_object_ref (&surface->base);
+
+  image = null_object_new (drv, NULL_OBJECT_IMAGE, sizeof (*image));
+  va_image = &image->image;
+  va_image->image_id = image->base.id;
+  va_image->format = g_null_image_formats[0];
+  va_image->buf = buf->base.id;
+  va_image->width = surface->width;
+  va_image->height = surface->height;
+  va_image->data_size = surface->data_size;
+  va_image->num_planes = 2;
+  va_image->pitches[0] = surface->pitch;
+  va_image->pitches[1] = surface->pitch;
+  va_image->offsets[0] = 0;
+  va_image->offsets[1] = surface->pitch * surface->height2;
+  *out_image = *va_image;
+  g_mutex_unlock (&drv->lock);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_DestroyImage (VADriverContextP ctx, VAImageID image_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullImage *image;
+
+  g_mutex_lock (&drv->lock);
+  image = null_object_lookup (drv, image_id, NULL_OBJECT_IMAGE);
+  if (image) {
+    null_object_destroy (drv, image->image.buf, NULL_OBJECT_BUFFER);
+    null_object_destroy (drv, image_id, NULL_OBJECT_IMAGE);
+  }
+  g_mutex_unlock (&drv->lock);
+  return image ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_IMAGE;
+}
+
+static VAStatus
+null_SetImagePalette (VADriverContextP ctx, VAImageID image,
+    unsigned char *palette)
+{
+  return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+/* Looks up the surface and image planes to transfer pixels between */
+static VAStatus
+null_lookup_transfer (NullDriverData * drv, VASurfaceID surface_id,
+    VAImageID image_id, NullSurface ** surface_ptr, NullImage ** image_ptr,
+    NullPlane surface_planes[3], NullPlane image_planes[3])
+{
+  NullSurface *surface;
+  NullImage *image;
+  NullBuffer *buf;
+
+  surface = null_object_lookup (drv, surface_id, NULL_OBJECT_SURFACE);
+  if (!surface)
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+
+  image = null_object_lookup (drv, image_id, NULL_OBJECT_IMAGE);
+  if (!image)
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+
+  buf = null_object_lookup (drv, image->image.buf, NULL_OBJECT_BUFFER);
+  if (!buf)
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+
+  null_surface_get_planes (surface, surface_planes);
+  if (!null_image_get_planes (&image->image, buf->data, image_planes))
+    return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+
+  *surface_ptr = surface;
+  *image_ptr = image;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_GetImage (VADriverContextP ctx, VASurfaceID surface_id, int x, int y,
+    unsigned int width, unsigned int height, VAImageID image_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullPlane surface_planes[3], image_planes[3];
+  NullSurface *surface;
+  NullImage *image;
+  VAStatus status;
+
+  g_mutex_lock (&drv->lock);
+  status = null_lookup_transfer (drv, surface_id, image_id, &surface, &image,
+      surface_planes, image_planes);
+  if (status != VA_STATUS_SUCCESS)
+    goto end;
+
+  if (x < 0 || y < 0 || x + width > surface->width ||
+      y + height > surface->height || width > image->image.width ||
+      height > image->image.height) {
+    status = VA_STATUS_ERROR_INVALID_PARAMETER;
+    goto end;
+  }
+  null_copy_planes (image_planes, 0, 0, surface_planes, x, y, width, height);
+
+end:
+  g_mutex_unlock (&drv->lock);
+  return status;
+}
+
+static VAStatus
+null_PutImage (VADriverContextP ctx, VASurfaceID surface_id,
+    VAImageID image_id, int src_x, int src_y, unsigned int src_width,
+    unsigned int src_height, int dest_x, int dest_y, unsigned int dest_width,
+    unsigned int dest_height)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullPlane surface_planes[3], image_planes[3];
+  NullSurface *surface;
+  NullImage *image;
+  guint width, height;
+  VAStatus status;
+
+  g_mutex_lock (&drv->lock);
+  status = null_lookup_transfer (drv, surface_id, image_id, &surface, &image,
+      surface_planes, image_planes);
+  if (status != VA_STATUS_SUCCESS)
+    goto end;
+
+  /* No scaling: the smallest of the two rectangles is copied */
+  width = MIN (src_width, dest_width);
+  height = MIN (src_height, dest_height);
+  if (src_x < 0 || src_y < 0 || dest_x < 0 || dest_y < 0 ||
+      src_x + width > image->image.width ||
+      src_y + height > image->image.height ||
+      dest_x + width > surface->width || dest_y + height > surface->height) {
+    status = VA_STATUS_ERROR_INVALID_PARAMETER;
+    goto end;
+  }
+  null_copy_planes (surface_planes, dest_x, dest_y, image_planes, src_x, src_y,
+      width, height);
+
+end:
+  g_mutex_unlock (&drv->lock);
+  return status;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Subpictures                                                       --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+null_QuerySubpictureFormats (VADriverContextP ctx, VAImageFormat * format_list,
+    unsigned int *flags, unsigned int *num_formats)
+{
+  *num_formats = 0;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_CreateSubpicture (VADriverContextP ctx, VAImageID image_id,
+    VASubpictureID * subpicture_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullSubpicture *subpicture = NULL;
+
+  g_mutex_lock (&drv->lock);
+  if (null_object_lookup (drv, image_id, NULL_OBJECT_IMAGE)) {
+    subpicture = null_object_new (drv, NULL_OBJECT_SUBPICTURE,
+        sizeof (*subpicture));
+    subpicture->image_id = image_id;
+    *subpicture_id = subpicture->base.id;
+  }
+  g_mutex_unlock (&drv->lock);
+  return subpicture ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_IMAGE;
+}
+
+static VAStatus
+null_DestroySubpicture (VADriverContextP ctx, VASubpictureID subpicture_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  gboolean success;
+
+  g_mutex_lock (&drv->lock);
+  success = null_object_destroy (drv, subpicture_id, NULL_OBJECT_SUBPICTURE);
+  g_mutex_unlock (&drv->lock);
+  return success ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_SUBPICTURE;
+}
+
+static VAStatus
+null_SetSubpictureImage (VADriverContextP ctx, VASubpictureID subpicture_id,
+    VAImageID image_id)
+{
+  NullDriverData *const drv = NULL_DRIVER_DATA (ctx);
+  NullSubpicture *subpicture;
+
+  g_mutex_lock (&drv->lock);
+  subpicture = null_object_lookup (drv, subpicture_id, NULL_OBJECT_SUBPICTURE);
+  if (subpicture)
+    subpicture->image_id = image_id;
+  g_mutex_unlock (&drv->lock);
+  return subpicture ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_SUBPICTURE;
+}
+
+static VAStatus
+null_SetSubpictureChromakey (VADriverContextP ctx,
+    VASubpictureID subpicture, unsigned int chromakey_min,
+    unsigned int chromakey_max, unsigned int chromakey_mask)
+{
+  return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+null_SetSubpictureGlobalAlpha (VADriverContextP ctx,
+    VASubpictureID subpicture, float global_alpha)
+{
+  return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+null_AssociateSubpicture (VADriverContextP ctx, VASubpictureID subpicture,
+    VASurfaceID * target_surfaces, int num_surfaces, short src_x,
+    short src_y, unsigned short src_width, unsigned short src_height,
+    short dest_x, short dest_y, unsigned short dest_width,
+    unsigned short dest_height, unsigned int flags)
+{
+  return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+null_DeassociateSubpicture (VADriverContextP ctx, VASubpictureID subpicture,
+    VASurfaceID * target_surfaces, int num_surfaces)
+{
+  return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Display attributes                                                --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+null_QueryDisplayAttributes (VADriverContextP ctx,
+    VADisplayAttribute * attr_list, int *num_attributes)
+{
+  *num_attributes = 0;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_GetDisplayAttributes (VADriverContextP ctx,
+    VADisplayAttribute * attr_list, int num_attributes)
+{
+  gint i;
+
+  for (i = 0; i < num_attributes; i++)
+    attr_list[i].flags = VA_DISPLAY_ATTRIB_NOT_SUPPORTED;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+null_SetDisplayAttributes (VADriverContextP ctx,
+    VADisplayAttribute * attr_list, int num_attributes)
+{
+  return VA_STATUS_ERROR_ATTR_NOT_SUPPORTED;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Display context                                                   --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+null_Terminate (VADriverContextP ctx)
+{
+  return VA_STATUS_SUCCESS;
+}
+
+static int
+null_display_context_is_valid (VADisplayContextP dctx)
+{
+  return dctx->pDriverContext != NULL &&
+      dctx->pDriverContext->pDriverData != NULL;
+}
+
+static VAStatus
+null_display_context_get_driver_name (VADisplayContextP dctx,
+    char **driver_name)
+{
+  *driver_name = strdup ("null");
+  return *driver_name ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_ALLOCATION_FAILED;
+}
+
+/* Called from vaTerminate(), once the vtables were released */
+static void
+null_display_context_destroy (VADisplayContextP dctx)
+{
+  VADriverContextP const ctx = dctx->pDriverContext;
+  NullDriverData *drv;
+
+  if (ctx) {
+    drv = NULL_DRIVER_DATA (ctx);
+    if (drv) {
+      g_hash_table_destroy (drv->objects);
+      g_mutex_clear (&drv->lock);
+      g_slice_free (NullDriverData, drv);
+    }
+    free (ctx->vtable);
+    free (ctx->vtable_vpp);
+    free (ctx);
+  }
+  free (dctx);
+}
+
+static void
+null_init_vtable (struct VADriverVTable *vtable)
+{
+  vtable->vaTerminate = null_Terminate;
+  vtable->vaQueryConfigProfiles = null_QueryConfigProfiles;
+  vtable->vaQueryConfigEntrypoints = null_QueryConfigEntrypoints;
+  vtable->vaGetConfigAttributes = null_GetConfigAttributes;
+  vtable->vaCreateConfig = null_CreateConfig;
+  vtable->vaDestroyConfig = null_DestroyConfig;
+  vtable->vaQueryConfigAttributes = null_QueryConfigAttributes;
+  vtable->vaCreateSurfaces = null_CreateSurfaces;
+  vtable->vaCreateSurfaces2 = null_CreateSurfaces2;
+  vtable->vaDestroySurfaces = null_DestroySurfaces;
+  vtable->vaCreateContext = null_CreateContext;
+  vtable->vaDestroyContext = null_DestroyContext;
+  vtable->vaCreateBuffer = null_CreateBuffer;
+  vtable->vaBufferSetNumElements = null_BufferSetNumElements;
+  vtable->vaMapBuffer = null_MapBuffer;
+  vtable->vaUnmapBuffer = null_UnmapBuffer;
+  vtable->vaDestroyBuffer = null_DestroyBuffer;
+  vtable->vaBeginPicture = null_BeginPicture;
+  vtable->vaRenderPicture = null_RenderPicture;
+  vtable->vaEndPicture = null_EndPicture;
+  vtable->vaSyncSurface = null_SyncSurface;
+  vtable->vaQuerySurfaceStatus = null_QuerySurfaceStatus;
+  vtable->vaQueryImageFormats = null_QueryImageFormats;
+  vtable->vaCreateImage = null_CreateImage;
+  vtable->vaDeriveImage = null_DeriveImage;
+  vtable->vaDestroyImage = null_DestroyImage;
+  vtable->vaSetImagePalette = null_SetImagePalette;
+  vtable->vaGetImage = null_GetImage;
+  vtable->vaPutImage = null_PutImage;
+  vtable->vaQuerySubpictureFormats = null_QuerySubpictureFormats;
+  vtable->vaCreateSubpicture = null_CreateSubpicture;
+  vtable->vaDestroySubpicture = null_DestroySubpicture;
+  vtable->vaSetSubpictureImage = null_SetSubpictureImage;
+  vtable->vaSetSubpictureChromakey = null_SetSubpictureChromakey;
+  vtable->vaSetSubpictureGlobalAlpha = null_SetSubpictureGlobalAlpha;
+  vtable->vaAssociateSubpicture = null_AssociateSubpicture;
+  vtable->vaDeassociateSubpicture = null_DeassociateSubpicture;
+  vtable->vaQueryDisplayAttributes = null_QueryDisplayAttributes;
+  vtable->vaGetDisplayAttributes = null_GetDisplayAttributes;
+  vtable->vaSetDisplayAttributes = null_SetDisplayAttributes;
+}
+
+/**
+ * gst_vaapi_driver_null_open:
+ *
+ * Creates a new VA display bound to the in-process VA/NULL driver.
+ * The resulting display does not need vaInitialize(), and it is
+ * released through vaTerminate() as any other VA display.
+ *
+ * Return value: the newly created #VADisplay, or %NULL on error
+ */
+VADisplay
+gst_vaapi_driver_null_open (void)
+{
+  VADisplayContextP dctx;
+  VADriverContextP ctx;
+  NullDriverData *drv;
+
+  /* vaTerminate() releases the vtables with free() */
+  dctx = calloc (1, sizeof (*dctx));
+  ctx = calloc (1, sizeof (*ctx));
+  if (!dctx || !ctx)
+    goto error;
+  ctx->vtable = calloc (1, sizeof (*ctx->vtable));
+  ctx->vtable_vpp = calloc (1, sizeof (*ctx->vtable_vpp));
+  if (!ctx->vtable || !ctx->vtable_vpp)
+    goto error;
+
+  drv = g_slice_new0 (NullDriverData);
+  g_mutex_init (&drv->lock);
+  drv->objects = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) null_object_unref);
+  drv->next_id = 1;
+
+  ctx->pDriverData = drv;
+  ctx->version_major = VA_MAJOR_VERSION;
+  ctx->version_minor = VA_MINOR_VERSION;
+  ctx->max_profiles = NULL_MAX_PROFILES;
+  ctx->max_entrypoints = NULL_MAX_ENTRYPOINTS;
+  ctx->max_attributes = NULL_MAX_ATTRIBUTES;
+  ctx->max_image_formats = NULL_MAX_IMAGE_FORMATS;
+  ctx->max_subpic_formats = 1;
+  ctx->max_display_attributes = 1;
+  ctx->str_vendor = NULL_VENDOR_STRING;
+  null_init_vtable (ctx->vtable);
+
+  dctx->vadpy_magic = VA_DISPLAY_MAGIC;
+  dctx->pDriverContext = ctx;
+  dctx->vaIsValid = null_display_context_is_valid;
+  dctx->vaDestroy = null_display_context_destroy;
+  dctx->vaGetDriverName = null_display_context_get_driver_name;
+  return (VADisplay) dctx;
+
+error:
+  if (ctx) {
+    free (ctx->vtable);
+    free (ctx->vtable_vpp);
+    free (ctx);
+  }
+  free (dctx);
+  return NULL;
+}
+
+static NullDriverData *
+get_driver_data (VADisplay dpy)
+{
+  VADisplayContextP const dctx = (VADisplayContextP) dpy;
+
+  if (!dctx || dctx->vaDestroy != null_display_context_destroy)
+    return NULL;
+  return NULL_DRIVER_DATA (dctx->pDriverContext);
+}
+
+/**
+ * gst_vaapi_driver_null_set_render_func:
+ * @dpy: a VA/NULL #VADisplay
+ * @func: the function to call for every rendered buffer, or %NULL
+ * @user_data: user data passed to @func
+ *
+ * Installs a hook that is called, with the driver lock held, for each
+ * buffer submitted through vaRenderPicture(). The buffer contents are
+ * only valid for the duration of the call.
+ */
+void
+gst_vaapi_driver_null_set_render_func (VADisplay dpy,
+    GstVaapiDriverNullRenderFunc func, gpointer user_data)
+{
+  NullDriverData *const drv = get_driver_data (dpy);
+
+  g_return_if_fail (drv != NULL);
+
+  g_mutex_lock (&drv->lock);
+  drv->render_func = func;
+  drv->render_data = user_data;
+  g_mutex_unlock (&drv->lock);
+}
+
+/**
+ * gst_vaapi_driver_null_get_buffer_count:
+ * @dpy: a VA/NULL #VADisplay
+ * @buffer_type: a #VABufferType
+ *
+ * Returns the number of buffers of type @buffer_type that were
+ * submitted through vaRenderPicture() so far.
+ *
+ * Return value: the number of submitted buffers
+ */
+guint64
+gst_vaapi_driver_null_get_buffer_count (VADisplay dpy,
+    VABufferType buffer_type)
+{
+  NullDriverData *const drv = get_driver_data (dpy);
+  guint64 count;
+
+  g_return_val_if_fail (drv != NULL, 0);
+
+  g_mutex_lock (&drv->lock);
+  count = drv->buffer_counts[MIN (buffer_type, NULL_MAX_BUFFER_TYPES)];
+  g_mutex_unlock (&drv->lock);
+  return count;
+}
+
+/**
+ * gst_vaapi_driver_null_get_picture_count:
+ * @dpy: a VA/NULL #VADisplay
+ *
+ * Returns the number of pictures completed with vaEndPicture() so far.
+ *
+ * Return value: the number of submitted pictures
+ */
+guint64
+gst_vaapi_driver_null_get_picture_count (VADisplay dpy)
+{
+  NullDriverData *const drv = get_driver_data (dpy);
+  guint64 count;
+
+  g_return_val_if_fail (drv != NULL, 0);
+
+  g_mutex_lock (&drv->lock);
+  count = drv->picture_count;
+  g_mutex_unlock (&drv->lock);
+  return count;
+}
+
+/**
+ * gst_vaapi_driver_null_reset_counters:
+ * @dpy: a VA/NULL #VADisplay
+ *
+ * Resets the buffer and picture counters of the driver.
+ */
+void
+gst_vaapi_driver_null_reset_counters (VADisplay dpy)
+{
+  NullDriverData *const drv = get_driver_data (dpy);
+
+  g_return_if_fail (drv != NULL);
+
+  g_mutex_lock (&drv->lock);
+  memset (drv->buffer_counts, 0, sizeof (drv->buffer_counts));
+  drv->picture_count = 0;
+  g_mutex_unlock (&drv->lock);
+}
@@ -0,0 +1,56 @@
+/*
+ *  gstvaapidriver_null.h - In-process VA driver for the VA/NULL display
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DRIVER_NULL_H
+#define GST_VAAPI_DRIVER_NULL_H
+
+#include <va/va.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef void (*GstVaapiDriverNullRenderFunc) (VAContextID context_id,
+    VASurfaceID surface_id, VABufferType buffer_type, gconstpointer data,
+    guint size, gpointer user_data);
+
+G_GNUC_INTERNAL
+VADisplay
+gst_vaapi_driver_null_open (void);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_driver_null_set_render_func (VADisplay dpy,
+    GstVaapiDriverNullRenderFunc func, gpointer user_data);
+
+G_GNUC_INTERNAL
+guint64
+gst_vaapi_driver_null_get_buffer_count (VADisplay dpy,
+    VABufferType buffer_type);
+
+G_GNUC_INTERNAL
+guint64
+gst_vaapi_driver_null_get_picture_count (VADisplay dpy);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_driver_null_reset_counters (VADisplay dpy);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DRIVER_NULL_H */
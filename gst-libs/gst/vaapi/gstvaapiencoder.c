@@ -224,15 +224,38 @@ _coded_buffer_proxy_released_notify (GstVaapiEncoder * encoder)
   g_mutex_unlock (&encoder->mutex);
 }
 
+/* Replaces the coded buffer pool if the coded sizes seen so far call
+   for larger buffers, or for buffers less than half the size */
+static void
+ensure_coded_buffer_pool_size_unlocked (GstVaapiEncoder * encoder)
+{
+  GstVaapiCodedBufferPool *const pool =
+      GST_VAAPI_CODED_BUFFER_POOL (encoder->codedbuf_pool);
+  GstVaapiVideoPool *new_pool;
+  gsize buf_size, optimal_buf_size;
+
+  buf_size = gst_vaapi_coded_buffer_pool_get_buffer_size (pool);
+  optimal_buf_size = gst_vaapi_coded_buffer_pool_get_optimal_buffer_size (pool);
+  if (optimal_buf_size <= buf_size && optimal_buf_size >= buf_size / 2)
+    return;
+
+  new_pool = gst_vaapi_coded_buffer_pool_new_resized (pool, optimal_buf_size);
+  if (!new_pool)
+    return;
+  gst_vaapi_video_pool_replace (&encoder->codedbuf_pool, new_pool);
+  gst_vaapi_video_pool_unref (new_pool);
+}
+
 /* Creates a new VA coded buffer object proxy, backed from a pool */
 static GstVaapiCodedBufferProxy *
 gst_vaapi_encoder_create_coded_buffer (GstVaapiEncoder * encoder)
 {
-  GstVaapiCodedBufferPool *const pool =
-      GST_VAAPI_CODED_BUFFER_POOL (encoder->codedbuf_pool);
+  GstVaapiCodedBufferPool *pool;
   GstVaapiCodedBufferProxy *codedbuf_proxy;
 
   g_mutex_lock (&encoder->mutex);
+  ensure_coded_buffer_pool_size_unlocked (encoder);
+  pool = GST_VAAPI_CODED_BUFFER_POOL (encoder->codedbuf_pool);
   do {
     codedbuf_proxy = gst_vaapi_coded_buffer_proxy_new_from_pool (pool);
     if (codedbuf_proxy)
@@ -285,6 +308,78 @@ gst_vaapi_encoder_create_surface (GstVaapiEncoder * encoder)
   return proxy;
 }
 
+typedef struct
+{
+  GstVaapiEncoder *encoder;
+  GstVaapiCodedBufferProxy *codedbuf_proxy;
+  gboolean done;
+  gboolean success;
+} PendingCodedBuffer;
+
+/* Moves the coded buffers whose surface completed to the output queue,
+   preserving submission order. Called with the encoder mutex held */
+static void
+flush_pending_coded_buffers_unlocked (GstVaapiEncoder * encoder)
+{
+  PendingCodedBuffer *pending;
+  GstVaapiEncPicture *picture;
+
+  while ((pending = g_queue_peek_head (&encoder->pending_codedbufs)) &&
+      pending->done) {
+    g_queue_pop_head (&encoder->pending_codedbufs);
+    if (!pending->success) {
+      picture =
+          gst_vaapi_coded_buffer_proxy_get_user_data (pending->codedbuf_proxy);
+      GST_VAAPI_ENC_PICTURE_FLAG_SET (picture,
+          GST_VAAPI_ENC_PICTURE_FLAG_FAILED);
+    }
+    g_queue_push_tail (&encoder->codedbuf_queue, pending->codedbuf_proxy);
+    g_slice_free (PendingCodedBuffer, pending);
+    g_cond_signal (&encoder->codedbuf_ready);
+  }
+  g_cond_broadcast (&encoder->codedbuf_synced);
+}
+
+/* Notifies that all operations on the surface of an encoded picture
+   completed, invoked from the surface waiter thread. The encoder shall
+   not be accessed once its mutex is released, as it may be finalized
+   right away */
+static void
+_coded_buffer_synced_notify (GstVaapiSurface * surface, gboolean success,
+    gpointer user_data)
+{
+  PendingCodedBuffer *const pending = user_data;
+  GstVaapiEncoder *const encoder = pending->encoder;
+
+  g_mutex_lock (&encoder->mutex);
+  pending->done = TRUE;
+  pending->success = success;
+  flush_pending_coded_buffers_unlocked (encoder);
+  g_mutex_unlock (&encoder->mutex);
+}
+
+/* Queues the coded buffer for output once its picture is encoded.
+   The encoder waits for all of them to complete before it is finalized,
+   so that its last reference is never released by the waiter thread */
+static void
+queue_coded_buffer (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferProxy * codedbuf_proxy, GstVaapiEncPicture * picture)
+{
+  PendingCodedBuffer *const pending = g_slice_new (PendingCodedBuffer);
+
+  pending->encoder = encoder;
+  pending->codedbuf_proxy = codedbuf_proxy;
+  pending->done = FALSE;
+  pending->success = FALSE;
+
+  g_mutex_lock (&encoder->mutex);
+  g_queue_push_tail (&encoder->pending_codedbufs, pending);
+  g_mutex_unlock (&encoder->mutex);
+
+  gst_vaapi_surface_sync_async (picture->surface, _coded_buffer_synced_notify,
+      pending);
+}
+
 /**
  * gst_vaapi_encoder_put_frame:
  * @encoder: a #GstVaapiEncoder
@@ -304,6 +399,15 @@ gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
   GstVaapiEncPicture *picture;
   GstVaapiCodedBufferProxy *codedbuf_proxy;
 
+  if (frame) {
+    g_mutex_lock (&encoder->mutex);
+    if (encoder->force_keyframe) {
+      GST_VIDEO_CODEC_FRAME_SET_FORCE_KEYFRAME (frame);
+      encoder->force_keyframe = FALSE;
+    }
+    g_mutex_unlock (&encoder->mutex);
+  }
+
   for (;;) {
     picture = NULL;
     status = klass->reordering (encoder, frame, &picture);
@@ -322,7 +426,7 @@ gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
 
     gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy,
         picture, (GDestroyNotify) gst_vaapi_mini_object_unref);
-    g_async_queue_push (encoder->codedbuf_queue, codedbuf_proxy);
+    queue_coded_buffer (encoder, codedbuf_proxy, picture);
     encoder->num_codedbuf_queued++;
 
     /* Try again with any pending reordered frame now available for encoding */
@@ -351,6 +455,34 @@ error_encode:
   }
 }
 
+/* Feeds the size of the coded data to the pool heuristics. Coded data
+   truncated by an undersized buffer cannot be recovered: the parameter
+   buffers were consumed by the driver, and subsequent pictures may
+   already reference this one. So the next picture is coded as a key
+   frame, to stop the corruption from propagating */
+static void
+update_coded_buffer_stats (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferProxy * codedbuf_proxy, GstVaapiEncPicture * picture)
+{
+  GstVaapiCodedBufferPool *pool;
+
+  g_mutex_lock (&encoder->mutex);
+  pool = (GstVaapiCodedBufferPool *)
+      gst_vaapi_video_pool_ref (encoder->codedbuf_pool);
+  g_mutex_unlock (&encoder->mutex);
+
+  if (!gst_vaapi_coded_buffer_pool_update_stats (pool,
+          GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy),
+          picture->type == GST_VAAPI_PICTURE_TYPE_I)) {
+    GST_ERROR ("coded data of frame %d is truncated, force a key frame",
+        picture->frame->system_frame_number);
+    g_mutex_lock (&encoder->mutex);
+    encoder->force_keyframe = TRUE;
+    g_mutex_unlock (&encoder->mutex);
+  }
+  gst_vaapi_video_pool_unref (pool);
+}
+
 /**
  * gst_vaapi_encoder_get_buffer_with_timeout:
  * @encoder: a #GstVaapiEncoder
@@ -363,6 +495,10 @@ error_encode:
  * after usage. Otherwise, @GST_VAAPI_DECODER_STATUS_ERROR_NO_BUFFER
  * is returned if no coded buffer is available so far (timeout).
  *
+ * The calling thread is woken up as soon as a coded buffer is ready.
+ * A @timeout of %G_MAXUINT64 waits without limit, until a coded buffer
+ * is ready or gst_vaapi_encoder_set_flushing() is called.
+ *
  * The parent frame is available as a #GstVideoCodecFrame attached to
  * the user-data anchor of the output coded buffer. Ownership of the
  * frame is transferred to the coded buffer.
@@ -375,16 +511,36 @@ gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
 {
   GstVaapiEncPicture *picture;
   GstVaapiCodedBufferProxy *codedbuf_proxy;
+  gint64 end_time = 0;
 
-  codedbuf_proxy = g_async_queue_timeout_pop (encoder->codedbuf_queue, timeout);
+  if (timeout > 0 && timeout != G_MAXUINT64)
+    end_time = g_get_monotonic_time () + timeout;
+
+  /* Wait for the coded buffer to be signalled, unless flushing */
+  g_mutex_lock (&encoder->mutex);
+  while (g_queue_is_empty (&encoder->codedbuf_queue) && !encoder->flushing) {
+    if (timeout == 0)
+      break;
+    if (timeout == G_MAXUINT64)
+      g_cond_wait (&encoder->codedbuf_ready, &encoder->mutex);
+    else if (!g_cond_wait_until (&encoder->codedbuf_ready, &encoder->mutex,
+            end_time))
+      break;
+  }
+  codedbuf_proxy = g_queue_pop_head (&encoder->codedbuf_queue);
+  g_mutex_unlock (&encoder->mutex);
   if (!codedbuf_proxy)
     return GST_VAAPI_ENCODER_STATUS_NO_BUFFER;
 
-  /* Wait for completion of all operations and report any error that occurred */
+  /* Coded buffers are only queued once all operations completed, report
+     any error that occurred */
   picture = gst_vaapi_coded_buffer_proxy_get_user_data (codedbuf_proxy);
-  if (!gst_vaapi_surface_sync (picture->surface))
+  if (GST_VAAPI_ENC_PICTURE_FLAG_IS_SET (picture,
+          GST_VAAPI_ENC_PICTURE_FLAG_FAILED))
     goto error_invalid_buffer;
 
+  update_coded_buffer_stats (encoder, codedbuf_proxy, picture);
+
   gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy,
       gst_video_codec_frame_ref (picture->frame),
       (GDestroyNotify) gst_video_codec_frame_unref);
@@ -403,11 +559,58 @@ error_invalid_buffer:
   }
 }
 
+/**
+ * gst_vaapi_encoder_has_pending_buffers:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * Checks whether frames were submitted for encoding, and their coded
+ * buffers not retrieved yet with
+ * gst_vaapi_encoder_get_buffer_with_timeout(). Frames held for
+ * reordering are not accounted for, since they are not encoded yet.
+ *
+ * Return value: %TRUE if coded buffers are pending
+ */
+gboolean
+gst_vaapi_encoder_has_pending_buffers (GstVaapiEncoder * encoder)
+{
+  gboolean has_pending;
+
+  g_return_val_if_fail (encoder != NULL, FALSE);
+
+  g_mutex_lock (&encoder->mutex);
+  has_pending = !g_queue_is_empty (&encoder->pending_codedbufs) ||
+      !g_queue_is_empty (&encoder->codedbuf_queue);
+  g_mutex_unlock (&encoder->mutex);
+  return has_pending;
+}
+
+/**
+ * gst_vaapi_encoder_set_flushing:
+ * @encoder: a #GstVaapiEncoder
+ * @flushing: %TRUE to interrupt waits for coded buffers
+ *
+ * While @flushing is set, gst_vaapi_encoder_get_buffer_with_timeout()
+ * returns immediately if no coded buffer is ready, and threads already
+ * waiting are woken up. This is used to stop an output thread blocked
+ * in an unlimited wait.
+ */
+void
+gst_vaapi_encoder_set_flushing (GstVaapiEncoder * encoder, gboolean flushing)
+{
+  g_return_if_fail (encoder != NULL);
+
+  g_mutex_lock (&encoder->mutex);
+  encoder->flushing = flushing;
+  g_cond_broadcast (&encoder->codedbuf_ready);
+  g_mutex_unlock (&encoder->mutex);
+}
+
 /**
  * gst_vaapi_encoder_flush:
  * @encoder: a #GstVaapiEncoder
  *
- * Submits any pending (reordered) frame for encoding.
+ * Submits any pending (reordered) frame for encoding, and waits for
+ * all submitted frames to be encoded.
  *
  * Return value: a #GstVaapiEncoderStatus
  */
@@ -415,8 +618,17 @@ GstVaapiEncoderStatus
 gst_vaapi_encoder_flush (GstVaapiEncoder * encoder)
 {
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
+  GstVaapiEncoderStatus status;
+
+  status = klass->flush (encoder);
 
-  return klass->flush (encoder);
+  /* Wait for the pictures being encoded, so that all coded buffers
+     are available through gst_vaapi_encoder_get_buffer_with_timeout() */
+  g_mutex_lock (&encoder->mutex);
+  while (!g_queue_is_empty (&encoder->pending_codedbufs))
+    g_cond_wait (&encoder->codedbuf_synced, &encoder->mutex);
+  g_mutex_unlock (&encoder->mutex);
+  return status;
 }
 
 /**
@@ -674,8 +886,8 @@ gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
     goto error_reset_context;
 
   codedbuf_size = encoder->codedbuf_pool ?
-      gst_vaapi_coded_buffer_pool_get_buffer_size (GST_VAAPI_CODED_BUFFER_POOL
-      (encoder)) : 0;
+      gst_vaapi_coded_buffer_pool_get_max_buffer_size
+      (GST_VAAPI_CODED_BUFFER_POOL (encoder->codedbuf_pool)) : 0;
   if (codedbuf_size != encoder->codedbuf_size) {
     pool = gst_vaapi_coded_buffer_pool_new (encoder, encoder->codedbuf_size);
     if (!pool)
@@ -1073,11 +1285,11 @@ gst_vaapi_encoder_init (GstVaapiEncoder * encoder, GstVaapiDisplay * display)
   g_mutex_init (&encoder->mutex);
   g_cond_init (&encoder->surface_free);
   g_cond_init (&encoder->codedbuf_free);
+  g_cond_init (&encoder->codedbuf_synced);
+  g_queue_init (&encoder->pending_codedbufs);
 
-  encoder->codedbuf_queue = g_async_queue_new_full ((GDestroyNotify)
-      gst_vaapi_coded_buffer_proxy_unref);
-  if (!encoder->codedbuf_queue)
-    return FALSE;
+  g_cond_init (&encoder->codedbuf_ready);
+  g_queue_init (&encoder->codedbuf_queue);
 
   if (!klass->init (encoder))
     return FALSE;
@@ -1099,6 +1311,12 @@ gst_vaapi_encoder_finalize (GstVaapiEncoder * encoder)
 {
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
 
+  /* Wait for the surface waiter to release the pictures being encoded */
+  g_mutex_lock (&encoder->mutex);
+  while (!g_queue_is_empty (&encoder->pending_codedbufs))
+    g_cond_wait (&encoder->codedbuf_synced, &encoder->mutex);
+  g_mutex_unlock (&encoder->mutex);
+
   klass->finalize (encoder);
 
   gst_vaapi_object_replace (&encoder->context, NULL);
@@ -1111,12 +1329,13 @@ gst_vaapi_encoder_finalize (GstVaapiEncoder * encoder)
   }
 
   gst_vaapi_video_pool_replace (&encoder->codedbuf_pool, NULL);
-  if (encoder->codedbuf_queue) {
-    g_async_queue_unref (encoder->codedbuf_queue);
-    encoder->codedbuf_queue = NULL;
-  }
+  g_queue_foreach (&encoder->codedbuf_queue,
+      (GFunc) gst_vaapi_coded_buffer_proxy_unref, NULL);
+  g_queue_clear (&encoder->codedbuf_queue);
   g_cond_clear (&encoder->surface_free);
   g_cond_clear (&encoder->codedbuf_free);
+  g_cond_clear (&encoder->codedbuf_synced);
+  g_cond_clear (&encoder->codedbuf_ready);
   g_mutex_clear (&encoder->mutex);
 }
 
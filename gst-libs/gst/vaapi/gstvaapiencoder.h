@@ -170,6 +170,12 @@ GstVaapiEncoderStatus
 gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
     GstVaapiCodedBufferProxy ** out_codedbuf_proxy_ptr, guint64 timeout);
 
+gboolean
+gst_vaapi_encoder_has_pending_buffers (GstVaapiEncoder * encoder);
+
+void
+gst_vaapi_encoder_set_flushing (GstVaapiEncoder * encoder, gboolean flushing);
+
 GstVaapiEncoderStatus
 gst_vaapi_encoder_flush (GstVaapiEncoder * encoder);
 
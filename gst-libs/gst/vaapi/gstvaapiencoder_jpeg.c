@@ -718,6 +718,8 @@ gst_vaapi_encoder_jpeg_reordering (GstVaapiEncoder * base_encoder,
     return GST_VAAPI_ENCODER_STATUS_ERROR_ALLOCATION_FAILED;
   }
 
+  /* Every JPEG picture is a key frame, so key frame requests are met */
+  GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
   *output = picture;
   return status;
 }
@@ -621,8 +621,14 @@ gst_vaapi_encoder_mpeg2_reordering (GstVaapiEncoder * base_encoder,
     return GST_VAAPI_ENCODER_STATUS_ERROR_ALLOCATION_FAILED;
   }
 
-  if (encoder->frame_num >= base_encoder->keyframe_period) {
+  /* A key frame request waits until the pending B frames are closed by
+     a P frame, since the I frame would drop their references */
+  if (GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame))
+    encoder->force_keyframe = TRUE;
+  if (encoder->frame_num >= base_encoder->keyframe_period ||
+      (encoder->force_keyframe && g_queue_is_empty (&encoder->b_frames))) {
     encoder->frame_num = 0;
+    encoder->force_keyframe = FALSE;
     clear_references (encoder);
   }
   if (encoder->frame_num == 0) {
@@ -632,7 +638,8 @@ gst_vaapi_encoder_mpeg2_reordering (GstVaapiEncoder * base_encoder,
   } else {
     encoder->new_gop = FALSE;
     if ((encoder->frame_num % (encoder->ip_period + 1)) == 0 ||
-        encoder->frame_num == base_encoder->keyframe_period - 1) {
+        encoder->frame_num == base_encoder->keyframe_period - 1 ||
+        encoder->force_keyframe) {
       picture->type = GST_VAAPI_PICTURE_TYPE_P;
       encoder->dump_frames = TRUE;
     } else {
@@ -54,6 +54,7 @@ struct _GstVaapiEncoderMpeg2
   GQueue b_frames;
   gboolean dump_frames;
   gboolean new_gop;
+  gboolean force_keyframe;
 
   /* reference list */
   GstVaapiSurfaceProxy *forward;
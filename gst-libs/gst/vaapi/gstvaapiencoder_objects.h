@@ -220,7 +220,8 @@ gst_vaapi_enc_huffman_table_new (GstVaapiEncoder * encoder, guint8 * data,
 typedef enum
 {
   GST_VAAPI_ENC_PICTURE_FLAG_IDR    = (GST_VAAPI_CODEC_OBJECT_FLAG_LAST << 0),
-  GST_VAAPI_ENC_PICTURE_FLAG_LAST   = (GST_VAAPI_CODEC_OBJECT_FLAG_LAST << 1),
+  GST_VAAPI_ENC_PICTURE_FLAG_FAILED = (GST_VAAPI_CODEC_OBJECT_FLAG_LAST << 1),
+  GST_VAAPI_ENC_PICTURE_FLAG_LAST   = (GST_VAAPI_CODEC_OBJECT_FLAG_LAST << 2),
 } GstVaapiEncPictureFlags;
 
 #define GST_VAAPI_ENC_PICTURE_FLAGS         GST_VAAPI_MINI_OBJECT_FLAGS
@@ -222,8 +222,14 @@ struct _GstVaapiEncoder
   GCond codedbuf_free;
   guint codedbuf_size;
   GstVaapiVideoPool *codedbuf_pool;
-  GAsyncQueue *codedbuf_queue;
+  GQueue codedbuf_queue;
   guint32 num_codedbuf_queued;
+  GQueue pending_codedbufs;
+  GCond codedbuf_synced;
+  GCond codedbuf_ready;
+  gboolean flushing;
+  /* set when a truncated picture was coded, protected by mutex */
+  gboolean force_keyframe;
 
   guint got_packed_headers:1;
   guint got_rate_control_mask:1;
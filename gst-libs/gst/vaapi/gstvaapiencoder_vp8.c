@@ -413,7 +413,8 @@ gst_vaapi_encoder_vp8_reordering (GstVaapiEncoder * base_encoder,
     return GST_VAAPI_ENCODER_STATUS_ERROR_ALLOCATION_FAILED;
   }
 
-  if (encoder->frame_num >= base_encoder->keyframe_period) {
+  if (encoder->frame_num >= base_encoder->keyframe_period ||
+      GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame)) {
     encoder->frame_num = 0;
     clear_references (encoder);
   }
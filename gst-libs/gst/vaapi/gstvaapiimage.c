@@ -31,6 +31,8 @@
 #include <string.h>
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiutils_copy.h"
+#include "gstvaapiutils_convert.h"
 #include "gstvaapiimage.h"
 #include "gstvaapiimage_priv.h"
 #include "gstvaapiobject_priv.h"
@@ -109,6 +111,7 @@ gst_vaapi_image_destroy (GstVaapiImage * image)
   VAImageID image_id;
   VAStatus status;
 
+  gst_vaapi_image_set_persistent_mapping (image, FALSE);
   _gst_vaapi_image_unmap (image);
 
   image_id = GST_VAAPI_OBJECT_ID (image);
@@ -537,6 +540,11 @@ _gst_vaapi_image_map (GstVaapiImage * image, GstVaapiImageRaw * raw_image)
   if (_gst_vaapi_image_is_mapped (image))
     goto map_success;
 
+  if (image->persistent_data) {
+    image->image_data = image->persistent_data;
+    goto map_success;
+  }
+
   display = GST_VAAPI_OBJECT_DISPLAY (image);
   if (!display)
     return FALSE;
@@ -548,6 +556,9 @@ _gst_vaapi_image_map (GstVaapiImage * image, GstVaapiImageRaw * raw_image)
   if (!vaapi_check_status (status, "vaMapBuffer()"))
     return FALSE;
 
+  if (image->is_persistent)
+    image->persistent_data = image->image_data;
+
 map_success:
   if (raw_image) {
     const VAImage *const va_image = &image->image;
@@ -581,15 +592,12 @@ gst_vaapi_image_unmap (GstVaapiImage * image)
   return _gst_vaapi_image_unmap (image);
 }
 
-gboolean
-_gst_vaapi_image_unmap (GstVaapiImage * image)
+static gboolean
+vaapi_image_unmap_buffer (GstVaapiImage * image)
 {
   GstVaapiDisplay *display;
   VAStatus status;
 
-  if (!_gst_vaapi_image_is_mapped (image))
-    return TRUE;
-
   display = GST_VAAPI_OBJECT_DISPLAY (image);
   if (!display)
     return FALSE;
@@ -600,11 +608,103 @@ _gst_vaapi_image_unmap (GstVaapiImage * image)
   GST_VAAPI_DISPLAY_UNLOCK (display);
   if (!vaapi_check_status (status, "vaUnmapBuffer()"))
     return FALSE;
+  return TRUE;
+}
+
+gboolean
+_gst_vaapi_image_unmap (GstVaapiImage * image)
+{
+  if (!_gst_vaapi_image_is_mapped (image))
+    return TRUE;
+
+  /* Persistent mappings are only released on destruction */
+  if (!image->persistent_data && !vaapi_image_unmap_buffer (image))
+    return FALSE;
 
   image->image_data = NULL;
   return TRUE;
 }
 
+/**
+ * gst_vaapi_image_set_persistent_mapping:
+ * @image: a #GstVaapiImage
+ * @persistent: %TRUE to keep the data buffer mapped
+ *
+ * Toggles persistent mapping of the @image data buffer. Once enabled,
+ * the buffer is mapped by the next gst_vaapi_image_map() call, and
+ * then stays mapped until the @image is destroyed, or persistent
+ * mapping is disabled again. gst_vaapi_image_unmap() only invalidates
+ * the pointers returned by gst_vaapi_image_get_plane().
+ *
+ * This shall only be used for images created with vaCreateImage():
+ * derived images alias the surface storage, which the hardware may
+ * write to behind the CPU mapping.
+ */
+void
+gst_vaapi_image_set_persistent_mapping (GstVaapiImage * image,
+    gboolean persistent)
+{
+  g_return_if_fail (image != NULL);
+
+  image->is_persistent = persistent;
+  if (persistent || !image->persistent_data)
+    return;
+
+  /* Release the mapping now, unless a user still holds it. In that
+     case, the next unmap will reach vaUnmapBuffer() again */
+  image->persistent_data = NULL;
+  if (!_gst_vaapi_image_is_mapped (image))
+    vaapi_image_unmap_buffer (image);
+}
+
+/**
+ * gst_vaapi_image_sync_for_cpu:
+ * @image: a #GstVaapiImage
+ *
+ * Orders the CPU reads of a persistent mapping after a vaGetImage()
+ * into the @image. This is a no-op for images that are mapped on
+ * demand, since vaMapBuffer() makes the data visible.
+ *
+ * Only the CPU side is ordered: a memory barrier does not flush or
+ * invalidate any cache the driver may keep for the buffer, as
+ * vaMapBuffer() can do. VA-API does not define the result of
+ * vaGetImage() into a buffer that is mapped, so persistent mapping is
+ * only correct for drivers that were checked to write straight into
+ * the mapped memory.
+ */
+void
+gst_vaapi_image_sync_for_cpu (GstVaapiImage * image)
+{
+  g_return_if_fail (image != NULL);
+
+  if (image->persistent_data)
+    __sync_synchronize ();
+}
+
+/**
+ * gst_vaapi_image_sync_for_device:
+ * @image: a #GstVaapiImage
+ *
+ * Orders the CPU writes through a persistent mapping before a
+ * following vaPutImage() from the @image. On x86, the full memory
+ * barrier also drains the write-combining buffers. This is a no-op
+ * for images that are mapped on demand.
+ *
+ * This does not replace the vaUnmapBuffer() call that is skipped: the
+ * barrier does not flush any cache the driver may keep for the buffer.
+ * VA-API does not define the result of vaPutImage() from a buffer that
+ * is mapped, so persistent mapping is only correct for drivers that
+ * were checked to read straight from the mapped memory.
+ */
+void
+gst_vaapi_image_sync_for_device (GstVaapiImage * image)
+{
+  g_return_if_fail (image != NULL);
+
+  if (image->persistent_data)
+    __sync_synchronize ();
+}
+
 /**
  * gst_vaapi_image_get_plane_count:
  * @image: a #GstVaapiImage
@@ -684,39 +784,65 @@ gst_vaapi_image_get_data_size (GstVaapiImage * image)
 #include <gst/video/gstvideometa.h>
 
 static gboolean
-init_image_from_video_meta (GstVaapiImageRaw * raw_image, GstVideoMeta * vmeta)
+init_image_from_video_meta (GstVaapiImageRaw * raw_image, GstVideoMeta * vmeta,
+    GstMapInfo map_info[3], GstMapFlags flags)
 {
-  GST_FIXME ("map from GstVideoMeta + add fini_image_from_buffer()");
-  return FALSE;
+  gpointer data;
+  gint stride;
+  guint i;
+
+  if (vmeta->n_planes > G_N_ELEMENTS (raw_image->pixels))
+    return FALSE;
+
+  raw_image->format = vmeta->format;
+  raw_image->width = vmeta->width;
+  raw_image->height = vmeta->height;
+  raw_image->num_planes = vmeta->n_planes;
+  for (i = 0; i < vmeta->n_planes; i++) {
+    if (!gst_video_meta_map (vmeta, i, &map_info[i], &data, &stride, flags))
+      goto error_map_plane;
+    raw_image->pixels[i] = data;
+    raw_image->stride[i] = stride;
+  }
+  return TRUE;
+
+  /* ERRORS */
+error_map_plane:
+  {
+    GST_ERROR ("failed to map plane %u of video buffer", i);
+    while (i-- > 0)
+      gst_video_meta_unmap (vmeta, i, &map_info[i]);
+    return FALSE;
+  }
 }
 
+/* The planes of @buffer stay mapped until fini_image_from_buffer() */
 static gboolean
-init_image_from_buffer (GstVaapiImageRaw * raw_image, GstBuffer * buffer)
+init_image_from_buffer (GstVaapiImageRaw * raw_image, GstBuffer * buffer,
+    GstMapInfo map_info[3], GstMapFlags flags)
 {
   GstVideoMeta *const vmeta = gst_buffer_get_video_meta (buffer);
 
-  return vmeta ? init_image_from_video_meta (raw_image, vmeta) : FALSE;
+  return vmeta ? init_image_from_video_meta (raw_image, vmeta, map_info,
+      flags) : FALSE;
 }
 
-/* Copy N lines of an image */
-static inline void
-memcpy_pic (guchar * dst,
-    guint dst_stride,
-    const guchar * src, guint src_stride, guint len, guint height)
+static void
+fini_image_from_buffer (GstVaapiImageRaw * raw_image, GstBuffer * buffer,
+    GstMapInfo map_info[3])
 {
+  GstVideoMeta *const vmeta = gst_buffer_get_video_meta (buffer);
   guint i;
 
-  for (i = 0; i < height; i++) {
-    memcpy (dst, src, len);
-    dst += dst_stride;
-    src += src_stride;
-  }
+  for (i = 0; i < raw_image->num_planes; i++)
+    gst_video_meta_unmap (vmeta, i, &map_info[i]);
 }
 
 /* Copy NV12 images */
 static void
 copy_image_NV12 (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect,
+    GstVaapiCopyPlaneFunc copy_func)
 {
   guchar *dst, *src;
   guint dst_stride, src_stride;
@@ -726,20 +852,21 @@ copy_image_NV12 (GstVaapiImageRaw * dst_image,
   dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
   src_stride = src_image->stride[0];
   src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width, rect->height);
+  copy_func (dst, dst_stride, src, src_stride, rect->width, rect->height);
 
   /* UV plane */
   dst_stride = dst_image->stride[1];
   dst = dst_image->pixels[1] + (rect->y / 2) * dst_stride + (rect->x & -2);
   src_stride = src_image->stride[1];
   src = src_image->pixels[1] + (rect->y / 2) * src_stride + (rect->x & -2);
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width, rect->height / 2);
+  copy_func (dst, dst_stride, src, src_stride, rect->width, rect->height / 2);
 }
 
 /* Copy YV12 images */
 static void
 copy_image_YV12 (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect,
+    GstVaapiCopyPlaneFunc copy_func)
 {
   guchar *dst, *src;
   guint dst_stride, src_stride;
@@ -750,7 +877,7 @@ copy_image_YV12 (GstVaapiImageRaw * dst_image,
   dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
   src_stride = src_image->stride[0];
   src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width, rect->height);
+  copy_func (dst, dst_stride, src, src_stride, rect->width, rect->height);
 
   /* U/V planes */
   x = rect->x / 2;
@@ -762,14 +889,15 @@ copy_image_YV12 (GstVaapiImageRaw * dst_image,
     dst = dst_image->pixels[i] + y * dst_stride + x;
     src_stride = src_image->stride[i];
     src = src_image->pixels[i] + y * src_stride + x;
-    memcpy_pic (dst, dst_stride, src, src_stride, w, h);
+    copy_func (dst, dst_stride, src, src_stride, w, h);
   }
 }
 
 /* Copy YUY2 images */
 static void
 copy_image_YUY2 (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect,
+    GstVaapiCopyPlaneFunc copy_func)
 {
   guchar *dst, *src;
   guint dst_stride, src_stride;
@@ -779,35 +907,78 @@ copy_image_YUY2 (GstVaapiImageRaw * dst_image,
   dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x * 2;
   src_stride = src_image->stride[0];
   src = src_image->pixels[0] + rect->y * src_stride + rect->x * 2;
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width * 2, rect->height);
+  copy_func (dst, dst_stride, src, src_stride, rect->width * 2, rect->height);
 }
 
 /* Copy RGBA images */
 static void
 copy_image_RGBA (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect,
+    GstVaapiCopyPlaneFunc copy_func)
 {
   guchar *dst, *src;
   guint dst_stride, src_stride;
 
   dst_stride = dst_image->stride[0];
-  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
+  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x * 4;
   src_stride = src_image->stride[0];
-  src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-  memcpy_pic (dst, dst_stride, src, src_stride, 4 * rect->width, rect->height);
+  src = src_image->pixels[0] + rect->y * src_stride + rect->x * 4;
+  copy_func (dst, dst_stride, src, src_stride, 4 * rect->width, rect->height);
 }
 
+/* Convert images to NV12, in the same pass as the copy */
 static gboolean
-copy_image (GstVaapiImageRaw * dst_image,
+convert_image (GstVaapiImageRaw * dst_image,
     GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+{
+  const GstVideoFormatInfo *const finfo =
+      gst_video_format_get_info (src_image->format);
+  const guint bpp = GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, 0);
+  GstVideoColorMatrix matrix;
+  guint8 *dst[2], *src[3];
+  guint i, sub;
+
+  /* The chroma of the destination is subsampled in both directions */
+  if ((rect->x | rect->y) & 1)
+    return FALSE;
+
+  for (i = 0; i < 2; i++)
+    dst[i] = dst_image->pixels[i] + (rect->y >> i) * dst_image->stride[i] +
+        rect->x;
+
+  /* Only I420 and YV12 have several planes, with subsampled chroma */
+  for (i = 0; i < src_image->num_planes; i++) {
+    sub = i > 0;
+    src[i] = src_image->pixels[i] + (rect->y >> sub) * src_image->stride[i] +
+        (rect->x >> sub) * bpp;
+  }
+
+  /* The colorimetry is not known here, so use the GstVideoInfo default */
+  matrix = src_image->height > 576 ?
+      GST_VIDEO_COLOR_MATRIX_BT709 : GST_VIDEO_COLOR_MATRIX_BT601;
+
+  return gst_vaapi_convert_to_NV12 (dst, dst_image->stride,
+      src_image->format, src, src_image->stride, rect->width, rect->height,
+      matrix);
+}
+
+/* @copy_func is gst_vaapi_copy_plane_download() for transfers from a
+   VA image mapping, and gst_vaapi_copy_plane_upload() otherwise */
+static gboolean
+copy_image (GstVaapiImageRaw * dst_image,
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect,
+    GstVaapiCopyPlaneFunc copy_func)
 {
   GstVaapiRectangle default_rect;
 
-  if (dst_image->format != src_image->format ||
-      dst_image->width != src_image->width ||
+  if (dst_image->width != src_image->width ||
       dst_image->height != src_image->height)
     return FALSE;
 
+  if (dst_image->format != src_image->format &&
+      !gst_vaapi_convert_is_supported (dst_image->format, src_image->format))
+    return FALSE;
+
   if (rect) {
     if (rect->x >= src_image->width ||
         rect->x + rect->width > src_image->width ||
@@ -822,23 +993,26 @@ copy_image (GstVaapiImageRaw * dst_image,
     rect = &default_rect;
   }
 
+  if (dst_image->format != src_image->format)
+    return convert_image (dst_image, src_image, rect);
+
   switch (dst_image->format) {
     case GST_VIDEO_FORMAT_NV12:
-      copy_image_NV12 (dst_image, src_image, rect);
+      copy_image_NV12 (dst_image, src_image, rect, copy_func);
       break;
     case GST_VIDEO_FORMAT_YV12:
     case GST_VIDEO_FORMAT_I420:
-      copy_image_YV12 (dst_image, src_image, rect);
+      copy_image_YV12 (dst_image, src_image, rect, copy_func);
       break;
     case GST_VIDEO_FORMAT_YUY2:
     case GST_VIDEO_FORMAT_UYVY:
-      copy_image_YUY2 (dst_image, src_image, rect);
+      copy_image_YUY2 (dst_image, src_image, rect, copy_func);
       break;
     case GST_VIDEO_FORMAT_ARGB:
     case GST_VIDEO_FORMAT_RGBA:
     case GST_VIDEO_FORMAT_ABGR:
     case GST_VIDEO_FORMAT_BGRA:
-      copy_image_RGBA (dst_image, src_image, rect);
+      copy_image_RGBA (dst_image, src_image, rect, copy_func);
       break;
     default:
       GST_ERROR ("unsupported image format for copy");
@@ -864,26 +1038,30 @@ gst_vaapi_image_get_buffer (GstVaapiImage * image,
     GstBuffer * buffer, GstVaapiRectangle * rect)
 {
   GstVaapiImageRaw dst_image, src_image;
-  gboolean success;
+  GstMapInfo map_info[3];
+  gboolean success = FALSE;
 
   g_return_val_if_fail (image != NULL, FALSE);
   g_return_val_if_fail (GST_IS_BUFFER (buffer), FALSE);
 
-  if (!init_image_from_buffer (&dst_image, buffer))
+  if (!init_image_from_buffer (&dst_image, buffer, map_info, GST_MAP_WRITE))
     return FALSE;
   if (dst_image.format != image->format)
-    return FALSE;
+    goto end;
   if (dst_image.width != image->width || dst_image.height != image->height)
-    return FALSE;
+    goto end;
 
   if (!_gst_vaapi_image_map (image, &src_image))
-    return FALSE;
+    goto end;
 
-  success = copy_image (&dst_image, &src_image, rect);
+  success = copy_image (&dst_image, &src_image, rect,
+      gst_vaapi_copy_plane_download);
 
   if (!_gst_vaapi_image_unmap (image))
-    return FALSE;
+    success = FALSE;
 
+end:
+  fini_image_from_buffer (&dst_image, buffer, map_info);
   return success;
 }
 
@@ -911,7 +1089,8 @@ gst_vaapi_image_get_raw (GstVaapiImage * image,
   if (!_gst_vaapi_image_map (image, &src_image))
     return FALSE;
 
-  success = copy_image (dst_image, &src_image, rect);
+  success = copy_image (dst_image, &src_image, rect,
+      gst_vaapi_copy_plane_download);
 
   if (!_gst_vaapi_image_unmap (image))
     return FALSE;
@@ -927,7 +1106,10 @@ gst_vaapi_image_get_raw (GstVaapiImage * image,
  *   whole image
  *
  * Transfers pixels data contained in the #GstBuffer into the
- * @image. Both image structures shall have the same format.
+ * @image. Both image structures shall have the same format, except
+ * for NV12 images, that can also be filled from I420, YV12, YUY2,
+ * UYVY and 32-bit RGB buffers. In that case, the conversion happens
+ * while the pixels are copied, and @rect shall have an even origin.
  *
  * Return value: %TRUE on success
  */
@@ -936,26 +1118,31 @@ gst_vaapi_image_update_from_buffer (GstVaapiImage * image,
     GstBuffer * buffer, GstVaapiRectangle * rect)
 {
   GstVaapiImageRaw dst_image, src_image;
-  gboolean success;
+  GstMapInfo map_info[3];
+  gboolean success = FALSE;
 
   g_return_val_if_fail (image != NULL, FALSE);
   g_return_val_if_fail (GST_IS_BUFFER (buffer), FALSE);
 
-  if (!init_image_from_buffer (&src_image, buffer))
-    return FALSE;
-  if (src_image.format != image->format)
+  if (!init_image_from_buffer (&src_image, buffer, map_info, GST_MAP_READ))
     return FALSE;
+  if (src_image.format != image->format &&
+      !gst_vaapi_convert_is_supported (image->format, src_image.format))
+    goto end;
   if (src_image.width != image->width || src_image.height != image->height)
-    return FALSE;
+    goto end;
 
   if (!_gst_vaapi_image_map (image, &dst_image))
-    return FALSE;
+    goto end;
 
-  success = copy_image (&dst_image, &src_image, rect);
+  success = copy_image (&dst_image, &src_image, rect,
+      gst_vaapi_copy_plane_upload);
 
   if (!_gst_vaapi_image_unmap (image))
-    return FALSE;
+    success = FALSE;
 
+end:
+  fini_image_from_buffer (&src_image, buffer, map_info);
   return success;
 }
 
@@ -984,7 +1171,8 @@ gst_vaapi_image_update_from_raw (GstVaapiImage * image,
   if (!_gst_vaapi_image_map (image, &dst_image))
     return FALSE;
 
-  success = copy_image (&dst_image, src_image, rect);
+  success = copy_image (&dst_image, src_image, rect,
+      gst_vaapi_copy_plane_upload);
 
   if (!_gst_vaapi_image_unmap (image))
     return FALSE;
@@ -1016,7 +1204,8 @@ gst_vaapi_image_copy (GstVaapiImage * dst_image, GstVaapiImage * src_image)
   if (!_gst_vaapi_image_map (src_image, &src_image_raw))
     goto end;
 
-  success = copy_image (&dst_image_raw, &src_image_raw, NULL);
+  success = copy_image (&dst_image_raw, &src_image_raw, NULL,
+      gst_vaapi_copy_plane_download);
 
 end:
   _gst_vaapi_image_unmap (src_image);
@@ -61,6 +61,22 @@ G_BEGIN_DECLS
 
 typedef struct _GstVaapiImage                   GstVaapiImage;
 
+/**
+ * GstVaapiImageAllocFlags:
+ * @GST_VAAPI_IMAGE_ALLOC_FLAG_PERSISTENT_MAPPING: keeps the image
+ *   data buffer mapped from the first gst_vaapi_image_map() call
+ *   until the image is destroyed. Later map and unmap cycles no
+ *   longer reach the VA driver. VA-API does not guarantee that
+ *   vaGetImage() and vaPutImage() work on a mapped buffer, so this
+ *   shall only be used with drivers known to support it.
+ *
+ * The set of optional allocation flags for gst_vaapi_image_pool_new_full().
+ */
+typedef enum
+{
+  GST_VAAPI_IMAGE_ALLOC_FLAG_PERSISTENT_MAPPING = 1 << 0,
+} GstVaapiImageAllocFlags;
+
 GstVaapiImage *
 gst_vaapi_image_new(
     GstVaapiDisplay    *display,
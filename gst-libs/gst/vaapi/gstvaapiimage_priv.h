@@ -45,11 +45,13 @@ struct _GstVaapiImage {
     VAImage             internal_image;
     VAImage             image;
     guchar             *image_data;
+    guchar             *persistent_data;
     GstVideoFormat      internal_format;
     GstVideoFormat      format;
     guint               width;
     guint               height;
     guint               is_linear       : 1;
+    guint               is_persistent   : 1;
 };
 
 /**
@@ -123,6 +125,21 @@ gst_vaapi_image_update_from_raw(
     GstVaapiRectangle *rect
 );
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_image_set_persistent_mapping(
+    GstVaapiImage     *image,
+    gboolean           persistent
+);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_image_sync_for_cpu(GstVaapiImage *image);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_image_sync_for_device(GstVaapiImage *image);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_IMAGE_PRIV_H */
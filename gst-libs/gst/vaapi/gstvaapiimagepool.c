@@ -29,6 +29,7 @@
 
 #include "sysdeps.h"
 #include "gstvaapiimagepool.h"
+#include "gstvaapiimage_priv.h"
 #include "gstvaapivideopool_priv.h"
 
 #define DEBUG 1
@@ -47,16 +48,19 @@ struct _GstVaapiImagePool
   GstVideoFormat format;
   guint width;
   guint height;
+  guint alloc_flags;
 };
 
 static gboolean
-image_pool_init (GstVaapiVideoPool * base_pool, const GstVideoInfo * vip)
+image_pool_init (GstVaapiVideoPool * base_pool, const GstVideoInfo * vip,
+    guint flags)
 {
   GstVaapiImagePool *const pool = GST_VAAPI_IMAGE_POOL (base_pool);
 
   pool->format = GST_VIDEO_INFO_FORMAT (vip);
   pool->width = GST_VIDEO_INFO_WIDTH (vip);
   pool->height = GST_VIDEO_INFO_HEIGHT (vip);
+  pool->alloc_flags = flags;
   return gst_vaapi_display_has_image_format (base_pool->display, pool->format);
 }
 
@@ -64,9 +68,16 @@ static gpointer
 gst_vaapi_image_pool_alloc_object (GstVaapiVideoPool * base_pool)
 {
   GstVaapiImagePool *const pool = GST_VAAPI_IMAGE_POOL (base_pool);
+  GstVaapiImage *image;
 
-  return gst_vaapi_image_new (base_pool->display, pool->format,
+  image = gst_vaapi_image_new (base_pool->display, pool->format,
       pool->width, pool->height);
+  if (!image)
+    return NULL;
+
+  if (pool->alloc_flags & GST_VAAPI_IMAGE_ALLOC_FLAG_PERSISTENT_MAPPING)
+    gst_vaapi_image_set_persistent_mapping (image, TRUE);
+  return image;
 }
 
 static inline const GstVaapiMiniObjectClass *
@@ -93,6 +104,29 @@ gst_vaapi_image_pool_class (void)
  */
 GstVaapiVideoPool *
 gst_vaapi_image_pool_new (GstVaapiDisplay * display, const GstVideoInfo * vip)
+{
+  return gst_vaapi_image_pool_new_full (display, vip, 0);
+}
+
+/**
+ * gst_vaapi_image_pool_new_full:
+ * @display: a #GstVaapiDisplay
+ * @vip: the #GstVideoInfo
+ * @flags: (optional) allocation flags, i.e. #GstVaapiImageAllocFlags
+ *
+ * Creates a new #GstVaapiVideoPool of #GstVaapiImage with the
+ * specified format and dimensions in @vip.
+ *
+ * With %GST_VAAPI_IMAGE_ALLOC_FLAG_PERSISTENT_MAPPING, each image
+ * keeps its data buffer mapped while it lives in the pool. This saves
+ * a vaMapBuffer() and vaUnmapBuffer() call pair per frame, which is
+ * expensive with some drivers.
+ *
+ * Return value: the newly allocated #GstVaapiVideoPool
+ */
+GstVaapiVideoPool *
+gst_vaapi_image_pool_new_full (GstVaapiDisplay * display,
+    const GstVideoInfo * vip, guint flags)
 {
   GstVaapiVideoPool *pool;
 
@@ -107,7 +141,7 @@ gst_vaapi_image_pool_new (GstVaapiDisplay * display, const GstVideoInfo * vip)
   gst_vaapi_video_pool_init (pool, display,
       GST_VAAPI_VIDEO_POOL_OBJECT_TYPE_IMAGE);
 
-  if (!image_pool_init (pool, vip))
+  if (!image_pool_init (pool, vip, flags))
     goto error;
   return pool;
 
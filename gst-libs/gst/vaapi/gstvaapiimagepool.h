@@ -39,6 +39,10 @@ typedef struct _GstVaapiImagePool GstVaapiImagePool;
 GstVaapiVideoPool *
 gst_vaapi_image_pool_new (GstVaapiDisplay * display, const GstVideoInfo * vip);
 
+GstVaapiVideoPool *
+gst_vaapi_image_pool_new_full (GstVaapiDisplay * display,
+    const GstVideoInfo * vip, guint flags);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_IMAGE_POOL_H */
@@ -28,6 +28,58 @@
 #undef gst_vaapi_mini_object_unref
 #undef gst_vaapi_mini_object_replace
 
+/* Caches can be bypassed with GST_VAAPI_MINI_OBJECT_CACHE=0, so that
+   their effect on allocator traffic could be measured */
+static gboolean
+cache_is_enabled (void)
+{
+  static gsize g_cache_state = 0;
+
+  if (g_once_init_enter (&g_cache_state)) {
+    const gchar *const env = g_getenv ("GST_VAAPI_MINI_OBJECT_CACHE");
+    g_once_init_leave (&g_cache_state, g_strcmp0 (env, "0") != 0 ? 2 : 1);
+  }
+  return g_cache_state == 2;
+}
+
+/* Stores the free @object into the @cache, or returns FALSE if full */
+static gboolean
+cache_push (GstVaapiMiniObjectCache * cache, gpointer object)
+{
+  const guint hint = g_atomic_int_get (&cache->hint);
+  guint i, n;
+
+  for (i = 0; i < GST_VAAPI_MINI_OBJECT_CACHE_SIZE; i++) {
+    n = (hint + i) % GST_VAAPI_MINI_OBJECT_CACHE_SIZE;
+    if (g_atomic_pointer_compare_and_exchange (&cache->objects[n],
+            NULL, object)) {
+      g_atomic_int_set (&cache->hint, n);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* Retrieves a free object from the @cache, starting with the most
+   recently stored one as it is more likely to still be hot in cache */
+static gpointer
+cache_pop (GstVaapiMiniObjectCache * cache)
+{
+  const guint hint = g_atomic_int_get (&cache->hint);
+  gpointer object;
+  guint i, n;
+
+  for (i = 0; i < GST_VAAPI_MINI_OBJECT_CACHE_SIZE; i++) {
+    n = (hint + GST_VAAPI_MINI_OBJECT_CACHE_SIZE - i) %
+        GST_VAAPI_MINI_OBJECT_CACHE_SIZE;
+    object = g_atomic_pointer_get (&cache->objects[n]);
+    if (object && g_atomic_pointer_compare_and_exchange (&cache->objects[n],
+            object, NULL))
+      return object;
+  }
+  return NULL;
+}
+
 void
 gst_vaapi_mini_object_free (GstVaapiMiniObject * object)
 {
@@ -38,8 +90,11 @@ gst_vaapi_mini_object_free (GstVaapiMiniObject * object)
   if (klass->finalize)
     klass->finalize (object);
 
-  if (G_LIKELY (g_atomic_int_dec_and_test (&object->ref_count)))
-    g_slice_free1 (klass->size, object);
+  if (G_LIKELY (g_atomic_int_dec_and_test (&object->ref_count))) {
+    if (!klass->cache || !cache_is_enabled () ||
+        !cache_push (klass->cache, object))
+      g_slice_free1 (klass->size, object);
+  }
 }
 
 /**
@@ -51,6 +106,11 @@ gst_vaapi_mini_object_free (GstVaapiMiniObject * object)
  * If @object_class is not NULL, typically when a sub-class is implemented,
  * that pointer shall reference a statically allocated descriptor.
  *
+ * If the @object_class has a #GstVaapiMiniObjectCache, a previously
+ * released object is recycled whenever possible. Setting the
+ * GST_VAAPI_MINI_OBJECT_CACHE environment variable to 0 disables all
+ * caches.
+ *
  * This function does *not* zero-initialize the derived object data,
  * use gst_vaapi_mini_object_new0() to fill this purpose.
  *
@@ -70,7 +130,10 @@ gst_vaapi_mini_object_new (const GstVaapiMiniObjectClass * object_class)
 
   g_return_val_if_fail (object_class->size >= sizeof (*object), NULL);
 
-  object = g_slice_alloc (object_class->size);
+  object = object_class->cache && cache_is_enabled () ?
+      cache_pop (object_class->cache) : NULL;
+  if (!object)
+    object = g_slice_alloc (object_class->size);
   if (!object)
     return NULL;
 
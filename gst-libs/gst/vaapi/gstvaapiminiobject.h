@@ -30,6 +30,14 @@ G_BEGIN_DECLS
 
 typedef struct _GstVaapiMiniObject              GstVaapiMiniObject;
 typedef struct _GstVaapiMiniObjectClass         GstVaapiMiniObjectClass;
+typedef struct _GstVaapiMiniObjectCache         GstVaapiMiniObjectCache;
+
+/**
+ * GST_VAAPI_MINI_OBJECT_CACHE_SIZE:
+ *
+ * The maximum number of free objects held by a #GstVaapiMiniObjectCache
+ */
+#define GST_VAAPI_MINI_OBJECT_CACHE_SIZE 16
 
 /**
  * GST_VAAPI_MINI_OBJECT:
@@ -125,11 +133,29 @@ struct _GstVaapiMiniObject
   guint flags;
 };
 
+/**
+ * GstVaapiMiniObjectCache:
+ *
+ * A bounded set of free objects that gst_vaapi_mini_object_new() can
+ * recycle instead of allocating new memory. Objects are stored and
+ * retrieved with atomic operations only, so the set can be shared
+ * by the decoder and output threads. A cache shall be statically
+ * allocated, i.e. zero-initialized, and never be released.
+ */
+struct _GstVaapiMiniObjectCache
+{
+  /*< private >*/
+  gpointer objects[GST_VAAPI_MINI_OBJECT_CACHE_SIZE];
+  volatile gint hint;
+};
+
 /**
  * GstVaapiMiniObjectClass:
  * @size: size in bytes of the #GstVaapiMiniObject, plus any
  *   additional data for derived classes
  * @finalize: function called to destroy data in derived classes
+ * @cache: (optional): a #GstVaapiMiniObjectCache holding free objects
+ *   of that class
  *
  * A #GstVaapiMiniObjectClass represents the base object class that
  * defines the size of the #GstVaapiMiniObject and utility function to
@@ -140,6 +166,7 @@ struct _GstVaapiMiniObjectClass
   /*< protected >*/
   guint size;
   GDestroyNotify finalize;
+  GstVaapiMiniObjectCache *cache;
 };
 
 GstVaapiMiniObject *
@@ -31,9 +31,11 @@
 static inline const GstVaapiMiniObjectClass *
 gst_vaapi_parser_frame_class (void)
 {
+  static GstVaapiMiniObjectCache GstVaapiParserFrameCache;
   static const GstVaapiMiniObjectClass GstVaapiParserFrameClass = {
     sizeof (GstVaapiParserFrame),
-    (GDestroyNotify) gst_vaapi_parser_frame_free
+    (GDestroyNotify) gst_vaapi_parser_frame_free,
+    &GstVaapiParserFrameCache
   };
   return &GstVaapiParserFrameClass;
 }
@@ -85,6 +87,8 @@ gst_vaapi_parser_frame_new (guint width, guint height)
   if (!frame)
     return NULL;
 
+  frame->input_buffer = NULL;
+
   if (!height)
     height = 1088;
   num_slices = (height + 15) / 16;
@@ -119,6 +123,7 @@ gst_vaapi_parser_frame_free (GstVaapiParserFrame * frame)
   free_units (&frame->units);
   free_units (&frame->pre_units);
   free_units (&frame->post_units);
+  gst_buffer_replace (&frame->input_buffer, NULL);
 }
 
 /**
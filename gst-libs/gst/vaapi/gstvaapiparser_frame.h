@@ -44,6 +44,8 @@ typedef struct _GstVaapiParserFrame             GstVaapiParserFrame;
  * @units: list of #GstVaapiDecoderUnit objects (slice data)
  * @pre_units: list of units to decode before GstVaapiDecoder:start_frame()
  * @post_units: list of units to decode after GstVaapiDecoder:end_frame()
+ * @input_buffer: the bytes the units were parsed from, if they differ
+ *    from the #GstVideoCodecFrame input buffer, or %NULL
  *
  * An extension to #GstVideoCodecFrame with #GstVaapiDecoder specific
  * information. Decoder frames are usually attached to codec frames as
@@ -57,6 +59,7 @@ struct _GstVaapiParserFrame {
     GArray             *units;
     GArray             *pre_units;
     GArray             *post_units;
+    GstBuffer          *input_buffer;
 };
 
 G_GNUC_INTERNAL
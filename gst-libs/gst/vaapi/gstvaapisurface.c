@@ -37,6 +37,7 @@
 #include "gstvaapiimage_priv.h"
 #include "gstvaapicontext_overlay.h"
 #include "gstvaapibufferproxy_priv.h"
+#include "gstvaapisurface_waiter.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -687,6 +688,7 @@ gst_vaapi_surface_get_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (!vaapi_check_status (status, "vaGetImage()"))
     return FALSE;
 
+  gst_vaapi_image_sync_for_cpu (image);
   return TRUE;
 }
 
@@ -724,6 +726,8 @@ gst_vaapi_surface_put_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (image_id == VA_INVALID_ID)
     return FALSE;
 
+  gst_vaapi_image_sync_for_device (image);
+
   GST_VAAPI_DISPLAY_LOCK (display);
   status = vaPutImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_OBJECT_ID (surface), image_id, 0, 0, width, height,
@@ -929,6 +933,29 @@ gst_vaapi_surface_sync (GstVaapiSurface * surface)
   return TRUE;
 }
 
+/**
+ * gst_vaapi_surface_sync_async:
+ * @surface: a #GstVaapiSurface
+ * @func: the function to call on completion
+ * @user_data: user data to pass to @func
+ *
+ * Arranges for @func to be called once all pending operations on the
+ * @surface have been completed, without blocking the calling thread.
+ * Surfaces of all streams are tracked by a single shared thread, from
+ * which @func is invoked. The @surface is kept alive until then.
+ *
+ * This is the non-blocking counterpart of gst_vaapi_surface_sync().
+ */
+void
+gst_vaapi_surface_sync_async (GstVaapiSurface * surface,
+    GstVaapiSurfaceSyncFunc func, gpointer user_data)
+{
+  g_return_if_fail (surface != NULL);
+  g_return_if_fail (func != NULL);
+
+  gst_vaapi_surface_waiter_add (surface, func, user_data);
+}
+
 /**
  * gst_vaapi_surface_query_status:
  * @surface: a #GstVaapiSurface
@@ -169,6 +169,18 @@ typedef enum
 typedef struct _GstVaapiSurface                 GstVaapiSurface;
 typedef struct _GstVaapiSurfaceProxy            GstVaapiSurfaceProxy;
 
+/**
+ * GstVaapiSurfaceSyncFunc:
+ * @surface: the #GstVaapiSurface whose operations completed
+ * @success: %FALSE if an error occurred while waiting
+ * @user_data: the user data supplied to gst_vaapi_surface_sync_async()
+ *
+ * Callback invoked once all pending operations on @surface have
+ * completed. It is called from an internal thread and shall not block.
+ */
+typedef void (*GstVaapiSurfaceSyncFunc) (GstVaapiSurface * surface,
+    gboolean success, gpointer user_data);
+
 GstVaapiSurface *
 gst_vaapi_surface_new (GstVaapiDisplay * display,
     GstVaapiChromaType chroma_type, guint width, guint height);
@@ -225,6 +237,10 @@ gst_vaapi_surface_deassociate_subpicture (GstVaapiSurface * surface,
 gboolean
 gst_vaapi_surface_sync (GstVaapiSurface * surface);
 
+void
+gst_vaapi_surface_sync_async (GstVaapiSurface * surface,
+    GstVaapiSurfaceSyncFunc func, gpointer user_data);
+
 gboolean
 gst_vaapi_surface_query_status (GstVaapiSurface * surface,
     GstVaapiSurfaceStatus * pstatus);
@@ -0,0 +1,188 @@
+/*
+ *  gstvaapisurface_waiter.c - Asynchronous surface completion
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* A single process-wide thread polls the status of the surfaces that
+   have pending operations, and notifies their owners as soon as they
+   complete. This replaces one thread blocked in vaSyncSurface(), with
+   the display lock held, per stream */
+
+#include "sysdeps.h"
+#include "gstvaapisurface_waiter.h"
+#include "gstvaapiobject.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Polling interval bounds, in microseconds. The interval of each
+   surface doubles every time it is found still rendering */
+#define MIN_POLL_INTERVAL 250
+#define MAX_POLL_INTERVAL 4000
+
+/* Surfaces still rendering after that time, in microseconds, are
+   reported once. They are still polled rather than waited for with
+   vaSyncSurface(), which would hold back every other surface */
+#define SYNC_TIMEOUT 200000
+
+/* The thread exits after being idle for that time, in microseconds */
+#define IDLE_TIMEOUT (G_USEC_PER_SEC)
+
+typedef struct
+{
+  GstVaapiSurface *surface;
+  GstVaapiSurfaceSyncFunc func;
+  gpointer user_data;
+  gint64 start_time;
+  gint64 poll_time;
+  gint64 poll_interval;
+  gboolean reported;
+} SyncRequest;
+
+static GMutex g_waiter_lock;
+static GCond g_waiter_cond;
+static GQueue g_waiter_requests = G_QUEUE_INIT;
+static gboolean g_waiter_running;
+
+static void
+sync_request_complete (SyncRequest * request, gboolean success)
+{
+  request->func (request->surface, success, request->user_data);
+  gst_vaapi_object_unref (request->surface);
+  g_slice_free (SyncRequest, request);
+}
+
+/* Returns TRUE if @request completed, and invokes its callback.
+   Otherwise, schedules the next poll of @request */
+static gboolean
+sync_request_poll (SyncRequest * request, gint64 now)
+{
+  GstVaapiSurfaceStatus status;
+
+  if (now < request->poll_time)
+    return FALSE;
+
+  if (!gst_vaapi_surface_query_status (request->surface, &status)) {
+    sync_request_complete (request, FALSE);
+    return TRUE;
+  }
+
+  if (status & GST_VAAPI_SURFACE_STATUS_RENDERING) {
+    if (!request->reported && now - request->start_time >= SYNC_TIMEOUT) {
+      GST_WARNING ("surface %" GST_VAAPI_ID_FORMAT " still busy after %d ms",
+          GST_VAAPI_ID_ARGS (GST_VAAPI_OBJECT_ID (request->surface)),
+          SYNC_TIMEOUT / 1000);
+      request->reported = TRUE;
+    }
+    request->poll_interval = MIN (request->poll_interval * 2,
+        MAX_POLL_INTERVAL);
+    request->poll_time = now + request->poll_interval;
+    return FALSE;
+  }
+
+  sync_request_complete (request, TRUE);
+  return TRUE;
+}
+
+static gpointer
+waiter_thread (gpointer data)
+{
+  GQueue requests = G_QUEUE_INIT;
+  SyncRequest *request;
+  gint64 now, poll_time;
+  GList *l, *next;
+
+  g_mutex_lock (&g_waiter_lock);
+  for (;;) {
+    /* Wait for new requests, or for the next poll */
+    if (g_queue_is_empty (&g_waiter_requests)) {
+      if (!g_cond_wait_until (&g_waiter_cond, &g_waiter_lock,
+              g_get_monotonic_time () + IDLE_TIMEOUT) &&
+          g_queue_is_empty (&g_waiter_requests))
+        break;
+      continue;
+    }
+
+    /* Poll outside of the lock so that callbacks may queue requests */
+    requests = g_waiter_requests;
+    g_queue_init (&g_waiter_requests);
+    g_mutex_unlock (&g_waiter_lock);
+
+    now = g_get_monotonic_time ();
+    poll_time = G_MAXINT64;
+    for (l = requests.head; l != NULL; l = next) {
+      next = l->next;
+      request = l->data;
+      if (sync_request_poll (request, now))
+        g_queue_delete_link (&requests, l);
+      else
+        poll_time = MIN (poll_time, request->poll_time);
+    }
+
+    /* Put back pending requests ahead of the new ones, and sleep until
+       the next one is due unless new requests were queued meanwhile */
+    g_mutex_lock (&g_waiter_lock);
+    if (g_queue_is_empty (&requests))
+      continue;
+    if (g_queue_is_empty (&g_waiter_requests))
+      g_cond_wait_until (&g_waiter_cond, &g_waiter_lock, poll_time);
+    while ((l = g_queue_pop_tail_link (&requests)) != NULL)
+      g_queue_push_head_link (&g_waiter_requests, l);
+  }
+  g_waiter_running = FALSE;
+  g_mutex_unlock (&g_waiter_lock);
+  return NULL;
+}
+
+/* Queues @surface for completion. @func is called from the waiter
+   thread, and shall not block */
+void
+gst_vaapi_surface_waiter_add (GstVaapiSurface * surface,
+    GstVaapiSurfaceSyncFunc func, gpointer user_data)
+{
+  SyncRequest *const request = g_slice_new (SyncRequest);
+  GThread *thread;
+  GError *error = NULL;
+
+  request->surface = gst_vaapi_object_ref (surface);
+  request->func = func;
+  request->user_data = user_data;
+  request->start_time = g_get_monotonic_time ();
+  request->poll_time = request->start_time;
+  request->poll_interval = MIN_POLL_INTERVAL;
+  request->reported = FALSE;
+
+  g_mutex_lock (&g_waiter_lock);
+  if (!g_waiter_running) {
+    thread = g_thread_try_new ("vaapi-surface-waiter", waiter_thread, NULL,
+        &error);
+    if (!thread) {
+      g_mutex_unlock (&g_waiter_lock);
+      GST_ERROR ("failed to create waiter thread: %s", error->message);
+      g_error_free (error);
+
+      /* Fallback to a synchronous wait */
+      sync_request_complete (request, gst_vaapi_surface_sync (surface));
+      return;
+    }
+    g_thread_unref (thread);
+    g_waiter_running = TRUE;
+  }
+  g_queue_push_tail (&g_waiter_requests, request);
+  g_cond_signal (&g_waiter_cond);
+  g_mutex_unlock (&g_waiter_lock);
+}
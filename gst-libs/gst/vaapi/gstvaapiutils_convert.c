@@ -0,0 +1,499 @@
+/*
+ *  gstvaapiutils_convert.c - Format conversion helpers for VA image uploads
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Source pixels are converted while they are written to the mapped
+   VA image, so that formats the driver does not support for images
+   cost a single pass over the frame, instead of one pass through
+   videoconvert and another one for the upload. The output lines are
+   written sequentially, in full 16-byte stores when possible, which
+   the write-combining buffers handle well.
+
+   Chroma is subsampled by averaging 2x2 blocks. RGB sources produce
+   limited range YUV, with 8-bit fixed point coefficients */
+
+#include "sysdeps.h"
+#include <string.h>
+#include "gstvaapiutils_convert.h"
+#include "gstvaapiutils_copy.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+# define USE_SSE2 1
+# include <emmintrin.h>
+#endif
+
+/* Coefficients applied to each byte of a 32-bit RGB pixel, in memory
+   order. The alpha or padding byte has a zero coefficient */
+typedef struct
+{
+  gint16 y[4];
+  gint16 u[4];
+  gint16 v[4];
+} RgbCoeffs;
+
+/* R, G, B coefficients for Y, U and V */
+static const gint16 g_bt601_matrix[3][3] = {
+  {66, 129, 25},
+  {-38, -74, 112},
+  {112, -94, -18},
+};
+
+static const gint16 g_bt709_matrix[3][3] = {
+  {47, 157, 16},
+  {-26, -87, 112},
+  {112, -102, -10},
+};
+
+/* Source formats that can be converted to NV12 */
+static const GstVideoFormat g_src_formats[] = {
+  GST_VIDEO_FORMAT_I420,
+  GST_VIDEO_FORMAT_YV12,
+  GST_VIDEO_FORMAT_YUY2,
+  GST_VIDEO_FORMAT_UYVY,
+  GST_VIDEO_FORMAT_BGRx,
+  GST_VIDEO_FORMAT_BGRA,
+  GST_VIDEO_FORMAT_RGBx,
+  GST_VIDEO_FORMAT_RGBA,
+  GST_VIDEO_FORMAT_xRGB,
+  GST_VIDEO_FORMAT_ARGB,
+  GST_VIDEO_FORMAT_xBGR,
+  GST_VIDEO_FORMAT_ABGR,
+};
+
+static inline guint8
+clamp_uint8 (gint v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline guint8
+avg_uint8 (guint a, guint b)
+{
+  return (a + b + 1) >> 1;
+}
+
+#if USE_SSE2
+/* Returns the dot products of the 4 pixels of @v with @k, as 32-bit
+   integers */
+static inline __m128i
+dot4_sse2 (__m128i v, __m128i k)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128i lo = _mm_madd_epi16 (_mm_unpacklo_epi8 (v, zero), k);
+  __m128i hi = _mm_madd_epi16 (_mm_unpackhi_epi8 (v, zero), k);
+
+  lo = _mm_add_epi32 (lo, _mm_srli_epi64 (lo, 32));
+  hi = _mm_add_epi32 (hi, _mm_srli_epi64 (hi, 32));
+  lo = _mm_shuffle_epi32 (lo, _MM_SHUFFLE (3, 1, 2, 0));
+  hi = _mm_shuffle_epi32 (hi, _MM_SHUFFLE (3, 1, 2, 0));
+  return _mm_unpacklo_epi64 (lo, hi);
+}
+
+/* Returns the dot products of the 2 pixels of @v, with 16-bit
+   channels, with @k, as 32-bit integers in the low 64 bits */
+static inline __m128i
+dot2_sse2 (__m128i v, __m128i k)
+{
+  __m128i d = _mm_madd_epi16 (v, k);
+
+  d = _mm_add_epi32 (d, _mm_srli_epi64 (d, 32));
+  return _mm_shuffle_epi32 (d, _MM_SHUFFLE (3, 1, 2, 0));
+}
+
+/* Sums the horizontal pairs of the 4 pixels of @v, into 2 pixels with
+   16-bit channels */
+static inline __m128i
+sum_pairs_sse2 (__m128i v)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128i lo = _mm_unpacklo_epi8 (v, zero);
+  __m128i hi = _mm_unpackhi_epi8 (v, zero);
+
+  lo = _mm_add_epi16 (lo, _mm_srli_si128 (lo, 8));
+  hi = _mm_add_epi16 (hi, _mm_srli_si128 (hi, 8));
+  return _mm_unpacklo_epi64 (lo, hi);
+}
+
+/* Converts 16 RGB pixels to Y */
+static inline __m128i
+rgb_to_y_sse2 (const guint8 * src, __m128i k)
+{
+  const __m128i round = _mm_set1_epi32 (128);
+  const __m128i offset = _mm_set1_epi16 (16);
+  __m128i y[4];
+  guint i;
+
+  for (i = 0; i < 4; i++)
+    y[i] = _mm_srai_epi32 (_mm_add_epi32 (dot4_sse2 (_mm_loadu_si128
+                ((const __m128i *) (src + 16 * i)), k), round), 8);
+  y[0] = _mm_add_epi16 (_mm_packs_epi32 (y[0], y[1]), offset);
+  y[2] = _mm_add_epi16 (_mm_packs_epi32 (y[2], y[3]), offset);
+  return _mm_packus_epi16 (y[0], y[2]);
+}
+
+/* Converts 2 lines of 16 RGB pixels to 8 interleaved UV samples */
+static inline __m128i
+rgb_to_uv_sse2 (const guint8 * src0, const guint8 * src1, __m128i ku,
+    __m128i kv)
+{
+  const __m128i round = _mm_set1_epi32 (256);
+  const __m128i offset = _mm_set1_epi16 (128);
+  __m128i s, u[4], v[4], uv;
+  guint i;
+
+  for (i = 0; i < 4; i++) {
+    s = sum_pairs_sse2 (_mm_avg_epu8 (
+            _mm_loadu_si128 ((const __m128i *) (src0 + 16 * i)),
+            _mm_loadu_si128 ((const __m128i *) (src1 + 16 * i))));
+    u[i] = dot2_sse2 (s, ku);
+    v[i] = dot2_sse2 (s, kv);
+  }
+  for (i = 0; i < 4; i += 2) {
+    u[i] = _mm_srai_epi32 (_mm_add_epi32 (_mm_unpacklo_epi64 (u[i],
+                u[i + 1]), round), 9);
+    v[i] = _mm_srai_epi32 (_mm_add_epi32 (_mm_unpacklo_epi64 (v[i],
+                v[i + 1]), round), 9);
+  }
+  u[0] = _mm_add_epi16 (_mm_packs_epi32 (u[0], u[2]), offset);
+  v[0] = _mm_add_epi16 (_mm_packs_epi32 (v[0], v[2]), offset);
+
+  /* U0..U7 V0..V7 -> U0 V0 .. U7 V7 */
+  uv = _mm_packus_epi16 (u[0], v[0]);
+  return _mm_unpacklo_epi8 (uv, _mm_srli_si128 (uv, 8));
+}
+#endif
+
+static inline guint8
+rgb_to_y (const guint8 * p, const gint16 k[4])
+{
+  return clamp_uint8 (((p[0] * k[0] + p[1] * k[1] + p[2] * k[2] +
+              p[3] * k[3] + 128) >> 8) + 16);
+}
+
+/* @s holds the sums of 2 averaged pixels */
+static inline guint8
+rgb_to_chroma (const guint s[4], const gint16 k[4])
+{
+  return clamp_uint8 ((((gint) s[0] * k[0] + (gint) s[1] * k[1] +
+              (gint) s[2] * k[2] + (gint) s[3] * k[3] + 256) >> 9) + 128);
+}
+
+/* Converts one or two lines of RGB pixels. @dst_y1 is NULL for the
+   last line of images with an odd height, and then @src1 is @src0.
+   The SSE2 code is only used if @use_sse2 is set */
+static void
+convert_rgb_lines (guint8 * dst_y0, guint8 * dst_y1, guint8 * dst_uv,
+    const guint8 * src0, const guint8 * src1, guint width,
+    const RgbCoeffs * coeffs, gboolean use_sse2)
+{
+  guint x = 0, x1, i;
+  guint s[4];
+
+#if USE_SSE2
+  const __m128i ky = _mm_setr_epi16 (coeffs->y[0], coeffs->y[1],
+      coeffs->y[2], coeffs->y[3], coeffs->y[0], coeffs->y[1], coeffs->y[2],
+      coeffs->y[3]);
+  const __m128i ku = _mm_setr_epi16 (coeffs->u[0], coeffs->u[1],
+      coeffs->u[2], coeffs->u[3], coeffs->u[0], coeffs->u[1], coeffs->u[2],
+      coeffs->u[3]);
+  const __m128i kv = _mm_setr_epi16 (coeffs->v[0], coeffs->v[1],
+      coeffs->v[2], coeffs->v[3], coeffs->v[0], coeffs->v[1], coeffs->v[2],
+      coeffs->v[3]);
+
+  for (; use_sse2 && x + 16 <= width; x += 16) {
+    _mm_storeu_si128 ((__m128i *) (dst_y0 + x),
+        rgb_to_y_sse2 (src0 + 4 * x, ky));
+    if (dst_y1)
+      _mm_storeu_si128 ((__m128i *) (dst_y1 + x),
+          rgb_to_y_sse2 (src1 + 4 * x, ky));
+    _mm_storeu_si128 ((__m128i *) (dst_uv + x),
+        rgb_to_uv_sse2 (src0 + 4 * x, src1 + 4 * x, ku, kv));
+  }
+#endif
+
+  for (; x < width; x += 2) {
+    x1 = x + 1 < width ? x + 1 : x;
+    dst_y0[x] = rgb_to_y (src0 + 4 * x, coeffs->y);
+    if (x1 != x)
+      dst_y0[x1] = rgb_to_y (src0 + 4 * x1, coeffs->y);
+    if (dst_y1) {
+      dst_y1[x] = rgb_to_y (src1 + 4 * x, coeffs->y);
+      if (x1 != x)
+        dst_y1[x1] = rgb_to_y (src1 + 4 * x1, coeffs->y);
+    }
+
+    for (i = 0; i < 4; i++)
+      s[i] = avg_uint8 (src0[4 * x + i], src1[4 * x + i]) +
+          avg_uint8 (src0[4 * x1 + i], src1[4 * x1 + i]);
+    dst_uv[x] = rgb_to_chroma (s, coeffs->u);
+    dst_uv[x + 1] = rgb_to_chroma (s, coeffs->v);
+  }
+}
+
+/* Converts one or two lines of YUY2 (@y_offset = 0) or UYVY
+   (@y_offset = 1) pixels. Same conventions as convert_rgb_lines() */
+static void
+convert_packed_lines (guint8 * dst_y0, guint8 * dst_y1, guint8 * dst_uv,
+    const guint8 * src0, const guint8 * src1, guint width, guint y_offset,
+    gboolean use_sse2)
+{
+  const guint c_offset = 1 - y_offset;
+  guint x = 0;
+
+#if USE_SSE2
+  const __m128i mask = _mm_set1_epi16 (0x00ff);
+  __m128i a0, a1, b0, b1, c0, c1;
+
+  for (; use_sse2 && x + 16 <= width; x += 16) {
+    a0 = _mm_loadu_si128 ((const __m128i *) (src0 + 2 * x));
+    a1 = _mm_loadu_si128 ((const __m128i *) (src0 + 2 * x + 16));
+    b0 = _mm_loadu_si128 ((const __m128i *) (src1 + 2 * x));
+    b1 = _mm_loadu_si128 ((const __m128i *) (src1 + 2 * x + 16));
+    c0 = _mm_avg_epu8 (a0, b0);
+    c1 = _mm_avg_epu8 (a1, b1);
+
+    if (y_offset == 0) {
+      _mm_storeu_si128 ((__m128i *) (dst_y0 + x),
+          _mm_packus_epi16 (_mm_and_si128 (a0, mask),
+              _mm_and_si128 (a1, mask)));
+      if (dst_y1)
+        _mm_storeu_si128 ((__m128i *) (dst_y1 + x),
+            _mm_packus_epi16 (_mm_and_si128 (b0, mask),
+                _mm_and_si128 (b1, mask)));
+      _mm_storeu_si128 ((__m128i *) (dst_uv + x),
+          _mm_packus_epi16 (_mm_srli_epi16 (c0, 8), _mm_srli_epi16 (c1, 8)));
+    } else {
+      _mm_storeu_si128 ((__m128i *) (dst_y0 + x),
+          _mm_packus_epi16 (_mm_srli_epi16 (a0, 8), _mm_srli_epi16 (a1, 8)));
+      if (dst_y1)
+        _mm_storeu_si128 ((__m128i *) (dst_y1 + x),
+            _mm_packus_epi16 (_mm_srli_epi16 (b0, 8),
+                _mm_srli_epi16 (b1, 8)));
+      _mm_storeu_si128 ((__m128i *) (dst_uv + x),
+          _mm_packus_epi16 (_mm_and_si128 (c0, mask),
+              _mm_and_si128 (c1, mask)));
+    }
+  }
+#endif
+
+  for (; x < width; x += 2) {
+    dst_y0[x] = src0[2 * x + y_offset];
+    if (x + 1 < width)
+      dst_y0[x + 1] = src0[2 * x + 2 + y_offset];
+    if (dst_y1) {
+      dst_y1[x] = src1[2 * x + y_offset];
+      if (x + 1 < width)
+        dst_y1[x + 1] = src1[2 * x + 2 + y_offset];
+    }
+    dst_uv[x] = avg_uint8 (src0[2 * x + c_offset], src1[2 * x + c_offset]);
+    dst_uv[x + 1] = avg_uint8 (src0[2 * x + 2 + c_offset],
+        src1[2 * x + 2 + c_offset]);
+  }
+}
+
+/* Interleaves @width U and V samples */
+static void
+interleave_uv_line (guint8 * dst, const guint8 * u, const guint8 * v,
+    guint width, gboolean use_sse2)
+{
+  guint x = 0;
+
+#if USE_SSE2
+  __m128i a, b;
+
+  for (; use_sse2 && x + 16 <= width; x += 16) {
+    a = _mm_loadu_si128 ((const __m128i *) (u + x));
+    b = _mm_loadu_si128 ((const __m128i *) (v + x));
+    _mm_storeu_si128 ((__m128i *) (dst + 2 * x), _mm_unpacklo_epi8 (a, b));
+    _mm_storeu_si128 ((__m128i *) (dst + 2 * x + 16),
+        _mm_unpackhi_epi8 (a, b));
+  }
+#endif
+
+  for (; x < width; x++) {
+    dst[2 * x] = u[x];
+    dst[2 * x + 1] = v[x];
+  }
+}
+
+static gboolean
+init_rgb_coeffs (RgbCoeffs * coeffs, GstVideoFormat format,
+    GstVideoColorMatrix matrix)
+{
+  const gint16 (*m)[3];
+  guint i, r, g, b;
+
+  switch (format) {
+    case GST_VIDEO_FORMAT_BGRx:
+    case GST_VIDEO_FORMAT_BGRA:
+      r = 2, g = 1, b = 0;
+      break;
+    case GST_VIDEO_FORMAT_RGBx:
+    case GST_VIDEO_FORMAT_RGBA:
+      r = 0, g = 1, b = 2;
+      break;
+    case GST_VIDEO_FORMAT_xRGB:
+    case GST_VIDEO_FORMAT_ARGB:
+      r = 1, g = 2, b = 3;
+      break;
+    case GST_VIDEO_FORMAT_xBGR:
+    case GST_VIDEO_FORMAT_ABGR:
+      r = 3, g = 2, b = 1;
+      break;
+    default:
+      return FALSE;
+  }
+
+  m = matrix == GST_VIDEO_COLOR_MATRIX_BT709 ? g_bt709_matrix : g_bt601_matrix;
+  memset (coeffs, 0, sizeof (*coeffs));
+  for (i = 0; i < 3; i++) {
+    gint16 *const k = i == 0 ? coeffs->y : (i == 1 ? coeffs->u : coeffs->v);
+    k[r] = m[i][0];
+    k[g] = m[i][1];
+    k[b] = m[i][2];
+  }
+  return TRUE;
+}
+
+gboolean
+gst_vaapi_convert_is_supported (GstVideoFormat dst_format,
+    GstVideoFormat src_format)
+{
+  guint i;
+
+  if (dst_format != GST_VIDEO_FORMAT_NV12)
+    return FALSE;
+
+  for (i = 0; i < G_N_ELEMENTS (g_src_formats); i++) {
+    if (g_src_formats[i] == src_format)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+const GstVideoFormat *
+gst_vaapi_convert_get_src_formats (guint * n_formats_ptr)
+{
+  if (n_formats_ptr)
+    *n_formats_ptr = G_N_ELEMENTS (g_src_formats);
+  return g_src_formats;
+}
+
+static gboolean
+convert_to_NV12 (guint8 * const dst[2], const guint dst_stride[2],
+    GstVideoFormat src_format, guint8 * const src[3],
+    const guint src_stride[3], guint width, guint height,
+    GstVideoColorMatrix matrix, gboolean use_sse2)
+{
+  RgbCoeffs coeffs;
+  const guint8 *u, *v, *src0, *src1;
+  guint y, u_stride, v_stride, y_offset;
+  gboolean has_line1;
+
+  switch (src_format) {
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_YV12:
+      if (src_format == GST_VIDEO_FORMAT_I420) {
+        u = src[1], u_stride = src_stride[1];
+        v = src[2], v_stride = src_stride[2];
+      } else {
+        u = src[2], u_stride = src_stride[2];
+        v = src[1], v_stride = src_stride[1];
+      }
+      gst_vaapi_copy_plane_upload (dst[0], dst_stride[0], src[0],
+          src_stride[0], width, height);
+      for (y = 0; y < (height + 1) / 2; y++)
+        interleave_uv_line (dst[1] + y * dst_stride[1], u + y * u_stride,
+            v + y * v_stride, (width + 1) / 2, use_sse2);
+      break;
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_UYVY:
+      y_offset = src_format == GST_VIDEO_FORMAT_UYVY;
+      for (y = 0; y < height; y += 2) {
+        has_line1 = y + 1 < height;
+        src0 = src[0] + y * src_stride[0];
+        src1 = has_line1 ? src0 + src_stride[0] : src0;
+        convert_packed_lines (dst[0] + y * dst_stride[0],
+            has_line1 ? dst[0] + (y + 1) * dst_stride[0] : NULL,
+            dst[1] + (y / 2) * dst_stride[1], src0, src1, width, y_offset,
+            use_sse2);
+      }
+      break;
+    default:
+      if (!init_rgb_coeffs (&coeffs, src_format, matrix))
+        return FALSE;
+      for (y = 0; y < height; y += 2) {
+        has_line1 = y + 1 < height;
+        src0 = src[0] + y * src_stride[0];
+        src1 = has_line1 ? src0 + src_stride[0] : src0;
+        convert_rgb_lines (dst[0] + y * dst_stride[0],
+            has_line1 ? dst[0] + (y + 1) * dst_stride[0] : NULL,
+            dst[1] + (y / 2) * dst_stride[1], src0, src1, width, &coeffs,
+            use_sse2);
+      }
+      break;
+  }
+  return TRUE;
+}
+
+static gboolean
+convert_to_NV12_c (guint8 * const dst[2], const guint dst_stride[2],
+    GstVideoFormat src_format, guint8 * const src[3],
+    const guint src_stride[3], guint width, guint height,
+    GstVideoColorMatrix matrix)
+{
+  return convert_to_NV12 (dst, dst_stride, src_format, src, src_stride,
+      width, height, matrix, FALSE);
+}
+
+#if USE_SSE2
+static gboolean
+convert_to_NV12_sse2 (guint8 * const dst[2], const guint dst_stride[2],
+    GstVideoFormat src_format, guint8 * const src[3],
+    const guint src_stride[3], guint width, guint height,
+    GstVideoColorMatrix matrix)
+{
+  return convert_to_NV12 (dst, dst_stride, src_format, src, src_stride,
+      width, height, matrix, TRUE);
+}
+#endif
+
+static const GstVaapiConvertImpl g_impls[] = {
+  {"c", convert_to_NV12_c},
+#if USE_SSE2
+  {"sse2", convert_to_NV12_sse2},
+#endif
+};
+
+const GstVaapiConvertImpl *
+gst_vaapi_convert_get_impls (guint * n_impls_ptr)
+{
+  if (n_impls_ptr)
+    *n_impls_ptr = G_N_ELEMENTS (g_impls);
+  return g_impls;
+}
+
+gboolean
+gst_vaapi_convert_to_NV12 (guint8 * const dst[2], const guint dst_stride[2],
+    GstVideoFormat src_format, guint8 * const src[3],
+    const guint src_stride[3], guint width, guint height,
+    GstVideoColorMatrix matrix)
+{
+  return g_impls[G_N_ELEMENTS (g_impls) - 1].to_NV12 (dst, dst_stride,
+      src_format, src, src_stride, width, height, matrix);
+}
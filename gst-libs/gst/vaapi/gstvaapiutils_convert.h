@@ -0,0 +1,72 @@
+/*
+ *  gstvaapiutils_convert.h - Format conversion helpers for VA image uploads
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_UTILS_CONVERT_H
+#define GST_VAAPI_UTILS_CONVERT_H
+
+#include <gst/video/video-format.h>
+#include <gst/video/video-color.h>
+
+G_BEGIN_DECLS
+
+typedef gboolean (*GstVaapiConvertFunc) (guint8 * const dst[2],
+    const guint dst_stride[2], GstVideoFormat src_format,
+    guint8 * const src[3], const guint src_stride[3], guint width,
+    guint height, GstVideoColorMatrix matrix);
+
+/* Describes one conversion implementation usable on the running CPU.
+   All of them produce the same output */
+typedef struct
+{
+  const gchar *name;
+  GstVaapiConvertFunc to_NV12;
+} GstVaapiConvertImpl;
+
+/* Returns TRUE if images in @src_format can be converted to
+   @dst_format while being uploaded */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_convert_is_supported (GstVideoFormat dst_format,
+    GstVideoFormat src_format);
+
+/* Converts @width x @height pixels from @src_format to NV12, writing
+   the result straight into @dst, e.g. a mapped VA image. The planes
+   of @src are in the natural order of @src_format. @matrix is only
+   used for RGB sources, and shall be BT.601 or BT.709 */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_convert_to_NV12 (guint8 * const dst[2], const guint dst_stride[2],
+    GstVideoFormat src_format, guint8 * const src[3],
+    const guint src_stride[3], guint width, guint height,
+    GstVideoColorMatrix matrix);
+
+/* Returns the list of formats that can be converted to NV12 */
+G_GNUC_INTERNAL
+const GstVideoFormat *
+gst_vaapi_convert_get_src_formats (guint * n_formats_ptr);
+
+/* Returns the list of implementations supported by the running CPU,
+   the fastest one last. gst_vaapi_convert_to_NV12() uses that one */
+G_GNUC_INTERNAL
+const GstVaapiConvertImpl *
+gst_vaapi_convert_get_impls (guint * n_impls_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_UTILS_CONVERT_H */
@@ -0,0 +1,393 @@
+/*
+ *  gstvaapiutils_copy.c - Copy helpers for VA image mappings
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* VA images are generally mapped as uncached, write-combined (WC or
+   USWC) memory. Regular loads from such memory are not cached and
+   fetch a few bytes at a time, and regular stores pollute the caches
+   with data that is not read back. Streaming loads (movntdqa) fetch
+   whole cache lines into a dedicated buffer instead, and non-temporal
+   stores (movntdq) fill the write-combining buffers directly.
+
+   A single thread cannot saturate the memory bandwidth for large
+   frames. So, large planes are split into row bands, copied in
+   parallel by a process-wide worker pool */
+
+#include "sysdeps.h"
+#include <stdlib.h>
+#include <string.h>
+#include "gstvaapiutils_copy.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+# define USE_SSE2 1
+# include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define USE_SSE4_1 1
+# include <smmintrin.h>
+#endif
+
+/* Lines shorter than that are copied with memcpy() */
+#define MIN_SIMD_WIDTH 64
+
+/* Planes smaller than that, in bytes, are copied by the calling
+   thread only */
+#define MIN_THREADED_SIZE (4 * 1024 * 1024)
+
+/* Bands smaller than that, in bytes, are not worth a thread wakeup */
+#define MIN_BAND_SIZE (1024 * 1024)
+
+/* The memory bandwidth is generally saturated with that many threads */
+#define DEFAULT_MAX_THREADS 4
+#define MAX_THREADS 16
+
+/* Number of bytes to skip until @p is 16-byte aligned */
+#define ALIGN_OFFSET_16(p) \
+  ((16 - ((guintptr) (p) & 15)) & 15)
+
+static void
+copy_plane_c (guint8 * dst, guint dst_stride, const guint8 * src,
+    guint src_stride, guint width, guint height)
+{
+  guint i;
+
+  for (i = 0; i < height; i++) {
+    memcpy (dst, src, width);
+    dst += dst_stride;
+    src += src_stride;
+  }
+}
+
+#if USE_SSE2
+/* Stores need a 16-byte aligned destination: the unaligned head and
+   the tail of each line are copied with memcpy() */
+static void
+copy_plane_upload_sse2 (guint8 * dst, guint dst_stride, const guint8 * src,
+    guint src_stride, guint width, guint height)
+{
+  guint i, x, head;
+
+  for (i = 0; i < height; i++, dst += dst_stride, src += src_stride) {
+    head = ALIGN_OFFSET_16 (dst);
+    if (width < head + MIN_SIMD_WIDTH) {
+      memcpy (dst, src, width);
+      continue;
+    }
+    memcpy (dst, src, head);
+
+    for (x = head; x + 64 <= width; x += 64) {
+      const __m128i v0 = _mm_loadu_si128 ((const __m128i *) (src + x));
+      const __m128i v1 = _mm_loadu_si128 ((const __m128i *) (src + x + 16));
+      const __m128i v2 = _mm_loadu_si128 ((const __m128i *) (src + x + 32));
+      const __m128i v3 = _mm_loadu_si128 ((const __m128i *) (src + x + 48));
+      _mm_stream_si128 ((__m128i *) (dst + x), v0);
+      _mm_stream_si128 ((__m128i *) (dst + x + 16), v1);
+      _mm_stream_si128 ((__m128i *) (dst + x + 32), v2);
+      _mm_stream_si128 ((__m128i *) (dst + x + 48), v3);
+    }
+    for (; x + 16 <= width; x += 16)
+      _mm_stream_si128 ((__m128i *) (dst + x),
+          _mm_loadu_si128 ((const __m128i *) (src + x)));
+    memcpy (dst + x, src + x, width - x);
+  }
+
+  /* Make the stores visible to the GPU, or any other thread */
+  _mm_sfence ();
+}
+#endif
+
+#if USE_SSE4_1
+/* Streaming loads need a 16-byte aligned source: the unaligned head
+   and the tail of each line are copied with memcpy() */
+__attribute__ ((target ("sse4.1")))
+static void
+copy_plane_download_sse4_1 (guint8 * dst, guint dst_stride,
+    const guint8 * src, guint src_stride, guint width, guint height)
+{
+  guint i, x, head;
+
+  /* Order the streaming loads after prior writes to the source */
+  _mm_mfence ();
+
+  for (i = 0; i < height; i++, dst += dst_stride, src += src_stride) {
+    head = ALIGN_OFFSET_16 (src);
+    if (width < head + MIN_SIMD_WIDTH) {
+      memcpy (dst, src, width);
+      continue;
+    }
+    memcpy (dst, src, head);
+
+    for (x = head; x + 64 <= width; x += 64) {
+      const __m128i v0 = _mm_stream_load_si128 ((__m128i *) (src + x));
+      const __m128i v1 = _mm_stream_load_si128 ((__m128i *) (src + x + 16));
+      const __m128i v2 = _mm_stream_load_si128 ((__m128i *) (src + x + 32));
+      const __m128i v3 = _mm_stream_load_si128 ((__m128i *) (src + x + 48));
+      _mm_storeu_si128 ((__m128i *) (dst + x), v0);
+      _mm_storeu_si128 ((__m128i *) (dst + x + 16), v1);
+      _mm_storeu_si128 ((__m128i *) (dst + x + 32), v2);
+      _mm_storeu_si128 ((__m128i *) (dst + x + 48), v3);
+    }
+    for (; x + 16 <= width; x += 16)
+      _mm_storeu_si128 ((__m128i *) (dst + x),
+          _mm_stream_load_si128 ((__m128i *) (src + x)));
+    memcpy (dst + x, src + x, width - x);
+  }
+}
+#endif
+
+static GstVaapiCopyPlaneImpl g_impls[3];
+static guint g_num_impls;
+
+static void
+init_impls (void)
+{
+  static gsize g_once = 0;
+  GstVaapiCopyPlaneFunc upload = copy_plane_c;
+
+  if (!g_once_init_enter (&g_once))
+    return;
+
+  g_impls[g_num_impls].name = "c";
+  g_impls[g_num_impls].download = copy_plane_c;
+  g_impls[g_num_impls++].upload = copy_plane_c;
+#if USE_SSE2
+  upload = copy_plane_upload_sse2;
+  g_impls[g_num_impls].name = "sse2";
+  g_impls[g_num_impls].download = copy_plane_c;
+  g_impls[g_num_impls++].upload = upload;
+#endif
+#if USE_SSE4_1
+  if (__builtin_cpu_supports ("sse4.1")) {
+    g_impls[g_num_impls].name = "sse4.1";
+    g_impls[g_num_impls].download = copy_plane_download_sse4_1;
+    g_impls[g_num_impls++].upload = upload;
+  }
+#endif
+  g_once_init_leave (&g_once, 1);
+}
+
+const GstVaapiCopyPlaneImpl *
+gst_vaapi_copy_plane_get_impls (guint * n_impls_ptr)
+{
+  init_impls ();
+  if (n_impls_ptr)
+    *n_impls_ptr = g_num_impls;
+  return g_impls;
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- Threaded copies                                                  --- */
+/* ------------------------------------------------------------------------ */
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  guint pending;
+} CopyJob;
+
+typedef struct
+{
+  CopyJob *job;
+  GstVaapiCopyPlaneFunc func;
+  guint8 *dst;
+  guint dst_stride;
+  const guint8 *src;
+  guint src_stride;
+  guint width;
+  guint height;
+} CopyBand;
+
+static GMutex g_copy_lock;
+static GThreadPool *g_copy_pool;
+static guint g_copy_threads;
+
+static void
+copy_band_run (CopyBand * band)
+{
+  band->func (band->dst, band->dst_stride, band->src, band->src_stride,
+      band->width, band->height);
+}
+
+static void
+copy_pool_func (gpointer data, gpointer user_data)
+{
+  CopyBand *const band = data;
+  CopyJob *const job = band->job;
+
+  copy_band_run (band);
+
+  g_mutex_lock (&job->lock);
+  if (--job->pending == 0)
+    g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+}
+
+/* Must be called with g_copy_lock held */
+static void
+init_copy_threads_unlocked (void)
+{
+  const gchar *env;
+  guint num_threads = 1;
+
+  if (g_copy_threads > 0)
+    return;
+
+  env = g_getenv ("GST_VAAPI_COPY_THREADS");
+  if (env)
+    num_threads = strtoul (env, NULL, 10);
+  else {
+#if GLIB_CHECK_VERSION(2,36,0)
+    num_threads = MIN (g_get_num_processors (), DEFAULT_MAX_THREADS);
+#endif
+  }
+  g_copy_threads = CLAMP (num_threads, 1, MAX_THREADS);
+}
+
+/* Returns the worker pool, or NULL if copies are single-threaded */
+static GThreadPool *
+get_copy_pool (guint * num_threads_ptr)
+{
+  GThreadPool *pool = NULL;
+  GError *error = NULL;
+
+  g_mutex_lock (&g_copy_lock);
+  init_copy_threads_unlocked ();
+  if (g_copy_threads > 1 && !g_copy_pool) {
+    /* The calling thread copies one band itself */
+    g_copy_pool = g_thread_pool_new (copy_pool_func, NULL,
+        g_copy_threads - 1, TRUE, &error);
+    if (!g_copy_pool) {
+      GST_WARNING ("failed to create copy threads: %s", error->message);
+      g_error_free (error);
+      g_copy_threads = 1;
+    }
+  }
+  if (g_copy_threads > 1) {
+    pool = g_copy_pool;
+    *num_threads_ptr = g_copy_threads;
+  }
+  g_mutex_unlock (&g_copy_lock);
+  return pool;
+}
+
+static void
+copy_plane (GstVaapiCopyPlaneFunc func, guint8 * dst, guint dst_stride,
+    const guint8 * src, guint src_stride, guint width, guint height)
+{
+  const gsize size = (gsize) width * height;
+  CopyBand bands[MAX_THREADS];
+  CopyJob job;
+  GThreadPool *pool;
+  guint i, y, num_bands, band_height;
+
+  if (size < MIN_THREADED_SIZE || !(pool = get_copy_pool (&num_bands))) {
+    func (dst, dst_stride, src, src_stride, width, height);
+    return;
+  }
+
+  num_bands = MIN (num_bands, size / MIN_BAND_SIZE);
+  band_height = (height + num_bands - 1) / num_bands;
+  for (i = 0, y = 0; y < height; i++, y += band_height) {
+    CopyBand *const band = &bands[i];
+
+    band->job = &job;
+    band->func = func;
+    band->dst = dst + (gsize) y * dst_stride;
+    band->dst_stride = dst_stride;
+    band->src = src + (gsize) y * src_stride;
+    band->src_stride = src_stride;
+    band->width = width;
+    band->height = MIN (band_height, height - y);
+  }
+  num_bands = i;
+
+  g_mutex_init (&job.lock);
+  g_cond_init (&job.cond);
+  job.pending = num_bands - 1;
+
+  for (i = 1; i < num_bands; i++)
+    g_thread_pool_push (pool, &bands[i], NULL);
+  copy_band_run (&bands[0]);
+
+  g_mutex_lock (&job.lock);
+  while (job.pending > 0)
+    g_cond_wait (&job.cond, &job.lock);
+  g_mutex_unlock (&job.lock);
+
+  g_mutex_clear (&job.lock);
+  g_cond_clear (&job.cond);
+}
+
+void
+gst_vaapi_copy_set_max_threads (guint num_threads)
+{
+  g_mutex_lock (&g_copy_lock);
+  g_copy_threads = CLAMP (num_threads, 1, MAX_THREADS);
+
+  /* Copies in progress may still queue bands: keep at least one
+     worker thread around */
+  if (g_copy_pool)
+    g_thread_pool_set_max_threads (g_copy_pool,
+        MAX (g_copy_threads - 1, 1), NULL);
+  g_mutex_unlock (&g_copy_lock);
+}
+
+guint
+gst_vaapi_copy_get_max_threads (void)
+{
+  guint num_threads;
+
+  g_mutex_lock (&g_copy_lock);
+  init_copy_threads_unlocked ();
+  num_threads = g_copy_threads;
+  g_mutex_unlock (&g_copy_lock);
+  return num_threads;
+}
+
+void
+gst_vaapi_copy_plane_download (guint8 * dst, guint dst_stride,
+    const guint8 * src, guint src_stride, guint width, guint height)
+{
+  static GstVaapiCopyPlaneFunc g_func;
+
+  if (G_UNLIKELY (!g_func)) {
+    init_impls ();
+    g_func = g_impls[g_num_impls - 1].download;
+  }
+  copy_plane (g_func, dst, dst_stride, src, src_stride, width, height);
+}
+
+void
+gst_vaapi_copy_plane_upload (guint8 * dst, guint dst_stride,
+    const guint8 * src, guint src_stride, guint width, guint height)
+{
+  static GstVaapiCopyPlaneFunc g_func;
+
+  if (G_UNLIKELY (!g_func)) {
+    init_impls ();
+    g_func = g_impls[g_num_impls - 1].upload;
+  }
+  copy_plane (g_func, dst, dst_stride, src, src_stride, width, height);
+}
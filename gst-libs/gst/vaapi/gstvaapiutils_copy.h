@@ -0,0 +1,77 @@
+/*
+ *  gstvaapiutils_copy.h - Copy helpers for VA image mappings
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_UTILS_COPY_H
+#define GST_VAAPI_UTILS_COPY_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef void (*GstVaapiCopyPlaneFunc) (guint8 * dst, guint dst_stride,
+    const guint8 * src, guint src_stride, guint width, guint height);
+
+/**
+ * GstVaapiCopyPlaneImpl:
+ * @name: the implementation name, e.g. "sse4.1"
+ * @download: the function copying from uncached (write-combined)
+ *   memory, e.g. a mapped VA image
+ * @upload: the function copying to uncached (write-combined) memory
+ *
+ * Describes one set of plane copy functions usable on the running
+ * CPU.
+ */
+typedef struct
+{
+  const gchar *name;
+  GstVaapiCopyPlaneFunc download;
+  GstVaapiCopyPlaneFunc upload;
+} GstVaapiCopyPlaneImpl;
+
+/* Copies @height lines of @width bytes from a mapped VA image, or any
+   other uncached memory, into regular memory. Large planes are copied
+   by several threads */
+void
+gst_vaapi_copy_plane_download (guint8 * dst, guint dst_stride,
+    const guint8 * src, guint src_stride, guint width, guint height);
+
+/* Copies @height lines of @width bytes into a mapped VA image, or any
+   other memory that is not read back soon */
+void
+gst_vaapi_copy_plane_upload (guint8 * dst, guint dst_stride,
+    const guint8 * src, guint src_stride, guint width, guint height);
+
+/* Sets the number of threads, including the calling one, that copy
+   large planes. The default is the number of processors, up to 4, or
+   the value of the GST_VAAPI_COPY_THREADS environment variable. The
+   worker threads are shared by all elements of the process */
+void
+gst_vaapi_copy_set_max_threads (guint num_threads);
+
+guint
+gst_vaapi_copy_get_max_threads (void);
+
+/* Returns the list of implementations supported by the running CPU,
+   the fastest one last */
+const GstVaapiCopyPlaneImpl *
+gst_vaapi_copy_plane_get_impls (guint * n_impls_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_UTILS_COPY_H */
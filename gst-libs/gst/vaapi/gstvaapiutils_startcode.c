@@ -0,0 +1,356 @@
+/*
+ *  gstvaapiutils_startcode.c - Start code scanning and NAL unit splitting
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include "gstvaapiutils_startcode.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+# define USE_SSE2 1
+# include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define USE_AVX2 1
+# include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+# define USE_NEON 1
+# include <arm_neon.h>
+#endif
+
+/* Scalar search starting at @ofs. Positions are skipped by up to three
+   bytes at a time depending on the value of the third byte */
+static inline gint
+find_start_code_from (const guint8 * data, guint ofs, guint size)
+{
+  guint i = ofs;
+
+  while (i + 4 <= size) {
+    if (data[i + 2] > 1)
+      i += 3;
+    else if (data[i + 1])
+      i += 2;
+    else if (data[i] || data[i + 2] != 1)
+      i++;
+    else
+      return i;
+  }
+  return -1;
+}
+
+static gint
+find_start_code_c (const guint8 * data, guint size)
+{
+  return find_start_code_from (data, 0, size);
+}
+
+#if USE_SSE2
+/* Each iteration checks 16 candidate positions. Loads read 18 bytes and
+   a start code at the last candidate needs 4 bytes, hence the bound */
+static gint
+find_start_code_sse2 (const guint8 * data, guint size)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i one = _mm_set1_epi8 (1);
+  guint i = 0;
+
+  for (; i + 19 <= size; i += 16) {
+    const __m128i v0 = _mm_loadu_si128 ((const __m128i *) (data + i));
+    const __m128i v1 = _mm_loadu_si128 ((const __m128i *) (data + i + 1));
+    const __m128i v2 = _mm_loadu_si128 ((const __m128i *) (data + i + 2));
+    const guint mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_and_si128 (
+                _mm_cmpeq_epi8 (v0, zero), _mm_cmpeq_epi8 (v1, zero)),
+            _mm_cmpeq_epi8 (v2, one)));
+
+    if (mask)
+      return i + __builtin_ctz (mask);
+  }
+  return find_start_code_from (data, i, size);
+}
+#endif
+
+#if USE_AVX2
+__attribute__ ((target ("avx2")))
+static gint
+find_start_code_avx2 (const guint8 * data, guint size)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i one = _mm256_set1_epi8 (1);
+  guint i = 0;
+
+  for (; i + 35 <= size; i += 32) {
+    const __m256i v0 = _mm256_loadu_si256 ((const __m256i *) (data + i));
+    const __m256i v1 = _mm256_loadu_si256 ((const __m256i *) (data + i + 1));
+    const __m256i v2 = _mm256_loadu_si256 ((const __m256i *) (data + i + 2));
+    const guint mask = _mm256_movemask_epi8 (_mm256_and_si256 (
+            _mm256_and_si256 (_mm256_cmpeq_epi8 (v0, zero),
+                _mm256_cmpeq_epi8 (v1, zero)), _mm256_cmpeq_epi8 (v2, one)));
+
+    if (mask)
+      return i + __builtin_ctz (mask);
+  }
+  return find_start_code_from (data, i, size);
+}
+#endif
+
+#if USE_NEON
+/* NEON has no movemask equivalent: detect a match in the block, then
+   let the scalar code locate it */
+static gint
+find_start_code_neon (const guint8 * data, guint size)
+{
+  const uint8x16_t zero = vdupq_n_u8 (0);
+  const uint8x16_t one = vdupq_n_u8 (1);
+  guint i = 0;
+
+  for (; i + 19 <= size; i += 16) {
+    const uint8x16_t v0 = vld1q_u8 (data + i);
+    const uint8x16_t v1 = vld1q_u8 (data + i + 1);
+    const uint8x16_t v2 = vld1q_u8 (data + i + 2);
+    const uint8x16_t m = vandq_u8 (vandq_u8 (vceqq_u8 (v0, zero),
+            vceqq_u8 (v1, zero)), vceqq_u8 (v2, one));
+#if defined(__aarch64__)
+    const gboolean found = vmaxvq_u8 (m) != 0;
+#else
+    const uint64x2_t m64 = vreinterpretq_u64_u8 (m);
+    const gboolean found =
+        (vgetq_lane_u64 (m64, 0) | vgetq_lane_u64 (m64, 1)) != 0;
+#endif
+
+    if (found)
+      return find_start_code_from (data, i, i + 19);
+  }
+  return find_start_code_from (data, i, size);
+}
+#endif
+
+static GstVaapiFindStartCodeImpl g_impls[4];
+static guint g_num_impls;
+
+static void
+init_impls (void)
+{
+  static gsize g_once = 0;
+
+  if (!g_once_init_enter (&g_once))
+    return;
+
+  g_impls[g_num_impls].name = "c";
+  g_impls[g_num_impls++].func = find_start_code_c;
+#if USE_NEON
+  g_impls[g_num_impls].name = "neon";
+  g_impls[g_num_impls++].func = find_start_code_neon;
+#endif
+#if USE_SSE2
+  g_impls[g_num_impls].name = "sse2";
+  g_impls[g_num_impls++].func = find_start_code_sse2;
+#endif
+#if USE_AVX2
+  if (__builtin_cpu_supports ("avx2")) {
+    g_impls[g_num_impls].name = "avx2";
+    g_impls[g_num_impls++].func = find_start_code_avx2;
+  }
+#endif
+  g_once_init_leave (&g_once, 1);
+}
+
+const GstVaapiFindStartCodeImpl *
+gst_vaapi_find_start_code_get_impls (guint * n_impls_ptr)
+{
+  init_impls ();
+  if (n_impls_ptr)
+    *n_impls_ptr = g_num_impls;
+  return g_impls;
+}
+
+gint
+gst_vaapi_find_start_code (const guint8 * data, guint size)
+{
+  static GstVaapiFindStartCodeFunc g_func;
+
+  if (G_UNLIKELY (!g_func)) {
+    init_impls ();
+    g_func = g_impls[g_num_impls - 1].func;
+  }
+  return g_func (data, size);
+}
+
+gint
+gst_vaapi_adapter_scan_for_start_code (GstAdapter * adapter, guint ofs,
+    guint size, guint32 * scp)
+{
+  const guint8 *data;
+  guint avail, len;
+  gint pos;
+
+  /* Only the head buffer can be mapped without a copy. Scan it in place
+     and leave the remaining bytes to the adapter scanner */
+  avail = gst_adapter_available_fast (adapter);
+  if (ofs + 4 <= avail) {
+    len = MIN (size, avail - ofs);
+    data = gst_adapter_map (adapter, ofs + len);
+    if (!data)
+      return -1;
+
+    pos = gst_vaapi_find_start_code (data + ofs, len);
+    if (pos >= 0) {
+      pos += ofs;
+      if (scp)
+        *scp = GST_READ_UINT32_BE (data + pos);
+    }
+    gst_adapter_unmap (adapter);
+    if (pos >= 0 || len == size)
+      return pos;
+
+    /* Resume three bytes back to catch start codes straddling the end
+       of the head buffer */
+    ofs += len - 3;
+    size -= len - 3;
+  }
+  return (gint) gst_adapter_masked_scan_uint32_peek (adapter,
+      0xffffff00, 0x00000100, ofs, size, scp);
+}
+
+void
+gst_vaapi_access_unit_splitter_init (GstVaapiAccessUnitSplitter * splitter)
+{
+  memset (splitter, 0, sizeof (*splitter));
+}
+
+void
+gst_vaapi_access_unit_splitter_clear (GstVaapiAccessUnitSplitter * splitter)
+{
+  if (splitter->unit_sizes) {
+    g_array_unref (splitter->unit_sizes);
+    splitter->unit_sizes = NULL;
+  }
+  gst_vaapi_access_unit_splitter_reset (splitter);
+}
+
+void
+gst_vaapi_access_unit_splitter_reset (GstVaapiAccessUnitSplitter * splitter)
+{
+  if (splitter->unit_sizes)
+    g_array_set_size (splitter->unit_sizes, 0);
+  splitter->unit_index = 0;
+  splitter->remaining = 0;
+  splitter->tail = 0;
+}
+
+static inline void
+append_unit (GstVaapiAccessUnitSplitter * splitter, guint size)
+{
+  g_array_append_val (splitter->unit_sizes, size);
+  splitter->remaining += size;
+}
+
+/* Records the NAL units delimited by start codes, the first one being
+   at the start of @data */
+static void
+split_start_code_units (GstVaapiAccessUnitSplitter * splitter,
+    const guint8 * data, guint size)
+{
+  guint start = 0, end;
+  gint ofs;
+
+  while (start < size) {
+    ofs = size - start < 8 ? -1 :
+        gst_vaapi_find_start_code (data + start + 4, size - start - 4);
+    end = ofs < 0 ? size : start + 4 + ofs;
+    append_unit (splitter, end - start);
+    start = end;
+  }
+}
+
+/* Records the NAL units with a @nal_length_size bytes length prefix.
+   Any truncated unit is left in the tail */
+static void
+split_length_prefixed_units (GstVaapiAccessUnitSplitter * splitter,
+    const guint8 * data, guint size, guint nal_length_size)
+{
+  guint i, start = 0, unit_size;
+
+  while (start + nal_length_size <= size) {
+    unit_size = 0;
+    for (i = 0; i < nal_length_size; i++)
+      unit_size = (unit_size << 8) | data[start + i];
+    unit_size += nal_length_size;
+    if (unit_size > size - start)
+      break;
+    append_unit (splitter, unit_size);
+    start += unit_size;
+  }
+  splitter->tail = size - start;
+}
+
+gboolean
+gst_vaapi_access_unit_splitter_next (GstVaapiAccessUnitSplitter * splitter,
+    GstAdapter * adapter, guint nal_length_size, guint * size_ptr,
+    gboolean * at_au_end_ptr)
+{
+  const guint8 *data;
+  guint size, unit_size;
+  gint ofs;
+
+  size = gst_adapter_available_fast (adapter);
+  if (size == 0)
+    return FALSE;
+
+  /* Split the next access unit once the recorded one was consumed */
+  if (size != splitter->remaining + splitter->tail) {
+    gst_vaapi_access_unit_splitter_reset (splitter);
+    if (!splitter->unit_sizes)
+      splitter->unit_sizes = g_array_sized_new (FALSE, FALSE,
+          sizeof (guint), 16);
+
+    data = gst_adapter_map (adapter, size);
+    if (!data)
+      return FALSE;
+
+    ofs = 0;
+    if (nal_length_size > 0)
+      split_length_prefixed_units (splitter, data, size, nal_length_size);
+    else {
+      ofs = gst_vaapi_find_start_code (data, size);
+      if (ofs >= 0)
+        split_start_code_units (splitter, data + ofs, size - ofs);
+    }
+    gst_adapter_unmap (adapter);
+
+    if (ofs < 0)
+      return FALSE;
+    if (ofs > 0)
+      gst_adapter_flush (adapter, ofs);
+  }
+
+  if (splitter->unit_index >= splitter->unit_sizes->len)
+    return FALSE;
+
+  unit_size = g_array_index (splitter->unit_sizes, guint,
+      splitter->unit_index++);
+  splitter->remaining -= unit_size;
+
+  *size_ptr = unit_size;
+  *at_au_end_ptr = splitter->remaining == 0 && splitter->tail == 0;
+  return TRUE;
+}
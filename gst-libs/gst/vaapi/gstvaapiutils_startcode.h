@@ -0,0 +1,108 @@
+/*
+ *  gstvaapiutils_startcode.h - Start code scanning and NAL unit splitting
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_UTILS_STARTCODE_H
+#define GST_VAAPI_UTILS_STARTCODE_H
+
+#include <glib.h>
+#include <gst/base/gstadapter.h>
+
+G_BEGIN_DECLS
+
+typedef gint (*GstVaapiFindStartCodeFunc) (const guint8 * data, guint size);
+
+/**
+ * GstVaapiFindStartCodeImpl:
+ * @name: the implementation name, e.g. "sse2"
+ * @func: the start code search function
+ *
+ * Describes one start code search implementation usable on the
+ * running CPU.
+ */
+typedef struct
+{
+  const gchar *name;
+  GstVaapiFindStartCodeFunc func;
+} GstVaapiFindStartCodeImpl;
+
+/* Returns the offset of the first 00 00 01 xx sequence fully contained
+   in @data, or -1 if none was found */
+G_GNUC_INTERNAL
+gint
+gst_vaapi_find_start_code (const guint8 * data, guint size);
+
+/* Returns the list of implementations supported by the running CPU,
+   the fastest one last */
+G_GNUC_INTERNAL
+const GstVaapiFindStartCodeImpl *
+gst_vaapi_find_start_code_get_impls (guint * n_impls_ptr);
+
+/* Drop-in replacement for gst_adapter_masked_scan_uint32_peek() with a
+   0xffffff00/0x00000100 pattern. Bytes held by the head buffer are
+   scanned in place */
+G_GNUC_INTERNAL
+gint
+gst_vaapi_adapter_scan_for_start_code (GstAdapter * adapter, guint ofs,
+    guint size, guint32 * scp);
+
+/**
+ * GstVaapiAccessUnitSplitter:
+ *
+ * Records the NAL unit boundaries of an access unit held in the head
+ * buffer of an adapter, so that it is split in one pass instead of
+ * searching for the end of each NAL unit in turn.
+ *
+ * The recorded boundaries stay valid as long as the adapter is only
+ * flushed by the unit sizes returned. The splitter shall be reset
+ * whenever the adapter contents are discarded, e.g. on decoder flush.
+ */
+typedef struct
+{
+  /*< private > */
+  GArray *unit_sizes;
+  guint unit_index;
+  guint remaining;
+  guint tail;
+} GstVaapiAccessUnitSplitter;
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_access_unit_splitter_init (GstVaapiAccessUnitSplitter * splitter);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_access_unit_splitter_clear (GstVaapiAccessUnitSplitter * splitter);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_access_unit_splitter_reset (GstVaapiAccessUnitSplitter * splitter);
+
+/* Returns the size of the next NAL unit, including its start code or
+   @nal_length_size bytes length prefix, of the access unit held in the
+   adapter head buffer. Start codes delimit NAL units if
+   @nal_length_size is zero */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_access_unit_splitter_next (GstVaapiAccessUnitSplitter * splitter,
+    GstAdapter * adapter, guint nal_length_size, guint * size_ptr,
+    gboolean * at_au_end_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_UTILS_STARTCODE_H */
@@ -55,30 +55,118 @@ gst_vaapi_video_pool_alloc_object (GstVaapiVideoPool * pool)
   return GST_VAAPI_VIDEO_POOL_GET_CLASS (pool)->alloc_object (pool);
 }
 
+typedef struct
+{
+  gpointer object;
+  gboolean used;
+} GstVaapiVideoPoolSlot;
+
+#define GET_SLOT(pool, index) \
+  (&g_array_index ((pool)->slots, GstVaapiVideoPoolSlot, (index)))
+
 void
 gst_vaapi_video_pool_init (GstVaapiVideoPool * pool, GstVaapiDisplay * display,
     GstVaapiVideoPoolObjectType object_type)
 {
   pool->object_type = object_type;
   pool->display = gst_vaapi_display_ref (display);
-  pool->used_objects = NULL;
+  pool->slots = g_array_new (FALSE, FALSE, sizeof (GstVaapiVideoPoolSlot));
+  pool->slot_map = g_hash_table_new (g_direct_hash, g_direct_equal);
+  pool->free_slots = NULL;
+  pool->free_slots_size = 0;
+  pool->free_slots_head = 0;
+  pool->free_count = 0;
   pool->used_count = 0;
   pool->capacity = 0;
+  pool->peak_used_count = 0;
+  pool->num_grown = 0;
+  pool->num_exhausted = 0;
 
-  g_queue_init (&pool->free_objects);
   g_mutex_init (&pool->mutex);
 }
 
 void
 gst_vaapi_video_pool_finalize (GstVaapiVideoPool * pool)
 {
-  g_list_free_full (pool->used_objects, gst_vaapi_object_unref);
-  g_queue_foreach (&pool->free_objects, (GFunc) gst_vaapi_object_unref, NULL);
-  g_queue_clear (&pool->free_objects);
+  guint i;
+
+  for (i = 0; i < pool->slots->len; i++)
+    gst_vaapi_object_unref (GET_SLOT (pool, i)->object);
+  g_array_unref (pool->slots);
+  g_hash_table_unref (pool->slot_map);
+  g_free (pool->free_slots);
   gst_vaapi_display_replace (&pool->display, NULL);
   g_mutex_clear (&pool->mutex);
 }
 
+/* Appends @index to the ring of free slots. The ring is always large
+   enough to hold all slots */
+static inline void
+free_slots_push (GstVaapiVideoPool * pool, guint index)
+{
+  guint pos = pool->free_slots_head + pool->free_count;
+
+  if (pos >= pool->free_slots_size)
+    pos -= pool->free_slots_size;
+  pool->free_slots[pos] = index;
+  pool->free_count++;
+}
+
+static inline guint
+free_slots_pop (GstVaapiVideoPool * pool)
+{
+  const guint index = pool->free_slots[pool->free_slots_head];
+
+  if (++pool->free_slots_head == pool->free_slots_size)
+    pool->free_slots_head = 0;
+  pool->free_count--;
+  return index;
+}
+
+/* Grows the ring of free slots, preserving the order of its elements */
+static void
+free_slots_ensure_size (GstVaapiVideoPool * pool, guint size)
+{
+  guint *free_slots, new_size, i, pos;
+
+  if (size <= pool->free_slots_size)
+    return;
+
+  new_size = MAX (pool->free_slots_size * 2, 16);
+  while (new_size < size)
+    new_size *= 2;
+
+  free_slots = g_new (guint, new_size);
+  for (i = 0, pos = pool->free_slots_head; i < pool->free_count; i++) {
+    free_slots[i] = pool->free_slots[pos];
+    if (++pos == pool->free_slots_size)
+      pos = 0;
+  }
+  g_free (pool->free_slots);
+  pool->free_slots = free_slots;
+  pool->free_slots_size = new_size;
+  pool->free_slots_head = 0;
+}
+
+/* Registers @object into a new slot, transferring ownership of one
+   reference to the pool. Returns the slot index */
+static guint
+add_slot_unlocked (GstVaapiVideoPool * pool, gpointer object, gboolean used)
+{
+  GstVaapiVideoPoolSlot slot;
+  const guint index = pool->slots->len;
+
+  free_slots_ensure_size (pool, index + 1);
+
+  slot.object = object;
+  slot.used = used;
+  g_array_append_val (pool->slots, slot);
+  g_hash_table_insert (pool->slot_map, object, GUINT_TO_POINTER (index + 1));
+  if (!used)
+    free_slots_push (pool, index);
+  return index;
+}
+
 /**
  * gst_vaapi_video_pool_ref:
  * @pool: a #GstVaapiVideoPool
@@ -170,22 +258,30 @@ gst_vaapi_video_pool_get_object_type (GstVaapiVideoPool * pool)
 static gpointer
 gst_vaapi_video_pool_get_object_unlocked (GstVaapiVideoPool * pool)
 {
+  GstVaapiVideoPoolSlot *slot;
   gpointer object;
 
-  if (pool->capacity && pool->used_count >= pool->capacity)
+  if (pool->capacity && pool->used_count >= pool->capacity) {
+    pool->num_exhausted++;
     return NULL;
+  }
 
-  object = g_queue_pop_head (&pool->free_objects);
-  if (!object) {
+  if (pool->free_count > 0) {
+    slot = GET_SLOT (pool, free_slots_pop (pool));
+    slot->used = TRUE;
+    object = slot->object;
+  } else {
     g_mutex_unlock (&pool->mutex);
     object = gst_vaapi_video_pool_alloc_object (pool);
     g_mutex_lock (&pool->mutex);
     if (!object)
       return NULL;
+    add_slot_unlocked (pool, object, TRUE);
+    pool->num_grown++;
   }
 
-  ++pool->used_count;
-  pool->used_objects = g_list_prepend (pool->used_objects, object);
+  if (++pool->used_count > pool->peak_used_count)
+    pool->peak_used_count = pool->used_count;
   return gst_vaapi_object_ref (object);
 }
 
@@ -216,16 +312,21 @@ static void
 gst_vaapi_video_pool_put_object_unlocked (GstVaapiVideoPool * pool,
     gpointer object)
 {
-  GList *elem;
+  GstVaapiVideoPoolSlot *slot;
+  guint index;
 
-  elem = g_list_find (pool->used_objects, object);
-  if (!elem)
+  index = GPOINTER_TO_UINT (g_hash_table_lookup (pool->slot_map, object));
+  if (!index--)
+    return;
+
+  slot = GET_SLOT (pool, index);
+  if (!slot->used)
     return;
 
   gst_vaapi_object_unref (object);
+  slot->used = FALSE;
   --pool->used_count;
-  pool->used_objects = g_list_delete_link (pool->used_objects, elem);
-  g_queue_push_tail (&pool->free_objects, object);
+  free_slots_push (pool, index);
 }
 
 void
@@ -254,7 +355,10 @@ static inline gboolean
 gst_vaapi_video_pool_add_object_unlocked (GstVaapiVideoPool * pool,
     gpointer object)
 {
-  g_queue_push_tail (&pool->free_objects, gst_vaapi_object_ref (object));
+  if (g_hash_table_contains (pool->slot_map, object))
+    return TRUE;
+
+  add_slot_unlocked (pool, gst_vaapi_object_ref (object), FALSE);
   return TRUE;
 }
 
@@ -326,7 +430,7 @@ gst_vaapi_video_pool_get_size (GstVaapiVideoPool * pool)
   g_return_val_if_fail (pool != NULL, 0);
 
   g_mutex_lock (&pool->mutex);
-  size = g_queue_get_length (&pool->free_objects);
+  size = pool->free_count;
   g_mutex_unlock (&pool->mutex);
   return size;
 }
@@ -348,11 +452,11 @@ gst_vaapi_video_pool_reserve_unlocked (GstVaapiVideoPool * pool, guint n)
 {
   guint i, num_allocated;
 
-  num_allocated = gst_vaapi_video_pool_get_size (pool) + pool->used_count;
-  if (n < num_allocated)
+  num_allocated = pool->slots->len;
+  if (n <= num_allocated)
     return TRUE;
 
-  if ((n -= num_allocated) > pool->capacity)
+  if (pool->capacity && n > pool->capacity)
     n = pool->capacity;
 
   for (i = num_allocated; i < n; i++) {
@@ -363,7 +467,7 @@ gst_vaapi_video_pool_reserve_unlocked (GstVaapiVideoPool * pool, guint n)
     g_mutex_lock (&pool->mutex);
     if (!object)
       return FALSE;
-    g_queue_push_tail (&pool->free_objects, object);
+    add_slot_unlocked (pool, object, FALSE);
   }
   return TRUE;
 }
@@ -420,3 +524,26 @@ gst_vaapi_video_pool_set_capacity (GstVaapiVideoPool * pool, guint capacity)
   pool->capacity = capacity;
   g_mutex_unlock (&pool->mutex);
 }
+
+/**
+ * gst_vaapi_video_pool_get_stats:
+ * @pool: a #GstVaapiVideoPool
+ * @stats: return location for the #GstVaapiVideoPoolStats
+ *
+ * Fills @stats with a snapshot of the @pool usage statistics.
+ */
+void
+gst_vaapi_video_pool_get_stats (GstVaapiVideoPool * pool,
+    GstVaapiVideoPoolStats * stats)
+{
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&pool->mutex);
+  stats->num_used = pool->used_count;
+  stats->num_objects = pool->slots->len;
+  stats->peak_used = pool->peak_used_count;
+  stats->num_grown = pool->num_grown;
+  stats->num_exhausted = pool->num_exhausted;
+  g_mutex_unlock (&pool->mutex);
+}
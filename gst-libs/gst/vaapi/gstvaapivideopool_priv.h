@@ -35,11 +35,18 @@ G_BEGIN_DECLS
   ((klass) != NULL)
 
 typedef struct _GstVaapiVideoPoolClass GstVaapiVideoPoolClass;
+typedef struct _GstVaapiVideoPoolStats GstVaapiVideoPoolStats;
 
 /**
  * GstVaapiVideoPool:
  *
  * A pool of lazily allocated video objects. e.g. surfaces, images.
+ *
+ * Each object owned by the pool lives in a slot, which is looked up
+ * from the object through @slot_map. Free slots are kept in a ring
+ * buffer of indices, so that objects are recycled in the order they
+ * were released, and both get and put operations run in constant time
+ * with the @mutex held only for a few instructions.
  */
 struct _GstVaapiVideoPool
 {
@@ -48,11 +55,20 @@ struct _GstVaapiVideoPool
 
   guint object_type;
   GstVaapiDisplay *display;
-  GQueue free_objects;
-  GList *used_objects;
+  GArray *slots;
+  GHashTable *slot_map;
+  guint *free_slots;
+  guint free_slots_size;
+  guint free_slots_head;
+  guint free_count;
   guint used_count;
   guint capacity;
   GMutex mutex;
+
+  /* statistics */
+  guint peak_used_count;
+  guint64 num_grown;
+  guint64 num_exhausted;
 };
 
 /**
@@ -70,6 +86,27 @@ struct _GstVaapiVideoPoolClass
   gpointer (*alloc_object) (GstVaapiVideoPool * pool);
 };
 
+/**
+ * GstVaapiVideoPoolStats:
+ * @num_objects: number of objects owned by the pool, free or in use
+ * @num_used: number of objects currently in use
+ * @peak_used: highest number of objects simultaneously in use
+ * @num_grown: number of objects allocated on demand, i.e. when no
+ *   free object was available
+ * @num_exhausted: number of requests that failed because the pool
+ *   reached its capacity
+ *
+ * Snapshot of the video pool usage statistics.
+ */
+struct _GstVaapiVideoPoolStats
+{
+  guint num_objects;
+  guint num_used;
+  guint peak_used;
+  guint64 num_grown;
+  guint64 num_exhausted;
+};
+
 G_GNUC_INTERNAL
 void
 gst_vaapi_video_pool_init (GstVaapiVideoPool * pool, GstVaapiDisplay * display,
@@ -79,6 +116,11 @@ G_GNUC_INTERNAL
 void
 gst_vaapi_video_pool_finalize (GstVaapiVideoPool * pool);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_video_pool_get_stats (GstVaapiVideoPool * pool,
+    GstVaapiVideoPoolStats * stats);
+
 /* Internal aliases */
 
 #define gst_vaapi_video_pool_ref_internal(pool) \
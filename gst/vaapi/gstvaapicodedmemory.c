@@ -0,0 +1,303 @@
+/*
+ *  gstvaapicodedmemory.c - Gstreamer/VA coded buffer memory
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gstcompat.h"
+#include <string.h>
+#include "gstvaapicodedmemory.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapicodedmemory);
+#define GST_CAT_DEFAULT gst_debug_vaapicodedmemory
+
+/* The encoder draws its coded buffers from a pool of 5, and blocks
+   when they are all in use. Leave enough of them for the frames in
+   flight, and copy the coded data once downstream holds that many
+   wrapped segments */
+#define MAX_WRAPPED_MEMORIES 2
+
+/* ------------------------------------------------------------------------ */
+/* --- GstVaapiCodedMemory                                              --- */
+/* ------------------------------------------------------------------------ */
+
+typedef struct
+{
+  GstMemory parent_instance;
+
+  GstVaapiEncoder *encoder;
+  GstVaapiCodedBufferProxy *proxy;
+  guint8 *data;
+} GstVaapiCodedMemory;
+
+#define GST_VAAPI_CODED_MEMORY_CAST(mem) \
+  ((GstVaapiCodedMemory *) (mem))
+
+/* Wraps one segment of the mapped coded buffer. The memory holds its
+   own mapping of the coded buffer, and keeps the proxy alive so that
+   the coded buffer is not recycled by the encoder until then. It is
+   read-only, so that writers get a copy through
+   gst_vaapi_coded_memory_copy() */
+static GstMemory *
+gst_vaapi_coded_memory_new (GstAllocator * base_allocator,
+    GstVaapiEncoder * encoder, GstVaapiCodedBufferProxy * proxy,
+    VACodedBufferSegment * segment)
+{
+  GstVaapiCodedAllocator *const allocator =
+      GST_VAAPI_CODED_ALLOCATOR_CAST (base_allocator);
+  GstVaapiCodedMemory *mem;
+  VACodedBufferSegment *segment_list;
+
+  if (!gst_vaapi_coded_buffer_map (GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (proxy),
+          &segment_list))
+    return NULL;
+
+  mem = g_slice_new (GstVaapiCodedMemory);
+  gst_memory_init (GST_MEMORY_CAST (mem), GST_MEMORY_FLAG_READONLY,
+      base_allocator, NULL, segment->size, 0, 0, segment->size);
+
+  mem->encoder = gst_vaapi_encoder_ref (encoder);
+  mem->proxy = gst_vaapi_coded_buffer_proxy_ref (proxy);
+  mem->data = segment->buf;
+  g_atomic_int_inc (&allocator->num_memories);
+  return GST_MEMORY_CAST (mem);
+}
+
+static void
+gst_vaapi_coded_memory_free (GstVaapiCodedMemory * mem)
+{
+  GstVaapiCodedAllocator *const allocator =
+      GST_VAAPI_CODED_ALLOCATOR_CAST (GST_MEMORY_CAST (mem)->allocator);
+
+  /* Shared memories only hold a reference to their parent */
+  if (mem->proxy) {
+    gst_vaapi_coded_buffer_unmap (GST_VAAPI_CODED_BUFFER_PROXY_BUFFER
+        (mem->proxy));
+    gst_vaapi_coded_buffer_proxy_replace (&mem->proxy, NULL);
+    g_atomic_int_add (&allocator->num_memories, -1);
+  }
+  gst_vaapi_encoder_replace (&mem->encoder, NULL);
+  g_slice_free (GstVaapiCodedMemory, mem);
+}
+
+static gpointer
+gst_vaapi_coded_memory_map (GstVaapiCodedMemory * mem, gsize maxsize,
+    guint flags)
+{
+  /* The VA coded buffer is recycled by the encoder */
+  if (flags & GST_MAP_WRITE) {
+    GST_WARNING ("GstVaapiCodedMemory cannot be mapped for writing");
+    return NULL;
+  }
+  return mem->data;
+}
+
+static void
+gst_vaapi_coded_memory_unmap (GstVaapiCodedMemory * mem)
+{
+}
+
+/* Downstream elements that need to modify the data get a copy into
+   system memory */
+static GstMemory *
+gst_vaapi_coded_memory_copy (GstVaapiCodedMemory * mem,
+    gssize offset, gssize size)
+{
+  GstMemory *const base_mem = GST_MEMORY_CAST (mem);
+  GstMemory *out_mem;
+  GstMapInfo info;
+
+  if (size == -1)
+    size = base_mem->size > offset ? base_mem->size - offset : 0;
+
+  out_mem = gst_allocator_alloc (NULL, size, NULL);
+  if (!out_mem)
+    goto error_allocate_memory;
+
+  if (!gst_memory_map (out_mem, &info, GST_MAP_WRITE))
+    goto error_map_memory;
+  memcpy (info.data, mem->data + base_mem->offset + offset, size);
+  gst_memory_unmap (out_mem, &info);
+  return out_mem;
+
+  /* ERRORS */
+error_allocate_memory:
+  GST_ERROR ("failed to allocate GstVaapiCodedMemory copy");
+  return NULL;
+error_map_memory:
+  GST_ERROR ("failed to map GstVaapiCodedMemory copy");
+  gst_memory_unref (out_mem);
+  return NULL;
+}
+
+static GstVaapiCodedMemory *
+gst_vaapi_coded_memory_share (GstVaapiCodedMemory * mem,
+    gssize offset, gssize size)
+{
+  GstMemory *const base_mem = GST_MEMORY_CAST (mem);
+  GstVaapiCodedMemory *out_mem;
+  GstMemory *parent;
+
+  parent = base_mem->parent ? base_mem->parent : base_mem;
+  if (size == -1)
+    size = base_mem->size - offset;
+
+  out_mem = g_slice_new (GstVaapiCodedMemory);
+  gst_memory_init (GST_MEMORY_CAST (out_mem),
+      GST_MINI_OBJECT_FLAGS (parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY,
+      base_mem->allocator, parent, base_mem->maxsize, base_mem->align,
+      base_mem->offset + offset, size);
+
+  out_mem->encoder = NULL;
+  out_mem->proxy = NULL;
+  out_mem->data = mem->data;
+  return out_mem;
+}
+
+static gboolean
+gst_vaapi_coded_memory_is_span (GstVaapiCodedMemory * mem1,
+    GstVaapiCodedMemory * mem2, gsize * offset_ptr)
+{
+  return FALSE;
+}
+
+/**
+ * gst_vaapi_coded_memory_wrap_buffer:
+ * @allocator: a #GstVaapiCodedAllocator
+ * @encoder: the #GstVaapiEncoder that produced @proxy
+ * @proxy: a #GstVaapiCodedBufferProxy
+ *
+ * Creates a #GstBuffer whose memories point to the segments of the
+ * mapped VA coded buffer, without copying them. @encoder and @proxy
+ * are kept alive until all memories are released.
+ *
+ * Return value: the newly allocated #GstBuffer, or %NULL if the coded
+ *   data could not be wrapped and shall be copied instead
+ */
+GstBuffer *
+gst_vaapi_coded_memory_wrap_buffer (GstAllocator * base_allocator,
+    GstVaapiEncoder * encoder, GstVaapiCodedBufferProxy * proxy)
+{
+  GstVaapiCodedAllocator *const allocator =
+      GST_VAAPI_CODED_ALLOCATOR_CAST (base_allocator);
+  GstVaapiCodedBuffer *coded_buf;
+  VACodedBufferSegment *segment_list, *segment;
+  GstBuffer *buf;
+  GstMemory *mem;
+
+  g_return_val_if_fail (GST_VAAPI_IS_CODED_ALLOCATOR (allocator), NULL);
+  g_return_val_if_fail (encoder != NULL, NULL);
+  g_return_val_if_fail (proxy != NULL, NULL);
+
+  if (g_atomic_int_get (&allocator->num_memories) >= MAX_WRAPPED_MEMORIES) {
+    GST_DEBUG ("too many coded buffers held downstream, copy data");
+    return NULL;
+  }
+
+  coded_buf = GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (proxy);
+  if (!gst_vaapi_coded_buffer_map (coded_buf, &segment_list))
+    return NULL;
+
+  buf = gst_buffer_new ();
+  for (segment = segment_list; segment != NULL; segment = segment->next) {
+    if (segment->size == 0)
+      continue;
+    mem = gst_vaapi_coded_memory_new (base_allocator, encoder, proxy, segment);
+    if (!mem)
+      goto error_wrap_segment;
+    gst_buffer_append_memory (buf, mem);
+  }
+  gst_vaapi_coded_buffer_unmap (coded_buf);
+  return buf;
+
+  /* ERRORS */
+error_wrap_segment:
+  {
+    GST_ERROR ("failed to wrap coded buffer segment");
+    gst_vaapi_coded_buffer_unmap (coded_buf);
+    gst_buffer_unref (buf);
+    return NULL;
+  }
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- GstVaapiCodedAllocator                                           --- */
+/* ------------------------------------------------------------------------ */
+
+G_DEFINE_TYPE (GstVaapiCodedAllocator,
+    gst_vaapi_coded_allocator, GST_TYPE_ALLOCATOR);
+
+static GstMemory *
+gst_vaapi_coded_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+  g_warning ("use gst_vaapi_coded_memory_wrap_buffer() to allocate from "
+      "GstVaapiCodedMemory allocator");
+
+  return NULL;
+}
+
+static void
+gst_vaapi_coded_allocator_free (GstAllocator * allocator, GstMemory * mem)
+{
+  gst_vaapi_coded_memory_free (GST_VAAPI_CODED_MEMORY_CAST (mem));
+}
+
+static void
+gst_vaapi_coded_allocator_class_init (GstVaapiCodedAllocatorClass * klass)
+{
+  GstAllocatorClass *const allocator_class = GST_ALLOCATOR_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (gst_debug_vaapicodedmemory,
+      "vaapicodedmemory", 0, "VA-API coded buffer memory allocator");
+
+  allocator_class->alloc = gst_vaapi_coded_allocator_alloc;
+  allocator_class->free = gst_vaapi_coded_allocator_free;
+}
+
+static void
+gst_vaapi_coded_allocator_init (GstVaapiCodedAllocator * allocator)
+{
+  GstAllocator *const base_allocator = GST_ALLOCATOR_CAST (allocator);
+
+  base_allocator->mem_type = GST_VAAPI_CODED_MEMORY_NAME;
+  base_allocator->mem_map = (GstMemoryMapFunction)
+      gst_vaapi_coded_memory_map;
+  base_allocator->mem_unmap = (GstMemoryUnmapFunction)
+      gst_vaapi_coded_memory_unmap;
+  base_allocator->mem_copy = (GstMemoryCopyFunction)
+      gst_vaapi_coded_memory_copy;
+  base_allocator->mem_share = (GstMemoryShareFunction)
+      gst_vaapi_coded_memory_share;
+  base_allocator->mem_is_span = (GstMemoryIsSpanFunction)
+      gst_vaapi_coded_memory_is_span;
+
+  GST_OBJECT_FLAG_SET (allocator, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+}
+
+/**
+ * gst_vaapi_coded_allocator_new:
+ *
+ * Creates a new #GstVaapiCodedAllocator, used to wrap the coded
+ * buffers of an encoder into #GstMemory objects.
+ *
+ * Return value: the newly allocated #GstAllocator
+ */
+GstAllocator *
+gst_vaapi_coded_allocator_new (void)
+{
+  return g_object_new (GST_VAAPI_TYPE_CODED_ALLOCATOR, NULL);
+}
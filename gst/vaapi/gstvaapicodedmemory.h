@@ -0,0 +1,95 @@
+/*
+ *  gstvaapicodedmemory.h - Gstreamer/VA coded buffer memory
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_CODED_MEMORY_H
+#define GST_VAAPI_CODED_MEMORY_H
+
+#include <gst/gstallocator.h>
+#include <gst/vaapi/gstvaapiencoder.h>
+#include <gst/vaapi/gstvaapicodedbufferproxy.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiCodedAllocator GstVaapiCodedAllocator;
+typedef struct _GstVaapiCodedAllocatorClass GstVaapiCodedAllocatorClass;
+
+/* ------------------------------------------------------------------------ */
+/* --- GstVaapiCodedMemory                                              --- */
+/* ------------------------------------------------------------------------ */
+
+#define GST_VAAPI_CODED_MEMORY_NAME             "GstVaapiCodedMemory"
+
+#define GST_VAAPI_IS_CODED_MEMORY(mem) \
+  ((mem) && (mem)->allocator && GST_VAAPI_IS_CODED_ALLOCATOR((mem)->allocator))
+
+G_GNUC_INTERNAL
+GstBuffer *
+gst_vaapi_coded_memory_wrap_buffer (GstAllocator * allocator,
+    GstVaapiEncoder * encoder, GstVaapiCodedBufferProxy * proxy);
+
+/* ------------------------------------------------------------------------ */
+/* --- GstVaapiCodedAllocator                                           --- */
+/* ------------------------------------------------------------------------ */
+
+#define GST_VAAPI_CODED_ALLOCATOR_CAST(allocator) \
+  ((GstVaapiCodedAllocator *) (allocator))
+
+#define GST_VAAPI_TYPE_CODED_ALLOCATOR \
+  (gst_vaapi_coded_allocator_get_type ())
+#define GST_VAAPI_CODED_ALLOCATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_VAAPI_TYPE_CODED_ALLOCATOR, \
+      GstVaapiCodedAllocator))
+#define GST_VAAPI_IS_CODED_ALLOCATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_VAAPI_TYPE_CODED_ALLOCATOR))
+
+#define GST_VAAPI_CODED_ALLOCATOR_NAME          "GstVaapiCodedAllocator"
+
+/**
+ * GstVaapiCodedAllocator:
+ *
+ * A VA coded buffer memory allocator object.
+ */
+struct _GstVaapiCodedAllocator
+{
+  GstAllocator parent_instance;
+
+  gint num_memories;            /* atomic */
+};
+
+/**
+ * GstVaapiCodedAllocatorClass:
+ *
+ * A VA coded buffer memory allocator class.
+ */
+struct _GstVaapiCodedAllocatorClass
+{
+  GstAllocatorClass parent_class;
+};
+
+G_GNUC_INTERNAL
+GType
+gst_vaapi_coded_allocator_get_type (void) G_GNUC_CONST;
+
+G_GNUC_INTERNAL
+GstAllocator *
+gst_vaapi_coded_allocator_new (void);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_CODED_MEMORY_H */
@@ -49,6 +49,7 @@
 
 #include "gstcompat.h"
 #include <gst/vaapi/gstvaapidisplay.h>
+#include <gst/vaapi/gstvaapiimagepool.h>
 
 #include "gstvaapidecode.h"
 #include "gstvaapipluginutil.h"
@@ -73,6 +74,21 @@
 
 #define GST_VAAPI_DECODE_FLOW_PARSE_DATA        GST_FLOW_CUSTOM_SUCCESS_2
 
+enum
+{
+  PROP_0,
+
+  PROP_ENABLE_STATS,
+  PROP_STATS,
+  PROP_SKIP_POLICY,
+  PROP_LOW_LATENCY,
+  PROP_MAX_WIDTH,
+  PROP_MAX_HEIGHT,
+  PROP_SURFACE_HEADROOM,
+  PROP_PREWARM_SURFACES,
+  PROP_PARSE_AHEAD,
+};
+
 GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapidecode);
 #define GST_CAT_DEFAULT gst_debug_vaapidecode
 
@@ -293,14 +309,15 @@ gst_vaapidecode_release (GstVaapiDecode * decode)
 
 static gboolean
 is_surface_resolution_changed (GstVideoDecoder * vdec,
-    GstVaapiSurface * surface)
+    GstVaapiSurfaceProxy * proxy)
 {
   guint surface_width, surface_height;
   guint configured_width, configured_height;
   GstVideoCodecState *state;
   gboolean ret = FALSE;
 
-  gst_vaapi_surface_get_size (surface, &surface_width, &surface_height);
+  gst_vaapi_surface_get_size (GST_VAAPI_SURFACE_PROXY_SURFACE (proxy),
+      &surface_width, &surface_height);
 
   state = gst_video_decoder_get_output_state (vdec);
   configured_width = GST_VIDEO_INFO_WIDTH (&state->info);
@@ -310,9 +327,67 @@ is_surface_resolution_changed (GstVideoDecoder * vdec,
   if (surface_width != configured_width || surface_height != configured_height)
     ret = TRUE;
 
+  /* Surfaces allocated for a larger maximum resolution are cropped */
+  if (ret && gst_vaapi_surface_proxy_get_crop_rect (proxy) &&
+      surface_width >= configured_width && surface_height >= configured_height)
+    ret = FALSE;
+
   return ret;
 }
 
+/* Reads the decoded surface back into a mapped VA image, that is
+   pushed as system memory. Returns NULL if the frame shall go through
+   the VA surface buffer pool instead */
+static GstBuffer *
+gst_vaapidecode_readback (GstVaapiDecode * decode,
+    GstVaapiSurfaceProxy * proxy)
+{
+  GstVideoInfo *const vip = &decode->readback_info;
+  GstVideoCodecState *state;
+  GstVideoInfo out_info;
+  GstBuffer *buffer;
+  guint width, height;
+
+  state = gst_video_decoder_get_output_state (GST_VIDEO_DECODER (decode));
+  if (!state)
+    return NULL;
+  out_info = state->info;
+  gst_video_codec_state_unref (state);
+
+  /* vaGetImage() needs images of the surface size */
+  gst_vaapi_surface_get_size (GST_VAAPI_SURFACE_PROXY_SURFACE (proxy),
+      &width, &height);
+  if (!decode->readback_pool ||
+      GST_VIDEO_INFO_FORMAT (vip) != GST_VIDEO_INFO_FORMAT (&out_info) ||
+      GST_VIDEO_INFO_WIDTH (vip) != width ||
+      GST_VIDEO_INFO_HEIGHT (vip) != height) {
+    gst_video_info_set_format (vip, GST_VIDEO_INFO_FORMAT (&out_info),
+        width, height);
+    gst_vaapi_video_pool_replace (&decode->readback_pool, NULL);
+    decode->readback_pool =
+        gst_vaapi_image_pool_new_full (GST_VAAPI_PLUGIN_BASE_DISPLAY (decode),
+        vip, gst_vaapi_get_image_alloc_flags ());
+    if (!decode->readback_pool)
+      goto error_readback;
+  }
+
+  buffer = gst_vaapi_readback_buffer_new (decode->readback_pool, proxy,
+      &out_info);
+  if (!buffer)
+    goto error_readback;
+  return buffer;
+
+  /* ERRORS */
+error_readback:
+  {
+    GST_WARNING_OBJECT (decode, "failed to read back %s surface, "
+        "use VA surface buffers",
+        gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (&out_info)));
+    decode->use_readback = FALSE;
+    return NULL;
+  }
+}
+
 static GstFlowReturn
 gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
     GstVideoCodecFrame * out_frame)
@@ -323,26 +398,33 @@ gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
   const GstVaapiRectangle *crop_rect;
   GstVaapiVideoMeta *meta;
   guint flags, out_flags = 0;
+  gboolean is_readback = FALSE;
 
   if (!GST_VIDEO_CODEC_FRAME_IS_DECODE_ONLY (out_frame)) {
     proxy = gst_video_codec_frame_get_user_data (out_frame);
 
     /* reconfigure if un-cropped surface resolution changed */
-    if (is_surface_resolution_changed (vdec,
-            GST_VAAPI_SURFACE_PROXY_SURFACE (proxy)))
+    if (is_surface_resolution_changed (vdec, proxy))
       gst_vaapidecode_negotiate (decode);
 
     gst_vaapi_surface_proxy_set_destroy_notify (proxy,
         (GDestroyNotify) gst_vaapidecode_release, gst_object_ref (decode));
 
-    ret = gst_video_decoder_allocate_output_frame (vdec, out_frame);
-    if (ret != GST_FLOW_OK)
-      goto error_create_buffer;
+    if (decode->use_readback) {
+      out_frame->output_buffer = gst_vaapidecode_readback (decode, proxy);
+      is_readback = out_frame->output_buffer != NULL;
+    }
+
+    if (!out_frame->output_buffer) {
+      ret = gst_video_decoder_allocate_output_frame (vdec, out_frame);
+      if (ret != GST_FLOW_OK)
+        goto error_create_buffer;
 
-    meta = gst_buffer_get_vaapi_video_meta (out_frame->output_buffer);
-    if (!meta)
-      goto error_get_meta;
-    gst_vaapi_video_meta_set_surface_proxy (meta, proxy);
+      meta = gst_buffer_get_vaapi_video_meta (out_frame->output_buffer);
+      if (!meta)
+        goto error_get_meta;
+      gst_vaapi_video_meta_set_surface_proxy (meta, proxy);
+    }
 
     flags = gst_vaapi_surface_proxy_get_flags (proxy);
     if (flags & GST_VAAPI_SURFACE_PROXY_FLAG_CORRUPTED)
@@ -363,8 +445,9 @@ gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
           GST_VIDEO_BUFFER_FLAG_FIRST_IN_BUNDLE);
     }
 
+    /* Read back buffers are already cropped through their GstVideoMeta */
     crop_rect = gst_vaapi_surface_proxy_get_crop_rect (proxy);
-    if (crop_rect) {
+    if (crop_rect && !is_readback) {
       GstVideoCropMeta *const crop_meta =
           gst_buffer_add_video_crop_meta (out_frame->output_buffer);
       if (crop_meta) {
@@ -506,6 +589,12 @@ gst_vaapidecode_handle_frame (GstVideoDecoder * vdec,
     decode->active = TRUE;
   }
 
+  /* Late frames are only decoded if other pictures depend on them,
+     unless the skip policy requests all pictures to be decoded */
+  if (decode->skip_policy != GST_VAAPI_DECODER_SKIP_NONE &&
+      gst_video_decoder_get_max_decode_time (vdec, frame) < 0)
+    GST_VIDEO_CODEC_FRAME_SET_DECODE_ONLY (frame);
+
   /* Decode current frame */
   for (;;) {
     status = gst_vaapi_decoder_decode (decode->decoder, frame);
@@ -635,6 +724,15 @@ gst_vaapidecode_decide_allocation (GstVideoDecoder * vdec, GstQuery * query)
       GST_VAAPI_CAPS_FEATURE_GL_TEXTURE_UPLOAD_META);
 #endif
 
+  /* Elements that only accept system memory get the pixels read back
+     into mapped VA images. The layout of VA images is driver specific,
+     so GstVideoMeta is needed */
+  decode->use_readback = caps &&
+      gst_vaapi_caps_feature_contains (caps,
+      GST_VAAPI_CAPS_FEATURE_SYSTEM_MEMORY) &&
+      gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  gst_vaapi_video_pool_replace (&decode->readback_pool, NULL);
+
   return gst_vaapi_plugin_base_decide_allocation (GST_VAAPI_PLUGIN_BASE (vdec),
       query, 0);
 }
@@ -651,10 +749,25 @@ gst_vaapi_codec_from_caps (GstCaps * caps)
   return gst_vaapi_profile_get_codec (gst_vaapi_profile_from_caps (caps));
 }
 
+/* Returns a new reference to the current decoder, if any. The decoder
+   may be replaced by the streaming thread while properties are
+   accessed */
+static GstVaapiDecoder *
+gst_vaapidecode_ref_decoder (GstVaapiDecode * decode)
+{
+  GstVaapiDecoder *decoder;
+
+  GST_OBJECT_LOCK (decode);
+  decoder = decode->decoder ? gst_vaapi_decoder_ref (decode->decoder) : NULL;
+  GST_OBJECT_UNLOCK (decode);
+  return decoder;
+}
+
 static gboolean
 gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
 {
   GstVaapiDisplay *dpy;
+  GstVaapiDecoder *decoder;
 
   if (!gst_vaapidecode_ensure_display (decode))
     return FALSE;
@@ -662,17 +775,17 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
 
   switch (gst_vaapi_codec_from_caps (caps)) {
     case GST_VAAPI_CODEC_MPEG2:
-      decode->decoder = gst_vaapi_decoder_mpeg2_new (dpy, caps);
+      decoder = gst_vaapi_decoder_mpeg2_new (dpy, caps);
       break;
     case GST_VAAPI_CODEC_MPEG4:
     case GST_VAAPI_CODEC_H263:
-      decode->decoder = gst_vaapi_decoder_mpeg4_new (dpy, caps);
+      decoder = gst_vaapi_decoder_mpeg4_new (dpy, caps);
       break;
     case GST_VAAPI_CODEC_H264:
-      decode->decoder = gst_vaapi_decoder_h264_new (dpy, caps);
+      decoder = gst_vaapi_decoder_h264_new (dpy, caps);
 
       /* Set the stream buffer alignment for better optimizations */
-      if (decode->decoder && caps) {
+      if (decoder && caps) {
         GstStructure *const structure = gst_caps_get_structure (caps, 0);
         const gchar *str = NULL;
 
@@ -685,16 +798,19 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
           else
             alignment = GST_VAAPI_STREAM_ALIGN_H264_NONE;
           gst_vaapi_decoder_h264_set_alignment (GST_VAAPI_DECODER_H264
-              (decode->decoder), alignment);
+              (decoder), alignment);
         }
       }
+      if (decoder)
+        gst_vaapi_decoder_h264_set_low_latency (GST_VAAPI_DECODER_H264
+            (decoder), decode->low_latency);
       break;
 #if USE_HEVC_DECODER
     case GST_VAAPI_CODEC_H265:
-      decode->decoder = gst_vaapi_decoder_h265_new (dpy, caps);
+      decoder = gst_vaapi_decoder_h265_new (dpy, caps);
 
       /* Set the stream buffer alignment for better optimizations */
-      if (decode->decoder && caps) {
+      if (decoder && caps) {
         GstStructure *const structure = gst_caps_get_structure (caps, 0);
         const gchar *str = NULL;
 
@@ -707,39 +823,56 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
           else
             alignment = GST_VAAPI_STREAM_ALIGN_H265_NONE;
           gst_vaapi_decoder_h265_set_alignment (GST_VAAPI_DECODER_H265
-              (decode->decoder), alignment);
+              (decoder), alignment);
         }
       }
       break;
 #endif
     case GST_VAAPI_CODEC_WMV3:
     case GST_VAAPI_CODEC_VC1:
-      decode->decoder = gst_vaapi_decoder_vc1_new (dpy, caps);
+      decoder = gst_vaapi_decoder_vc1_new (dpy, caps);
       break;
 #if USE_JPEG_DECODER
     case GST_VAAPI_CODEC_JPEG:
-      decode->decoder = gst_vaapi_decoder_jpeg_new (dpy, caps);
+      decoder = gst_vaapi_decoder_jpeg_new (dpy, caps);
       break;
 #endif
 #if USE_VP8_DECODER
     case GST_VAAPI_CODEC_VP8:
-      decode->decoder = gst_vaapi_decoder_vp8_new (dpy, caps);
+      decoder = gst_vaapi_decoder_vp8_new (dpy, caps);
       break;
 #endif
 #if USE_VP9_DECODER
     case GST_VAAPI_CODEC_VP9:
-      decode->decoder = gst_vaapi_decoder_vp9_new (dpy, caps);
+      decoder = gst_vaapi_decoder_vp9_new (dpy, caps);
       break;
 #endif
     default:
-      decode->decoder = NULL;
+      decoder = NULL;
       break;
   }
-  if (!decode->decoder)
+  if (!decoder)
     return FALSE;
 
+  GST_OBJECT_LOCK (decode);
+  decode->decoder = decoder;
+  GST_OBJECT_UNLOCK (decode);
+
   gst_vaapi_decoder_set_codec_state_changed_func (decode->decoder,
       gst_vaapi_decoder_state_changed, decode);
+  gst_vaapi_decoder_set_stats_enabled (decode->decoder, decode->enable_stats);
+  gst_vaapi_decoder_set_skip_policy (decode->decoder, decode->skip_policy);
+  gst_vaapi_decoder_set_max_size (decode->decoder, decode->max_width,
+      decode->max_height);
+  gst_vaapi_decoder_set_surface_headroom (decode->decoder,
+      decode->surface_headroom);
+  gst_vaapi_decoder_set_prewarm_surfaces (decode->decoder,
+      decode->prewarm_surfaces);
+  if (decode->parse_ahead > 0 &&
+      !gst_vaapi_decoder_set_parse_ahead (decode->decoder,
+          decode->parse_ahead))
+    GST_WARNING_OBJECT (decode, "parse-ahead is disabled for %"
+        GST_PTR_FORMAT, caps);
 
   decode->decoder_caps = gst_caps_ref (caps);
   return TRUE;
@@ -775,9 +908,15 @@ gst_vaapidecode_purge (GstVaapiDecode * decode)
 static void
 gst_vaapidecode_destroy (GstVaapiDecode * decode)
 {
+  GstVaapiDecoder *decoder;
+
   gst_vaapidecode_purge (decode);
 
-  gst_vaapi_decoder_replace (&decode->decoder, NULL);
+  GST_OBJECT_LOCK (decode);
+  decoder = decode->decoder;
+  decode->decoder = NULL;
+  GST_OBJECT_UNLOCK (decode);
+  gst_vaapi_decoder_replace (&decoder, NULL);
   gst_caps_replace (&decode->decoder_caps, NULL);
 
   decode->active = FALSE;
@@ -822,6 +961,114 @@ gst_vaapidecode_finalize (GObject * object)
   G_OBJECT_CLASS (gst_vaapidecode_parent_class)->finalize (object);
 }
 
+static void
+gst_vaapidecode_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+  GstVaapiDecoder *const decoder = gst_vaapidecode_ref_decoder (decode);
+
+  switch (prop_id) {
+    case PROP_ENABLE_STATS:
+      decode->enable_stats = g_value_get_boolean (value);
+      if (decoder)
+        gst_vaapi_decoder_set_stats_enabled (decoder, decode->enable_stats);
+      break;
+    case PROP_SKIP_POLICY:
+      decode->skip_policy = g_value_get_enum (value);
+      if (decoder)
+        gst_vaapi_decoder_set_skip_policy (decoder, decode->skip_policy);
+      break;
+    case PROP_LOW_LATENCY:
+      decode->low_latency = g_value_get_boolean (value);
+      if (decoder &&
+          gst_vaapi_decoder_get_codec (decoder) == GST_VAAPI_CODEC_H264)
+        gst_vaapi_decoder_h264_set_low_latency (GST_VAAPI_DECODER_H264
+            (decoder), decode->low_latency);
+      break;
+    case PROP_MAX_WIDTH:
+      decode->max_width = g_value_get_uint (value);
+      if (decoder)
+        gst_vaapi_decoder_set_max_size (decoder, decode->max_width,
+            decode->max_height);
+      break;
+    case PROP_MAX_HEIGHT:
+      decode->max_height = g_value_get_uint (value);
+      if (decoder)
+        gst_vaapi_decoder_set_max_size (decoder, decode->max_width,
+            decode->max_height);
+      break;
+    case PROP_SURFACE_HEADROOM:
+      decode->surface_headroom = g_value_get_uint (value);
+      if (decoder)
+        gst_vaapi_decoder_set_surface_headroom (decoder,
+            decode->surface_headroom);
+      break;
+    case PROP_PREWARM_SURFACES:
+      decode->prewarm_surfaces = g_value_get_boolean (value);
+      if (decoder)
+        gst_vaapi_decoder_set_prewarm_surfaces (decoder,
+            decode->prewarm_surfaces);
+      break;
+    case PROP_PARSE_AHEAD:
+      /* Applies to the next decoder, the parser thread is only started
+         before any data is submitted */
+      decode->parse_ahead = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  if (decoder)
+    gst_vaapi_decoder_unref (decoder);
+}
+
+static void
+gst_vaapidecode_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+
+  switch (prop_id) {
+    case PROP_ENABLE_STATS:
+      g_value_set_boolean (value, decode->enable_stats);
+      break;
+    case PROP_STATS:{
+      GstVaapiDecoder *const decoder = gst_vaapidecode_ref_decoder (decode);
+
+      g_value_take_boxed (value, decoder ?
+          gst_vaapi_decoder_get_stats (decoder) : NULL);
+      if (decoder)
+        gst_vaapi_decoder_unref (decoder);
+      break;
+    }
+    case PROP_SKIP_POLICY:
+      g_value_set_enum (value, decode->skip_policy);
+      break;
+    case PROP_LOW_LATENCY:
+      g_value_set_boolean (value, decode->low_latency);
+      break;
+    case PROP_MAX_WIDTH:
+      g_value_set_uint (value, decode->max_width);
+      break;
+    case PROP_MAX_HEIGHT:
+      g_value_set_uint (value, decode->max_height);
+      break;
+    case PROP_SURFACE_HEADROOM:
+      g_value_set_uint (value, decode->surface_headroom);
+      break;
+    case PROP_PREWARM_SURFACES:
+      g_value_set_boolean (value, decode->prewarm_surfaces);
+      break;
+    case PROP_PARSE_AHEAD:
+      g_value_set_uint (value, decode->parse_ahead);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static gboolean
 gst_vaapidecode_open (GstVideoDecoder * vdec)
 {
@@ -851,6 +1098,7 @@ gst_vaapidecode_close (GstVideoDecoder * vdec)
 
   gst_vaapi_decode_input_state_replace (decode, NULL);
   gst_vaapidecode_destroy (decode);
+  gst_vaapi_video_pool_replace (&decode->readback_pool, NULL);
   gst_vaapi_plugin_base_close (GST_VAAPI_PLUGIN_BASE (decode));
   return TRUE;
 }
@@ -956,6 +1204,8 @@ gst_vaapidecode_class_init (GstVaapiDecodeClass * klass)
   gst_vaapi_plugin_base_class_init (GST_VAAPI_PLUGIN_BASE_CLASS (klass));
 
   object_class->finalize = gst_vaapidecode_finalize;
+  object_class->set_property = gst_vaapidecode_set_property;
+  object_class->get_property = gst_vaapidecode_get_property;
 
   vdec_class->open = GST_DEBUG_FUNCPTR (gst_vaapidecode_open);
   vdec_class->close = GST_DEBUG_FUNCPTR (gst_vaapidecode_close);
@@ -986,6 +1236,148 @@ gst_vaapidecode_class_init (GstVaapiDecodeClass * klass)
   /* src pad */
   pad_template = gst_static_pad_template_get (&gst_vaapidecode_src_factory);
   gst_element_class_add_pad_template (element_class, pad_template);
+
+  /**
+   * GstVaapiDecode:enable-stats:
+   *
+   * When enabled, the decoder collects timing statistics that are
+   * available through the #GstVaapiDecode:stats property.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_ENABLE_STATS,
+      g_param_spec_boolean ("enable-stats",
+          "Enable statistics",
+          "Collect decoding timing statistics",
+          FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiDecode:stats:
+   *
+   * A snapshot of the decoding statistics collected since the decoder
+   * was last created, or %NULL if there is no decoder yet. See
+   * gst_vaapi_decoder_get_stats() for the structure fields.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_STATS,
+      g_param_spec_boxed ("stats",
+          "Statistics",
+          "Decoding timing statistics",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiDecode:skip-policy:
+   *
+   * Selects the pictures that are not decoded at all, e.g. to only
+   * decode key pictures for thumbnail extraction or trick modes.
+   * Skipped pictures are dropped. Unless all pictures are to be
+   * decoded, late non-reference pictures are skipped as well.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_SKIP_POLICY,
+      g_param_spec_enum ("skip-policy",
+          "Skip policy",
+          "Pictures that are skipped instead of being decoded",
+          GST_VAAPI_TYPE_DECODER_SKIP_POLICY, GST_VAAPI_DECODER_SKIP_NONE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiDecode:low-latency:
+   *
+   * When enabled, H.264 pictures are output as soon as the output
+   * order allows, instead of when the DPB is full. This applies to
+   * streams whose SPS signals the reordering depth, either through the
+   * VUI bitstream restriction parameters or with pic_order_cnt_type 2,
+   * as commonly produced by cameras or for video calls.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_LOW_LATENCY,
+      g_param_spec_boolean ("low-latency",
+          "Low latency",
+          "Output H.264 pictures as early as the output order allows",
+          FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiDecode:max-width:
+   *
+   * The largest picture width expected in the stream, e.g. that of
+   * the highest rendition of an adaptive streaming session. When
+   * either this or #GstVaapiDecode:max-height is set, surfaces are
+   * allocated for that size and reused across resolution switches,
+   * instead of being reallocated each time the resolution changes.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_MAX_WIDTH,
+      g_param_spec_uint ("max-width",
+          "Maximum width",
+          "Largest expected picture width (0 = stream width)",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiDecode:max-height:
+   *
+   * The largest picture height expected in the stream, see
+   * #GstVaapiDecode:max-width.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_MAX_HEIGHT,
+      g_param_spec_uint ("max-height",
+          "Maximum height",
+          "Largest expected picture height (0 = stream height)",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiDecode:surface-headroom:
+   *
+   * Number of VA surfaces allocated on top of those required by the
+   * codec, for frames held downstream, e.g. by queues or a compositor.
+   * Without enough headroom, the decoder waits for downstream to
+   * release frames, which shows up in the "surface-pool-exhausted"
+   * counter of #GstVaapiDecode:stats.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_SURFACE_HEADROOM,
+      g_param_spec_uint ("surface-headroom",
+          "Surface headroom",
+          "Extra surfaces allocated for frames held downstream",
+          0, 64, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiDecode:prewarm-surfaces:
+   *
+   * Commits the memory of all VA surfaces when they are created, so
+   * that the driver does not allocate it while decoding the first
+   * frames of the stream.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_PREWARM_SURFACES,
+      g_param_spec_boolean ("prewarm-surfaces",
+          "Pre-warm surfaces",
+          "Allocate surfaces memory upfront",
+          FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiDecode:parse-ahead:
+   *
+   * Maximum number of frames parsed ahead by a dedicated thread, while
+   * the streaming thread submits the previous frames to the hardware.
+   * Zero disables the parser thread. This is only supported for H.264
+   * and HEVC streams, and takes effect when the decoder is created.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_PARSE_AHEAD,
+      g_param_spec_uint ("parse-ahead",
+          "Parse ahead",
+          "Number of frames parsed ahead in a separate thread (0: disabled)",
+          0, 64, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static gboolean
@@ -1156,6 +1548,16 @@ gst_vaapidecode_init (GstVaapiDecode * decode)
   decode->decoder = NULL;
   decode->decoder_caps = NULL;
   decode->allowed_caps = NULL;
+  decode->enable_stats = FALSE;
+  decode->skip_policy = GST_VAAPI_DECODER_SKIP_NONE;
+  decode->low_latency = FALSE;
+  decode->max_width = 0;
+  decode->max_height = 0;
+  decode->surface_headroom = 0;
+  decode->prewarm_surfaces = FALSE;
+  decode->parse_ahead = 0;
+  decode->use_readback = FALSE;
+  decode->readback_pool = NULL;
 
   g_mutex_init (&decode->surface_ready_mutex);
   g_cond_init (&decode->surface_ready);
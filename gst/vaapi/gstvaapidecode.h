@@ -27,6 +27,7 @@
 
 #include "gstvaapipluginbase.h"
 #include <gst/vaapi/gstvaapidecoder.h>
+#include <gst/vaapi/gstvaapivideopool.h>
 
 G_BEGIN_DECLS
 
@@ -70,6 +71,17 @@ struct _GstVaapiDecode {
     GstCaps            *allowed_caps;
     guint               current_frame_size;
     guint               has_texture_upload_meta : 1;
+    guint               use_readback : 1;
+    guint               enable_stats : 1;
+    guint               low_latency : 1;
+    guint               prewarm_surfaces : 1;
+    GstVaapiDecoderSkipPolicy skip_policy;
+    guint               max_width;
+    guint               max_height;
+    guint               parse_ahead;
+    guint               surface_headroom;
+    GstVaapiVideoPool  *readback_pool;
+    GstVideoInfo        readback_info;
 
     GstVideoCodecState *input_state;
     volatile gboolean   active;
@@ -29,6 +29,7 @@
 #include "gstvaapivideometa.h"
 #include "gstvaapivideomemory.h"
 #include "gstvaapivideobufferpool.h"
+#include "gstvaapicodedmemory.h"
 
 #define GST_PLUGIN_NAME "vaapiencode"
 #define GST_PLUGIN_DESC "A VA-API based video encoder"
@@ -48,6 +49,7 @@ enum
 {
   PROP_0,
 
+  PROP_LOW_LATENCY,
   PROP_BASE,
 };
 
@@ -157,6 +159,10 @@ gst_vaapiencode_default_get_property (GstVaapiEncode * encode, guint prop_id,
 {
   PropValue *const prop_value = prop_value_lookup (encode, prop_id);
 
+  if (prop_id == PROP_LOW_LATENCY) {
+    g_value_set_boolean (value, encode->low_latency);
+    return TRUE;
+  }
   if (prop_value) {
     g_value_copy (&prop_value->value, value);
     return TRUE;
@@ -170,6 +176,10 @@ gst_vaapiencode_default_set_property (GstVaapiEncode * encode, guint prop_id,
 {
   PropValue *const prop_value = prop_value_lookup (encode, prop_id);
 
+  if (prop_id == PROP_LOW_LATENCY) {
+    encode->low_latency = g_value_get_boolean (value);
+    return TRUE;
+  }
   if (prop_value) {
     g_value_copy (value, &prop_value->value);
     return TRUE;
@@ -179,18 +189,29 @@ gst_vaapiencode_default_set_property (GstVaapiEncode * encode, guint prop_id,
 
 static GstFlowReturn
 gst_vaapiencode_default_alloc_buffer (GstVaapiEncode * encode,
-    GstVaapiCodedBuffer * coded_buf, GstBuffer ** outbuf_ptr)
+    GstVaapiCodedBufferProxy * proxy, GstBuffer ** outbuf_ptr)
 {
+  GstVaapiCodedBuffer *coded_buf;
   GstBuffer *buf;
   gint32 buf_size;
 
-  g_return_val_if_fail (coded_buf != NULL, GST_FLOW_ERROR);
+  g_return_val_if_fail (proxy != NULL, GST_FLOW_ERROR);
   g_return_val_if_fail (outbuf_ptr != NULL, GST_FLOW_ERROR);
 
+  coded_buf = GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (proxy);
   buf_size = gst_vaapi_coded_buffer_get_size (coded_buf);
   if (buf_size <= 0)
     goto error_invalid_buffer;
 
+  /* Hand over the VA coded buffer itself, unless downstream already
+     holds too many of them */
+  buf = gst_vaapi_coded_memory_wrap_buffer (encode->coded_allocator,
+      encode->encoder, proxy);
+  if (buf) {
+    *outbuf_ptr = buf;
+    return GST_FLOW_OK;
+  }
+
   buf =
       gst_video_encoder_allocate_output_buffer (GST_VIDEO_ENCODER_CAST (encode),
       buf_size);
@@ -265,6 +286,7 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
   GstVaapiEncoderStatus status;
   GstBuffer *out_buffer;
   GstFlowReturn ret;
+  gboolean truncated;
 
   status = gst_vaapi_encoder_get_buffer_with_timeout (encode->encoder,
       &codedbuf_proxy, timeout);
@@ -279,6 +301,10 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
   gst_video_codec_frame_ref (out_frame);
   gst_video_codec_frame_set_user_data (out_frame, NULL, NULL);
 
+  /* The coded buffer may outlive the frame, if wrapped into the output
+     buffer, so don't let it hold onto the source surface */
+  gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy, NULL, NULL);
+
   /* Update output state */
   GST_VIDEO_ENCODER_STREAM_LOCK (encode);
   if (!ensure_output_state (encode))
@@ -286,13 +312,23 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
   GST_VIDEO_ENCODER_STREAM_UNLOCK (encode);
 
   /* Allocate and copy buffer into system memory */
+  truncated = gst_vaapi_coded_buffer_is_truncated
+      (GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy));
   out_buffer = NULL;
-  ret = klass->alloc_buffer (encode,
-      GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy), &out_buffer);
+  ret = klass->alloc_buffer (encode, codedbuf_proxy, &out_buffer);
   gst_vaapi_coded_buffer_proxy_replace (&codedbuf_proxy, NULL);
   if (ret != GST_FLOW_OK)
     goto error_allocate_buffer;
 
+  /* The encoder codes the next frame as a key frame, so downstream
+     can resume decoding from there */
+  if (truncated) {
+    GST_ELEMENT_WARNING (encode, STREAM, ENCODE, (NULL),
+        ("coded buffer overflow, frame %d is corrupted",
+            out_frame->system_frame_number));
+    GST_BUFFER_FLAG_SET (out_buffer, GST_BUFFER_FLAG_CORRUPTED);
+  }
+
   gst_buffer_replace (&out_frame->output_buffer, out_buffer);
   gst_buffer_unref (out_buffer);
 
@@ -326,19 +362,43 @@ error_output_state:
   }
 }
 
+/* The encoder wakes us up as soon as a coded buffer is ready, or when
+   the task is being stopped (flushing) */
 static void
 gst_vaapiencode_buffer_loop (GstVaapiEncode * encode)
 {
   GstFlowReturn ret;
-  const gint64 timeout = 50000; /* microseconds */
 
-  ret = gst_vaapiencode_push_frame (encode, timeout);
+  ret = gst_vaapiencode_push_frame (encode, G_MAXUINT64);
   if (ret == GST_FLOW_OK || ret == GST_VAAPI_ENCODE_FLOW_TIMEOUT)
     return;
 
   gst_pad_pause_task (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode));
 }
 
+/* Restricts the raw formats of the sink pad template caps to the ones
+   that can be uploaded, possibly through a conversion to NV12 */
+static GstCaps *
+get_allowed_sinkpad_caps (GstVaapiPluginBase * plugin)
+{
+  GstCaps *template_caps, *allowed_caps, *raw_caps, *caps;
+
+  template_caps = gst_pad_get_pad_template_caps (plugin->sinkpad);
+  if (!plugin->display)
+    return template_caps;
+
+  raw_caps = gst_vaapi_plugin_base_get_allowed_raw_caps (plugin);
+  if (!raw_caps)
+    return template_caps;
+
+  allowed_caps = gst_caps_from_string (GST_VAAPI_MAKE_ENC_SURFACE_CAPS);
+  gst_caps_append (allowed_caps, gst_caps_copy (raw_caps));
+  caps = gst_caps_intersect (template_caps, allowed_caps);
+  gst_caps_unref (allowed_caps);
+  gst_caps_unref (template_caps);
+  return caps;
+}
+
 static GstCaps *
 gst_vaapiencode_get_caps_impl (GstVideoEncoder * venc)
 {
@@ -347,9 +407,8 @@ gst_vaapiencode_get_caps_impl (GstVideoEncoder * venc)
 
   if (plugin->sinkpad_caps)
     caps = gst_caps_ref (plugin->sinkpad_caps);
-  else {
-    caps = gst_pad_get_pad_template_caps (plugin->sinkpad);
-  }
+  else
+    caps = get_allowed_sinkpad_caps (plugin);
   return caps;
 }
 
@@ -476,6 +535,11 @@ gst_vaapiencode_set_format (GstVideoEncoder * venc, GstVideoCodecState * state)
   encode->input_state = gst_video_codec_state_ref (state);
   encode->input_state_changed = TRUE;
 
+  /* In low-latency mode, coded buffers are pushed from handle_frame() */
+  gst_vaapi_encoder_set_flushing (encode->encoder, FALSE);
+  if (encode->low_latency)
+    return TRUE;
+
   return gst_pad_start_task (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode),
       (GstTaskFunction) gst_vaapiencode_buffer_loop, encode, NULL);
 }
@@ -518,8 +582,22 @@ gst_vaapiencode_handle_frame (GstVideoEncoder * venc,
   if (status < GST_VAAPI_ENCODER_STATUS_SUCCESS)
     goto error_encode_frame;
 
+  /* Push the coded buffers from this thread, without any hand-off to
+     the src pad task. Frames held for reordering are not waited for */
+  ret = GST_FLOW_OK;
+  if (encode->low_latency) {
+    while (ret == GST_FLOW_OK &&
+        gst_vaapi_encoder_has_pending_buffers (encode->encoder)) {
+      GST_VIDEO_ENCODER_STREAM_UNLOCK (encode);
+      ret = gst_vaapiencode_push_frame (encode, G_MAXUINT64);
+      GST_VIDEO_ENCODER_STREAM_LOCK (encode);
+    }
+    if (ret == GST_VAAPI_ENCODE_FLOW_TIMEOUT)
+      ret = GST_FLOW_OK;
+  }
+
   gst_video_codec_frame_unref (frame);
-  return GST_FLOW_OK;
+  return ret;
 
   /* ERRORS */
 error_buffer_invalid:
@@ -567,7 +645,9 @@ gst_vaapiencode_finish (GstVideoEncoder * venc)
   status = gst_vaapi_encoder_flush (encode->encoder);
 
   GST_VIDEO_ENCODER_STREAM_UNLOCK (encode);
+  gst_vaapi_encoder_set_flushing (encode->encoder, TRUE);
   gst_pad_stop_task (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode));
+  gst_vaapi_encoder_set_flushing (encode->encoder, FALSE);
   GST_VIDEO_ENCODER_STREAM_LOCK (encode);
 
   while (status == GST_VAAPI_ENCODER_STATUS_SUCCESS && ret == GST_FLOW_OK)
@@ -585,6 +665,8 @@ gst_vaapiencode_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      if (encode->encoder)
+        gst_vaapi_encoder_set_flushing (encode->encoder, TRUE);
       gst_pad_stop_task (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode));
       break;
     default:
@@ -617,6 +699,11 @@ gst_vaapiencode_finalize (GObject * object)
     encode->prop_values = NULL;
   }
 
+  if (encode->coded_allocator) {
+    gst_object_unref (encode->coded_allocator);
+    encode->coded_allocator = NULL;
+  }
+
   gst_vaapi_plugin_base_finalize (GST_VAAPI_PLUGIN_BASE (object));
   G_OBJECT_CLASS (gst_vaapiencode_parent_class)->finalize (object);
 }
@@ -628,6 +715,8 @@ gst_vaapiencode_init (GstVaapiEncode * encode)
 
   gst_vaapi_plugin_base_init (GST_VAAPI_PLUGIN_BASE (encode), GST_CAT_DEFAULT);
   gst_pad_use_fixed_caps (plugin->srcpad);
+
+  encode->coded_allocator = gst_vaapi_coded_allocator_new ();
 }
 
 static void
@@ -707,6 +796,18 @@ gst_vaapiencode_class_init_properties (GstVaapiEncodeClass * klass)
   if (!props)
     return FALSE;
 
+  /**
+   * GstVaapiEncode:low-latency:
+   *
+   * Push the coded buffers from the streaming thread, as soon as
+   * each frame is encoded, instead of from a separate src pad task.
+   * This saves one thread hand-off per frame.
+   */
+  g_object_class_install_property (object_class, PROP_LOW_LATENCY,
+      g_param_spec_boolean ("low-latency", "Low latency",
+          "Push coded buffers from the streaming thread",
+          FALSE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
   for (i = 0; i < props->len; i++) {
     GstVaapiEncoderPropInfo *const prop = g_ptr_array_index (props, i);
     g_object_class_install_property (object_class, PROP_BASE + i, prop->pspec);
@@ -59,6 +59,8 @@ struct _GstVaapiEncode
   gboolean need_codec_data;
   GstVideoCodecState *output_state;
   GPtrArray *prop_values;
+  gboolean low_latency;
+  GstAllocator *coded_allocator;
 };
 
 struct _GstVaapiEncodeClass
@@ -77,7 +79,7 @@ struct _GstVaapiEncodeClass
   GstVaapiEncoder *   (*alloc_encoder)  (GstVaapiEncode * encode,
                                          GstVaapiDisplay * display);
   GstFlowReturn       (*alloc_buffer)   (GstVaapiEncode * encode,
-                                         GstVaapiCodedBuffer * coded_buf,
+                                         GstVaapiCodedBufferProxy * proxy,
                                          GstBuffer ** outbuf_ptr);
 };
 
@@ -346,7 +346,7 @@ error:
 
 static GstFlowReturn
 gst_vaapiencode_h265_alloc_buffer (GstVaapiEncode * base_encode,
-    GstVaapiCodedBuffer * coded_buf, GstBuffer ** out_buffer_ptr)
+    GstVaapiCodedBufferProxy * proxy, GstBuffer ** out_buffer_ptr)
 {
   GstVaapiEncodeH265 *const encode = GST_VAAPIENCODE_H265_CAST (base_encode);
   GstVaapiEncoderH265 *const encoder =
@@ -357,7 +357,7 @@ gst_vaapiencode_h265_alloc_buffer (GstVaapiEncode * base_encode,
 
   ret =
       GST_VAAPIENCODE_CLASS (gst_vaapiencode_h265_parent_class)->alloc_buffer
-      (base_encode, coded_buf, out_buffer_ptr);
+      (base_encode, proxy, out_buffer_ptr);
   if (ret != GST_FLOW_OK)
     return ret;
 
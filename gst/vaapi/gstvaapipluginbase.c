@@ -24,6 +24,8 @@
 
 #include "gstcompat.h"
 #include <gst/vaapi/gstvaapisurface_drm.h>
+#include <gst/vaapi/gstvaapiutils_convert.h>
+#include <gst/vaapi/gstvaapiutils_copy.h>
 #include <gst/base/gstpushsrc.h>
 #include "gstvaapipluginbase.h"
 #include "gstvaapipluginutil.h"
@@ -201,6 +203,7 @@ gst_vaapi_plugin_base_init (GstVaapiPluginBase * plugin,
   /* sink pad */
   plugin->sinkpad = gst_element_get_static_pad (GST_ELEMENT (plugin), "sink");
   gst_video_info_init (&plugin->sinkpad_info);
+  gst_video_info_init (&plugin->sinkpad_buffer_info);
 
   /* src pad */
   if (!(GST_OBJECT_FLAGS (plugin) & GST_ELEMENT_FLAG_SINK))
@@ -254,6 +257,7 @@ gst_vaapi_plugin_base_close (GstVaapiPluginBase * plugin)
     gst_object_unref (plugin->sinkpad_buffer_pool);
     plugin->sinkpad_buffer_pool = NULL;
   }
+  gst_video_info_init (&plugin->sinkpad_buffer_info);
   g_clear_object (&plugin->srcpad_buffer_pool);
 
   gst_caps_replace (&plugin->srcpad_caps, NULL);
@@ -348,13 +352,55 @@ gst_vaapi_plugin_base_ensure_display (GstVaapiPluginBase * plugin)
   return TRUE;
 }
 
+/* Returns TRUE if raw images in @format are uploaded through a
+   conversion to NV12, because the driver does not support them */
+static gboolean
+needs_upload_conversion (GstVaapiPluginBase * plugin, GstVideoFormat format)
+{
+  return format != GST_VIDEO_FORMAT_ENCODED &&
+      !gst_vaapi_display_has_image_format (plugin->display, format) &&
+      gst_vaapi_convert_is_supported (GST_VIDEO_FORMAT_NV12, format);
+}
+
+static gboolean
+caps_need_upload_conversion (GstVaapiPluginBase * plugin, GstCaps * caps)
+{
+  GstVideoInfo vi;
+
+  if (gst_caps_has_vaapi_surface (caps) ||
+      !gst_video_info_from_caps (&vi, caps))
+    return FALSE;
+  return needs_upload_conversion (plugin, GST_VIDEO_INFO_FORMAT (&vi));
+}
+
+/* Returns the caps of the VA surfaces that hold buffers with @caps,
+   i.e. NV12 caps if the buffers are converted on upload */
+static GstCaps *
+get_sinkpad_pool_caps (GstVaapiPluginBase * plugin, GstCaps * caps)
+{
+  GstCaps *pool_caps;
+  GstStructure *structure;
+
+  if (!caps_need_upload_conversion (plugin, caps))
+    return gst_caps_ref (caps);
+
+  pool_caps = gst_caps_copy (caps);
+  structure = gst_caps_get_structure (pool_caps, 0);
+  gst_structure_set (structure, "format", G_TYPE_STRING,
+      gst_video_format_to_string (GST_VIDEO_FORMAT_NV12), NULL);
+  gst_structure_remove_fields (structure, "colorimetry", "chroma-site", NULL);
+  return pool_caps;
+}
+
 /**
  * ensure_sinkpad_buffer_pool:
  * @plugin: a #GstVaapiPluginBase
  * @caps: the initial #GstCaps for the resulting buffer pool
  *
  * Makes sure the sink pad video buffer pool is created with the
- * appropriate @caps.
+ * appropriate @caps. Raw formats that the driver does not support
+ * for images, but that can be converted to NV12, get a pool of NV12
+ * buffers, and the conversion happens on upload.
  *
  * Returns: %TRUE if successful, %FALSE otherwise.
  */
@@ -370,13 +416,14 @@ ensure_sinkpad_buffer_pool (GstVaapiPluginBase * plugin, GstCaps * caps)
   if (!gst_vaapi_plugin_base_ensure_display (plugin))
     return FALSE;
 
+  caps = get_sinkpad_pool_caps (plugin, caps);
   if (plugin->sinkpad_buffer_pool) {
     config = gst_buffer_pool_get_config (plugin->sinkpad_buffer_pool);
     gst_buffer_pool_config_get_params (config, &pool_caps, NULL, NULL, NULL);
     need_pool = !gst_caps_is_equal (caps, pool_caps);
     gst_structure_free (config);
     if (!need_pool)
-      return TRUE;
+      goto done;
     g_clear_object (&plugin->sinkpad_buffer_pool);
     plugin->sinkpad_buffer_size = 0;
   }
@@ -393,6 +440,7 @@ ensure_sinkpad_buffer_pool (GstVaapiPluginBase * plugin, GstCaps * caps)
         GST_VIDEO_INFO_WIDTH (&vi), GST_VIDEO_INFO_HEIGHT (&vi));
   }
   plugin->sinkpad_buffer_size = vi.size;
+  plugin->sinkpad_buffer_info = vi;
 
   config = gst_buffer_pool_get_config (pool);
   gst_buffer_pool_config_set_params (config, caps,
@@ -403,18 +451,23 @@ ensure_sinkpad_buffer_pool (GstVaapiPluginBase * plugin, GstCaps * caps)
   if (!gst_buffer_pool_set_config (pool, config))
     goto error_pool_config;
   plugin->sinkpad_buffer_pool = pool;
+
+done:
+  gst_caps_unref (caps);
   return TRUE;
 
   /* ERRORS */
 error_create_pool:
   {
     GST_ERROR ("failed to create buffer pool");
+    gst_caps_unref (caps);
     return FALSE;
   }
 error_pool_config:
   {
     GST_ERROR ("failed to reset buffer pool config");
     gst_object_unref (pool);
+    gst_caps_unref (caps);
     return FALSE;
   }
 }
@@ -477,8 +530,10 @@ gst_vaapi_plugin_base_propose_allocation (GstVaapiPluginBase * plugin,
       goto error_no_caps;
     if (!ensure_sinkpad_buffer_pool (plugin, caps))
       return FALSE;
-    gst_query_add_allocation_pool (query, plugin->sinkpad_buffer_pool,
-        plugin->sinkpad_buffer_size, 0, 0);
+    /* Upstream cannot write into buffers that hold another format */
+    if (!caps_need_upload_conversion (plugin, caps))
+      gst_query_add_allocation_pool (query, plugin->sinkpad_buffer_pool,
+          plugin->sinkpad_buffer_size, 0, 0);
   }
 
   gst_query_add_allocation_meta (query, GST_VAAPI_VIDEO_META_API_TYPE, NULL);
@@ -687,6 +742,80 @@ config_failed:
   }
 }
 
+/* Converts @src_frame to the format of @dst_frame, while writing the
+   pixels into the VA image mapping */
+static gboolean
+video_frame_convert_to_image (GstVideoFrame * dst_frame,
+    const GstVideoFrame * src_frame)
+{
+  const GstVideoFormat src_format = GST_VIDEO_FRAME_FORMAT (src_frame);
+  GstVideoColorMatrix matrix;
+  guint8 *dst[2], *src[3];
+  guint i, dst_stride[2], src_stride[3];
+
+  if (!gst_vaapi_convert_is_supported (GST_VIDEO_FRAME_FORMAT (dst_frame),
+          src_format))
+    return FALSE;
+
+  for (i = 0; i < 2; i++) {
+    dst[i] = GST_VIDEO_FRAME_PLANE_DATA (dst_frame, i);
+    dst_stride[i] = GST_VIDEO_FRAME_PLANE_STRIDE (dst_frame, i);
+  }
+  for (i = 0; i < 3; i++) {
+    if (i < GST_VIDEO_FRAME_N_PLANES (src_frame)) {
+      src[i] = GST_VIDEO_FRAME_PLANE_DATA (src_frame, i);
+      src_stride[i] = GST_VIDEO_FRAME_PLANE_STRIDE (src_frame, i);
+    } else {
+      src[i] = NULL;
+      src_stride[i] = 0;
+    }
+  }
+
+  matrix = src_frame->info.colorimetry.matrix == GST_VIDEO_COLOR_MATRIX_BT709 ?
+      GST_VIDEO_COLOR_MATRIX_BT709 : GST_VIDEO_COLOR_MATRIX_BT601;
+  return gst_vaapi_convert_to_NV12 (dst, dst_stride, src_format, src,
+      src_stride, GST_VIDEO_FRAME_WIDTH (src_frame),
+      GST_VIDEO_FRAME_HEIGHT (src_frame), matrix);
+}
+
+/* Same as gst_video_frame_copy(), but with non-temporal stores into the
+   VA image mapping, since the pixels are not read back by the CPU.
+   Formats that the driver does not support are converted on the way */
+static gboolean
+video_frame_copy_to_image (GstVideoFrame * dst_frame,
+    const GstVideoFrame * src_frame)
+{
+  guint i, width, height;
+
+  if (GST_VIDEO_FRAME_WIDTH (dst_frame) != GST_VIDEO_FRAME_WIDTH (src_frame)
+      || GST_VIDEO_FRAME_HEIGHT (dst_frame) !=
+      GST_VIDEO_FRAME_HEIGHT (src_frame))
+    return FALSE;
+
+  if (GST_VIDEO_FRAME_FORMAT (dst_frame) != GST_VIDEO_FRAME_FORMAT (src_frame))
+    return video_frame_convert_to_image (dst_frame, src_frame);
+
+  if (GST_VIDEO_FORMAT_INFO_HAS_PALETTE (dst_frame->info.finfo))
+    return gst_video_frame_copy (dst_frame, src_frame);
+
+  /* This assumes that plane N has the subsampling of component N, as
+     gst_video_frame_copy_plane() does */
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (dst_frame); i++) {
+    width = GST_VIDEO_FRAME_COMP_WIDTH (dst_frame, i) *
+        GST_VIDEO_FRAME_COMP_PSTRIDE (dst_frame, i);
+    if (width == 0)
+      width = MIN (GST_VIDEO_FRAME_PLANE_STRIDE (dst_frame, i),
+          GST_VIDEO_FRAME_PLANE_STRIDE (src_frame, i));
+    height = GST_VIDEO_FRAME_COMP_HEIGHT (dst_frame, i);
+
+    gst_vaapi_copy_plane_upload (GST_VIDEO_FRAME_PLANE_DATA (dst_frame, i),
+        GST_VIDEO_FRAME_PLANE_STRIDE (dst_frame, i),
+        GST_VIDEO_FRAME_PLANE_DATA (src_frame, i),
+        GST_VIDEO_FRAME_PLANE_STRIDE (src_frame, i), width, height);
+  }
+  return TRUE;
+}
+
 /**
  * gst_vaapi_plugin_base_get_input_buffer:
  * @plugin: a #GstVaapiPluginBase
@@ -734,7 +863,10 @@ gst_vaapi_plugin_base_get_input_buffer (GstVaapiPluginBase * plugin,
           &outbuf, NULL) != GST_FLOW_OK)
     goto error_create_buffer;
 
-  if (is_dma_buffer (inbuf)) {
+  /* dma_buf memory in formats that are converted on upload is mapped
+     and converted as regular memory */
+  if (is_dma_buffer (inbuf) && !needs_upload_conversion (plugin,
+          GST_VIDEO_INFO_FORMAT (&plugin->sinkpad_info))) {
     if (!plugin_bind_dma_to_vaapi_buffer (plugin, inbuf, outbuf))
       goto error_bind_dma_buffer;
     goto done;
@@ -744,11 +876,11 @@ gst_vaapi_plugin_base_get_input_buffer (GstVaapiPluginBase * plugin,
           GST_MAP_READ))
     goto error_map_src_buffer;
 
-  if (!gst_video_frame_map (&out_frame, &plugin->sinkpad_info, outbuf,
+  if (!gst_video_frame_map (&out_frame, &plugin->sinkpad_buffer_info, outbuf,
           GST_MAP_WRITE))
     goto error_map_dst_buffer;
 
-  success = gst_video_frame_copy (&out_frame, &src_frame);
+  success = video_frame_copy_to_image (&out_frame, &src_frame);
   gst_video_frame_unmap (&out_frame);
   gst_video_frame_unmap (&src_frame);
   if (!success)
@@ -898,6 +1030,24 @@ ensure_allowed_raw_caps (GstVaapiPluginBase * plugin)
     gst_vaapi_object_unref (image);
   }
 
+  /* Formats that the driver does not support can still be converted
+     to NV12 on upload */
+  for (i = 0; i < out_formats->len; i++) {
+    if (g_array_index (out_formats, GstVideoFormat, i) ==
+        GST_VIDEO_FORMAT_NV12)
+      break;
+  }
+  if (i < out_formats->len) {
+    const GstVideoFormat *convert_formats;
+    guint n_convert_formats;
+
+    convert_formats = gst_vaapi_convert_get_src_formats (&n_convert_formats);
+    for (i = 0; i < n_convert_formats; i++) {
+      if (needs_upload_conversion (plugin, convert_formats[i]))
+        g_array_append_val (out_formats, convert_formats[i]);
+    }
+  }
+
   out_caps = gst_vaapi_video_format_new_template_caps_from_list (out_formats);
   if (!out_caps)
     goto bail;
@@ -123,6 +123,7 @@ struct _GstVaapiPluginBase
   GstVideoInfo sinkpad_info;
   GstBufferPool *sinkpad_buffer_pool;
   guint sinkpad_buffer_size;
+  GstVideoInfo sinkpad_buffer_info;
 
   GstPad *srcpad;
   GstCaps *srcpad_caps;
@@ -39,6 +39,9 @@
 #if USE_WAYLAND
 # include <gst/vaapi/gstvaapidisplay_wayland.h>
 #endif
+#if USE_NULL
+# include <gst/vaapi/gstvaapidisplay_null.h>
+#endif
 #include "gstvaapipluginutil.h"
 #include "gstvaapipluginbase.h"
 
@@ -80,6 +83,11 @@ static const DisplayMap g_display_map[] = {
   {"drm",
    GST_VAAPI_DISPLAY_TYPE_DRM,
    gst_vaapi_display_drm_new},
+#endif
+#if USE_NULL
+  {"null",
+   GST_VAAPI_DISPLAY_TYPE_NULL,
+   gst_vaapi_display_null_new},
 #endif
   {NULL,}
 };
@@ -95,9 +103,16 @@ gst_vaapi_create_display (GstVaapiDisplayType display_type,
   if (getenv("LIBVA_DRIVER_NAME") && g_strcmp0 (getenv("LIBVA_DRIVER_NAME"), "gallium") == 0)
       display_type = GST_VAAPI_DISPLAY_TYPE_DRM;
 
+  /* The VA/NULL backend is never auto-detected, it has to be requested */
+  if (g_strcmp0 (g_getenv ("LIBVA_DRIVER_NAME"), "null") == 0)
+    display_type = GST_VAAPI_DISPLAY_TYPE_NULL;
+
   for (m = g_display_map; m->type_str != NULL; m++) {
     if (display_type != GST_VAAPI_DISPLAY_TYPE_ANY && display_type != m->type)
       continue;
+    if (display_type == GST_VAAPI_DISPLAY_TYPE_ANY &&
+        m->type == GST_VAAPI_DISPLAY_TYPE_NULL)
+      continue;
 
     display = m->create_display (display_name);
     if (display || display_type != GST_VAAPI_DISPLAY_TYPE_ANY)
@@ -682,3 +697,31 @@ gst_vaapi_create_test_display ()
 {
   return gst_vaapi_create_display (GST_VAAPI_DISPLAY_TYPE_ANY, NULL);
 }
+
+/**
+ * gst_vaapi_get_image_alloc_flags:
+ *
+ * Returns the #GstVaapiImageAllocFlags for the pools of images that
+ * the elements map to upload or read back pixels.
+ *
+ * Persistent mapping is only enabled with the
+ * GST_VAAPI_IMAGE_PERSISTENT_MAPPING=1 environment variable. VA-API
+ * does not define what vaGetImage() or vaPutImage() do to a buffer
+ * that is still mapped, so this must first be validated with the
+ * driver in use.
+ *
+ * Returns: the image allocation flags
+ **/
+guint
+gst_vaapi_get_image_alloc_flags (void)
+{
+  static gsize g_persistent_state = 0;
+
+  if (g_once_init_enter (&g_persistent_state)) {
+    const gchar *const env = g_getenv ("GST_VAAPI_IMAGE_PERSISTENT_MAPPING");
+    g_once_init_leave (&g_persistent_state,
+        g_strcmp0 (env, "1") == 0 ? 2 : 1);
+  }
+  return g_persistent_state == 2 ?
+      GST_VAAPI_IMAGE_ALLOC_FLAG_PERSISTENT_MAPPING : 0;
+}
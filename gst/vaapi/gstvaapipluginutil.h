@@ -136,4 +136,8 @@ G_GNUC_INTERNAL
 GstVaapiDisplay *
 gst_vaapi_create_test_display (void);
 
+G_GNUC_INTERNAL
+guint
+gst_vaapi_get_image_alloc_flags (void);
+
 #endif /* GST_VAAPI_PLUGIN_UTIL_H */
@@ -26,6 +26,7 @@
 #include <gst/vaapi/gstvaapisurfacepool.h>
 #include <gst/vaapi/gstvaapiimagepool.h>
 #include "gstvaapivideomemory.h"
+#include "gstvaapipluginutil.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapivideomemory);
 #define GST_CAT_DEFAULT gst_debug_vaapivideomemory
@@ -94,14 +95,69 @@ ensure_image (GstVaapiVideoMemory * mem)
   return TRUE;
 }
 
+typedef struct
+{
+  GMutex mutex;
+  GCond cond;
+  gboolean done;
+  gboolean success;
+} SurfaceSync;
+
+static void
+surface_sync_done (GstVaapiSurface * surface, gboolean success,
+    gpointer user_data)
+{
+  SurfaceSync *const sync = user_data;
+
+  g_mutex_lock (&sync->mutex);
+  sync->success = success;
+  sync->done = TRUE;
+  g_cond_signal (&sync->cond);
+  g_mutex_unlock (&sync->mutex);
+}
+
+/* Waits for the pending operations on the surface to complete. Unlike
+   gst_vaapi_surface_sync(), or an implicit sync in vaGetImage() or
+   vaMapBuffer(), this does not hold the display lock meanwhile, so
+   that other streams sharing the display are not stalled */
+static gboolean
+wait_surface (GstVaapiSurface * surface)
+{
+  GstVaapiSurfaceStatus status;
+  SurfaceSync sync;
+
+  /* Surfaces are usually idle by the time they get mapped */
+  if (gst_vaapi_surface_query_status (surface, &status) &&
+      !(status & GST_VAAPI_SURFACE_STATUS_RENDERING))
+    return TRUE;
+
+  g_mutex_init (&sync.mutex);
+  g_cond_init (&sync.cond);
+  sync.done = FALSE;
+  sync.success = FALSE;
+
+  gst_vaapi_surface_sync_async (surface, surface_sync_done, &sync);
+
+  g_mutex_lock (&sync.mutex);
+  while (!sync.done)
+    g_cond_wait (&sync.cond, &sync.mutex);
+  g_mutex_unlock (&sync.mutex);
+
+  g_cond_clear (&sync.cond);
+  g_mutex_clear (&sync.mutex);
+  return sync.success;
+}
+
 static gboolean
 ensure_image_is_current (GstVaapiVideoMemory * mem)
 {
   if (mem->use_direct_rendering)
-    return TRUE;
+    return wait_surface (mem->surface);
 
   if (!GST_VAAPI_VIDEO_MEMORY_FLAG_IS_SET (mem,
           GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT)) {
+    if (!wait_surface (mem->surface))
+      return FALSE;
     if (!gst_vaapi_surface_get_image (mem->surface, mem->image))
       return FALSE;
 
@@ -757,8 +813,8 @@ gst_vaapi_video_allocator_new (GstVaapiDisplay * display,
     goto error_create_surface_pool;
 
   allocator_configure_image_info (display, allocator);
-  allocator->image_pool = gst_vaapi_image_pool_new (display,
-      &allocator->image_info);
+  allocator->image_pool = gst_vaapi_image_pool_new_full (display,
+      &allocator->image_info, gst_vaapi_get_image_alloc_flags ());
   if (!allocator->image_pool)
     goto error_create_image_pool;
 
@@ -781,6 +837,182 @@ error_create_image_pool:
   }
 }
 
+/* ------------------------------------------------------------------------ */
+/* --- Readback buffers                                                 --- */
+/* ------------------------------------------------------------------------ */
+
+typedef struct
+{
+  GstVaapiVideoPool *image_pool;
+  GstVaapiImage *image;
+  GstVaapiSurfaceProxy *proxy;
+  gboolean is_mapped;
+} ReadbackData;
+
+static void
+readback_data_free (ReadbackData * data)
+{
+  if (data->is_mapped)
+    gst_vaapi_image_unmap (data->image);
+
+  if (data->image_pool) {
+    gst_vaapi_video_pool_put_object (data->image_pool, data->image);
+    gst_vaapi_video_pool_unref (data->image_pool);
+  } else
+    gst_vaapi_object_unref (data->image);
+  gst_vaapi_surface_proxy_replace (&data->proxy, NULL);
+  g_slice_free (ReadbackData, data);
+}
+
+/* Derived images are used in place, and keep the surface from being
+   reused by the decoder until downstream releases them */
+static GstVaapiImage *
+readback_derive_image (ReadbackData * data, GstVaapiSurfaceProxy * proxy,
+    const GstVideoInfo * vip)
+{
+  GstVaapiImage *image;
+
+  image = gst_vaapi_surface_derive_image (GST_VAAPI_SURFACE_PROXY_SURFACE
+      (proxy));
+  if (!image)
+    return NULL;
+
+  if (GST_VAAPI_IMAGE_FORMAT (image) != GST_VIDEO_INFO_FORMAT (vip) ||
+      !gst_vaapi_image_is_linear (image)) {
+    gst_vaapi_object_unref (image);
+    return NULL;
+  }
+  data->proxy = gst_vaapi_surface_proxy_ref (proxy);
+  return image;
+}
+
+/* Otherwise, the surface is read back into an image of @image_pool,
+   and can be reused right away */
+static GstVaapiImage *
+readback_get_image (ReadbackData * data, GstVaapiVideoPool * image_pool,
+    GstVaapiSurfaceProxy * proxy)
+{
+  GstVaapiImage *image;
+
+  image = gst_vaapi_video_pool_get_object (image_pool);
+  if (!image)
+    return NULL;
+
+  if (!gst_vaapi_surface_get_image (GST_VAAPI_SURFACE_PROXY_SURFACE (proxy),
+          image)) {
+    gst_vaapi_video_pool_put_object (image_pool, image);
+    return NULL;
+  }
+  data->image_pool = gst_vaapi_video_pool_ref (image_pool);
+  return image;
+}
+
+/**
+ * gst_vaapi_readback_buffer_new:
+ * @image_pool: a #GstVaapiImagePool with images of the @proxy surface
+ *   size, in the output format
+ * @proxy: the #GstVaapiSurfaceProxy to read back
+ * @vip: the output #GstVideoInfo
+ *
+ * Creates a #GstBuffer, with a #GstVideoMeta, whose memory wraps the
+ * mapped VA image holding the pixels of the @proxy surface. This is
+ * for downstream elements that only accept system memory: the pixels
+ * are not copied again on the way, and the buffer is read-only. The
+ * #GstVideoMeta plane offsets account for the @proxy crop rectangle,
+ * so the buffer does not need a #GstVideoCropMeta.
+ *
+ * The surface is derived into an image if it is linear, and in the
+ * output format. Otherwise, it is read back into an image from
+ * @image_pool.
+ *
+ * Return value: the newly allocated #GstBuffer, or %NULL on failure
+ */
+GstBuffer *
+gst_vaapi_readback_buffer_new (GstVaapiVideoPool * image_pool,
+    GstVaapiSurfaceProxy * proxy, const GstVideoInfo * vip)
+{
+  ReadbackData *data;
+  GstVaapiImage *image;
+  GstBuffer *buffer;
+  const GstVideoFormatInfo *finfo;
+  const GstVaapiRectangle *crop_rect;
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  gint stride[GST_VIDEO_MAX_PLANES];
+  guchar *base;
+  guint i, p, num_planes, data_size, cropped_planes = 0;
+
+  g_return_val_if_fail (image_pool != NULL, NULL);
+  g_return_val_if_fail (proxy != NULL, NULL);
+  g_return_val_if_fail (vip != NULL, NULL);
+
+  if (!wait_surface (GST_VAAPI_SURFACE_PROXY_SURFACE (proxy)))
+    return NULL;
+
+  data = g_slice_new0 (ReadbackData);
+  image = readback_derive_image (data, proxy, vip);
+  if (!image)
+    image = readback_get_image (data, image_pool, proxy);
+  if (!image)
+    goto error_get_image;
+  data->image = image;
+
+  if (!gst_vaapi_image_map (image))
+    goto error_map_image;
+  data->is_mapped = TRUE;
+
+  base = get_image_data (image);
+  if (!base)
+    goto error_map_image;
+
+  num_planes = gst_vaapi_image_get_plane_count (image);
+  for (i = 0; i < num_planes; i++) {
+    offset[i] = gst_vaapi_image_get_plane (image, i) - base;
+    stride[i] = gst_vaapi_image_get_pitch (image, i);
+  }
+  data_size = gst_vaapi_image_get_data_size (image);
+
+  /* Point the planes to the top-left pixel of the crop rectangle */
+  crop_rect = gst_vaapi_surface_proxy_get_crop_rect (proxy);
+  if (crop_rect && (crop_rect->x || crop_rect->y)) {
+    finfo = vip->finfo;
+    for (i = 0; i < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); i++) {
+      p = GST_VIDEO_FORMAT_INFO_PLANE (finfo, i);
+      if (p >= num_planes || (cropped_planes & (1U << p)))
+        continue;
+      cropped_planes |= 1U << p;
+      offset[p] += GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, i,
+          crop_rect->y) * stride[p] +
+          GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, i, crop_rect->x) *
+          GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, i);
+    }
+  }
+
+  buffer = gst_buffer_new ();
+  gst_buffer_append_memory (buffer,
+      gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, base, data_size, 0,
+          data_size, data, (GDestroyNotify) readback_data_free));
+  gst_buffer_add_video_meta_full (buffer, GST_VIDEO_FRAME_FLAG_NONE,
+      GST_VIDEO_INFO_FORMAT (vip), GST_VIDEO_INFO_WIDTH (vip),
+      GST_VIDEO_INFO_HEIGHT (vip), num_planes, offset, stride);
+  return buffer;
+
+  /* ERRORS */
+error_get_image:
+  {
+    GST_ERROR ("failed to read back surface %" GST_VAAPI_ID_FORMAT,
+        GST_VAAPI_ID_ARGS (GST_VAAPI_SURFACE_PROXY_SURFACE_ID (proxy)));
+    g_slice_free (ReadbackData, data);
+    return NULL;
+  }
+error_map_image:
+  {
+    GST_ERROR ("failed to map image %" GST_VAAPI_ID_FORMAT,
+        GST_VAAPI_ID_ARGS (gst_vaapi_image_get_id (image)));
+    readback_data_free (data);
+    return NULL;
+  }
+}
+
 /* ------------------------------------------------------------------------ */
 /* --- GstVaapiDmaBufMemory                                             --- */
 /* ------------------------------------------------------------------------ */
@@ -190,6 +190,15 @@ GstAllocator *
 gst_vaapi_video_allocator_new (GstVaapiDisplay * display,
     const GstVideoInfo * vip, guint flags);
 
+/* ------------------------------------------------------------------------ */
+/* --- Readback buffers                                                 --- */
+/* ------------------------------------------------------------------------ */
+
+G_GNUC_INTERNAL
+GstBuffer *
+gst_vaapi_readback_buffer_new (GstVaapiVideoPool * image_pool,
+    GstVaapiSurfaceProxy * proxy, const GstVideoInfo * vip);
+
 /* ------------------------------------------------------------------------ */
 /* --- GstVaapiDmaBufMemory                                             --- */
 /* ------------------------------------------------------------------------ */
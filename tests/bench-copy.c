@@ -0,0 +1,192 @@
+/*
+ *  bench-copy.c - VA image copy benchmark
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <gst/vaapi/gstvaapiimage.h>
+#include <gst/vaapi/gstvaapiutils_copy.h>
+#include "output.h"
+
+static gint g_iterations = 50;
+static gint g_threads = 0;
+
+static GOptionEntry g_options[] = {
+    { "iterations", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_iterations,
+      "number of frame copies per measurement", NULL },
+    { "threads", 't',
+      0,
+      G_OPTION_ARG_INT, &g_threads,
+      "number of threads copying large planes (default: auto)", NULL },
+    { NULL, }
+};
+
+static const GstVideoFormat g_formats[] = {
+    GST_VIDEO_FORMAT_NV12,
+    GST_VIDEO_FORMAT_I420,
+    GST_VIDEO_FORMAT_YUY2,
+    GST_VIDEO_FORMAT_RGBA,
+};
+
+static const struct {
+    guint width;
+    guint height;
+} g_sizes[] = {
+    { 1280,  720 },
+    { 1920, 1080 },
+    { 3840, 2160 },
+    { 7680, 4320 },
+};
+
+/* Copies all planes between the mapped VA image and the system memory
+   frame, in the direction given by @upload */
+static void
+copy_frame(GstVaapiCopyPlaneFunc func, gboolean upload,
+    GstVaapiImage *image, const GstVideoInfo *vip, guint8 *data)
+{
+    guint i, width, height, pitch;
+    guint8 *plane, *pixels;
+
+    for (i = 0; i < GST_VIDEO_INFO_N_PLANES(vip); i++) {
+        width = GST_VIDEO_INFO_COMP_WIDTH(vip, i) *
+            GST_VIDEO_INFO_COMP_PSTRIDE(vip, i);
+        height = GST_VIDEO_INFO_COMP_HEIGHT(vip, i);
+        plane = gst_vaapi_image_get_plane(image, i);
+        pitch = gst_vaapi_image_get_pitch(image, i);
+        pixels = data + GST_VIDEO_INFO_PLANE_OFFSET(vip, i);
+
+        if (upload)
+            func(plane, pitch, pixels, GST_VIDEO_INFO_PLANE_STRIDE(vip, i),
+                width, height);
+        else
+            func(pixels, GST_VIDEO_INFO_PLANE_STRIDE(vip, i), plane, pitch,
+                width, height);
+    }
+}
+
+static gdouble
+run_copy(GstVaapiCopyPlaneFunc func, gboolean upload,
+    GstVaapiImage *image, const GstVideoInfo *vip, guint8 *data)
+{
+    gint64 start, elapsed;
+    gint i;
+
+    /* Warm up */
+    copy_frame(func, upload, image, vip, data);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < g_iterations; i++)
+        copy_frame(func, upload, image, vip, data);
+    elapsed = g_get_monotonic_time() - start;
+
+    return (gdouble)GST_VIDEO_INFO_SIZE(vip) * g_iterations /
+        (elapsed / (gdouble)G_USEC_PER_SEC) / 1e9;
+}
+
+static gboolean
+run_bench(GstVaapiDisplay *display, GstVideoFormat format,
+    guint width, guint height)
+{
+    const GstVaapiCopyPlaneImpl *impls;
+    GstVaapiImage *image;
+    GstVideoInfo vi;
+    guint8 *data;
+    guint i, num_impls;
+
+    image = gst_vaapi_image_new(display, format, width, height);
+    if (!image) {
+        g_print("%-4s %4ux%-4u unsupported\n",
+            gst_video_format_to_string(format), width, height);
+        return TRUE;
+    }
+
+    if (!gst_vaapi_image_map(image)) {
+        g_printerr("error: could not map %s image\n",
+            gst_video_format_to_string(format));
+        gst_vaapi_object_unref(image);
+        return FALSE;
+    }
+
+    gst_video_info_init(&vi);
+    gst_video_info_set_format(&vi, format, width, height);
+    data = g_malloc(GST_VIDEO_INFO_SIZE(&vi));
+    memset(data, 0x80, GST_VIDEO_INFO_SIZE(&vi));
+
+    impls = gst_vaapi_copy_plane_get_impls(&num_impls);
+    for (i = 0; i < num_impls; i++) {
+        const gdouble download_rate =
+            run_copy(impls[i].download, FALSE, image, &vi, data);
+        const gdouble upload_rate =
+            run_copy(impls[i].upload, TRUE, image, &vi, data);
+
+        g_print("%-4s %4ux%-4u %-8s download %6.2f GB/s upload %6.2f GB/s\n",
+            gst_video_format_to_string(format), width, height,
+            impls[i].name, download_rate, upload_rate);
+    }
+
+    /* Default implementation, split across the copy threads */
+    {
+        const gdouble download_rate =
+            run_copy(gst_vaapi_copy_plane_download, FALSE, image, &vi, data);
+        const gdouble upload_rate =
+            run_copy(gst_vaapi_copy_plane_upload, TRUE, image, &vi, data);
+        gchar *const name =
+            g_strdup_printf("%ut", gst_vaapi_copy_get_max_threads());
+
+        g_print("%-4s %4ux%-4u %-8s download %6.2f GB/s upload %6.2f GB/s\n",
+            gst_video_format_to_string(format), width, height,
+            name, download_rate, upload_rate);
+        g_free(name);
+    }
+
+    g_free(data);
+    gst_vaapi_image_unmap(image);
+    gst_vaapi_object_unref(image);
+    return TRUE;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    gboolean success = TRUE;
+    guint i, j;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    if (g_iterations < 1 || g_threads < 0)
+        g_error("invalid iteration or thread count");
+    if (g_threads > 0)
+        gst_vaapi_copy_set_max_threads(g_threads);
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create Gst/VA display");
+
+    for (i = 0; i < G_N_ELEMENTS(g_formats); i++) {
+        for (j = 0; j < G_N_ELEMENTS(g_sizes); j++)
+            success &= run_bench(display, g_formats[i],
+                g_sizes[j].width, g_sizes[j].height);
+    }
+
+    gst_vaapi_display_unref(display);
+    video_output_exit();
+    return !success;
+}
@@ -0,0 +1,168 @@
+/*
+ *  bench-parse.c - Parser-only decode benchmark
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/base/gstadapter.h>
+#if USE_NULL
+# include <gst/vaapi/gstvaapidisplay_null.h>
+#endif
+#include "decoder.h"
+#include "output.h"
+
+static gchar *g_codec_str;
+static gint g_iterations = 100000;
+static gboolean g_use_output = !USE_NULL;
+
+static GOptionEntry g_options[] = {
+    { "codec", 'c',
+      0,
+      G_OPTION_ARG_STRING, &g_codec_str,
+      "codec to test", NULL },
+    { "iterations", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_iterations,
+      "number of passes over the sample clip", NULL },
+#if USE_NULL
+    { "use-output", 0,
+      0,
+      G_OPTION_ARG_NONE, &g_use_output,
+      "use the selected video output instead of the VA/NULL display", NULL },
+#endif
+    { NULL, }
+};
+
+/* Mimics the vaapidecode parse() loop over the whole sample clip. Each
+   parsed frame is released right away, along with the parser objects
+   that were attached to it */
+static gboolean
+parse_clip(GstVaapiDecoder *decoder, GstAdapter *adapter, GstBuffer *buffer,
+    guint *num_frames_ptr)
+{
+    GstVideoCodecFrame *frame = NULL;
+    GstVaapiDecoderStatus status;
+    guint got_unit_size;
+    gboolean got_frame;
+
+    gst_adapter_push(adapter, gst_buffer_ref(buffer));
+    while (gst_adapter_available(adapter) > 0) {
+        if (!frame) {
+            frame = g_slice_new0(GstVideoCodecFrame);
+            frame->ref_count = 1;
+        }
+
+        status = gst_vaapi_decoder_parse(decoder, frame, adapter, TRUE,
+            &got_unit_size, &got_frame);
+        if (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA)
+            break;
+        if (status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
+            gst_video_codec_frame_unref(frame);
+            return FALSE;
+        }
+
+        gst_adapter_flush(adapter, got_unit_size);
+        if (got_frame) {
+            gst_video_codec_frame_unref(frame);
+            frame = NULL;
+            (*num_frames_ptr)++;
+        }
+    }
+    if (frame)
+        gst_video_codec_frame_unref(frame);
+    gst_adapter_clear(adapter);
+    return TRUE;
+}
+
+static GstBuffer *
+get_clip_buffer(GstVaapiDecoder *decoder)
+{
+    const gchar * const codec_name = decoder_get_codec_name(decoder);
+    VideoDecodeInfo info;
+
+    if (!decoder_get_video_info(decoder, &info))
+        g_error("could not find %s sample clip", codec_name);
+
+    return gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,
+        (guchar *)info.data, info.data_size, 0, info.data_size, NULL, NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    GstVaapiDecoder *decoder;
+    GstAdapter *adapter;
+    GstBuffer *buffer;
+    gint64 start, elapsed;
+    guint num_frames = 0;
+    const gchar *cache_env;
+    gdouble secs;
+    gint i;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    if (g_iterations < 1)
+        g_error("invalid iteration count");
+
+#if USE_NULL
+    if (!g_use_output)
+        display = gst_vaapi_display_null_new(NULL);
+    else
+#endif
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create Gst/VA display");
+
+    decoder = decoder_new(display, g_codec_str);
+    if (!decoder)
+        g_error("could not create decoder");
+
+    buffer = get_clip_buffer(decoder);
+    adapter = gst_adapter_new();
+
+    /* Warm up the parser state and the mini object caches */
+    if (!parse_clip(decoder, adapter, buffer, &num_frames))
+        g_error("could not parse %s sample clip",
+            decoder_get_codec_name(decoder));
+
+    num_frames = 0;
+    start = g_get_monotonic_time();
+    for (i = 0; i < g_iterations; i++) {
+        if (!parse_clip(decoder, adapter, buffer, &num_frames))
+            g_error("could not parse %s sample clip",
+                decoder_get_codec_name(decoder));
+    }
+    elapsed = g_get_monotonic_time() - start;
+
+    /* Compare with a run where GST_VAAPI_MINI_OBJECT_CACHE=0 */
+    cache_env = g_getenv("GST_VAAPI_MINI_OBJECT_CACHE");
+    secs = elapsed / (gdouble)G_USEC_PER_SEC;
+    g_print("%s: %u frames, object caches %s\n",
+        decoder_get_codec_name(decoder), num_frames,
+        g_strcmp0(cache_env, "0") != 0 ? "enabled" : "disabled");
+    g_print("%12.0f frames/s %8.1f ns/frame\n", num_frames / secs,
+        secs * 1e9 / num_frames);
+
+    g_object_unref(adapter);
+    gst_buffer_unref(buffer);
+    gst_vaapi_decoder_unref(decoder);
+    gst_vaapi_display_unref(display);
+    video_output_exit();
+    return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ *  bench-startcode.c - Start code scanner benchmark
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/base/gstadapter.h>
+#include "gst/vaapi/gstvaapiutils_startcode.h"
+
+/* Size of the synthetic stream used when no file is supplied */
+#define SYNTHETIC_STREAM_SIZE (32 * 1024 * 1024)
+
+static gint g_chunk_size = 4096;
+static gint g_iterations = 10;
+
+static GOptionEntry g_options[] = {
+    { "chunk-size", 's',
+      0,
+      G_OPTION_ARG_INT, &g_chunk_size,
+      "size of buffers pushed to the adapter", NULL },
+    { "iterations", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_iterations,
+      "number of passes over the stream", NULL },
+    { NULL, }
+};
+
+typedef gint (*AdapterScanFunc)(GstAdapter *adapter, guint ofs, guint size,
+    guint32 *scp);
+
+static gint
+adapter_scan_reference(GstAdapter *adapter, guint ofs, guint size,
+    guint32 *scp)
+{
+    return (gint)gst_adapter_masked_scan_uint32_peek(adapter,
+        0xffffff00, 0x00000100, ofs, size, scp);
+}
+
+/* Random payload with emulation prevention, and start codes roughly
+   every 64 KB as found in high bitrate intra streams */
+static guint8 *
+make_synthetic_stream(gsize *size_ptr)
+{
+    GRand * const rand = g_rand_new_with_seed(0x53544152);
+    guint8 * const data = g_malloc(SYNTHETIC_STREAM_SIZE);
+    gsize i, next_sc = 0;
+
+    for (i = 0; i + 4 <= SYNTHETIC_STREAM_SIZE; i++) {
+        if (i == next_sc) {
+            data[i++] = 0; data[i++] = 0; data[i++] = 1; data[i] = 0x65;
+            next_sc += 32768 + g_rand_int_range(rand, 0, 65536);
+            continue;
+        }
+        data[i] = g_rand_int_range(rand, 0, 256);
+        if (i >= 2 && data[i] <= 3 && !data[i - 1] && !data[i - 2])
+            data[i] = 3;
+    }
+    for (; i < SYNTHETIC_STREAM_SIZE; i++)
+        data[i] = 0xff;
+    g_rand_free(rand);
+
+    *size_ptr = SYNTHETIC_STREAM_SIZE;
+    return data;
+}
+
+/* Mimics the decoders parse() loop: scan, then flush up to the next unit */
+static guint
+count_adapter(AdapterScanFunc scan, const guint8 *data, gsize size)
+{
+    GstAdapter * const adapter = gst_adapter_new();
+    guint n = 0;
+    gsize ofs;
+    gint pos;
+
+    for (ofs = 0; ofs < size; ofs += g_chunk_size) {
+        const gsize len = MIN(g_chunk_size, size - ofs);
+        gst_adapter_push(adapter, gst_buffer_new_wrapped_full(
+            GST_MEMORY_FLAG_READONLY, (gpointer)(data + ofs), len, 0, len,
+            NULL, NULL));
+
+        while (gst_adapter_available(adapter) >= 4) {
+            pos = scan(adapter, 0, gst_adapter_available(adapter), NULL);
+            if (pos < 0) {
+                gst_adapter_flush(adapter, gst_adapter_available(adapter) - 3);
+                break;
+            }
+            gst_adapter_flush(adapter, pos + 3);
+            n++;
+        }
+    }
+    g_object_unref(adapter);
+    return n;
+}
+
+static guint
+count_contiguous(GstVaapiFindStartCodeFunc find, const guint8 *data,
+    gsize size)
+{
+    guint n = 0;
+    gsize ofs = 0;
+    gint pos;
+
+    while ((pos = find(data + ofs, size - ofs)) >= 0) {
+        ofs += pos + 3;
+        n++;
+    }
+    return n;
+}
+
+static void
+report(const gchar *name, gint64 elapsed, gsize size, guint count)
+{
+    const gdouble secs = elapsed / (gdouble)G_USEC_PER_SEC;
+
+    g_print("%-16s %8u start codes %10.1f MB/s\n", name, count,
+        (gdouble)size * g_iterations / (secs * 1024 * 1024));
+}
+
+int
+main(int argc, char *argv[])
+{
+    GOptionContext *ctx;
+    const GstVaapiFindStartCodeImpl *impls;
+    guint8 *data;
+    gsize size;
+    guint j, n_impls, count = 0, ref_count = 0;
+    gint i;
+    gint64 start;
+    gboolean success = TRUE;
+
+    ctx = g_option_context_new("[FILE] - start code scanner benchmark");
+    g_option_context_add_main_entries(ctx, g_options, NULL);
+    g_option_context_add_group(ctx, gst_init_get_option_group());
+    if (!g_option_context_parse(ctx, &argc, &argv, NULL)) {
+        g_option_context_free(ctx);
+        return 1;
+    }
+    g_option_context_free(ctx);
+
+    if (g_chunk_size < 4 || g_iterations < 1)
+        g_error("invalid chunk size or iteration count");
+
+    if (argc > 1) {
+        if (!g_file_get_contents(argv[1], (gchar **)&data, &size, NULL))
+            g_error("failed to read elementary stream %s", argv[1]);
+        g_print("Stream %s, %" G_GSIZE_FORMAT " bytes\n", argv[1], size);
+    }
+    else {
+        data = make_synthetic_stream(&size);
+        g_print("Synthetic stream, %" G_GSIZE_FORMAT " bytes\n", size);
+    }
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < g_iterations; i++)
+        ref_count = count_adapter(adapter_scan_reference, data, size);
+    report("adapter", g_get_monotonic_time() - start, size, ref_count);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < g_iterations; i++)
+        count = count_adapter(gst_vaapi_adapter_scan_for_start_code,
+            data, size);
+    report("adapter+simd", g_get_monotonic_time() - start, size, count);
+    success &= count == ref_count;
+
+    impls = gst_vaapi_find_start_code_get_impls(&n_impls);
+    for (j = 0; j < n_impls; j++) {
+        start = g_get_monotonic_time();
+        for (i = 0; i < g_iterations; i++)
+            count = count_contiguous(impls[j].func, data, size);
+        report(impls[j].name, g_get_monotonic_time() - start, size, count);
+        success &= count == ref_count;
+    }
+
+    if (!success)
+        g_printerr("error: start code counts differ\n");
+    g_free(data);
+    return !success;
+}
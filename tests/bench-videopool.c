@@ -0,0 +1,145 @@
+/*
+ *  bench-videopool.c - Video pool contention benchmark
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/vaapi/gstvaapisurface.h>
+#include <gst/vaapi/gstvaapisurfacepool.h>
+#include "output.h"
+
+#define MAX_HELD_OBJECTS 64
+
+static gint g_max_threads = 8;
+static gint g_iterations = 100000;
+static gint g_held_objects = 4;
+
+static GOptionEntry g_options[] = {
+    { "threads", 't',
+      0,
+      G_OPTION_ARG_INT, &g_max_threads,
+      "maximum number of concurrent threads", NULL },
+    { "iterations", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_iterations,
+      "number of get/put cycles per thread", NULL },
+    { "held", 'k',
+      0,
+      G_OPTION_ARG_INT, &g_held_objects,
+      "number of objects held by each thread in a cycle", NULL },
+    { NULL, }
+};
+
+typedef struct {
+    GstVaapiVideoPool  *pool;
+    guint               failures;
+} ThreadData;
+
+/* Mimics the decoder, sink and buffer pool threads: acquire a few
+   surfaces, then release them in a different order */
+static gpointer
+bench_thread(gpointer user_data)
+{
+    ThreadData * const data = user_data;
+    gpointer objects[MAX_HELD_OBJECTS];
+    gint i, j;
+
+    for (i = 0; i < g_iterations; i++) {
+        for (j = 0; j < g_held_objects; j++) {
+            objects[j] = gst_vaapi_video_pool_get_object(data->pool);
+            if (!objects[j])
+                data->failures++;
+        }
+        for (j = 0; j < g_held_objects; j++) {
+            gpointer const object = objects[(j + i) % g_held_objects];
+            if (object)
+                gst_vaapi_video_pool_put_object(data->pool, object);
+        }
+    }
+    return NULL;
+}
+
+static gboolean
+run_bench(GstVaapiVideoPool *pool, guint num_threads)
+{
+    GThread *threads[64];
+    ThreadData data[64];
+    gint64 start, elapsed;
+    guint i, failures = 0;
+    gdouble secs, ops;
+
+    for (i = 0; i < num_threads; i++) {
+        data[i].pool = pool;
+        data[i].failures = 0;
+    }
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < num_threads; i++)
+        threads[i] = g_thread_new("bench", bench_thread, &data[i]);
+    for (i = 0; i < num_threads; i++) {
+        g_thread_join(threads[i]);
+        failures += data[i].failures;
+    }
+    elapsed = g_get_monotonic_time() - start;
+
+    secs = elapsed / (gdouble)G_USEC_PER_SEC;
+    ops = (gdouble)num_threads * g_iterations * g_held_objects * 2;
+    g_print("%2u threads %12.0f ops/s %8.1f ns/op\n", num_threads,
+        ops / secs, secs * 1e9 / ops);
+
+    if (failures > 0)
+        g_printerr("error: %u allocations failed\n", failures);
+    return failures == 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    GstVaapiVideoPool *pool;
+    guint num_threads;
+    gboolean success = TRUE;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    if (g_max_threads < 1 || g_max_threads > 64 || g_iterations < 1 ||
+        g_held_objects < 1 || g_held_objects > MAX_HELD_OBJECTS)
+        g_error("invalid thread, iteration or held object count");
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create Gst/VA display");
+
+    pool = gst_vaapi_surface_pool_new(display, GST_VIDEO_FORMAT_ENCODED,
+        320, 240);
+    if (!pool)
+        g_error("could not create Gst/VA surface pool");
+
+    /* Allocate all surfaces upfront so that only get/put is measured */
+    gst_vaapi_video_pool_set_capacity(pool, g_max_threads * g_held_objects);
+    if (!gst_vaapi_video_pool_reserve(pool, g_max_threads * g_held_objects))
+        g_error("could not allocate Gst/VA surfaces");
+
+    for (num_threads = 1; num_threads <= (guint)g_max_threads;
+         num_threads *= 2)
+        success &= run_bench(pool, num_threads);
+
+    gst_vaapi_video_pool_unref(pool);
+    gst_vaapi_display_unref(display);
+    video_output_exit();
+    return !success;
+}
@@ -24,6 +24,7 @@
 #define DECODER_H
 
 #include <gst/vaapi/gstvaapidecoder.h>
+#include "test-decode.h"
 
 GstVaapiDecoder *
 decoder_new(GstVaapiDisplay *display, const gchar *codec_name);
@@ -34,6 +35,9 @@ decoder_put_buffers(GstVaapiDecoder *decoder);
 GstVaapiSurfaceProxy *
 decoder_get_surface(GstVaapiDecoder *decoder);
 
+gboolean
+decoder_get_video_info(GstVaapiDecoder *decoder, VideoDecodeInfo *info);
+
 const gchar *
 decoder_get_codec_name(GstVaapiDecoder *decoder);
 
@@ -0,0 +1,238 @@
+/*
+ *  test-coded-buffer-pool.c - Test coded buffer sizing heuristics
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/vaapi/gstvaapidisplay_null.h>
+#include <gst/vaapi/gstvaapiencoder_h264.h>
+#include <gst/vaapi/gstvaapicodedbuffer.h>
+#include <gst/vaapi/gstvaapicodedbufferpool.h>
+
+#define MAX_BUFFER_SIZE (4 * 1024 * 1024)
+
+/* Mirrors the margin on top of twice the largest sizes */
+#define MIN_MARGIN_SIZE (64 * 1024)
+
+static gboolean g_success = TRUE;
+
+#define CHECK(expr) G_STMT_START {                      \
+    if (!(expr)) {                                      \
+      g_print ("%s:%d: check failed: %s\n",             \
+          __FILE__, __LINE__, #expr);                   \
+      g_success = FALSE;                                \
+    }                                                   \
+  } G_STMT_END
+
+static GstVaapiEncoder *
+create_encoder (GstVaapiDisplay * display)
+{
+  GstVaapiEncoder *encoder;
+  GstVideoCodecState state = { 0, };
+  GstVaapiEncoderStatus status;
+
+  encoder = gst_vaapi_encoder_h264_new (display);
+  if (!encoder)
+    g_error ("could not create H.264 encoder");
+
+  state.ref_count = 1;
+  gst_video_info_init (&state.info);
+  gst_video_info_set_format (&state.info, GST_VIDEO_FORMAT_ENCODED, 320, 240);
+  state.info.fps_n = 30;
+  state.info.fps_d = 1;
+
+  status = gst_vaapi_encoder_set_codec_state (encoder, &state);
+  if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
+    g_error ("could not configure encoder (status %d)", status);
+  return encoder;
+}
+
+/* Reports a coded picture of @size bytes, as the driver would */
+static gboolean
+add_picture (GstVaapiVideoPool * pool, guint size, gboolean is_intra,
+    gboolean truncated)
+{
+  GstVaapiCodedBufferPool *const coded_pool = GST_VAAPI_CODED_BUFFER_POOL (pool);
+  GstVaapiCodedBuffer *buf;
+  VACodedBufferSegment *segment;
+  gboolean success;
+
+  buf = gst_vaapi_video_pool_get_object (pool);
+  if (!buf)
+    g_error ("could not allocate coded buffer");
+
+  if (!gst_vaapi_coded_buffer_map (buf, &segment))
+    g_error ("could not map coded buffer");
+  segment->size = size;
+  segment->bit_offset = 0;
+  segment->status = truncated ? VA_CODED_BUF_STATUS_SLICE_OVERFLOW_MASK : 0;
+  segment->next = NULL;
+  gst_vaapi_coded_buffer_unmap (buf);
+
+  success = gst_vaapi_coded_buffer_pool_update_stats (coded_pool, buf,
+      is_intra);
+  gst_vaapi_video_pool_put_object (pool, buf);
+  return success;
+}
+
+static void
+add_pictures (GstVaapiVideoPool * pool, guint count, guint size,
+    gboolean is_intra)
+{
+  guint i;
+
+  for (i = 0; i < count; i++)
+    CHECK (add_picture (pool, size, is_intra, FALSE));
+}
+
+static gsize
+get_optimal_size (GstVaapiVideoPool * pool)
+{
+  return gst_vaapi_coded_buffer_pool_get_optimal_buffer_size
+      (GST_VAAPI_CODED_BUFFER_POOL (pool));
+}
+
+/* Checks that the optimal size accounts for twice @size, plus a
+   safety margin, but not much more */
+static void
+check_optimal_size (GstVaapiVideoPool * pool, guint size)
+{
+  const gsize optimal_size = get_optimal_size (pool);
+  const gsize min_size = 2 * (gsize) size +
+      MAX (2 * (gsize) size / 4, MIN_MARGIN_SIZE);
+
+  CHECK (optimal_size >= min_size);
+  CHECK (optimal_size <= 2 * min_size);
+  CHECK (optimal_size <= MAX_BUFFER_SIZE);
+}
+
+/* The buffer size only departs from the maximum once enough sizes were
+   collected, then follows the 95th percentile of inter pictures */
+static void
+test_inter_window (GstVaapiEncoder * encoder)
+{
+  GstVaapiVideoPool *pool;
+
+  pool = gst_vaapi_coded_buffer_pool_new (encoder, MAX_BUFFER_SIZE);
+  CHECK (pool != NULL);
+
+  add_pictures (pool, 15, 10000, FALSE);
+  CHECK (get_optimal_size (pool) == MAX_BUFFER_SIZE);
+  add_pictures (pool, 1, 10000, FALSE);
+  check_optimal_size (pool, 10000);
+
+  /* 6 outliers out of 128 pictures are below the 95th percentile */
+  add_pictures (pool, 106, 10000, FALSE);
+  add_pictures (pool, 6, 100000, FALSE);
+  check_optimal_size (pool, 10000);
+
+  /* ... but not 7 of them */
+  add_pictures (pool, 1, 100000, FALSE);
+  check_optimal_size (pool, 100000);
+
+  /* Large pictures leave the window after 128 pictures */
+  add_pictures (pool, 128, 20000, FALSE);
+  check_optimal_size (pool, 20000);
+
+  gst_vaapi_video_pool_unref (pool);
+}
+
+/* The largest of the last intra pictures is always accounted for */
+static void
+test_intra_window (GstVaapiEncoder * encoder)
+{
+  GstVaapiVideoPool *pool;
+
+  pool = gst_vaapi_coded_buffer_pool_new (encoder, MAX_BUFFER_SIZE);
+  CHECK (pool != NULL);
+
+  add_pictures (pool, 1, 300000, TRUE);
+  add_pictures (pool, 15, 10000, FALSE);
+  check_optimal_size (pool, 300000);
+
+  add_pictures (pool, 7, 40000, TRUE);
+  check_optimal_size (pool, 300000);
+  add_pictures (pool, 1, 40000, TRUE);
+  check_optimal_size (pool, 40000);
+
+  /* Sizes are capped to the maximum */
+  add_pictures (pool, 1, MAX_BUFFER_SIZE, TRUE);
+  CHECK (get_optimal_size (pool) == MAX_BUFFER_SIZE);
+
+  gst_vaapi_video_pool_unref (pool);
+}
+
+/* An overflow of a reduced buffer is reported, and brings buffers back
+   to the maximum size for good */
+static void
+test_overflow (GstVaapiEncoder * encoder)
+{
+  GstVaapiVideoPool *pool, *resized_pool;
+  gsize buf_size;
+
+  pool = gst_vaapi_coded_buffer_pool_new (encoder, MAX_BUFFER_SIZE);
+  CHECK (pool != NULL);
+
+  add_pictures (pool, 16, 10000, FALSE);
+  buf_size = get_optimal_size (pool);
+  CHECK (buf_size < MAX_BUFFER_SIZE);
+
+  /* Overflows of full size buffers do not disable sizing */
+  CHECK (!add_picture (pool, 10000, FALSE, TRUE));
+  CHECK (get_optimal_size (pool) == buf_size);
+
+  resized_pool = gst_vaapi_coded_buffer_pool_new_resized
+      (GST_VAAPI_CODED_BUFFER_POOL (pool), buf_size);
+  CHECK (resized_pool != NULL);
+  CHECK (gst_vaapi_coded_buffer_pool_get_buffer_size
+      (GST_VAAPI_CODED_BUFFER_POOL (resized_pool)) == buf_size);
+  check_optimal_size (resized_pool, 10000);
+
+  CHECK (!add_picture (resized_pool, buf_size, FALSE, TRUE));
+  CHECK (get_optimal_size (resized_pool) == MAX_BUFFER_SIZE);
+
+  add_pictures (resized_pool, 128, 10000, FALSE);
+  CHECK (get_optimal_size (resized_pool) == MAX_BUFFER_SIZE);
+
+  gst_vaapi_video_pool_unref (resized_pool);
+  gst_vaapi_video_pool_unref (pool);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstVaapiDisplay *display;
+  GstVaapiEncoder *encoder;
+
+  gst_init (&argc, &argv);
+
+  display = gst_vaapi_display_null_new (NULL);
+  if (!display)
+    g_error ("could not create VA/NULL display");
+  encoder = create_encoder (display);
+
+  test_inter_window (encoder);
+  test_intra_window (encoder);
+  test_overflow (encoder);
+
+  gst_vaapi_encoder_unref (encoder);
+  gst_vaapi_display_unref (display);
+  gst_deinit ();
+
+  g_print ("coded buffer pool: %s\n", g_success ? "PASS" : "FAIL");
+  return g_success ? 0 : 1;
+}
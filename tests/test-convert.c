@@ -0,0 +1,204 @@
+/*
+ *  test-convert.c - Test conversions to NV12 on upload
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gst/vaapi/sysdeps.h"
+#include <string.h>
+#include <gst/video/video.h>
+#include <gst/vaapi/gstvaapiutils_convert.h>
+
+/* Value of the destination bytes that shall not be written */
+#define GUARD_BYTE 0xa5
+
+/* Odd sizes exercise the C code that completes the SSE2 loops, and
+   the last line or column of chroma samples */
+static const struct
+{
+  guint width;
+  guint height;
+} g_sizes[] = {
+  {1, 1},
+  {2, 2},
+  {15, 3},
+  {16, 16},
+  {17, 5},
+  {33, 7},
+  {64, 16},
+  {95, 31},
+  {130, 2},
+};
+
+static const GstVideoColorMatrix g_matrices[] = {
+  GST_VIDEO_COLOR_MATRIX_BT601,
+  GST_VIDEO_COLOR_MATRIX_BT709,
+};
+
+typedef struct
+{
+  guint8 *data;
+  guint8 *planes[2];
+  guint strides[2];
+  gsize size;
+} Image;
+
+static void
+image_init (Image * image, guint width, guint height)
+{
+  /* Leave some room past the end of each line, and past the last line
+     of each plane, to catch out of bounds writes */
+  image->strides[0] = GST_ROUND_UP_16 (width) + 16;
+  image->strides[1] = image->strides[0];
+  image->size = image->strides[0] * (height + 1) +
+      image->strides[1] * ((height + 1) / 2 + 1);
+  image->data = g_malloc (image->size);
+  memset (image->data, GUARD_BYTE, image->size);
+  image->planes[0] = image->data;
+  image->planes[1] = image->data + image->strides[0] * (height + 1);
+}
+
+static void
+image_clear (Image * image)
+{
+  g_free (image->data);
+}
+
+/* Checks that only the @width x @height pixels were written */
+static gboolean
+image_check_guards (const Image * image, guint width, guint height)
+{
+  const guint8 *const end = image->data + image->size;
+  const guint8 *p, *line;
+  guint i, y, line_width, num_lines;
+
+  for (i = 0; i < 2; i++) {
+    line_width = i == 0 ? width : 2 * ((width + 1) / 2);
+    num_lines = i == 0 ? height : (height + 1) / 2;
+    for (y = 0; y < num_lines; y++) {
+      line = image->planes[i] + y * image->strides[i];
+      for (p = line + line_width; p < line + image->strides[i]; p++) {
+        if (*p != GUARD_BYTE)
+          return FALSE;
+      }
+    }
+    line = image->planes[i] + num_lines * image->strides[i];
+    for (p = line; p < (i == 0 ? image->planes[1] : end); p++) {
+      if (*p != GUARD_BYTE)
+        return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static gboolean
+test_format (GRand * rand, GstVideoFormat format, guint width, guint height,
+    GstVideoColorMatrix matrix)
+{
+  const GstVaapiConvertImpl *impls;
+  guint i, n_impls;
+  GstVideoInfo vi;
+  guint8 *src_data, *src[3];
+  guint src_strides[3];
+  Image ref, image;
+  gboolean success = TRUE;
+
+  gst_video_info_set_format (&vi, format, width, height);
+  src_data = g_malloc (GST_VIDEO_INFO_SIZE (&vi));
+  for (i = 0; i < GST_VIDEO_INFO_SIZE (&vi); i++)
+    src_data[i] = g_rand_int_range (rand, 0, 256);
+  for (i = 0; i < 3; i++) {
+    if (i < GST_VIDEO_INFO_N_PLANES (&vi)) {
+      src[i] = src_data + GST_VIDEO_INFO_PLANE_OFFSET (&vi, i);
+      src_strides[i] = GST_VIDEO_INFO_PLANE_STRIDE (&vi, i);
+    } else {
+      src[i] = NULL;
+      src_strides[i] = 0;
+    }
+  }
+
+  /* The plain C implementation is the reference */
+  impls = gst_vaapi_convert_get_impls (&n_impls);
+  image_init (&ref, width, height);
+  if (!impls[0].to_NV12 (ref.planes, ref.strides, format, src, src_strides,
+          width, height, matrix) || !image_check_guards (&ref, width, height)) {
+    g_print ("%s %ux%u: %s conversion failed\n",
+        gst_video_format_to_string (format), width, height, impls[0].name);
+    success = FALSE;
+  }
+
+  for (i = 1; success && i < n_impls; i++) {
+    image_init (&image, width, height);
+    if (!impls[i].to_NV12 (image.planes, image.strides, format, src,
+            src_strides, width, height, matrix) ||
+        memcmp (image.data, ref.data, ref.size) != 0) {
+      g_print ("%s %ux%u: %s output differs from %s output\n",
+          gst_video_format_to_string (format), width, height, impls[i].name,
+          impls[0].name);
+      success = FALSE;
+    }
+    image_clear (&image);
+  }
+
+  image_clear (&ref);
+  g_free (src_data);
+  return success;
+}
+
+int
+main (int argc, char *argv[])
+{
+  const GstVideoFormat *formats;
+  const GstVaapiConvertImpl *impls;
+  guint i, j, k, n_formats, n_impls, n_matrices;
+  GstVideoFormat format;
+  GRand *rand;
+  gboolean success = TRUE;
+
+  gst_init (&argc, &argv);
+
+  impls = gst_vaapi_convert_get_impls (&n_impls);
+  g_print ("implementations:");
+  for (i = 0; i < n_impls; i++)
+    g_print (" %s", impls[i].name);
+  g_print ("\n");
+
+  rand = g_rand_new_with_seed (0x5eed);
+  formats = gst_vaapi_convert_get_src_formats (&n_formats);
+  for (i = 0; i < n_formats; i++) {
+    format = formats[i];
+    if (!gst_vaapi_convert_is_supported (GST_VIDEO_FORMAT_NV12, format)) {
+      g_print ("%s: not supported\n", gst_video_format_to_string (format));
+      success = FALSE;
+      continue;
+    }
+
+    /* Only RGB sources depend on the color matrix */
+    n_matrices = GST_VIDEO_FORMAT_INFO_IS_RGB (gst_video_format_get_info
+        (format)) ? G_N_ELEMENTS (g_matrices) : 1;
+    for (j = 0; j < G_N_ELEMENTS (g_sizes); j++) {
+      for (k = 0; k < n_matrices; k++)
+        success &= test_format (rand, format, g_sizes[j].width,
+            g_sizes[j].height, g_matrices[k]);
+    }
+  }
+  g_rand_free (rand);
+
+  gst_deinit ();
+
+  g_print ("convert: %s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
@@ -0,0 +1,334 @@
+/*
+ *  test-parse-ahead.c - Test decoding with the parser thread enabled
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/base/gstadapter.h>
+#include <gst/vaapi/gstvaapidisplay_null.h>
+#include "decoder.h"
+#include "output.h"
+
+/* Chunk size used to split the input stream, so that frames straddle
+   buffer boundaries */
+#define CHUNK_SIZE 4093
+
+static gint g_repeat = 32;
+static gint g_max_frames = 4;
+
+static GOptionEntry g_options[] = {
+    { "repeat", 'r',
+      0,
+      G_OPTION_ARG_INT, &g_repeat,
+      "number of times the sample clip is repeated", NULL },
+    { "parse-ahead", 'p',
+      0,
+      G_OPTION_ARG_INT, &g_max_frames,
+      "maximum number of frames to parse ahead", NULL },
+    { NULL, }
+};
+
+typedef struct {
+    guint       num_frames;
+    guint64     num_pictures;
+} DecodeResult;
+
+static GstBuffer *
+make_stream(GstVaapiDecoder *decoder, gsize *clip_size_ptr)
+{
+    VideoDecodeInfo info;
+    GByteArray *bytes;
+    gint i;
+
+    if (!decoder_get_video_info(decoder, &info))
+        g_error("could not find sample clip");
+    *clip_size_ptr = info.data_size;
+
+    bytes = g_byte_array_sized_new(info.data_size * g_repeat);
+    for (i = 0; i < g_repeat; i++)
+        g_byte_array_append(bytes, info.data, info.data_size);
+    return gst_buffer_new_wrapped(g_byte_array_free(bytes, FALSE),
+        info.data_size * g_repeat);
+}
+
+static GstVaapiDecoder *
+create_decoder(GstVaapiDisplay *display, guint max_frames)
+{
+    GstVaapiDecoder *decoder;
+
+    decoder = decoder_new(display, "h264");
+    if (!decoder)
+        g_error("could not create decoder");
+
+    if (!gst_vaapi_decoder_set_parse_ahead(decoder, max_frames))
+        g_error("could not enable parse-ahead");
+    return decoder;
+}
+
+static void
+pop_frames(GstVaapiDecoder *decoder, DecodeResult *result)
+{
+    GstVideoCodecFrame *frame;
+
+    while (gst_vaapi_decoder_get_frame(decoder, &frame) ==
+           GST_VAAPI_DECODER_STATUS_SUCCESS) {
+        if (!GST_VIDEO_CODEC_FRAME_IS_DECODE_ONLY(frame))
+            result->num_frames++;
+        gst_video_codec_frame_unref(frame);
+    }
+}
+
+/* Submits @stream from @offset up to @end_offset, or up to the end of
+   the stream and <end-of-stream> if @end_offset is -1, and counts the
+   surfaces that get decoded */
+static void
+put_buffers(GstVaapiDecoder *decoder, GstBuffer *stream, gsize offset,
+    gssize end_offset, DecodeResult *result)
+{
+    GstVaapiDecoderStatus status;
+    GstVaapiSurfaceProxy *proxy;
+    GstBuffer *buffer;
+    gsize size;
+
+    size = end_offset < 0 ? gst_buffer_get_size(stream) : end_offset;
+    for (; offset <= size; offset += CHUNK_SIZE) {
+        if (offset < size) {
+            buffer = gst_buffer_copy_region(stream, GST_BUFFER_COPY_ALL,
+                offset, MIN(CHUNK_SIZE, size - offset));
+            if (!gst_vaapi_decoder_put_buffer(decoder, buffer))
+                g_error("could not submit buffer");
+            gst_buffer_unref(buffer);
+        }
+        else if (end_offset >= 0)
+            break;
+        else if (!gst_vaapi_decoder_put_buffer(decoder, NULL))
+            g_error("could not submit <end-of-stream>");
+
+        for (;;) {
+            status = gst_vaapi_decoder_get_surface(decoder, &proxy);
+            if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+                break;
+            gst_vaapi_surface_proxy_unref(proxy);
+            result->num_frames++;
+        }
+        if (status != GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA &&
+            status != GST_VAAPI_DECODER_STATUS_END_OF_STREAM)
+            g_error("failed to decode frame (status %d)", status);
+    }
+}
+
+/* Decodes through gst_vaapi_decoder_put_buffer() and
+   gst_vaapi_decoder_get_surface() */
+static void
+decode_buffers(GstVaapiDisplay *display, GstBuffer *stream, guint max_frames,
+    DecodeResult *result)
+{
+    GstVaapiDecoder *decoder;
+
+    gst_vaapi_display_null_reset_counters(GST_VAAPI_DISPLAY_NULL(display));
+    decoder = create_decoder(display, max_frames);
+    result->num_frames = 0;
+
+    put_buffers(decoder, stream, 0, -1, result);
+
+    result->num_pictures = gst_vaapi_display_null_get_picture_count(
+        GST_VAAPI_DISPLAY_NULL(display));
+    gst_vaapi_decoder_unref(decoder);
+}
+
+/* Decodes @stream up to @stop_offset, in the middle of a frame, then
+   flushes the decoder and seeks to @seek_offset, the start of a clip.
+   Only the frames that follow the seek are counted, and the data left
+   over before the flush shall not show up there */
+static void
+decode_seek(GstVaapiDisplay *display, GstBuffer *stream, gsize stop_offset,
+    gsize seek_offset, guint max_frames, DecodeResult *result)
+{
+    GstVaapiDecoder *decoder;
+    GstVaapiDecoderStatus status;
+    DecodeResult discarded = { 0, };
+
+    decoder = create_decoder(display, max_frames);
+    put_buffers(decoder, stream, 0, stop_offset, &discarded);
+
+    status = gst_vaapi_decoder_flush(decoder);
+    if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+        g_error("failed to flush decoder (status %d)", status);
+    pop_frames(decoder, &discarded);
+
+    gst_vaapi_display_null_reset_counters(GST_VAAPI_DISPLAY_NULL(display));
+    result->num_frames = 0;
+    put_buffers(decoder, stream, seek_offset, -1, result);
+
+    result->num_pictures = gst_vaapi_display_null_get_picture_count(
+        GST_VAAPI_DISPLAY_NULL(display));
+    gst_vaapi_decoder_unref(decoder);
+}
+
+/* Mimics the vaapidecode parse() and handle_frame() loops. Bytes that
+   belong to the current frame move to an output adapter, the way
+   gst_video_decoder_add_to_frame() does */
+static void
+parse_and_decode(GstVaapiDecoder *decoder, GstAdapter *adapter,
+    GstAdapter *frame_adapter, GstVideoCodecFrame **frame_ptr,
+    gboolean at_eos, DecodeResult *result)
+{
+    GstVideoCodecFrame *frame;
+    GstVaapiDecoderStatus status;
+    guint got_unit_size;
+    gboolean got_frame;
+
+    while (gst_adapter_available(adapter) > 0) {
+        frame = *frame_ptr;
+        if (!frame) {
+            frame = g_slice_new0(GstVideoCodecFrame);
+            frame->ref_count = 1;
+            *frame_ptr = frame;
+        }
+
+        do {
+            status = gst_vaapi_decoder_parse(decoder, frame, adapter, at_eos,
+                &got_unit_size, &got_frame);
+            if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+                break;
+            if (got_unit_size > 0)
+                gst_adapter_push(frame_adapter,
+                    gst_adapter_take_buffer(adapter, got_unit_size));
+        } while (!got_frame);
+
+        if (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA)
+            break;
+        if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+            g_error("failed to parse frame (status %d)", status);
+
+        *frame_ptr = NULL;
+        frame->input_buffer = gst_adapter_take_buffer(frame_adapter,
+            gst_adapter_available(frame_adapter));
+        status = gst_vaapi_decoder_decode(decoder, frame);
+        gst_video_codec_frame_unref(frame);
+        if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+            g_error("failed to decode frame (status %d)", status);
+        pop_frames(decoder, result);
+    }
+}
+
+/* Decodes through gst_vaapi_decoder_parse() and
+   gst_vaapi_decoder_decode(), as vaapidecode does */
+static void
+decode_frames(GstVaapiDisplay *display, GstBuffer *stream, guint max_frames,
+    DecodeResult *result)
+{
+    GstVaapiDecoder *decoder;
+    GstAdapter *adapter, *frame_adapter;
+    GstVideoCodecFrame *frame = NULL;
+    GstVaapiDecoderStatus status;
+    gsize offset, size;
+
+    gst_vaapi_display_null_reset_counters(GST_VAAPI_DISPLAY_NULL(display));
+    decoder = create_decoder(display, max_frames);
+    adapter = gst_adapter_new();
+    frame_adapter = gst_adapter_new();
+    result->num_frames = 0;
+
+    size = gst_buffer_get_size(stream);
+    for (offset = 0; offset < size; offset += CHUNK_SIZE) {
+        gst_adapter_push(adapter, gst_buffer_copy_region(stream,
+                GST_BUFFER_COPY_ALL, offset, MIN(CHUNK_SIZE, size - offset)));
+        parse_and_decode(decoder, adapter, frame_adapter, &frame, FALSE,
+            result);
+    }
+    parse_and_decode(decoder, adapter, frame_adapter, &frame, TRUE, result);
+    if (frame)
+        gst_video_codec_frame_unref(frame);
+
+    status = gst_vaapi_decoder_flush(decoder);
+    if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+        g_error("failed to flush decoder (status %d)", status);
+    pop_frames(decoder, result);
+
+    result->num_pictures = gst_vaapi_display_null_get_picture_count(
+        GST_VAAPI_DISPLAY_NULL(display));
+    g_object_unref(frame_adapter);
+    g_object_unref(adapter);
+    gst_vaapi_decoder_unref(decoder);
+}
+
+static gboolean
+check_results(const gchar *name, const DecodeResult *ref,
+    const DecodeResult *res)
+{
+    const gboolean success = res->num_frames == ref->num_frames &&
+        res->num_pictures == ref->num_pictures && ref->num_frames > 0;
+
+    g_print("%s: %u frames, %" G_GUINT64_FORMAT " pictures (expected %u, %"
+        G_GUINT64_FORMAT "): %s\n", name, res->num_frames, res->num_pictures,
+        ref->num_frames, ref->num_pictures, success ? "PASS" : "FAIL");
+    return success;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    GstVaapiDecoder *decoder;
+    GstBuffer *stream, *tail;
+    DecodeResult ref, res;
+    gsize clip_size, seek_offset, stop_offset;
+    gboolean success = TRUE;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    if (g_repeat < 1 || g_max_frames < 1)
+        g_error("invalid options");
+
+    display = gst_vaapi_display_null_new(NULL);
+    if (!display)
+        g_error("could not create VA/NULL display");
+
+    decoder = decoder_new(display, "h264");
+    if (!decoder)
+        g_error("could not create decoder");
+    stream = make_stream(decoder, &clip_size);
+    gst_vaapi_decoder_unref(decoder);
+
+    decode_buffers(display, stream, 0, &ref);
+    decode_buffers(display, stream, g_max_frames, &res);
+    success &= check_results("put_buffer()", &ref, &res);
+
+    decode_frames(display, stream, 0, &ref);
+    decode_frames(display, stream, g_max_frames, &res);
+    success &= check_results("parse()", &ref, &res);
+
+    /* The reference is a fresh decoder that starts at the seek point */
+    seek_offset = clip_size * (g_repeat / 2);
+    tail = gst_buffer_copy_region(stream, GST_BUFFER_COPY_ALL, seek_offset,
+        gst_buffer_get_size(stream) - seek_offset);
+    decode_buffers(display, tail, 0, &ref);
+    gst_buffer_unref(tail);
+
+    stop_offset = seek_offset + clip_size / 3;
+    decode_seek(display, stream, stop_offset, seek_offset, 0, &res);
+    success &= check_results("seek", &ref, &res);
+    decode_seek(display, stream, stop_offset, seek_offset, g_max_frames, &res);
+    success &= check_results("seek, parse-ahead", &ref, &res);
+
+    gst_buffer_unref(stream);
+    gst_vaapi_display_unref(display);
+    video_output_exit();
+    return success ? 0 : 1;
+}